@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/RedBlackTree.h>
+
+namespace AK {
+
+template<typename K>
+class IntrusiveRedBlackTreeNode;
+
+template<typename K, typename V, IntrusiveRedBlackTreeNode<K> V::*member>
+class IntrusiveRedBlackTree;
+
+template<typename K>
+class IntrusiveRedBlackTreeNode : public BaseRedBlackTree<K>::Node {
+public:
+    IntrusiveRedBlackTreeNode() = default;
+    ~IntrusiveRedBlackTreeNode() { VERIFY(!is_in_tree()); }
+
+    bool is_in_tree() const { return m_in_tree; }
+
+private:
+    template<typename TK, typename TV, IntrusiveRedBlackTreeNode<TK> TV::*>
+    friend class IntrusiveRedBlackTree;
+
+    bool m_in_tree { false };
+};
+
+// A RedBlackTree that links values through a node embedded in them instead of
+// allocating its own. It never owns the values it contains.
+template<typename K, typename V, IntrusiveRedBlackTreeNode<K> V::*member>
+class IntrusiveRedBlackTree final : public BaseRedBlackTree<K> {
+    using BaseTree = BaseRedBlackTree<K>;
+    using BaseNode = typename BaseTree::Node;
+    using TreeNode = IntrusiveRedBlackTreeNode<K>;
+
+public:
+    IntrusiveRedBlackTree() = default;
+    ~IntrusiveRedBlackTree() { clear(); }
+
+    V* find(K key) { return node_to_value_or_null(BaseTree::find_node(key)); }
+    const V* find(K key) const { return node_to_value_or_null(BaseTree::find_node(key)); }
+
+    // Returns the value with the greatest key that is less than or equal to the given one.
+    V* find_largest_not_above(K key) { return node_to_value_or_null(BaseTree::find_largest_not_above_node(key)); }
+    const V* find_largest_not_above(K key) const { return node_to_value_or_null(BaseTree::find_largest_not_above_node(key)); }
+
+    // Returns the value with the smallest key that is greater than or equal to the given one.
+    V* find_smallest_not_below(K key) { return node_to_value_or_null(BaseTree::find_smallest_not_below_node(key)); }
+    const V* find_smallest_not_below(K key) const { return node_to_value_or_null(BaseTree::find_smallest_not_below_node(key)); }
+
+    V* first() { return node_to_value_or_null(BaseTree::leftmost(this->m_root)); }
+
+    void insert(K key, V& value)
+    {
+        auto& node = value.*member;
+        VERIFY(!node.m_in_tree);
+        node.key = key;
+        BaseTree::insert(&node);
+        node.m_in_tree = true;
+    }
+
+    bool remove(K key)
+    {
+        auto* node = static_cast<TreeNode*>(BaseTree::find_node(key));
+        if (!node)
+            return false;
+        BaseTree::remove(node);
+        node->m_in_tree = false;
+        return true;
+    }
+
+    void clear()
+    {
+        while (this->m_root)
+            remove(this->m_root->key);
+    }
+
+private:
+    static V& node_to_value(BaseNode& node)
+    {
+        auto& tree_node = static_cast<TreeNode&>(node);
+        return *(V*)((char*)&tree_node - ((char*)&(((V*)nullptr)->*member) - (char*)nullptr));
+    }
+
+    static const V& node_to_value(const BaseNode& node)
+    {
+        return node_to_value(const_cast<BaseNode&>(node));
+    }
+
+    static V* node_to_value_or_null(BaseNode* node) { return node ? &node_to_value(*node) : nullptr; }
+
+    template<typename, typename, typename>
+    friend class RedBlackTreeIterator;
+
+public:
+    using Iterator = RedBlackTreeIterator<IntrusiveRedBlackTree, BaseNode, V>;
+    using ConstIterator = RedBlackTreeIterator<const IntrusiveRedBlackTree, const BaseNode, const V>;
+
+    Iterator begin() { return Iterator(BaseTree::leftmost(this->m_root)); }
+    Iterator end() { return {}; }
+    ConstIterator begin() const { return ConstIterator(BaseTree::leftmost(this->m_root)); }
+    ConstIterator end() const { return {}; }
+};
+
+}
+
+using AK::IntrusiveRedBlackTree;
+using AK::IntrusiveRedBlackTreeNode;
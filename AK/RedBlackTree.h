@@ -0,0 +1,457 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Assertions.h>
+#include <AK/Noncopyable.h>
+#include <AK/StdLibExtras.h>
+#include <AK/Types.h>
+
+namespace AK {
+
+// An ordered map with unique keys. Lookups, insertions and removals are O(log n).
+// Since the nodes are never moved, a pointer to a value stays valid until that
+// value itself is removed from the tree.
+template<typename K>
+class BaseRedBlackTree {
+    AK_MAKE_NONCOPYABLE(BaseRedBlackTree);
+    AK_MAKE_NONMOVABLE(BaseRedBlackTree);
+
+public:
+    size_t size() const { return m_size; }
+    bool is_empty() const { return m_size == 0; }
+
+    enum class Color : bool {
+        Red,
+        Black,
+    };
+
+    struct Node {
+        Node* left_child { nullptr };
+        Node* right_child { nullptr };
+        Node* parent { nullptr };
+        Color color { Color::Red };
+        K key {};
+    };
+
+protected:
+    BaseRedBlackTree() = default;
+    ~BaseRedBlackTree() = default;
+
+    static bool is_black(const Node* node) { return !node || node->color == Color::Black; }
+
+    void rotate_left(Node* node)
+    {
+        auto* pivot = node->right_child;
+        VERIFY(pivot);
+        node->right_child = pivot->left_child;
+        if (pivot->left_child)
+            pivot->left_child->parent = node;
+        replace_in_parent(node, pivot);
+        pivot->left_child = node;
+        node->parent = pivot;
+    }
+
+    void rotate_right(Node* node)
+    {
+        auto* pivot = node->left_child;
+        VERIFY(pivot);
+        node->left_child = pivot->right_child;
+        if (pivot->right_child)
+            pivot->right_child->parent = node;
+        replace_in_parent(node, pivot);
+        pivot->right_child = node;
+        node->parent = pivot;
+    }
+
+    void replace_in_parent(Node* node, Node* replacement)
+    {
+        if (!node->parent)
+            m_root = replacement;
+        else if (node->parent->left_child == node)
+            node->parent->left_child = replacement;
+        else
+            node->parent->right_child = replacement;
+        if (replacement)
+            replacement->parent = node->parent;
+    }
+
+    void insert(Node* node)
+    {
+        node->left_child = nullptr;
+        node->right_child = nullptr;
+        node->color = Color::Red;
+
+        Node* parent = nullptr;
+        for (auto* temp = m_root; temp;) {
+            VERIFY(node->key != temp->key);
+            parent = temp;
+            temp = node->key < temp->key ? temp->left_child : temp->right_child;
+        }
+        node->parent = parent;
+        if (!parent)
+            m_root = node;
+        else if (node->key < parent->key)
+            parent->left_child = node;
+        else
+            parent->right_child = node;
+        ++m_size;
+
+        while (node->parent && node->parent->color == Color::Red) {
+            // NOTE: The root is always black, so a red parent always has a parent of its own.
+            auto* grandparent = node->parent->parent;
+            if (node->parent == grandparent->left_child) {
+                auto* uncle = grandparent->right_child;
+                if (!is_black(uncle)) {
+                    node->parent->color = Color::Black;
+                    uncle->color = Color::Black;
+                    grandparent->color = Color::Red;
+                    node = grandparent;
+                    continue;
+                }
+                if (node == node->parent->right_child) {
+                    node = node->parent;
+                    rotate_left(node);
+                }
+                node->parent->color = Color::Black;
+                grandparent->color = Color::Red;
+                rotate_right(grandparent);
+            } else {
+                auto* uncle = grandparent->left_child;
+                if (!is_black(uncle)) {
+                    node->parent->color = Color::Black;
+                    uncle->color = Color::Black;
+                    grandparent->color = Color::Red;
+                    node = grandparent;
+                    continue;
+                }
+                if (node == node->parent->left_child) {
+                    node = node->parent;
+                    rotate_right(node);
+                }
+                node->parent->color = Color::Black;
+                grandparent->color = Color::Red;
+                rotate_left(grandparent);
+            }
+        }
+        m_root->color = Color::Black;
+    }
+
+    void remove(Node* node)
+    {
+        Node* child = nullptr;
+        Node* parent = nullptr;
+        Color removed_color = node->color;
+
+        if (!node->left_child || !node->right_child) {
+            child = node->left_child ? node->left_child : node->right_child;
+            parent = node->parent;
+            replace_in_parent(node, child);
+        } else {
+            // Splice the in-order successor into the place of the removed node.
+            auto* successor = leftmost(node->right_child);
+            removed_color = successor->color;
+            child = successor->right_child;
+            if (successor->parent == node) {
+                parent = successor;
+            } else {
+                parent = successor->parent;
+                parent->left_child = child;
+                if (child)
+                    child->parent = parent;
+                successor->right_child = node->right_child;
+                successor->right_child->parent = successor;
+            }
+            replace_in_parent(node, successor);
+            successor->left_child = node->left_child;
+            successor->left_child->parent = successor;
+            successor->color = node->color;
+        }
+
+        node->left_child = nullptr;
+        node->right_child = nullptr;
+        node->parent = nullptr;
+        --m_size;
+
+        if (removed_color == Color::Red)
+            return;
+
+        while (child != m_root && is_black(child)) {
+            if (child == parent->left_child) {
+                auto* sibling = parent->right_child;
+                if (!is_black(sibling)) {
+                    sibling->color = Color::Black;
+                    parent->color = Color::Red;
+                    rotate_left(parent);
+                    sibling = parent->right_child;
+                }
+                if (is_black(sibling->left_child) && is_black(sibling->right_child)) {
+                    sibling->color = Color::Red;
+                    child = parent;
+                    parent = child->parent;
+                    continue;
+                }
+                if (is_black(sibling->right_child)) {
+                    sibling->left_child->color = Color::Black;
+                    sibling->color = Color::Red;
+                    rotate_right(sibling);
+                    sibling = parent->right_child;
+                }
+                sibling->color = parent->color;
+                parent->color = Color::Black;
+                sibling->right_child->color = Color::Black;
+                rotate_left(parent);
+            } else {
+                auto* sibling = parent->left_child;
+                if (!is_black(sibling)) {
+                    sibling->color = Color::Black;
+                    parent->color = Color::Red;
+                    rotate_right(parent);
+                    sibling = parent->left_child;
+                }
+                if (is_black(sibling->left_child) && is_black(sibling->right_child)) {
+                    sibling->color = Color::Red;
+                    child = parent;
+                    parent = child->parent;
+                    continue;
+                }
+                if (is_black(sibling->left_child)) {
+                    sibling->right_child->color = Color::Black;
+                    sibling->color = Color::Red;
+                    rotate_left(sibling);
+                    sibling = parent->left_child;
+                }
+                sibling->color = parent->color;
+                parent->color = Color::Black;
+                sibling->left_child->color = Color::Black;
+                rotate_right(parent);
+            }
+            child = m_root;
+        }
+        if (child)
+            child->color = Color::Black;
+    }
+
+    Node* find_node(K key) const
+    {
+        auto* node = m_root;
+        while (node && node->key != key)
+            node = key < node->key ? node->left_child : node->right_child;
+        return node;
+    }
+
+    Node* find_largest_not_above_node(K key) const
+    {
+        Node* candidate = nullptr;
+        for (auto* node = m_root; node;) {
+            if (node->key == key)
+                return node;
+            if (key < node->key) {
+                node = node->left_child;
+            } else {
+                candidate = node;
+                node = node->right_child;
+            }
+        }
+        return candidate;
+    }
+
+    Node* find_smallest_not_below_node(K key) const
+    {
+        Node* candidate = nullptr;
+        for (auto* node = m_root; node;) {
+            if (node->key == key)
+                return node;
+            if (key > node->key) {
+                node = node->right_child;
+            } else {
+                candidate = node;
+                node = node->left_child;
+            }
+        }
+        return candidate;
+    }
+
+    static Node* leftmost(Node* node)
+    {
+        if (!node)
+            return nullptr;
+        while (node->left_child)
+            node = node->left_child;
+        return node;
+    }
+
+    static Node* successor(const Node* node)
+    {
+        if (node->right_child)
+            return leftmost(node->right_child);
+        auto* parent = node->parent;
+        while (parent && node == parent->right_child) {
+            node = parent;
+            parent = parent->parent;
+        }
+        return parent;
+    }
+
+    Node* m_root { nullptr };
+    size_t m_size { 0 };
+};
+
+template<typename TreeType, typename NodeType, typename ElementType>
+class RedBlackTreeIterator {
+public:
+    RedBlackTreeIterator() = default;
+    explicit RedBlackTreeIterator(NodeType* node)
+        : m_node(node)
+    {
+    }
+
+    bool operator==(const RedBlackTreeIterator& other) const { return m_node == other.m_node; }
+    bool operator!=(const RedBlackTreeIterator& other) const { return m_node != other.m_node; }
+
+    RedBlackTreeIterator& operator++()
+    {
+        m_node = static_cast<NodeType*>(TreeType::successor(m_node));
+        return *this;
+    }
+
+    ElementType& operator*() const { return TreeType::node_to_value(*m_node); }
+    ElementType* operator->() const { return &TreeType::node_to_value(*m_node); }
+
+    auto key() const { return m_node->key; }
+
+private:
+    NodeType* m_node { nullptr };
+};
+
+template<typename K, typename V>
+class RedBlackTree final : public BaseRedBlackTree<K> {
+    using BaseTree = BaseRedBlackTree<K>;
+
+public:
+    RedBlackTree() = default;
+    ~RedBlackTree() { clear(); }
+
+    V* find(K key)
+    {
+        auto* node = static_cast<Node*>(BaseTree::find_node(key));
+        return node ? &node->value : nullptr;
+    }
+
+    const V* find(K key) const { return const_cast<RedBlackTree&>(*this).find(key); }
+
+    // Returns the value with the greatest key that is less than or equal to the given one.
+    V* find_largest_not_above(K key)
+    {
+        auto* node = static_cast<Node*>(BaseTree::find_largest_not_above_node(key));
+        return node ? &node->value : nullptr;
+    }
+
+    // Returns the value with the smallest key that is greater than or equal to the given one.
+    V* find_smallest_not_below(K key)
+    {
+        auto* node = static_cast<Node*>(BaseTree::find_smallest_not_below_node(key));
+        return node ? &node->value : nullptr;
+    }
+
+    V& insert(K key, const V& value)
+    {
+        auto* node = new Node(key, value);
+        BaseTree::insert(node);
+        return node->value;
+    }
+
+    V& insert(K key, V&& value)
+    {
+        auto* node = new Node(key, move(value));
+        BaseTree::insert(node);
+        return node->value;
+    }
+
+    bool remove(K key)
+    {
+        auto* node = static_cast<Node*>(BaseTree::find_node(key));
+        if (!node)
+            return false;
+        BaseTree::remove(node);
+        delete node;
+        return true;
+    }
+
+    void clear()
+    {
+        delete_subtree(static_cast<Node*>(this->m_root));
+        this->m_root = nullptr;
+        this->m_size = 0;
+    }
+
+private:
+    struct Node : BaseTree::Node {
+        Node(K key, const V& value)
+            : value(value)
+        {
+            this->key = key;
+        }
+
+        Node(K key, V&& value)
+            : value(move(value))
+        {
+            this->key = key;
+        }
+
+        V value;
+    };
+
+    static void delete_subtree(Node* node)
+    {
+        while (node) {
+            delete_subtree(static_cast<Node*>(node->right_child));
+            auto* left_child = static_cast<Node*>(node->left_child);
+            delete node;
+            node = left_child;
+        }
+    }
+
+    static V& node_to_value(Node& node) { return node.value; }
+    static const V& node_to_value(const Node& node) { return node.value; }
+
+    template<typename, typename, typename>
+    friend class RedBlackTreeIterator;
+
+public:
+    using Iterator = RedBlackTreeIterator<RedBlackTree, Node, V>;
+    using ConstIterator = RedBlackTreeIterator<const RedBlackTree, const Node, const V>;
+
+    Iterator begin() { return Iterator(static_cast<Node*>(BaseTree::leftmost(this->m_root))); }
+    Iterator end() { return {}; }
+    ConstIterator begin() const { return ConstIterator(static_cast<const Node*>(BaseTree::leftmost(this->m_root))); }
+    ConstIterator end() const { return {}; }
+};
+
+}
+
+using AK::RedBlackTree;
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/TestSuite.h>
+
+#include <AK/IntrusiveRedBlackTree.h>
+#include <AK/RedBlackTree.h>
+#include <AK/Vector.h>
+
+TEST_CASE(construct)
+{
+    RedBlackTree<int, int> empty;
+    EXPECT(empty.is_empty());
+    EXPECT_EQ(empty.size(), 0u);
+    EXPECT(empty.begin() == empty.end());
+}
+
+TEST_CASE(insert_and_find)
+{
+    RedBlackTree<int, int> tree;
+    tree.insert(5, 50);
+    tree.insert(1, 10);
+    tree.insert(9, 90);
+    EXPECT_EQ(tree.size(), 3u);
+    EXPECT_EQ(*tree.find(1), 10);
+    EXPECT_EQ(*tree.find(5), 50);
+    EXPECT_EQ(*tree.find(9), 90);
+    EXPECT_EQ(tree.find(4), nullptr);
+}
+
+TEST_CASE(find_largest_not_above)
+{
+    RedBlackTree<unsigned, unsigned> tree;
+    for (unsigned i = 0x1000; i <= 0x10000; i += 0x1000)
+        tree.insert(i, i);
+
+    EXPECT_EQ(tree.find_largest_not_above(0xfff), nullptr);
+    EXPECT_EQ(*tree.find_largest_not_above(0x1000), 0x1000u);
+    EXPECT_EQ(*tree.find_largest_not_above(0x1fff), 0x1000u);
+    EXPECT_EQ(*tree.find_largest_not_above(0x7abc), 0x7000u);
+    EXPECT_EQ(*tree.find_largest_not_above(0xffffffff), 0x10000u);
+
+    EXPECT_EQ(*tree.find_smallest_not_below(0), 0x1000u);
+    EXPECT_EQ(*tree.find_smallest_not_below(0x7abc), 0x8000u);
+    EXPECT_EQ(*tree.find_smallest_not_below(0x8000), 0x8000u);
+    EXPECT_EQ(tree.find_smallest_not_below(0x10001), nullptr);
+}
+
+TEST_CASE(iterates_in_order)
+{
+    RedBlackTree<int, int> tree;
+    // Insert in a scrambled order to exercise all the rebalancing cases.
+    for (int i = 0; i < 1000; ++i)
+        tree.insert((i * 7919) % 1000, i);
+    EXPECT_EQ(tree.size(), 1000u);
+
+    int expected_key = 0;
+    for (auto it = tree.begin(); it != tree.end(); ++it) {
+        EXPECT_EQ(it.key(), expected_key);
+        EXPECT_EQ((*it * 7919) % 1000, expected_key);
+        ++expected_key;
+    }
+    EXPECT_EQ(expected_key, 1000);
+}
+
+TEST_CASE(remove)
+{
+    RedBlackTree<int, int> tree;
+    for (int i = 0; i < 1000; ++i)
+        tree.insert(i, i);
+
+    EXPECT(!tree.remove(1000));
+    for (int i = 0; i < 1000; i += 2)
+        EXPECT(tree.remove(i));
+    EXPECT_EQ(tree.size(), 500u);
+
+    for (int i = 0; i < 1000; ++i)
+        EXPECT_EQ(tree.find(i) != nullptr, i % 2 == 1);
+
+    int expected_key = 1;
+    for (auto& value : tree) {
+        EXPECT_EQ(value, expected_key);
+        expected_key += 2;
+    }
+
+    // Pointers to the remaining values must survive the removal of other nodes.
+    auto* survivor = tree.find(501);
+    for (int i = 1; i < 1000; i += 2) {
+        if (i != 501)
+            EXPECT(tree.remove(i));
+    }
+    EXPECT_EQ(tree.size(), 1u);
+    EXPECT_EQ(tree.find(501), survivor);
+    EXPECT_EQ(*survivor, 501);
+
+    tree.clear();
+    EXPECT(tree.is_empty());
+}
+
+struct IntrusiveTestItem {
+    IntrusiveTestItem(unsigned base, unsigned size)
+        : base(base)
+        , size(size)
+    {
+    }
+
+    unsigned base { 0 };
+    unsigned size { 0 };
+    IntrusiveRedBlackTreeNode<unsigned> tree_node;
+};
+using IntrusiveTestTree = IntrusiveRedBlackTree<unsigned, IntrusiveTestItem, &IntrusiveTestItem::tree_node>;
+
+TEST_CASE(intrusive_interval_lookup)
+{
+    Vector<IntrusiveTestItem> items;
+    items.ensure_capacity(64);
+    for (unsigned i = 0; i < 64; ++i)
+        items.unchecked_append({ 0x100000 + i * 0x10000, 0x1000 * (i + 1) });
+
+    IntrusiveTestTree tree;
+    for (size_t i = items.size(); i > 0; --i)
+        tree.insert(items[i - 1].base, items[i - 1]);
+    EXPECT_EQ(tree.size(), 64u);
+    EXPECT(items[0].tree_node.is_in_tree());
+
+    auto find_containing = [&](unsigned address) -> IntrusiveTestItem* {
+        auto* item = tree.find_largest_not_above(address);
+        if (!item || address >= item->base + item->size)
+            return nullptr;
+        return item;
+    };
+
+    EXPECT_EQ(find_containing(0xfffff), nullptr);
+    EXPECT_EQ(find_containing(0x100000), &items[0]);
+    EXPECT_EQ(find_containing(0x100fff), &items[0]);
+    EXPECT_EQ(find_containing(0x101000), nullptr);
+    EXPECT_EQ(find_containing(0x131fff), &items[3]);
+    EXPECT_EQ(find_containing(0x133fff), &items[3]);
+    EXPECT_EQ(find_containing(0x134000), nullptr);
+
+    EXPECT(tree.remove(items[3].base));
+    EXPECT(!items[3].tree_node.is_in_tree());
+    EXPECT_EQ(find_containing(0x131000), nullptr);
+    EXPECT_EQ(tree.first(), &items[0]);
+
+    unsigned previous_base = 0;
+    size_t count = 0;
+    for (auto& item : tree) {
+        EXPECT(item.base > previous_base);
+        previous_base = item.base;
+        ++count;
+    }
+    EXPECT_EQ(count, 63u);
+
+    tree.clear();
+    EXPECT(tree.is_empty());
+    EXPECT(!items[0].tree_node.is_in_tree());
+}
+
+TEST_MAIN(RedBlackTree)
@@ -37,6 +37,7 @@ constexpr int syscall_vector = 0x82;
 
 extern "C" {
 struct pollfd;
+struct epoll_event;
 struct timeval;
 struct timespec;
 struct sockaddr;
@@ -192,7 +193,14 @@ namespace Kernel {
     S(abort)                  \
     S(anon_create)            \
     S(msyscall)               \
-    S(readv)
+    S(readv)                  \
+    S(posix_fadvise)          \
+    S(posix_spawn)            \
+    S(sendfile)               \
+    S(splice)                 \
+    S(epoll_create)           \
+    S(epoll_ctl)              \
+    S(epoll_wait)
 
 namespace Syscall {
 
@@ -277,6 +285,21 @@ struct SC_poll_params {
     const u32* sigmask;
 };
 
+struct SC_epoll_ctl_params {
+    int epoll_fd;
+    int op;
+    int fd;
+    struct epoll_event* event;
+};
+
+struct SC_epoll_wait_params {
+    int epoll_fd;
+    struct epoll_event* events;
+    int max_events;
+    const struct timespec* timeout;
+    const u32* sigmask;
+};
+
 struct SC_clock_nanosleep_params {
     int clock_id;
     int flags;
@@ -361,6 +384,13 @@ struct SC_realpath_params {
     MutableBufferArgument<char, size_t> buffer;
 };
 
+struct SC_posix_fadvise_params {
+    int32_t fd;
+    ssize_t offset;
+    ssize_t length;
+    int32_t advice;
+};
+
 struct SC_set_mmap_name_params {
     void* addr;
     size_t size;
@@ -373,6 +403,28 @@ struct SC_execve_params {
     StringListArgument environment;
 };
 
+struct SC_posix_spawn_params {
+    StringArgument path;
+    StringListArgument arguments;
+    StringListArgument environment;
+};
+
+struct SC_sendfile_params {
+    int out_fd;
+    int in_fd;
+    ssize_t* offset;
+    size_t count;
+};
+
+struct SC_splice_params {
+    int in_fd;
+    ssize_t* in_offset;
+    int out_fd;
+    ssize_t* out_offset;
+    size_t length;
+    unsigned flags;
+};
+
 struct SC_readlink_params {
     StringArgument path;
     MutableBufferArgument<char, size_t> buffer;
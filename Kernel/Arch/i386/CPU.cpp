@@ -779,6 +779,10 @@ FlatPtr read_cr3()
 
 void write_cr3(FlatPtr cr3)
 {
+    // NOTE: Publish the address space before loading it, so that Processor::flush_tlb() can
+    //       tell whether this processor may be caching translations from it.
+    if (Processor::is_initialized())
+        Processor::current().set_active_cr3(cr3);
     // NOTE: If you're here from a GPF crash, it's very likely that a PDPT entry is incorrect, not this!
 #if ARCH(I386)
     asm volatile("mov %%eax, %%cr3" ::"a"(cr3)
@@ -1720,12 +1724,77 @@ void Processor::flush_tlb_local(VirtualAddress vaddr, size_t page_count)
     }
 }
 
+bool Processor::is_thread_running_on_other_processor(const Thread& thread)
+{
+    auto current_id = Processor::id();
+    bool is_running = false;
+    for_each(
+        [&](Processor& proc) -> IterationDecision {
+            if (proc.get_id() != current_id && AK::atomic_load(&proc.m_current_thread, AK::MemoryOrder::memory_order_relaxed) == &thread) {
+                is_running = true;
+                return IterationDecision::Break;
+            }
+            return IterationDecision::Continue;
+        });
+    return is_running;
+}
+
+static void flush_tlb_ranges_local(const TLBFlushRange* ranges, size_t range_count)
+{
+    if (!ranges) {
+        Processor::flush_entire_tlb_local();
+        return;
+    }
+    for (size_t i = 0; i < range_count; ++i)
+        Processor::flush_tlb_local(ranges[i].base, ranges[i].page_count);
+}
+
 void Processor::flush_tlb(const PageDirectory* page_directory, VirtualAddress vaddr, size_t page_count)
 {
-    if (s_smp_enabled && (!is_user_address(vaddr) || Process::current()->thread_count() > 1))
-        smp_broadcast_flush_tlb(page_directory, vaddr, page_count);
+    TLBFlushRange range { vaddr, page_count };
+    flush_tlb(page_directory, &range, 1);
+}
+
+void Processor::flush_tlb(const PageDirectory* page_directory, const TLBFlushRange* ranges, size_t range_count)
+{
+    VERIFY(ranges && range_count > 0);
+    bool is_user = true;
+    size_t page_count = 0;
+    for (size_t i = 0; i < range_count; ++i) {
+        if (!is_user_address(ranges[i].base))
+            is_user = false;
+        page_count += ranges[i].page_count;
+    }
+
+    // NOTE: Kernel mappings are global, so reloading CR3 would not get rid of them.
+    if (is_user && page_count > max_pages_to_flush_individually)
+        ranges = nullptr;
+
+    u32 prev_flags;
+    auto& cur_proc = Processor::current();
+    cur_proc.enter_critical(prev_flags);
+
+    u32 cpu_mask = 0;
+    if (s_smp_enabled) {
+        // NOTE: The page table updates must be visible before we look at which address space
+        //       everybody else is running. A processor that switches to this page directory
+        //       afterwards will load the new entries anyway (see write_cr3()).
+        atomic_thread_fence(AK::MemoryOrder::memory_order_seq_cst);
+        auto cr3 = page_directory->cr3();
+        for_each(
+            [&](Processor& proc) -> IterationDecision {
+                if (&proc != &cur_proc && (!is_user || proc.m_active_cr3.load() == cr3))
+                    cpu_mask |= 1u << proc.get_id();
+                return IterationDecision::Continue;
+            });
+    }
+
+    if (cpu_mask)
+        smp_multicast_flush_tlb(cpu_mask, page_directory, ranges, range_count);
     else
-        flush_tlb_local(vaddr, page_count);
+        flush_tlb_ranges_local(ranges, range_count);
+
+    cur_proc.leave_critical(prev_flags);
 }
 
 static volatile ProcessorMessage* s_message_pool;
@@ -1817,6 +1886,20 @@ u32 Processor::smp_wake_n_idle_processors(u32 wake_count)
     return did_wake_count;
 }
 
+bool Processor::smp_wake_idle_processor(u32 cpu)
+{
+    VERIFY(Processor::current().in_critical());
+    if (!s_smp_enabled || cpu == Processor::current().id())
+        return false;
+
+    // Flip it to busy, so that nobody else sends it another IPI.
+    u32 cpu_bit = 1u << cpu;
+    if (!(s_idle_cpu_mask.fetch_and(~cpu_bit, AK::MemoryOrder::memory_order_acq_rel) & cpu_bit))
+        return false;
+    APIC::the().send_ipi(cpu);
+    return true;
+}
+
 UNMAP_AFTER_INIT void Processor::smp_enable()
 {
     size_t msg_pool_size = Processor::count() * 100u;
@@ -1888,19 +1971,20 @@ bool Processor::smp_process_pending_messages()
             case ProcessorMessage::CallbackWithData:
                 msg->callback_with_data.handler(msg->callback_with_data.data);
                 break;
-            case ProcessorMessage::FlushTlb:
-                if (is_user_address(VirtualAddress(msg->flush_tlb.ptr))) {
-                    // We assume that we don't cross into kernel land!
-                    VERIFY(is_user_range(VirtualAddress(msg->flush_tlb.ptr), msg->flush_tlb.page_count * PAGE_SIZE));
+            case ProcessorMessage::FlushTlb: {
+                m_tlb_shootdowns_received++;
+                auto* ranges = msg->flush_tlb.ranges;
+                if (!ranges || is_user_address(ranges[0].base)) {
+                    // We may have switched away from this page directory since the message was sent.
                     if (read_cr3() != msg->flush_tlb.page_directory->cr3()) {
-                        // This processor isn't using this page directory right now, we can ignore this request
-                        dbgln_if(SMP_DEBUG, "SMP[{}]: No need to flush {} pages at {}", id(), msg->flush_tlb.page_count, VirtualAddress(msg->flush_tlb.ptr));
+                        dbgln_if(SMP_DEBUG, "SMP[{}]: No need to flush {} ranges", id(), msg->flush_tlb.range_count);
                         break;
                     }
                 }
-                flush_tlb_local(VirtualAddress(msg->flush_tlb.ptr), msg->flush_tlb.page_count);
+                flush_tlb_ranges_local(ranges, msg->flush_tlb.range_count);
                 break;
             }
+            }
 
             bool is_async = msg->async; // Need to cache this value *before* dropping the ref count!
             auto prev_refs = atomic_fetch_sub(&msg->refs, 1u, AK::MemoryOrder::memory_order_acq_rel);
@@ -1959,8 +2043,44 @@ void Processor::smp_broadcast_message(ProcessorMessage& msg)
         });
 
     // Now trigger an IPI on all other APs (unless all targets already had messages queued)
-    if (need_broadcast)
+    if (need_broadcast) {
+        cur_proc.m_ipis_sent += count() - 1;
         APIC::the().broadcast_ipi();
+    }
+}
+
+void Processor::smp_multicast_message(u32 cpu_mask, ProcessorMessage& msg)
+{
+    auto& cur_proc = Processor::current();
+    VERIFY(!(cpu_mask & (1u << cur_proc.get_id())));
+
+    dbgln_if(SMP_DEBUG, "SMP[{}]: Multicast message {} to cpu mask: {:08x}", cur_proc.get_id(), VirtualAddress(&msg), cpu_mask);
+
+    atomic_store(&msg.refs, (u32)__builtin_popcount(cpu_mask), AK::MemoryOrder::memory_order_release);
+    VERIFY(msg.refs > 0);
+    u32 need_ipi_mask = 0;
+    for_each(
+        [&](Processor& proc) -> IterationDecision {
+            u32 cpu_bit = 1u << proc.get_id();
+            if ((cpu_mask & cpu_bit) && proc.smp_queue_message(msg))
+                need_ipi_mask |= cpu_bit;
+            return IterationDecision::Continue;
+        });
+
+    if (!need_ipi_mask)
+        return;
+    if (__builtin_popcount(need_ipi_mask) == (int)count() - 1) {
+        cur_proc.m_ipis_sent += count() - 1;
+        APIC::the().broadcast_ipi();
+        return;
+    }
+    for (u32 cpu = 0; need_ipi_mask; ++cpu) {
+        if (!(need_ipi_mask & (1u << cpu)))
+            continue;
+        need_ipi_mask &= ~(1u << cpu);
+        cur_proc.m_ipis_sent++;
+        APIC::the().send_ipi(cpu);
+    }
 }
 
 void Processor::smp_broadcast_wait_sync(ProcessorMessage& msg)
@@ -2017,6 +2137,7 @@ void Processor::smp_unicast_message(u32 cpu, ProcessorMessage& msg, bool async)
 
     atomic_store(&msg.refs, 1u, AK::MemoryOrder::memory_order_release);
     if (target_proc->smp_queue_message(msg)) {
+        cur_proc.m_ipis_sent++;
         APIC::the().send_ipi(cpu);
     }
 
@@ -2055,17 +2176,17 @@ void Processor::smp_unicast(u32 cpu, void (*callback)(), bool async)
     smp_unicast_message(cpu, msg, async);
 }
 
-void Processor::smp_broadcast_flush_tlb(const PageDirectory* page_directory, VirtualAddress vaddr, size_t page_count)
+void Processor::smp_multicast_flush_tlb(u32 cpu_mask, const PageDirectory* page_directory, const TLBFlushRange* ranges, size_t range_count)
 {
     auto& msg = smp_get_from_pool();
     msg.async = false;
     msg.type = ProcessorMessage::FlushTlb;
     msg.flush_tlb.page_directory = page_directory;
-    msg.flush_tlb.ptr = vaddr.as_ptr();
-    msg.flush_tlb.page_count = page_count;
-    smp_broadcast_message(msg);
+    msg.flush_tlb.ranges = ranges;
+    msg.flush_tlb.range_count = range_count;
+    smp_multicast_message(cpu_mask, msg);
     // While the other processors handle this request, we'll flush ours
-    flush_tlb_local(vaddr, page_count);
+    flush_tlb_ranges_local(ranges, range_count);
     // Now wait until everybody is done as well
     smp_broadcast_wait_sync(msg);
 }
@@ -600,6 +600,11 @@ class SchedulerPerProcessorData;
 struct MemoryManagerData;
 struct ProcessorMessageEntry;
 
+struct TLBFlushRange {
+    VirtualAddress base;
+    size_t page_count { 0 };
+};
+
 struct ProcessorMessage {
     enum Type {
         FlushTlb,
@@ -620,8 +625,8 @@ struct ProcessorMessage {
         } callback_with_data;
         struct {
             const PageDirectory* page_directory;
-            u8* ptr;
-            size_t page_count;
+            const TLBFlushRange* ranges; // nullptr means the entire TLB
+            size_t range_count;
         } flush_tlb;
     };
 
@@ -681,6 +686,11 @@ class Processor {
     Thread* m_idle_thread;
 
     volatile ProcessorMessageEntry* m_message_queue; // atomic, LIFO
+    Atomic<FlatPtr> m_active_cr3 { 0 };
+
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> m_ipis_sent { 0 };
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> m_ipis_received { 0 };
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> m_tlb_shootdowns_received { 0 };
 
     bool m_invoke_scheduler_async;
     bool m_scheduler_initialized;
@@ -701,6 +711,7 @@ class Processor {
     bool smp_queue_message(ProcessorMessage& msg);
     static void smp_unicast_message(u32 cpu, ProcessorMessage& msg, bool async);
     static void smp_broadcast_message(ProcessorMessage& msg);
+    static void smp_multicast_message(u32 cpu_mask, ProcessorMessage& msg);
     static void smp_broadcast_wait_sync(ProcessorMessage& msg);
     static void smp_broadcast_halt();
 
@@ -731,6 +742,9 @@ public:
         s_idle_cpu_mask.fetch_and(~(1u << m_cpu), AK::MemoryOrder::memory_order_relaxed);
     }
 
+    // NOTE: Sets of processors (thread affinity, idle processors) are 32-bit masks.
+    static constexpr u32 max_count = sizeof(u32) * 8;
+
     static u32 count()
     {
         // NOTE: because this value never changes once all APs are booted,
@@ -751,8 +765,22 @@ public:
         write_cr3(read_cr3());
     }
 
+    // NOTE: Flushing more user pages than this at once reloads CR3 instead.
+    static constexpr size_t max_pages_to_flush_individually = 32;
+
     static void flush_tlb_local(VirtualAddress vaddr, size_t page_count);
     static void flush_tlb(const PageDirectory*, VirtualAddress, size_t);
+    static void flush_tlb(const PageDirectory*, const TLBFlushRange*, size_t range_count);
+
+    ALWAYS_INLINE void set_active_cr3(FlatPtr cr3)
+    {
+        m_active_cr3.store(cr3, AK::MemoryOrder::memory_order_seq_cst);
+    }
+
+    ALWAYS_INLINE void did_receive_ipi() { m_ipis_received++; }
+    u32 ipis_sent() const { return m_ipis_sent.load(); }
+    u32 ipis_received() const { return m_ipis_received.load(); }
+    u32 tlb_shootdowns_received() const { return m_tlb_shootdowns_received.load(); }
 
     Descriptor& get_gdt_entry(u16 selector);
     void flush_gdt();
@@ -829,6 +857,9 @@ public:
         return (Thread*)read_fs_ptr(__builtin_offsetof(Processor, m_current_thread));
     }
 
+    // NOTE: This is only a hint, the thread may be switched in or out at any moment.
+    static bool is_thread_running_on_other_processor(const Thread&);
+
     ALWAYS_INLINE static void set_current_thread(Thread& current_thread)
     {
         // See comment in Processor::current_thread
@@ -977,8 +1008,9 @@ public:
     }
     static void smp_unicast(u32 cpu, void (*callback)(), bool async);
     static void smp_unicast(u32 cpu, void (*callback)(void*), void* data, void (*free_data)(void*), bool async);
-    static void smp_broadcast_flush_tlb(const PageDirectory*, VirtualAddress, size_t);
+    static void smp_multicast_flush_tlb(u32 cpu_mask, const PageDirectory*, const TLBFlushRange*, size_t range_count);
     static u32 smp_wake_n_idle_processors(u32 wake_count);
+    static bool smp_wake_idle_processor(u32 cpu);
 
     template<typename Callback>
     static void deferred_call_queue(Callback callback)
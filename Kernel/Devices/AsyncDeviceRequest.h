@@ -133,18 +133,24 @@ protected:
 
     RequestResult get_request_result() const;
 
+    // NOTE: Used for requests that are served as part of another one, and so never have start() called.
+    [[nodiscard]] bool set_started()
+    {
+        ScopedSpinLock lock(m_lock);
+        if (is_completed_result(m_result))
+            return false;
+        m_result = Started;
+        return true;
+    }
+
 private:
     void sub_request_finished(AsyncDeviceRequest&);
     void request_finished();
 
     void do_start()
     {
-        {
-            ScopedSpinLock lock(m_lock);
-            if (is_completed_result(m_result))
-                return;
-            m_result = Started;
-        }
+        if (!set_started())
+            return;
         start();
     }
 
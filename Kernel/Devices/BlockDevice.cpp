@@ -25,9 +25,20 @@
  */
 
 #include <Kernel/Devices/BlockDevice.h>
+#include <Kernel/Time/TimeManagement.h>
 
 namespace Kernel {
 
+// Requests that have been waiting for longer than this are served before anything else.
+static const u64 read_deadline_us = 50'000;
+static const u64 write_deadline_us = 500'000;
+
+static u64 now_us()
+{
+    auto now = TimeManagement::the().monotonic_time();
+    return (u64)now.tv_sec * 1'000'000 + now.tv_nsec / 1000;
+}
+
 AsyncBlockDeviceRequest::AsyncBlockDeviceRequest(Device& block_device, RequestType request_type, u32 block_index, u32 block_count, const UserOrKernelBuffer& buffer, size_t buffer_size)
     : AsyncDeviceRequest(block_device)
     , m_block_device(static_cast<BlockDevice&>(block_device))
@@ -44,10 +55,193 @@ void AsyncBlockDeviceRequest::start()
     m_block_device.start_request(*this);
 }
 
+UserOrKernelBuffer AsyncBlockDeviceRequest::buffer_for_block(u32 index)
+{
+    VERIFY(index < total_block_count());
+    if (index < m_block_count)
+        return m_buffer.offset(index * m_block_device.block_size());
+    index -= m_block_count;
+    for (auto& merged_request : m_merged_requests) {
+        if (index < merged_request.block_count())
+            return merged_request.buffer().offset(index * m_block_device.block_size());
+        index -= merged_request.block_count();
+    }
+    VERIFY_NOT_REACHED();
+}
+
+void AsyncBlockDeviceRequest::merge(Badge<BlockDevice>, AsyncBlockDeviceRequest& request)
+{
+    VERIFY(request.request_type() == m_request_type);
+    VERIFY(request.block_index() == m_block_index + total_block_count());
+    VERIFY(request.merged_requests().is_empty());
+    bool started = request.set_started();
+    VERIFY(started);
+    m_merged_block_count += request.block_count();
+    m_merged_requests.append(request);
+}
+
+void AsyncBlockDeviceRequest::complete_merged_requests(Badge<BlockDevice>)
+{
+    auto result = get_request_result();
+    for (auto& merged_request : m_merged_requests)
+        merged_request.complete(result);
+}
+
 BlockDevice::~BlockDevice()
 {
 }
 
+void BlockDevice::submit_request(AsyncDeviceRequest& request)
+{
+    if (!schedules_requests()) {
+        do_start_request(request);
+        return;
+    }
+
+    auto& block_request = static_cast<AsyncBlockDeviceRequest&>(request);
+    block_request.set_submitted_at_us({}, now_us());
+
+    RefPtr<AsyncBlockDeviceRequest> next_request;
+    {
+        ScopedSpinLock lock(m_queue_lock);
+        m_pending_requests.append(block_request);
+        if (++m_statistics.queue_depth > m_statistics.max_queue_depth)
+            m_statistics.max_queue_depth = m_statistics.queue_depth;
+        if (m_active_request)
+            return;
+        next_request = pick_next_request();
+    }
+    do_start_request(*next_request);
+}
+
+RefPtr<AsyncBlockDeviceRequest> BlockDevice::pick_next_request()
+{
+    VERIFY(m_queue_lock.is_locked());
+    VERIFY(!m_active_request);
+    if (m_pending_requests.is_empty())
+        return nullptr;
+
+    auto is_read = [](auto& request) { return request.request_type() == AsyncBlockDeviceRequest::Read; };
+
+    // Pending requests are kept in submission order, so the first expired one is the one that has waited the longest.
+    Optional<size_t> chosen_index;
+    auto now = now_us();
+    for (size_t i = 0; i < m_pending_requests.size(); ++i) {
+        auto& request = *m_pending_requests[i];
+        if (now - request.submitted_at_us() >= (is_read(request) ? read_deadline_us : write_deadline_us)) {
+            chosen_index = i;
+            break;
+        }
+    }
+
+    if (!chosen_index.has_value()) {
+        // Reads have someone waiting for them, while writes are almost always writeback, so reads go first.
+        // Within that, sweep across the disk in one direction (C-LOOK) to keep seeks short.
+        bool have_reads = false;
+        for (auto& request : m_pending_requests) {
+            if (is_read(*request)) {
+                have_reads = true;
+                break;
+            }
+        }
+        Optional<size_t> ahead_index;
+        Optional<size_t> wrapped_index;
+        for (size_t i = 0; i < m_pending_requests.size(); ++i) {
+            auto& request = *m_pending_requests[i];
+            if (is_read(request) != have_reads)
+                continue;
+            auto& best_index = request.block_index() >= m_head_block_index ? ahead_index : wrapped_index;
+            if (!best_index.has_value() || request.block_index() < m_pending_requests[best_index.value()]->block_index())
+                best_index = i;
+        }
+        chosen_index = ahead_index.has_value() ? ahead_index : wrapped_index;
+    }
+
+    auto request = m_pending_requests.take(chosen_index.value());
+
+    // Fold in the requests for the blocks that directly follow this one.
+    size_t max_blocks = max_merged_request_blocks();
+    if (max_blocks && request->buffer().is_kernel_buffer()) {
+        for (;;) {
+            u32 next_block_index = request->block_index() + request->total_block_count();
+            Optional<size_t> merge_index;
+            for (size_t i = 0; i < m_pending_requests.size(); ++i) {
+                auto& candidate = *m_pending_requests[i];
+                if (candidate.request_type() == request->request_type()
+                    && candidate.block_index() == next_block_index
+                    && candidate.buffer().is_kernel_buffer()
+                    && request->total_block_count() + candidate.block_count() <= max_blocks) {
+                    merge_index = i;
+                    break;
+                }
+            }
+            if (!merge_index.has_value())
+                break;
+            request->merge({}, m_pending_requests.take(merge_index.value()));
+            ++m_statistics.merged_request_count;
+        }
+    }
+
+    m_head_block_index = request->block_index() + request->total_block_count();
+    m_active_request = request;
+    return request;
+}
+
+void BlockDevice::account_completed_request(AsyncBlockDeviceRequest& request)
+{
+    auto latency_us = now_us() - request.submitted_at_us();
+    size_t bucket = 0;
+    for (u64 limit = 64; bucket < latency_bucket_count - 1 && latency_us >= limit; limit *= 2)
+        ++bucket;
+
+    size_t type = request.request_type() == AsyncBlockDeviceRequest::Read ? 0 : 1;
+    ScopedSpinLock lock(m_queue_lock);
+    VERIFY(m_statistics.queue_depth);
+    --m_statistics.queue_depth;
+    ++m_statistics.request_count[type];
+    m_statistics.block_count[type] += request.block_count();
+    ++m_statistics.latency_histogram[type][bucket];
+}
+
+void BlockDevice::process_next_queued_request(Badge<AsyncDeviceRequest>, const AsyncDeviceRequest& completed_request)
+{
+    if (!schedules_requests()) {
+        evaluate_block_conditions();
+        return;
+    }
+
+    auto& request = const_cast<AsyncBlockDeviceRequest&>(static_cast<const AsyncBlockDeviceRequest&>(completed_request));
+    account_completed_request(request);
+
+    bool is_active_request;
+    {
+        ScopedSpinLock lock(m_queue_lock);
+        is_active_request = m_active_request.ptr() == &request;
+    }
+
+    // Requests that were merged into the active one don't start anything, the active one takes care of that.
+    if (is_active_request) {
+        request.complete_merged_requests({});
+
+        RefPtr<AsyncBlockDeviceRequest> next_request;
+        {
+            ScopedSpinLock lock(m_queue_lock);
+            m_active_request = nullptr;
+            next_request = pick_next_request();
+        }
+        if (next_request)
+            do_start_request(*next_request);
+    }
+
+    evaluate_block_conditions();
+}
+
+auto BlockDevice::request_queue_statistics() const -> RequestQueueStatistics
+{
+    ScopedSpinLock lock(m_queue_lock);
+    return m_statistics;
+}
+
 bool BlockDevice::read_block(unsigned index, UserOrKernelBuffer& buffer)
 {
     auto read_request = make_request<AsyncBlockDeviceRequest>(AsyncBlockDeviceRequest::Read, index, 1, buffer, 512);
@@ -26,6 +26,8 @@
 
 #pragma once
 
+#include <AK/NonnullRefPtrVector.h>
+#include <AK/Vector.h>
 #include <Kernel/Devices/Device.h>
 
 namespace Kernel {
@@ -48,6 +50,18 @@ public:
     const UserOrKernelBuffer& buffer() const { return m_buffer; }
     size_t buffer_size() const { return m_buffer_size; }
 
+    // NOTE: Requests for the blocks right after this one can be merged into it by the device's
+    //       request queue, and the driver is expected to transfer them all as a single command.
+    NonnullRefPtrVector<AsyncBlockDeviceRequest>& merged_requests() { return m_merged_requests; }
+    const NonnullRefPtrVector<AsyncBlockDeviceRequest>& merged_requests() const { return m_merged_requests; }
+    u32 total_block_count() const { return m_block_count + m_merged_block_count; }
+    UserOrKernelBuffer buffer_for_block(u32 index);
+    void merge(Badge<BlockDevice>, AsyncBlockDeviceRequest&);
+    void complete_merged_requests(Badge<BlockDevice>);
+
+    u64 submitted_at_us() const { return m_submitted_at_us; }
+    void set_submitted_at_us(Badge<BlockDevice>, u64 time) { m_submitted_at_us = time; }
+
     virtual void start() override;
     virtual const char* name() const override
     {
@@ -68,6 +82,9 @@ private:
     const u32 m_block_count;
     UserOrKernelBuffer m_buffer;
     const size_t m_buffer_size;
+    NonnullRefPtrVector<AsyncBlockDeviceRequest> m_merged_requests;
+    u32 m_merged_block_count { 0 };
+    u64 m_submitted_at_us { 0 };
 };
 
 class BlockDevice : public Device {
@@ -82,6 +99,24 @@ public:
 
     virtual void start_request(AsyncBlockDeviceRequest&) = 0;
 
+    // ^Device
+    virtual void process_next_queued_request(Badge<AsyncDeviceRequest>, const AsyncDeviceRequest&) override;
+
+    static constexpr size_t latency_bucket_count = 16;
+    struct RequestQueueStatistics {
+        u64 request_count[2] {};
+        u64 block_count[2] {};
+        u64 merged_request_count { 0 };
+        size_t queue_depth { 0 };
+        size_t max_queue_depth { 0 };
+        // NOTE: Bucket 0 counts requests that completed in less than 64us, every following bucket doubles that.
+        u64 latency_histogram[2][latency_bucket_count] {};
+    };
+    RequestQueueStatistics request_queue_statistics() const;
+
+    // Devices that just forward their requests to another device don't need to schedule them.
+    virtual bool schedules_requests() const { return true; }
+
 protected:
     BlockDevice(unsigned major, unsigned minor, size_t block_size = PAGE_SIZE)
         : Device(major, minor)
@@ -89,10 +124,25 @@ protected:
     {
     }
 
+    // ^Device
+    virtual void submit_request(AsyncDeviceRequest&) override;
+
+    // The largest request (in blocks) that requests may be merged into, or 0 if the driver can't handle merged requests.
+    virtual size_t max_merged_request_blocks() const { return 0; }
+
 private:
     virtual bool is_block_device() const final { return true; }
 
+    RefPtr<AsyncBlockDeviceRequest> pick_next_request();
+    void account_completed_request(AsyncBlockDeviceRequest&);
+
     size_t m_block_size { 0 };
+
+    mutable SpinLock<u8> m_queue_lock;
+    Vector<NonnullRefPtr<AsyncBlockDeviceRequest>> m_pending_requests;
+    RefPtr<AsyncBlockDeviceRequest> m_active_request;
+    u32 m_head_block_index { 0 };
+    RequestQueueStatistics m_statistics;
 };
 
 }
@@ -80,6 +80,18 @@ String Device::absolute_path(const FileDescription&) const
     return absolute_path();
 }
 
+void Device::submit_request(AsyncDeviceRequest& request)
+{
+    bool was_empty;
+    {
+        ScopedSpinLock lock(m_requests_lock);
+        was_empty = m_requests.is_empty();
+        m_requests.append(request);
+    }
+    if (was_empty)
+        request.do_start({});
+}
+
 void Device::process_next_queued_request(Badge<AsyncDeviceRequest>, const AsyncDeviceRequest& completed_request)
 {
     AsyncDeviceRequest* next_request = nullptr;
@@ -66,20 +66,13 @@ public:
     static void for_each(Function<void(Device&)>);
     static Device* get_device(unsigned major, unsigned minor);
 
-    void process_next_queued_request(Badge<AsyncDeviceRequest>, const AsyncDeviceRequest&);
+    virtual void process_next_queued_request(Badge<AsyncDeviceRequest>, const AsyncDeviceRequest&);
 
     template<typename AsyncRequestType, typename... Args>
     NonnullRefPtr<AsyncRequestType> make_request(Args&&... args)
     {
         auto request = adopt(*new AsyncRequestType(*this, forward<Args>(args)...));
-        bool was_empty;
-        {
-            ScopedSpinLock lock(m_requests_lock);
-            was_empty = m_requests.is_empty();
-            m_requests.append(request);
-        }
-        if (was_empty)
-            request->do_start({});
+        submit_request(*request);
         return request;
     }
 
@@ -90,6 +83,10 @@ protected:
 
     static HashMap<u32, Device*>& all_devices();
 
+    // NOTE: By default, requests are served one at a time in the order they were submitted.
+    virtual void submit_request(AsyncDeviceRequest&);
+    void do_start_request(AsyncDeviceRequest& request) { request.do_start({}); }
+
 private:
     unsigned m_major { 0 };
     unsigned m_minor { 0 };
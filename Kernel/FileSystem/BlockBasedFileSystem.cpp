@@ -25,9 +25,12 @@
  */
 
 #include <AK/IntrusiveList.h>
+#include <AK/QuickSort.h>
 #include <Kernel/Debug.h>
 #include <Kernel/FileSystem/BlockBasedFileSystem.h>
 #include <Kernel/Process.h>
+#include <Kernel/Tasks/SyncTask.h>
+#include <Kernel/Time/TimeManagement.h>
 
 namespace Kernel {
 
@@ -36,66 +39,110 @@ struct CacheEntry {
     BlockBasedFS::BlockIndex block_index { 0 };
     u8* data { nullptr };
     bool has_data { false };
+    bool is_dirty { false };
+    u64 dirtied_at_ms { 0 };
 };
 
 class DiskCache {
 public:
+    // The cache grows and shrinks in chunks of this many bytes worth of blocks.
+    static constexpr size_t chunk_size = 1 * MiB;
+    static constexpr size_t shard_count = 16;
+
+    // Dirty blocks are written back once they've been dirty for this long...
+    static constexpr u64 dirty_expire_ms = 3000;
+    // ...or all at once, when this percentage of the cache is dirty.
+    static constexpr size_t background_dirty_ratio = 10;
+    // Writers that push the dirty percentage beyond this have to write back blocks themselves.
+    static constexpr size_t throttle_dirty_ratio = 40;
+    static constexpr size_t throttle_batch_size = 256 * KiB;
+
+    // Runs of adjacent blocks are coalesced into transfers of up to this size.
+    static constexpr size_t max_transfer_size = 64 * KiB;
+
     explicit DiskCache(BlockBasedFS& fs)
         : m_fs(fs)
-        , m_cached_block_data(KBuffer::create_with_size(m_entry_count * m_fs.block_size()))
-        , m_entries(KBuffer::create_with_size(m_entry_count * sizeof(CacheEntry)))
+        , m_entries_per_chunk(max(chunk_size / fs.block_size(), (size_t)1))
     {
-        for (size_t i = 0; i < m_entry_count; ++i) {
-            entries()[i].data = m_cached_block_data.data() + i * m_fs.block_size();
-            m_clean_list.append(entries()[i]);
-        }
+        // NOTE: We always start out with one chunk, regardless of memory pressure.
+        bool did_grow = grow(true);
+        VERIFY(did_grow);
     }
 
     ~DiskCache() { }
 
-    bool is_dirty() const { return m_dirty; }
-    void set_dirty(bool b) { m_dirty = b; }
+    size_t entry_count() const { return m_chunks.size() * m_entries_per_chunk; }
+    size_t dirty_count() const { return m_dirty_count; }
+    bool is_dirty() const { return m_dirty_count > 0; }
 
-    void mark_all_clean()
-    {
-        while (auto* entry = m_dirty_list.first())
-            m_clean_list.prepend(*entry);
-        m_dirty = false;
-    }
+    bool is_above_background_dirty_ratio() const { return m_dirty_count * 100 >= entry_count() * background_dirty_ratio; }
+    bool is_above_throttle_dirty_ratio() const { return m_dirty_count * 100 >= entry_count() * throttle_dirty_ratio; }
+    size_t throttle_batch_count() const { return max(throttle_batch_size / m_fs.block_size(), (size_t)1); }
 
     void mark_dirty(CacheEntry& entry)
     {
+        // NOTE: The dirty list is kept in the order in which entries were first dirtied,
+        //       so that the oldest dirty entries can always be found at its end.
+        if (entry.is_dirty)
+            return;
+        entry.is_dirty = true;
+        entry.dirtied_at_ms = TimeManagement::the().uptime_ms();
+        ++m_dirty_count;
         m_dirty_list.prepend(entry);
-        m_dirty = true;
+
+        // Start writing back before we run out of clean entries, so that
+        // nobody has to flush synchronously in get().
+        if (is_above_background_dirty_ratio())
+            SyncTask::notify();
     }
 
     void mark_clean(CacheEntry& entry)
     {
+        if (entry.is_dirty) {
+            entry.is_dirty = false;
+            VERIFY(m_dirty_count > 0);
+            --m_dirty_count;
+        }
         m_clean_list.prepend(entry);
     }
 
+    CacheEntry* find(BlockBasedFS::BlockIndex block_index) const
+    {
+        auto& shard = shard_for(block_index);
+        if (auto it = shard.find(block_index); it != shard.end())
+            return it->value;
+        return nullptr;
+    }
+
     CacheEntry& get(BlockBasedFS::BlockIndex block_index) const
     {
-        if (auto it = m_hash.find(block_index); it != m_hash.end()) {
+        auto& shard = shard_for(block_index);
+        if (auto it = shard.find(block_index); it != shard.end()) {
             auto& entry = const_cast<CacheEntry&>(*it->value);
             VERIFY(entry.block_index == block_index);
             return entry;
         }
 
-        if (m_clean_list.is_empty()) {
-            // Not a single clean entry! Flush writes and try again.
-            // NOTE: We want to make sure we only call FileBackedFS flush here,
-            //       not some FileBackedFS subclass flush!
-            m_fs.flush_writes_impl();
-            return get(block_index);
+        // NOTE: Entries that were never used come first. Only once those are gone do we grow,
+        //       and only once we can't grow anymore do we start recycling clean entries.
+        auto* new_entry_ptr = m_unused_list.take_first();
+        if (!new_entry_ptr && const_cast<DiskCache&>(*this).grow())
+            new_entry_ptr = m_unused_list.take_first();
+        if (!new_entry_ptr) {
+            if (m_clean_list.is_empty()) {
+                // Not a single clean entry, and not enough memory to grow! Flush writes and try again.
+                // NOTE: We want to make sure we only call FileBackedFS flush here,
+                //       not some FileBackedFS subclass flush!
+                m_fs.flush_writes_impl();
+                return get(block_index);
+            }
+            new_entry_ptr = m_clean_list.last();
+            unindex(*new_entry_ptr);
         }
 
-        VERIFY(m_clean_list.last());
-        auto& new_entry = *m_clean_list.last();
+        auto& new_entry = *new_entry_ptr;
         m_clean_list.prepend(new_entry);
-
-        m_hash.remove(new_entry.block_index);
-        m_hash.set(block_index, &new_entry);
+        shard.set(block_index, &new_entry);
 
         new_entry.block_index = block_index;
         new_entry.has_data = false;
@@ -103,25 +150,211 @@ public:
         return new_entry;
     }
 
-    const CacheEntry* entries() const { return (const CacheEntry*)m_entries.data(); }
-    CacheEntry* entries() { return (CacheEntry*)m_entries.data(); }
+    // Writes back up to max_count of the oldest dirty entries, for as long as they satisfy the predicate.
+    // Returns the number of blocks that were written back.
+    template<typename Predicate>
+    size_t write_back_oldest(size_t max_count, Predicate predicate)
+    {
+        Vector<CacheEntry*> entries;
+        while (entries.size() < max_count) {
+            auto* entry = m_dirty_list.last();
+            if (!entry || !predicate(*entry))
+                break;
+            mark_clean(*entry);
+            entries.append(entry);
+        }
+        write_back(entries);
+        return entries.size();
+    }
+
+    void write_back_entry(CacheEntry& entry)
+    {
+        mark_clean(entry);
+        if (!write_to_device(entry.block_index, 1, entry.data))
+            dbgln("DiskCache: Failed to write back block {}", entry.block_index);
+    }
 
-    template<typename Callback>
-    void for_each_dirty_entry(Callback callback)
+    // Brings the given blocks into the cache, reading each run of missing blocks with a single request.
+    void prefetch(BlockBasedFS::BlockIndex index, size_t count)
     {
-        for (auto& entry : m_dirty_list)
-            callback(entry);
+        auto* transfer_buffer = this->transfer_buffer();
+        if (!transfer_buffer)
+            return;
+        for (size_t i = 0; i < count;) {
+            if (has_data(BlockBasedFS::BlockIndex { index.value() + i })) {
+                ++i;
+                continue;
+            }
+            size_t run_count = 1;
+            while (i + run_count < count && run_count < max_transfer_block_count() && !has_data(BlockBasedFS::BlockIndex { index.value() + i + run_count }))
+                ++run_count;
+
+            auto buffer = UserOrKernelBuffer::for_kernel_buffer(transfer_buffer->data());
+            if (m_fs.read_blocks_from_device(BlockBasedFS::BlockIndex { index.value() + i }, run_count, buffer).is_error())
+                return;
+            for (size_t j = 0; j < run_count; ++j) {
+                // NOTE: Read-ahead is only a hint, so we'd rather stop than have get() flush
+                //       (which would also clobber the transfer buffer).
+                if (m_unused_list.is_empty() && m_clean_list.is_empty() && !grow())
+                    return;
+                auto& entry = get(BlockBasedFS::BlockIndex { index.value() + i + j });
+                if (entry.has_data)
+                    continue;
+                memcpy(entry.data, transfer_buffer->data() + j * m_fs.block_size(), m_fs.block_size());
+                entry.has_data = true;
+            }
+            i += run_count;
+        }
+    }
+
+    // Forget the cached data for a block, e.g. because it was written to the device behind our back.
+    void invalidate(BlockBasedFS::BlockIndex block_index)
+    {
+        auto* entry = find(block_index);
+        if (!entry || entry->is_dirty)
+            return;
+        entry->has_data = false;
+    }
+
+    // Give memory back to the system if it's running low. Only chunks without
+    // dirty entries can be released, so this is best called right after a flush.
+    void shrink_if_needed()
+    {
+        while (m_chunks.size() > 1 && is_under_memory_pressure()) {
+            auto& chunk = m_chunks.last();
+            auto* entries = chunk.entries();
+            for (size_t i = 0; i < m_entries_per_chunk; ++i) {
+                if (entries[i].is_dirty)
+                    return;
+            }
+            for (size_t i = 0; i < m_entries_per_chunk; ++i) {
+                unindex(entries[i]);
+                entries[i].list_node.remove();
+            }
+            m_chunks.take_last();
+            dbgln_if(BBFS_DEBUG, "DiskCache: Shrunk to {} entries", entry_count());
+        }
     }
 
 private:
+    // Writes back the given entries sorted by block index, coalescing adjacent blocks into larger writes.
+    void write_back(Vector<CacheEntry*>& entries)
+    {
+        if (entries.is_empty())
+            return;
+        quick_sort(entries, [](auto* a, auto* b) { return a->block_index < b->block_index; });
+
+        auto* transfer_buffer = this->transfer_buffer();
+        size_t max_run_count = transfer_buffer ? max_transfer_block_count() : 1;
+
+        for (size_t i = 0; i < entries.size();) {
+            size_t run_count = 1;
+            while (i + run_count < entries.size() && run_count < max_run_count
+                && entries[i + run_count]->block_index.value() == entries[i]->block_index.value() + run_count)
+                ++run_count;
+
+            bool success;
+            if (run_count == 1) {
+                success = write_to_device(entries[i]->block_index, 1, entries[i]->data);
+            } else {
+                for (size_t j = 0; j < run_count; ++j)
+                    memcpy(transfer_buffer->data() + j * m_fs.block_size(), entries[i + j]->data, m_fs.block_size());
+                success = write_to_device(entries[i]->block_index, run_count, transfer_buffer->data());
+            }
+            // FIXME: Should this error path be surfaced somehow?
+            if (!success)
+                dbgln("DiskCache: Failed to write back {} block(s) at {}", run_count, entries[i]->block_index);
+            i += run_count;
+        }
+    }
+
+    bool has_data(BlockBasedFS::BlockIndex block_index) const
+    {
+        auto* entry = find(block_index);
+        return entry && entry->has_data;
+    }
+
+    size_t max_transfer_block_count() const { return max(max_transfer_size / m_fs.block_size(), (size_t)1); }
+
+    KBuffer* transfer_buffer()
+    {
+        if (!m_transfer_buffer)
+            m_transfer_buffer = KBuffer::try_create_with_size(max_transfer_size, Region::Access::Read | Region::Access::Write, "DiskCache transfer");
+        return m_transfer_buffer.ptr();
+    }
+
+    bool write_to_device(BlockBasedFS::BlockIndex block_index, size_t count, const u8* data)
+    {
+        auto buffer = UserOrKernelBuffer::for_kernel_buffer(const_cast<u8*>(data));
+        return !m_fs.write_blocks_to_device(block_index, count, buffer).is_error();
+    }
+
+    struct Chunk {
+        NonnullOwnPtr<KBuffer> data;
+        NonnullOwnPtr<KBuffer> entry_storage;
+
+        CacheEntry* entries() { return (CacheEntry*)entry_storage->data(); }
+    };
+
+    static bool is_under_memory_pressure()
+    {
+        return MM.user_physical_pages_uncommitted() < MM.user_physical_pages() / 16;
+    }
+
+    bool can_grow() const
+    {
+        // Let the cache take up to a quarter of physical memory, but only for as
+        // long as there's plenty of uncommitted memory left for everyone else.
+        size_t chunk_page_count = ceil_div(m_entries_per_chunk * m_fs.block_size(), PAGE_SIZE);
+        size_t total_page_count = MM.user_physical_pages();
+        size_t uncommitted_page_count = MM.user_physical_pages_uncommitted();
+        if ((m_chunks.size() + 1) * chunk_page_count > total_page_count / 4)
+            return false;
+        return uncommitted_page_count > chunk_page_count + total_page_count / 8;
+    }
+
+    bool grow(bool force = false)
+    {
+        if (!force && !can_grow())
+            return false;
+        auto data = KBuffer::try_create_with_size(m_entries_per_chunk * m_fs.block_size(), Region::Access::Read | Region::Access::Write, "DiskCache");
+        auto entry_storage = KBuffer::try_create_with_size(m_entries_per_chunk * sizeof(CacheEntry), Region::Access::Read | Region::Access::Write, "DiskCache");
+        if (!data || !entry_storage)
+            return false;
+        m_chunks.append({ data.release_nonnull(), entry_storage.release_nonnull() });
+        auto& chunk = m_chunks.last();
+        auto* entries = chunk.entries();
+        for (size_t i = 0; i < m_entries_per_chunk; ++i) {
+            entries[i].data = chunk.data->data() + i * m_fs.block_size();
+            m_unused_list.append(entries[i]);
+        }
+        dbgln_if(BBFS_DEBUG, "DiskCache: Grew to {} entries", entry_count());
+        return true;
+    }
+
+    HashMap<BlockBasedFS::BlockIndex, CacheEntry*>& shard_for(BlockBasedFS::BlockIndex block_index) const
+    {
+        return m_shards[block_index.value() % shard_count];
+    }
+
+    void unindex(CacheEntry& entry) const
+    {
+        auto& shard = shard_for(entry.block_index);
+        if (auto it = shard.find(entry.block_index); it != shard.end() && it->value == &entry)
+            shard.remove(it);
+    }
+
     BlockBasedFS& m_fs;
-    size_t m_entry_count { 10000 };
-    mutable HashMap<BlockBasedFS::BlockIndex, CacheEntry*> m_hash;
+    size_t m_entries_per_chunk { 0 };
+    size_t m_dirty_count { 0 };
+    Vector<Chunk> m_chunks;
+    // NOTE: The index is split into shards so that growing the cache never has to rehash one huge table.
+    mutable HashMap<BlockBasedFS::BlockIndex, CacheEntry*> m_shards[shard_count];
+    // Entries that haven't held a block yet, these are handed out before anything gets recycled.
+    mutable IntrusiveList<CacheEntry, &CacheEntry::list_node> m_unused_list;
     mutable IntrusiveList<CacheEntry, &CacheEntry::list_node> m_clean_list;
     mutable IntrusiveList<CacheEntry, &CacheEntry::list_node> m_dirty_list;
-    KBuffer m_cached_block_data;
-    KBuffer m_entries;
-    bool m_dirty { false };
+    OwnPtr<KBuffer> m_transfer_buffer;
 };
 
 BlockBasedFS::BlockBasedFS(FileDescription& file_description)
@@ -148,6 +381,7 @@ KResult BlockBasedFS::write_block(BlockIndex index, const UserOrKernelBuffer& da
         if (nwritten.is_error())
             return nwritten.error();
         VERIFY(nwritten.value() == count);
+        cache().invalidate(index);
         return KSuccess;
     }
 
@@ -163,6 +397,13 @@ KResult BlockBasedFS::write_block(BlockIndex index, const UserOrKernelBuffer& da
 
     cache().mark_dirty(entry);
     entry.has_data = true;
+
+    if (cache().is_above_throttle_dirty_ratio()) {
+        // This writer is dirtying blocks faster than they're being written back.
+        // Make it write back a batch of the oldest ones before letting it continue.
+        LOCKER(m_lock);
+        cache().write_back_oldest(cache().throttle_batch_count(), [](auto&) { return true; });
+    }
     return KSuccess;
 }
 
@@ -210,6 +451,15 @@ KResult BlockBasedFS::write_blocks(BlockIndex index, unsigned count, const UserO
 {
     VERIFY(m_logical_block_size);
     dbgln_if(BBFS_DEBUG, "BlockBasedFileSystem::write_blocks {}, count={}", index, count);
+    if (!allow_cache) {
+        // Write the whole run in one go, but make sure the cache neither overwrites it later nor serves stale data.
+        for (unsigned i = 0; i < count; ++i)
+            flush_specific_block_if_needed(BlockIndex { index.value() + i });
+        auto result = write_blocks_to_device(index, count, data);
+        for (unsigned i = 0; i < count; ++i)
+            cache().invalidate(BlockIndex { index.value() + i });
+        return result;
+    }
     for (unsigned i = 0; i < count; ++i) {
         auto result = write_block(BlockIndex { index.value() + i }, data.offset(i * block_size()), block_size(), 0, allow_cache);
         if (result.is_error())
@@ -258,6 +508,12 @@ KResult BlockBasedFS::read_blocks(BlockIndex index, unsigned count, UserOrKernel
         return EINVAL;
     if (count == 1)
         return read_block(index, &buffer, block_size(), 0, allow_cache);
+    if (!allow_cache) {
+        // Read the whole run in one go, after making sure the device has the latest data.
+        for (unsigned i = 0; i < count; ++i)
+            const_cast<BlockBasedFS*>(this)->flush_specific_block_if_needed(BlockIndex { index.value() + i });
+        return read_blocks_from_device(index, count, buffer);
+    }
     auto out = buffer;
     for (unsigned i = 0; i < count; ++i) {
         auto result = read_block(BlockIndex { index.value() + i }, &out, block_size(), 0, allow_cache);
@@ -269,26 +525,68 @@ KResult BlockBasedFS::read_blocks(BlockIndex index, unsigned count, UserOrKernel
     return KSuccess;
 }
 
+void BlockBasedFS::prefetch_blocks(BlockIndex index, size_t count)
+{
+    LOCKER(m_lock);
+    cache().prefetch(index, count);
+}
+
+void BlockBasedFS::evict_blocks(BlockIndex index, size_t count)
+{
+    LOCKER(m_lock);
+    for (size_t i = 0; i < count; ++i) {
+        BlockIndex block_index { index.value() + i };
+        flush_specific_block_if_needed(block_index);
+        cache().invalidate(block_index);
+    }
+}
+
+KResult BlockBasedFS::read_blocks_from_device(BlockIndex index, size_t count, UserOrKernelBuffer& buffer) const
+{
+    size_t size = count * block_size();
+    LOCKER(m_lock);
+    if (file_description().seek((off_t)index.value() * block_size(), SEEK_SET) < 0)
+        return EIO;
+    // NOTE: The device may not be able to transfer the whole run at once, so keep going until it's done.
+    size_t nread = 0;
+    while (nread < size) {
+        auto out = buffer.offset(nread);
+        auto result = file_description().read(out, size - nread);
+        if (result.is_error())
+            return result.error();
+        if (result.value() == 0)
+            return EIO;
+        nread += result.value();
+    }
+    return KSuccess;
+}
+
+KResult BlockBasedFS::write_blocks_to_device(BlockIndex index, size_t count, const UserOrKernelBuffer& buffer)
+{
+    size_t size = count * block_size();
+    LOCKER(m_lock);
+    if (file_description().seek((off_t)index.value() * block_size(), SEEK_SET) < 0)
+        return EIO;
+    // NOTE: The device may not be able to transfer the whole run at once, so keep going until it's done.
+    size_t nwritten = 0;
+    while (nwritten < size) {
+        auto result = file_description().write(buffer.offset(nwritten), size - nwritten);
+        if (result.is_error())
+            return result.error();
+        if (result.value() == 0)
+            return EIO;
+        nwritten += result.value();
+    }
+    return KSuccess;
+}
+
 void BlockBasedFS::flush_specific_block_if_needed(BlockIndex index)
 {
     LOCKER(m_lock);
-    if (!cache().is_dirty())
+    auto* entry = cache().find(index);
+    if (!entry || !entry->is_dirty)
         return;
-    Vector<CacheEntry*, 32> cleaned_entries;
-    cache().for_each_dirty_entry([&](CacheEntry& entry) {
-        if (entry.block_index != index) {
-            size_t base_offset = entry.block_index.value() * block_size();
-            file_description().seek(base_offset, SEEK_SET);
-            // FIXME: Should this error path be surfaced somehow?
-            auto entry_data_buffer = UserOrKernelBuffer::for_kernel_buffer(entry.data);
-            [[maybe_unused]] auto rc = file_description().write(entry_data_buffer, block_size());
-            cleaned_entries.append(&entry);
-        }
-    });
-    // NOTE: We make a separate pass to mark entries clean since marking them clean
-    //       moves them out of the dirty list which would disturb the iteration above.
-    for (auto* entry : cleaned_entries)
-        cache().mark_clean(*entry);
+    cache().write_back_entry(*entry);
 }
 
 void BlockBasedFS::flush_writes_impl()
@@ -296,22 +594,31 @@ void BlockBasedFS::flush_writes_impl()
     LOCKER(m_lock);
     if (!cache().is_dirty())
         return;
-    u32 count = 0;
-    cache().for_each_dirty_entry([&](CacheEntry& entry) {
-        u32 base_offset = entry.block_index.value() * block_size();
-        file_description().seek(base_offset, SEEK_SET);
-        // FIXME: Should this error path be surfaced somehow?
-        auto entry_data_buffer = UserOrKernelBuffer::for_kernel_buffer(entry.data);
-        [[maybe_unused]] auto rc = file_description().write(entry_data_buffer, block_size());
-        ++count;
-    });
-    cache().mark_all_clean();
-    dbgln("{}: Flushed {} blocks to disk", class_name(), count);
+    size_t count = cache().write_back_oldest(cache().dirty_count(), [](auto&) { return true; });
+    dbgln_if(BBFS_DEBUG, "{}: Flushed {} blocks to disk", class_name(), count);
 }
 
 void BlockBasedFS::flush_writes()
 {
     flush_writes_impl();
+
+    LOCKER(m_lock);
+    cache().shrink_if_needed();
+}
+
+void BlockBasedFS::flush_expired_writes()
+{
+    LOCKER(m_lock);
+    if (cache().is_above_background_dirty_ratio()) {
+        flush_writes_impl();
+    } else {
+        auto now = TimeManagement::the().uptime_ms();
+        size_t count = cache().write_back_oldest(cache().dirty_count(), [&](auto& entry) {
+            return now - entry.dirtied_at_ms >= DiskCache::dirty_expire_ms;
+        });
+        dbgln_if(BBFS_DEBUG, "{}: Wrote back {} expired blocks", class_name(), count);
+    }
+    cache().shrink_if_needed();
 }
 
 DiskCache& BlockBasedFS::cache() const
@@ -39,6 +39,7 @@ public:
     size_t logical_block_size() const { return m_logical_block_size; };
 
     virtual void flush_writes() override;
+    virtual void flush_expired_writes() override;
     void flush_writes_impl();
 
 protected:
@@ -56,12 +57,20 @@ protected:
     KResult write_block(BlockIndex, const UserOrKernelBuffer&, size_t count, size_t offset = 0, bool allow_cache = true);
     KResult write_blocks(BlockIndex, unsigned count, const UserOrKernelBuffer&, bool allow_cache = true);
 
+    void prefetch_blocks(BlockIndex, size_t count);
+    void evict_blocks(BlockIndex, size_t count);
+
     size_t m_logical_block_size { 512 };
 
 private:
+    friend class DiskCache;
+
     DiskCache& cache() const;
     void flush_specific_block_if_needed(BlockIndex index);
 
+    KResult read_blocks_from_device(BlockIndex, size_t count, UserOrKernelBuffer&) const;
+    KResult write_blocks_to_device(BlockIndex, size_t count, const UserOrKernelBuffer&);
+
     mutable OwnPtr<DiskCache> m_cache;
 };
 
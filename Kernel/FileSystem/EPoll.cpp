@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/FileSystem/EPoll.h>
+#include <Kernel/FileSystem/FIFO.h>
+#include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/Net/Socket.h>
+
+namespace Kernel {
+
+static constexpr u32 epoll_mode_flags = EPOLLET | EPOLLONESHOT;
+
+static Thread::FileBlocker::BlockFlags block_flags_for_events(u32 events)
+{
+    u32 block_flags = (u32)Thread::FileBlocker::BlockFlags::None;
+    if (events & EPOLLIN)
+        block_flags |= (u32)Thread::FileBlocker::BlockFlags::Read;
+    if (events & EPOLLOUT)
+        block_flags |= (u32)Thread::FileBlocker::BlockFlags::Write;
+    if (events & EPOLLPRI)
+        block_flags |= (u32)Thread::FileBlocker::BlockFlags::ReadPriority;
+    return (Thread::FileBlocker::BlockFlags)block_flags;
+}
+
+static u32 events_for_block_flags(Thread::FileBlocker::BlockFlags flags)
+{
+    u32 events = 0;
+    if ((u32)flags & (u32)Thread::FileBlocker::BlockFlags::Read)
+        events |= EPOLLIN;
+    if ((u32)flags & (u32)Thread::FileBlocker::BlockFlags::Write)
+        events |= EPOLLOUT;
+    if ((u32)flags & (u32)Thread::FileBlocker::BlockFlags::ReadPriority)
+        events |= EPOLLPRI;
+    return events;
+}
+
+// EPOLLHUP and EPOLLERR are always reported, whether they were asked for or not.
+static u32 exceptional_events(FileDescription& description)
+{
+    u32 events = 0;
+    if (description.is_fifo()) {
+        auto& fifo = *description.fifo();
+        if (description.fifo_direction() == FIFO::Direction::Reader && !fifo.writers())
+            events |= EPOLLHUP;
+        if (description.fifo_direction() == FIFO::Direction::Writer && !fifo.readers())
+            events |= EPOLLERR;
+    } else if (description.is_socket()) {
+        auto& socket = *description.socket();
+        auto role = socket.role(description);
+        bool was_connected = role == Socket::Role::Connected || role == Socket::Role::Accepted;
+        if ((was_connected && !socket.is_connected()) || (socket.is_shut_down_for_reading() && socket.is_shut_down_for_writing()))
+            events |= EPOLLHUP;
+    }
+    return events;
+}
+
+EPollEntry::EPollEntry(EPoll& epoll, FileDescription& description, const epoll_event& event)
+    : epoll(epoll)
+    , description(description)
+    , file(description.file())
+    , event(event)
+{
+}
+
+NonnullRefPtr<EPoll> EPoll::create()
+{
+    return adopt(*new EPoll);
+}
+
+EPoll::EPoll()
+{
+}
+
+EPoll::~EPoll()
+{
+    // NOTE: A description that died while we were already dying has taken our entry off its block condition,
+    //       but left it to us to free. We go through the file here, as the description may be gone.
+    for (auto& it : m_entries)
+        it.value->file->block_condition().remove_epoll_entry(*it.value);
+    m_ready_list.clear();
+}
+
+bool EPoll::is_ready(EPollEntry& entry) const
+{
+    u32 events;
+    {
+        ScopedSpinLock lock(m_ready_lock);
+        events = entry.event.events;
+    }
+    if (!(events & ~epoll_mode_flags))
+        return false;
+    if (exceptional_events(entry.description))
+        return true;
+    return entry.description.should_unblock(block_flags_for_events(events)) != Thread::FileBlocker::BlockFlags::None;
+}
+
+KResult EPoll::add(FileDescription& description, const epoll_event& event)
+{
+    LOCKER(m_lock);
+    if (m_entries.contains(&description))
+        return EEXIST;
+    auto entry = make<EPollEntry>(*this, description, event);
+    auto& entry_ref = *entry;
+    m_entries.set(&description, move(entry));
+    description.block_condition().add_epoll_entry(entry_ref);
+
+    // The description may already be ready, in which case no notification is coming.
+    if (is_ready(entry_ref)) {
+        {
+            ScopedSpinLock lock(m_ready_lock);
+            if (!entry_ref.ready_list_node.is_in_list())
+                m_ready_list.append(entry_ref);
+        }
+        evaluate_block_conditions();
+    }
+    return KSuccess;
+}
+
+KResult EPoll::modify(FileDescription& description, const epoll_event& event)
+{
+    LOCKER(m_lock);
+    auto it = m_entries.find(&description);
+    if (it == m_entries.end())
+        return ENOENT;
+    auto& entry = *it->value;
+    {
+        ScopedSpinLock lock(m_ready_lock);
+        entry.event = event;
+    }
+    // NOTE: Like EPOLL_CTL_ADD, this re-arms the entry, so current readiness gets reported again.
+    if (is_ready(entry)) {
+        {
+            ScopedSpinLock lock(m_ready_lock);
+            if (!entry.ready_list_node.is_in_list())
+                m_ready_list.append(entry);
+        }
+        evaluate_block_conditions();
+    } else {
+        remove_from_ready_list(entry);
+    }
+    return KSuccess;
+}
+
+KResult EPoll::remove(FileDescription& description)
+{
+    LOCKER(m_lock);
+    auto it = m_entries.find(&description);
+    if (it == m_entries.end())
+        return ENOENT;
+    auto entry = move(it->value);
+    m_entries.remove(it);
+    // NOTE: Once the entry is off the block condition, it can't be put back on the ready list.
+    description.block_condition().remove_epoll_entry(*entry);
+    remove_from_ready_list(*entry);
+    return KSuccess;
+}
+
+void EPoll::forget(Badge<FileBlockCondition>, EPollEntry& entry)
+{
+    LOCKER(m_lock);
+    remove_from_ready_list(entry);
+    m_entries.remove(&entry.description);
+}
+
+void EPoll::remove_from_ready_list(EPollEntry& entry)
+{
+    ScopedSpinLock lock(m_ready_lock);
+    if (entry.ready_list_node.is_in_list())
+        m_ready_list.remove(entry);
+}
+
+bool EPoll::notify(Badge<FileBlockCondition>, EPollEntry& entry)
+{
+    {
+        ScopedSpinLock lock(m_ready_lock);
+        if (entry.ready_list_node.is_in_list())
+            return false;
+    }
+    if (!is_ready(entry))
+        return false;
+    ScopedSpinLock lock(m_ready_lock);
+    if (entry.ready_list_node.is_in_list())
+        return false;
+    m_ready_list.append(entry);
+    return true;
+}
+
+void EPoll::collect_ready_events(Vector<epoll_event, 32>& events, size_t max_events)
+{
+    LOCKER(m_lock);
+    Vector<EPollEntry*, 32> still_ready;
+    while (events.size() < max_events) {
+        EPollEntry* entry;
+        u32 interest;
+        {
+            ScopedSpinLock lock(m_ready_lock);
+            entry = m_ready_list.take_first();
+            if (!entry)
+                break;
+            interest = entry->event.events;
+        }
+
+        // Readiness is re-checked here, as it may have been consumed since the notification.
+        if (!(interest & ~epoll_mode_flags))
+            continue;
+        auto flags = entry->description.should_unblock(block_flags_for_events(interest));
+        auto ready_events = events_for_block_flags(flags) | exceptional_events(entry->description);
+        if (!ready_events)
+            continue;
+
+        ScopedSpinLock lock(m_ready_lock);
+        events.append({ ready_events, entry->event.data });
+        if (interest & EPOLLONESHOT)
+            entry->event.events &= epoll_mode_flags;
+        else if (!(interest & EPOLLET))
+            still_ready.append(entry);
+    }
+
+    // Level-triggered entries stay on the ready list until a wait finds them no longer ready.
+    ScopedSpinLock lock(m_ready_lock);
+    for (auto* entry : still_ready) {
+        if (!entry->ready_list_node.is_in_list())
+            m_ready_list.append(*entry);
+    }
+}
+
+bool EPoll::can_read(const FileDescription&, size_t) const
+{
+    ScopedSpinLock lock(m_ready_lock);
+    return !m_ready_list.is_empty();
+}
+
+}
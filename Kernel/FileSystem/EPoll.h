@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Badge.h>
+#include <AK/HashMap.h>
+#include <AK/IntrusiveList.h>
+#include <AK/OwnPtr.h>
+#include <Kernel/FileSystem/File.h>
+#include <Kernel/Lock.h>
+#include <Kernel/SpinLock.h>
+#include <Kernel/UnixTypes.h>
+
+namespace Kernel {
+
+class EPoll;
+
+// An EPollEntry lives on the watched file's FileBlockCondition for as long as it is registered,
+// so readiness changes reach the epoll directly instead of being rediscovered by scanning.
+// NOTE: The entry keeps the file alive, but not the description. A dying description takes its
+//       entries off the block condition, so the epoll must only reach the description while it
+//       still has the entry in m_entries.
+struct EPollEntry {
+    AK_MAKE_NONCOPYABLE(EPollEntry);
+    AK_MAKE_NONMOVABLE(EPollEntry);
+
+public:
+    EPollEntry(EPoll& epoll, FileDescription& description, const epoll_event& event);
+
+    EPoll& epoll;
+    FileDescription& description;
+    NonnullRefPtr<File> file;
+    epoll_event event;
+    IntrusiveListNode ready_list_node;
+};
+
+class EPoll final : public File {
+public:
+    static NonnullRefPtr<EPoll> create();
+    virtual ~EPoll() override;
+
+    KResult add(FileDescription&, const epoll_event&);
+    KResult modify(FileDescription&, const epoll_event&);
+    KResult remove(FileDescription&);
+    void collect_ready_events(Vector<epoll_event, 32>&, size_t max_events);
+
+    // Called by the watched file's FileBlockCondition with its lock held.
+    bool notify(Badge<FileBlockCondition>, EPollEntry&);
+    void wake_waiters(Badge<FileBlockCondition>) { evaluate_block_conditions(); }
+    void forget(Badge<FileBlockCondition>, EPollEntry&);
+
+    virtual bool can_read(const FileDescription&, size_t) const override;
+    virtual bool can_write(const FileDescription&, size_t) const override { return false; }
+    virtual KResultOr<size_t> read(FileDescription&, size_t, UserOrKernelBuffer&, size_t) override { return EINVAL; }
+    virtual KResultOr<size_t> write(FileDescription&, size_t, const UserOrKernelBuffer&, size_t) override { return EINVAL; }
+    virtual String absolute_path(const FileDescription&) const override { return "epoll"; }
+    virtual const char* class_name() const override { return "EPoll"; }
+    virtual bool is_epoll() const override { return true; }
+
+private:
+    EPoll();
+
+    bool is_ready(EPollEntry&) const;
+    void remove_from_ready_list(EPollEntry&);
+
+    // NOTE: m_lock guards the set of entries, m_ready_lock guards the ready list and entry events,
+    //       which are also touched from inside the watched files' block conditions.
+    Lock m_lock { "EPoll" };
+    HashMap<FileDescription*, OwnPtr<EPollEntry>> m_entries;
+
+    mutable SpinLock<u8> m_ready_lock;
+    IntrusiveList<EPollEntry, &EPollEntry::ready_list_node> m_ready_list;
+};
+
+}
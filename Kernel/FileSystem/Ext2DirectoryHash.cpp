@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Types.h>
+#include <Kernel/FileSystem/Ext2DirectoryHash.h>
+#include <Kernel/FileSystem/ext2_fs.h>
+
+namespace Kernel {
+
+static u32 rotate_left(u32 value, unsigned bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static void tea_transform(u32 buffer[4], const u32 in[4])
+{
+    u32 sum = 0;
+    u32 b0 = buffer[0];
+    u32 b1 = buffer[1];
+    for (int i = 0; i < 16; ++i) {
+        sum += 0x9E3779B9;
+        b0 += ((b1 << 4) + in[0]) ^ (b1 + sum) ^ ((b1 >> 5) + in[1]);
+        b1 += ((b0 << 4) + in[2]) ^ (b0 + sum) ^ ((b0 >> 5) + in[3]);
+    }
+    buffer[0] += b0;
+    buffer[1] += b1;
+}
+
+static void half_md4_transform(u32 buffer[4], const u32 in[8])
+{
+    auto f = [](u32 x, u32 y, u32 z) { return z ^ (x & (y ^ z)); };
+    auto g = [](u32 x, u32 y, u32 z) { return (x & y) + ((x ^ y) & z); };
+    auto h = [](u32 x, u32 y, u32 z) { return x ^ y ^ z; };
+    constexpr u32 k2 = 013240474631;
+    constexpr u32 k3 = 015666365641;
+
+    u32 a = buffer[0];
+    u32 b = buffer[1];
+    u32 c = buffer[2];
+    u32 d = buffer[3];
+
+#define ROUND(function, a, b, c, d, x, s) (a += function(b, c, d) + (x), a = rotate_left(a, s))
+    ROUND(f, a, b, c, d, in[0], 3);
+    ROUND(f, d, a, b, c, in[1], 7);
+    ROUND(f, c, d, a, b, in[2], 11);
+    ROUND(f, b, c, d, a, in[3], 19);
+    ROUND(f, a, b, c, d, in[4], 3);
+    ROUND(f, d, a, b, c, in[5], 7);
+    ROUND(f, c, d, a, b, in[6], 11);
+    ROUND(f, b, c, d, a, in[7], 19);
+
+    ROUND(g, a, b, c, d, in[1] + k2, 3);
+    ROUND(g, d, a, b, c, in[3] + k2, 5);
+    ROUND(g, c, d, a, b, in[5] + k2, 9);
+    ROUND(g, b, c, d, a, in[7] + k2, 13);
+    ROUND(g, a, b, c, d, in[0] + k2, 3);
+    ROUND(g, d, a, b, c, in[2] + k2, 5);
+    ROUND(g, c, d, a, b, in[4] + k2, 9);
+    ROUND(g, b, c, d, a, in[6] + k2, 13);
+
+    ROUND(h, a, b, c, d, in[3] + k3, 3);
+    ROUND(h, d, a, b, c, in[7] + k3, 9);
+    ROUND(h, c, d, a, b, in[2] + k3, 11);
+    ROUND(h, b, c, d, a, in[6] + k3, 15);
+    ROUND(h, a, b, c, d, in[1] + k3, 3);
+    ROUND(h, d, a, b, c, in[5] + k3, 9);
+    ROUND(h, c, d, a, b, in[0] + k3, 11);
+    ROUND(h, b, c, d, a, in[4] + k3, 15);
+#undef ROUND
+
+    buffer[0] += a;
+    buffer[1] += b;
+    buffer[2] += c;
+    buffer[3] += d;
+}
+
+template<typename CharType>
+static u32 legacy_hash(const StringView& name)
+{
+    u32 hash0 = 0x12a3fe2d;
+    u32 hash1 = 0x37abe8f9;
+    for (size_t i = 0; i < name.length(); ++i) {
+        u32 hash = hash1 + (hash0 ^ ((u32)(int)(CharType)name[i] * 7152373));
+        if (hash & 0x80000000)
+            hash -= 0x7fffffff;
+        hash1 = hash0;
+        hash0 = hash;
+    }
+    return hash0 << 1;
+}
+
+// Packs (up to) the next num_words * 4 bytes of the name into words, padding with the name length.
+template<typename CharType>
+static void string_to_hash_buffer(const char* characters, size_t length, u32* words, size_t num_words)
+{
+    u32 pad = (u32)length | ((u32)length << 8);
+    pad |= pad << 16;
+
+    u32 value = pad;
+    length = min(length, num_words * 4);
+    size_t words_written = 0;
+    for (size_t i = 0; i < length; ++i) {
+        value = (u32)(int)(CharType)characters[i] + (value << 8);
+        if ((i % 4) == 3) {
+            words[words_written++] = value;
+            value = pad;
+        }
+    }
+    if (words_written < num_words)
+        words[words_written++] = value;
+    while (words_written < num_words)
+        words[words_written++] = pad;
+}
+
+template<typename CharType>
+static u32 hash_with_transform(const StringView& name, u32 buffer[4], u8 hash_version)
+{
+    u32 in[8];
+    const char* characters = name.characters_without_null_termination();
+    size_t length = name.length();
+    if (hash_version == EXT2_HASH_TEA) {
+        do {
+            string_to_hash_buffer<CharType>(characters, length, in, 4);
+            tea_transform(buffer, in);
+            characters += min(length, (size_t)16);
+            length -= min(length, (size_t)16);
+        } while (length > 0);
+        return buffer[0];
+    }
+
+    do {
+        string_to_hash_buffer<CharType>(characters, length, in, 8);
+        half_md4_transform(buffer, in);
+        characters += min(length, (size_t)32);
+        length -= min(length, (size_t)32);
+    } while (length > 0);
+    return buffer[1];
+}
+
+u32 ext2_directory_hash(const StringView& name, u8 hash_version, const u32 seed[4])
+{
+    u32 buffer[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    if (seed[0] || seed[1] || seed[2] || seed[3]) {
+        for (size_t i = 0; i < 4; ++i)
+            buffer[i] = seed[i];
+    }
+
+    u32 hash;
+    switch (hash_version) {
+    case EXT2_HASH_LEGACY:
+        hash = legacy_hash<i8>(name);
+        break;
+    case EXT2_HASH_LEGACY_UNSIGNED:
+        hash = legacy_hash<u8>(name);
+        break;
+    case EXT2_HASH_HALF_MD4:
+    case EXT2_HASH_TEA:
+        hash = hash_with_transform<i8>(name, buffer, hash_version);
+        break;
+    case EXT2_HASH_HALF_MD4_UNSIGNED:
+    case EXT2_HASH_TEA_UNSIGNED:
+        hash = hash_with_transform<u8>(name, buffer, hash_version - 3);
+        break;
+    default:
+        VERIFY_NOT_REACHED();
+    }
+
+    hash &= ~1u;
+    // NOTE: 0xfffffffe is reserved to mark the end of a directory.
+    if (hash == 0xfffffffe)
+        hash = 0xfffffffc;
+    return hash;
+}
+
+}
@@ -27,14 +27,17 @@
 #include <AK/Bitmap.h>
 #include <AK/HashMap.h>
 #include <AK/MemoryStream.h>
+#include <AK/QuickSort.h>
 #include <AK/StdLibExtras.h>
 #include <AK/StringView.h>
 #include <Kernel/Debug.h>
 #include <Kernel/Devices/BlockDevice.h>
+#include <Kernel/FileSystem/Ext2DirectoryHash.h>
 #include <Kernel/FileSystem/Ext2FileSystem.h>
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/FileSystem/ext2_fs.h>
 #include <Kernel/Process.h>
+#include <Kernel/Time/TimeManagement.h>
 #include <Kernel/UnixTypes.h>
 #include <LibC/errno_numbers.h>
 
@@ -43,6 +46,15 @@ namespace Kernel {
 static const size_t max_link_count = 65535;
 static const size_t max_block_size = 4096;
 static const ssize_t max_inline_symlink_length = 60;
+// Reads of at least this many physically contiguous bytes go straight to the device, bypassing the block cache.
+static const size_t uncached_read_threshold = 128 * KiB;
+static const size_t max_cached_block_map_leaves = 128;
+static const size_t block_reservation_size = 256 * KiB;
+// Delayed blocks are allocated at the first writeback after they've been around for this long,
+// or right away once a single inode (or the whole file system) buffers too many of them.
+static const u64 delayed_allocation_expire_ms = 3000;
+static const size_t max_delayed_bytes_per_inode = 1 * MiB;
+static const size_t max_delayed_bytes = 16 * MiB;
 
 struct Ext2FSDirectoryEntry {
     String name;
@@ -231,205 +243,6 @@ Ext2FS::BlockListShape Ext2FS::compute_block_list_shape(unsigned blocks) const
     return shape;
 }
 
-KResult Ext2FS::write_block_list_for_inode(InodeIndex inode_index, ext2_inode& e2inode, const Vector<BlockIndex>& blocks)
-{
-    LOCKER(m_lock);
-
-    if (blocks.is_empty()) {
-        e2inode.i_blocks = 0;
-        memset(e2inode.i_block, 0, sizeof(e2inode.i_block));
-        write_ext2_inode(inode_index, e2inode);
-        return KSuccess;
-    }
-
-    // NOTE: There is a mismatch between i_blocks and blocks.size() since i_blocks includes meta blocks and blocks.size() does not.
-    auto old_block_count = ceil_div(static_cast<size_t>(e2inode.i_size), block_size());
-
-    auto old_shape = compute_block_list_shape(old_block_count);
-    auto new_shape = compute_block_list_shape(blocks.size());
-
-    Vector<BlockIndex> new_meta_blocks;
-    if (new_shape.meta_blocks > old_shape.meta_blocks) {
-        new_meta_blocks = allocate_blocks(group_index_from_inode(inode_index), new_shape.meta_blocks - old_shape.meta_blocks);
-    }
-
-    e2inode.i_blocks = (blocks.size() + new_shape.meta_blocks) * (block_size() / 512);
-
-    bool inode_dirty = false;
-
-    unsigned output_block_index = 0;
-    unsigned remaining_blocks = blocks.size();
-    for (unsigned i = 0; i < new_shape.direct_blocks; ++i) {
-        if (e2inode.i_block[i] != blocks[output_block_index])
-            inode_dirty = true;
-        e2inode.i_block[i] = blocks[output_block_index].value();
-        ++output_block_index;
-        --remaining_blocks;
-    }
-    if (inode_dirty) {
-        if constexpr (EXT2_DEBUG) {
-            dbgln("Ext2FS: Writing {} direct block(s) to i_block array of inode {}", min((size_t)EXT2_NDIR_BLOCKS, blocks.size()), inode_index);
-            for (size_t i = 0; i < min((size_t)EXT2_NDIR_BLOCKS, blocks.size()); ++i)
-                dbgln("   + {}", blocks[i]);
-        }
-        write_ext2_inode(inode_index, e2inode);
-        inode_dirty = false;
-    }
-
-    if (!remaining_blocks)
-        return KSuccess;
-
-    const unsigned entries_per_block = EXT2_ADDR_PER_BLOCK(&super_block());
-
-    bool ind_block_new = !e2inode.i_block[EXT2_IND_BLOCK];
-    if (ind_block_new) {
-        BlockIndex new_indirect_block = new_meta_blocks.take_last();
-        if (e2inode.i_block[EXT2_IND_BLOCK] != new_indirect_block)
-            inode_dirty = true;
-        e2inode.i_block[EXT2_IND_BLOCK] = new_indirect_block.value();
-        if (inode_dirty) {
-            dbgln_if(EXT2_DEBUG, "Ext2FS: Adding the indirect block to i_block array of inode {}", inode_index);
-            write_ext2_inode(inode_index, e2inode);
-            inode_dirty = false;
-        }
-    }
-
-    if (old_shape.indirect_blocks == new_shape.indirect_blocks) {
-        // No need to update the singly indirect block array.
-        remaining_blocks -= new_shape.indirect_blocks;
-        output_block_index += new_shape.indirect_blocks;
-    } else {
-        auto block_contents = ByteBuffer::create_uninitialized(block_size());
-        OutputMemoryStream stream { block_contents };
-
-        VERIFY(new_shape.indirect_blocks <= entries_per_block);
-        for (unsigned i = 0; i < new_shape.indirect_blocks; ++i) {
-            stream << blocks[output_block_index++].value();
-            --remaining_blocks;
-        }
-
-        stream.fill_to_end(0);
-
-        auto buffer = UserOrKernelBuffer::for_kernel_buffer(stream.data());
-        auto result = write_block(e2inode.i_block[EXT2_IND_BLOCK], buffer, stream.size());
-        if (result.is_error())
-            return result;
-    }
-
-    if (!remaining_blocks)
-        return KSuccess;
-
-    bool dind_block_dirty = false;
-
-    bool dind_block_new = !e2inode.i_block[EXT2_DIND_BLOCK];
-    if (dind_block_new) {
-        BlockIndex new_dindirect_block = new_meta_blocks.take_last();
-        if (e2inode.i_block[EXT2_DIND_BLOCK] != new_dindirect_block)
-            inode_dirty = true;
-        e2inode.i_block[EXT2_DIND_BLOCK] = new_dindirect_block.value();
-        if (inode_dirty) {
-            dbgln_if(EXT2_DEBUG, "Ext2FS: Adding the doubly-indirect block to i_block array of inode {}", inode_index);
-            write_ext2_inode(inode_index, e2inode);
-            inode_dirty = false;
-        }
-    }
-
-    if (old_shape.doubly_indirect_blocks == new_shape.doubly_indirect_blocks) {
-        // No need to update the doubly indirect block data.
-        remaining_blocks -= new_shape.doubly_indirect_blocks;
-        output_block_index += new_shape.doubly_indirect_blocks;
-    } else {
-        unsigned indirect_block_count = divide_rounded_up(new_shape.doubly_indirect_blocks, entries_per_block);
-
-        auto dind_block_contents = ByteBuffer::create_uninitialized(block_size());
-        if (dind_block_new) {
-            dind_block_contents.zero_fill();
-            dind_block_dirty = true;
-        } else {
-            auto buffer = UserOrKernelBuffer::for_kernel_buffer(dind_block_contents.data());
-            auto result = read_block(e2inode.i_block[EXT2_DIND_BLOCK], &buffer, block_size());
-            if (result.is_error()) {
-                dbgln("Ext2FS: write_block_list_for_inode had error: {}", result.error());
-                return result;
-            }
-        }
-        auto* dind_block_as_pointers = (unsigned*)dind_block_contents.data();
-
-        VERIFY(indirect_block_count <= entries_per_block);
-        for (unsigned i = 0; i < indirect_block_count; ++i) {
-            bool ind_block_dirty = false;
-
-            BlockIndex indirect_block_index = dind_block_as_pointers[i];
-
-            bool ind_block_new = !indirect_block_index;
-            if (ind_block_new) {
-                indirect_block_index = new_meta_blocks.take_last();
-                dind_block_as_pointers[i] = indirect_block_index.value();
-                dind_block_dirty = true;
-            }
-
-            auto ind_block_contents = ByteBuffer::create_uninitialized(block_size());
-            if (ind_block_new) {
-                ind_block_contents.zero_fill();
-                ind_block_dirty = true;
-            } else {
-                auto buffer = UserOrKernelBuffer::for_kernel_buffer(ind_block_contents.data());
-                auto result = read_block(indirect_block_index, &buffer, block_size());
-                if (result.is_error()) {
-                    dbgln("Ext2FS: write_block_list_for_inode had error: {}", result.error());
-                    return result;
-                }
-            }
-            auto* ind_block_as_pointers = (unsigned*)ind_block_contents.data();
-
-            unsigned entries_to_write = new_shape.doubly_indirect_blocks - (i * entries_per_block);
-            if (entries_to_write > entries_per_block)
-                entries_to_write = entries_per_block;
-
-            VERIFY(entries_to_write <= entries_per_block);
-            for (unsigned j = 0; j < entries_to_write; ++j) {
-                BlockIndex output_block = blocks[output_block_index++];
-                if (ind_block_as_pointers[j] != output_block) {
-                    ind_block_as_pointers[j] = output_block.value();
-                    ind_block_dirty = true;
-                }
-                --remaining_blocks;
-            }
-            for (unsigned j = entries_to_write; j < entries_per_block; ++j) {
-                if (ind_block_as_pointers[j] != 0) {
-                    ind_block_as_pointers[j] = 0;
-                    ind_block_dirty = true;
-                }
-            }
-
-            if (ind_block_dirty) {
-                auto buffer = UserOrKernelBuffer::for_kernel_buffer(ind_block_contents.data());
-                int err = write_block(indirect_block_index, buffer, block_size());
-                VERIFY(err >= 0);
-            }
-        }
-        for (unsigned i = indirect_block_count; i < entries_per_block; ++i) {
-            if (dind_block_as_pointers[i] != 0) {
-                dind_block_as_pointers[i] = 0;
-                dind_block_dirty = true;
-            }
-        }
-
-        if (dind_block_dirty) {
-            auto buffer = UserOrKernelBuffer::for_kernel_buffer(dind_block_contents.data());
-            int err = write_block(e2inode.i_block[EXT2_DIND_BLOCK], buffer, block_size());
-            VERIFY(err >= 0);
-        }
-    }
-
-    if (!remaining_blocks)
-        return KSuccess;
-
-    // FIXME: Implement!
-    dbgln("we don't know how to write tind ext2fs blocks yet!");
-    VERIFY_NOT_REACHED();
-}
-
 Vector<Ext2FS::BlockIndex> Ext2FS::block_list_for_inode(const ext2_inode& e2inode, bool include_block_list_blocks) const
 {
     auto block_list = block_list_for_inode_impl(e2inode, include_block_list_blocks);
@@ -575,7 +388,7 @@ void Ext2FS::flush_block_group_descriptor_table()
         dbgln("Ext2FS: flush_block_group_descriptor_table had error: {}", result.error());
 }
 
-void Ext2FS::flush_writes()
+void Ext2FS::flush_metadata_to_cache()
 {
     LOCKER(m_lock);
     if (m_super_block_dirty) {
@@ -597,9 +410,11 @@ void Ext2FS::flush_writes()
             dbgln_if(EXT2_DEBUG, "Flushed bitmap block {}", cached_bitmap->bitmap_block_index);
         }
     }
+}
 
-    BlockBasedFS::flush_writes();
-
+void Ext2FS::uncache_unused_inodes()
+{
+    LOCKER(m_lock);
     // Uncache Inodes that are only kept alive by the index-to-inode lookup cache.
     // We don't uncache Inodes that are being watched by at least one InodeWatcher.
 
@@ -612,12 +427,78 @@ void Ext2FS::flush_writes()
             continue;
         if (it.value->has_watchers())
             continue;
+        // Inodes with delayed blocks are the only place their data lives, keep them until it's written back.
+        if (!it.value->m_delayed_blocks.is_empty())
+            continue;
         unused_inodes.append(it.key);
     }
     for (auto index : unused_inodes)
         uncache_inode(index);
 }
 
+void Ext2FS::allocate_delayed_blocks(bool only_expired)
+{
+    // NOTE: Inode locks are taken before the FS lock everywhere else, so we must not hold it
+    //       while visiting the inodes.
+    NonnullRefPtrVector<Ext2FSInode> inodes;
+    {
+        LOCKER(m_lock);
+        for (auto& it : m_inode_cache) {
+            if (it.value && !it.value->m_delayed_blocks.is_empty())
+                inodes.append(*it.value);
+        }
+    }
+
+    auto now = TimeManagement::the().uptime_ms();
+    for (auto& inode : inodes) {
+        LOCKER(inode.m_lock);
+        if (inode.m_delayed_blocks.is_empty())
+            continue;
+        if (only_expired && now - inode.m_delayed_since_ms < delayed_allocation_expire_ms)
+            continue;
+        auto result = inode.allocate_delayed_blocks();
+        if (result.is_error()) {
+            dbgln("Ext2FS: Failed to allocate delayed blocks for inode {}: {}", inode.index(), result.error());
+            continue;
+        }
+        inode.flush_metadata();
+    }
+}
+
+KResult Ext2FS::reserve_delayed_blocks(size_t count)
+{
+    LOCKER(m_lock);
+    if (m_delayed_block_count + count > super_block().s_free_blocks_count)
+        return ENOSPC;
+    m_delayed_block_count += count;
+    return KSuccess;
+}
+
+void Ext2FS::release_delayed_blocks(size_t count)
+{
+    LOCKER(m_lock);
+    VERIFY(m_delayed_block_count >= count);
+    m_delayed_block_count -= count;
+}
+
+void Ext2FS::flush_writes()
+{
+    allocate_delayed_blocks(false);
+    LOCKER(m_lock);
+    flush_metadata_to_cache();
+    BlockBasedFS::flush_writes();
+    uncache_unused_inodes();
+}
+
+void Ext2FS::flush_expired_writes()
+{
+    allocate_delayed_blocks(true);
+    LOCKER(m_lock);
+    flush_metadata_to_cache();
+    BlockBasedFS::flush_expired_writes();
+    uncache_unused_inodes();
+}
+
 Ext2FSInode::Ext2FSInode(Ext2FS& fs, InodeIndex index)
     : Inode(fs, index)
 {
@@ -625,6 +506,17 @@ Ext2FSInode::Ext2FSInode(Ext2FS& fs, InodeIndex index)
 
 Ext2FSInode::~Ext2FSInode()
 {
+    if (!m_delayed_blocks.is_empty()) {
+        if (m_raw_inode.i_links_count != 0) {
+            auto result = allocate_delayed_blocks();
+            if (result.is_error())
+                dbgln("Ext2FS: Lost delayed blocks of inode {}: {}", index(), result.error());
+            else
+                fs().write_ext2_inode(index(), m_raw_inode);
+        }
+        discard_delayed_blocks();
+    }
+    fs().discard_block_reservation(index());
     if (m_raw_inode.i_links_count == 0)
         fs().free_inode(*this);
 }
@@ -660,7 +552,14 @@ void Ext2FSInode::flush_metadata()
 {
     LOCKER(m_lock);
     dbgln_if(EXT2_DEBUG, "Ext2FS: flush_metadata for inode {}", index());
-    fs().write_ext2_inode(index(), m_raw_inode);
+    if (!m_delayed_blocks.is_empty()) {
+        // The on-disk size must not cover blocks that haven't been allocated yet.
+        auto raw_inode = m_raw_inode;
+        raw_inode.i_size = min((u64)size(), (u64)allocated_block_count() * fs().block_size());
+        fs().write_ext2_inode(index(), raw_inode);
+    } else {
+        fs().write_ext2_inode(index(), m_raw_inode);
+    }
     if (is_directory()) {
         // Unless we're about to go away permanently, invalidate the lookup cache.
         if (m_raw_inode.i_links_count != 0) {
@@ -703,6 +602,302 @@ RefPtr<Inode> Ext2FS::get_inode(InodeIdentifier inode) const
     return new_inode;
 }
 
+size_t Ext2FSInode::block_count() const
+{
+    // Short symlinks are stored inline in the i_block array and don't have any blocks.
+    if (is_symlink() && m_raw_inode.i_blocks == 0)
+        return 0;
+    return ceil_div(size(), (size_t)fs().block_size());
+}
+
+KResultOr<Ext2FS::BlockIndex> Ext2FSInode::leaf_block(size_t leaf_index, bool allocate, Ext2FS::BlockIndex goal)
+{
+    // Leaf 0 is the singly indirect block, followed by the leaves below the doubly
+    // indirect block and then the ones below the triply indirect block.
+    const size_t entries_per_block = EXT2_ADDR_PER_BLOCK(&fs().super_block());
+    size_t path[2];
+    size_t path_length = 0;
+    u32* root = nullptr;
+    if (leaf_index == 0) {
+        root = &m_raw_inode.i_block[EXT2_IND_BLOCK];
+    } else if (leaf_index - 1 < entries_per_block) {
+        root = &m_raw_inode.i_block[EXT2_DIND_BLOCK];
+        path[path_length++] = leaf_index - 1;
+    } else if (leaf_index - 1 - entries_per_block < entries_per_block * entries_per_block) {
+        root = &m_raw_inode.i_block[EXT2_TIND_BLOCK];
+        size_t index_below_root = leaf_index - 1 - entries_per_block;
+        path[path_length++] = index_below_root / entries_per_block;
+        path[path_length++] = index_below_root % entries_per_block;
+    } else {
+        return EFBIG;
+    }
+
+    if (!*root) {
+        if (!allocate)
+            return Ext2FS::BlockIndex(0);
+        auto new_block_or_error = allocate_pointer_block(goal);
+        if (new_block_or_error.is_error())
+            return new_block_or_error.error();
+        *root = new_block_or_error.value().value();
+        set_metadata_dirty(true);
+    }
+
+    Ext2FS::BlockIndex block = *root;
+    for (size_t i = 0; i < path_length; ++i) {
+        u32 entry = 0;
+        auto buffer = UserOrKernelBuffer::for_kernel_buffer((u8*)&entry);
+        auto result = fs().read_block(block, &buffer, sizeof(entry), path[i] * sizeof(entry));
+        if (result.is_error())
+            return result;
+        if (!entry) {
+            if (!allocate)
+                return Ext2FS::BlockIndex(0);
+            auto new_block_or_error = allocate_pointer_block(goal);
+            if (new_block_or_error.is_error())
+                return new_block_or_error.error();
+            entry = new_block_or_error.value().value();
+            result = fs().write_block(block, buffer, sizeof(entry), path[i] * sizeof(entry));
+            if (result.is_error())
+                return result;
+        }
+        block = entry;
+    }
+    return block;
+}
+
+KResultOr<const Vector<u32>*> Ext2FSInode::block_map_leaf(size_t leaf_index) const
+{
+    if (auto it = m_block_map_leaves.find(leaf_index); it != m_block_map_leaves.end())
+        return &it->value;
+
+    auto block_or_error = const_cast<Ext2FSInode&>(*this).leaf_block(leaf_index, false);
+    if (block_or_error.is_error())
+        return block_or_error.error();
+    if (!block_or_error.value().value())
+        return nullptr;
+
+    Vector<u32> entries;
+    entries.resize(EXT2_ADDR_PER_BLOCK(&fs().super_block()));
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer((u8*)entries.data());
+    auto result = fs().read_block(block_or_error.value(), &buffer, entries.size() * sizeof(u32));
+    if (result.is_error())
+        return result;
+
+    if (m_block_map_leaves.size() >= max_cached_block_map_leaves)
+        m_block_map_leaves.remove_one_randomly();
+    m_block_map_leaves.set(leaf_index, move(entries));
+    return &m_block_map_leaves.find(leaf_index)->value;
+}
+
+KResultOr<Ext2FS::BlockIndex> Ext2FSInode::block_at(size_t logical_index) const
+{
+    if (logical_index < EXT2_NDIR_BLOCKS)
+        return Ext2FS::BlockIndex(m_raw_inode.i_block[logical_index]);
+
+    const size_t entries_per_block = EXT2_ADDR_PER_BLOCK(&fs().super_block());
+    size_t index_past_direct_blocks = logical_index - EXT2_NDIR_BLOCKS;
+    auto leaf_or_error = block_map_leaf(index_past_direct_blocks / entries_per_block);
+    if (leaf_or_error.is_error())
+        return leaf_or_error.error();
+    if (!leaf_or_error.value())
+        return Ext2FS::BlockIndex(0);
+    return Ext2FS::BlockIndex(leaf_or_error.value()->at(index_past_direct_blocks % entries_per_block));
+}
+
+KResult Ext2FSInode::set_block_at(size_t logical_index, Ext2FS::BlockIndex block)
+{
+    if (logical_index < EXT2_NDIR_BLOCKS) {
+        m_raw_inode.i_block[logical_index] = block.value();
+        set_metadata_dirty(true);
+        return KSuccess;
+    }
+
+    const size_t entries_per_block = EXT2_ADDR_PER_BLOCK(&fs().super_block());
+    size_t index_past_direct_blocks = logical_index - EXT2_NDIR_BLOCKS;
+    size_t leaf_index = index_past_direct_blocks / entries_per_block;
+    size_t entry_index = index_past_direct_blocks % entries_per_block;
+
+    auto leaf_block_or_error = leaf_block(leaf_index, true, block);
+    if (leaf_block_or_error.is_error())
+        return leaf_block_or_error.error();
+
+    u32 entry = block.value();
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer((u8*)&entry);
+    auto result = fs().write_block(leaf_block_or_error.value(), buffer, sizeof(entry), entry_index * sizeof(entry));
+    if (result.is_error())
+        return result;
+
+    if (auto it = m_block_map_leaves.find(leaf_index); it != m_block_map_leaves.end())
+        it->value[entry_index] = entry;
+    return KSuccess;
+}
+
+KResultOr<Ext2FS::BlockIndex> Ext2FSInode::allocate_pointer_block(Ext2FS::BlockIndex goal)
+{
+    if (fs().free_block_count() == 0)
+        return ENOSPC;
+    auto blocks = fs().allocate_blocks(fs().group_index_from_inode(index()), 1, goal);
+
+    auto zeroes = ByteBuffer::create_zeroed(fs().block_size());
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(zeroes.data());
+    auto result = fs().write_block(blocks[0], buffer, zeroes.size());
+    if (result.is_error())
+        return result;
+
+    m_raw_inode.i_blocks += fs().block_size() / 512;
+    set_metadata_dirty(true);
+    return blocks[0];
+}
+
+void Ext2FSInode::release_block(Ext2FS::BlockIndex block)
+{
+    fs().set_block_allocation_state(block, false);
+    m_raw_inode.i_blocks -= fs().block_size() / 512;
+    set_metadata_dirty(true);
+}
+
+KResultOr<bool> Ext2FSInode::truncate_pointer_block(Ext2FS::BlockIndex block, unsigned depth, u64 first_logical_index, size_t new_block_count)
+{
+    // Releases everything below this pointer block that maps logical blocks at or past new_block_count,
+    // and the pointer block itself if nothing below it is left. Returns whether the block was released.
+    const size_t entries_per_block = EXT2_ADDR_PER_BLOCK(&fs().super_block());
+    u64 entry_span = 1;
+    for (unsigned i = 1; i < depth; ++i)
+        entry_span *= entries_per_block;
+
+    Vector<u32> entries;
+    entries.resize(entries_per_block);
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer((u8*)entries.data());
+    auto result = fs().read_block(block, &buffer, entries.size() * sizeof(u32));
+    if (result.is_error())
+        return result;
+
+    bool dirty = false;
+    for (size_t i = 0; i < entries_per_block; ++i) {
+        u64 entry_first_logical_index = first_logical_index + i * entry_span;
+        if (entry_first_logical_index + entry_span <= new_block_count || !entries[i])
+            continue;
+        if (depth == 1) {
+            release_block(entries[i]);
+        } else {
+            auto released_or_error = truncate_pointer_block(entries[i], depth - 1, entry_first_logical_index, new_block_count);
+            if (released_or_error.is_error())
+                return released_or_error.error();
+            if (!released_or_error.value())
+                continue;
+        }
+        entries[i] = 0;
+        dirty = true;
+    }
+
+    if (first_logical_index >= new_block_count) {
+        release_block(block);
+        return true;
+    }
+
+    if (dirty) {
+        result = fs().write_block(block, buffer, entries.size() * sizeof(u32));
+        if (result.is_error())
+            return result;
+    }
+    return false;
+}
+
+KResult Ext2FSInode::shrink_block_map(size_t new_block_count)
+{
+    size_t old_block_count = block_count();
+    VERIFY(new_block_count <= old_block_count);
+
+    for (size_t i = new_block_count; i < min(old_block_count, (size_t)EXT2_NDIR_BLOCKS); ++i) {
+        if (m_raw_inode.i_block[i])
+            release_block(m_raw_inode.i_block[i]);
+        m_raw_inode.i_block[i] = 0;
+    }
+
+    const u64 entries_per_block = EXT2_ADDR_PER_BLOCK(&fs().super_block());
+    u64 first_logical_index = EXT2_NDIR_BLOCKS;
+    u64 span = entries_per_block;
+    for (unsigned depth = 1; depth <= 3; ++depth) {
+        auto& root = m_raw_inode.i_block[EXT2_IND_BLOCK + depth - 1];
+        if (root) {
+            auto released_or_error = truncate_pointer_block(root, depth, first_logical_index, new_block_count);
+            if (released_or_error.is_error())
+                return released_or_error.error();
+            if (released_or_error.value())
+                root = 0;
+        }
+        first_logical_index += span;
+        span *= entries_per_block;
+    }
+    set_metadata_dirty(true);
+
+    // Forget cached leaves that have been released or modified.
+    size_t first_stale_leaf = new_block_count <= EXT2_NDIR_BLOCKS ? 0 : (new_block_count - EXT2_NDIR_BLOCKS) / entries_per_block;
+    Vector<size_t> stale_leaves;
+    for (auto& it : m_block_map_leaves) {
+        if (it.key >= first_stale_leaf)
+            stale_leaves.append(it.key);
+    }
+    for (auto leaf_index : stale_leaves)
+        m_block_map_leaves.remove(leaf_index);
+    return KSuccess;
+}
+
+size_t Ext2FSInode::contiguous_run_length(size_t first_logical_index, size_t max_length) const
+{
+    // NOTE: Lookup errors just end the run, the caller will run into them again when it touches that block.
+    auto first_block_or_error = block_at(first_logical_index);
+    if (first_block_or_error.is_error())
+        return 1;
+    auto first_block_index = first_block_or_error.value().value();
+    size_t length = 1;
+    while (length < max_length) {
+        auto block_or_error = block_at(first_logical_index + length);
+        if (block_or_error.is_error() || block_or_error.value().value() != first_block_index + length)
+            break;
+        ++length;
+    }
+    return length;
+}
+
+template<typename Callback>
+void Ext2FSInode::for_each_block_run_in_range(off_t offset, size_t count, Callback callback) const
+{
+    if (block_count() == 0 || offset >= (off_t)size())
+        return;
+
+    const size_t block_size = fs().block_size();
+    size_t first_block_logical_index = offset / block_size;
+    u64 end = min((u64)offset + count, (u64)size());
+    size_t last_block_logical_index = min((size_t)ceil_div(end, (u64)block_size), block_count()) - 1;
+    for (size_t bi = first_block_logical_index; bi <= last_block_logical_index;) {
+        auto block_or_error = block_at(bi);
+        if (block_or_error.is_error() || !block_or_error.value().value())
+            return;
+        size_t run_length = contiguous_run_length(bi, last_block_logical_index - bi + 1);
+        callback(block_or_error.value(), run_length);
+        bi += run_length;
+    }
+}
+
+void Ext2FSInode::read_ahead(off_t offset, size_t count)
+{
+    Locker inode_locker(m_lock);
+    Locker fs_locker(fs().m_lock);
+    for_each_block_run_in_range(offset, count, [&](auto first_block, size_t run_length) {
+        fs().prefetch_blocks(first_block, run_length);
+    });
+}
+
+void Ext2FSInode::evict_cached_data(off_t offset, size_t count)
+{
+    Locker inode_locker(m_lock);
+    Locker fs_locker(fs().m_lock);
+    for_each_block_run_in_range(offset, count, [&](auto first_block, size_t run_length) {
+        fs().evict_blocks(first_block, run_length);
+    });
+}
+
 ssize_t Ext2FSInode::read_bytes(off_t offset, ssize_t count, UserOrKernelBuffer& buffer, FileDescription* description) const
 {
     Locker inode_locker(m_lock);
@@ -722,10 +917,7 @@ ssize_t Ext2FSInode::read_bytes(off_t offset, ssize_t count, UserOrKernelBuffer&
 
     Locker fs_locker(fs().m_lock);
 
-    if (m_block_list.is_empty())
-        m_block_list = fs().block_list_for_inode(m_raw_inode);
-
-    if (m_block_list.is_empty()) {
+    if (block_count() == 0) {
         dmesgln("Ext2FS: read_bytes: empty block list for inode {}", index());
         return -EIO;
     }
@@ -736,8 +928,8 @@ ssize_t Ext2FSInode::read_bytes(off_t offset, ssize_t count, UserOrKernelBuffer&
 
     size_t first_block_logical_index = offset / block_size;
     size_t last_block_logical_index = (offset + count) / block_size;
-    if (last_block_logical_index >= m_block_list.size())
-        last_block_logical_index = m_block_list.size() - 1;
+    if (last_block_logical_index >= block_count())
+        last_block_logical_index = block_count() - 1;
 
     int offset_into_first_block = offset % block_size;
 
@@ -746,12 +938,45 @@ ssize_t Ext2FSInode::read_bytes(off_t offset, ssize_t count, UserOrKernelBuffer&
 
     dbgln_if(EXT2_VERY_DEBUG, "Ext2FS: Reading up to {} bytes, {} bytes into inode {} to {}", count, offset, index(), buffer.user_or_kernel_ptr());
 
+    size_t first_delayed_block_logical_index = allocated_block_count();
+
     for (size_t bi = first_block_logical_index; remaining_count && bi <= last_block_logical_index; ++bi) {
-        auto block_index = m_block_list[bi];
-        VERIFY(block_index.value());
         size_t offset_into_block = (bi == first_block_logical_index) ? offset_into_first_block : 0;
-        size_t num_bytes_to_copy = min(block_size - offset_into_block, remaining_count);
         auto buffer_offset = buffer.offset(nread);
+
+        if (bi >= first_delayed_block_logical_index) {
+            size_t num_bytes_to_copy = min(block_size - offset_into_block, remaining_count);
+            auto& delayed_block = m_delayed_blocks[bi - first_delayed_block_logical_index];
+            if (!buffer_offset.write(delayed_block.data() + offset_into_block, num_bytes_to_copy))
+                return -EFAULT;
+            remaining_count -= num_bytes_to_copy;
+            nread += num_bytes_to_copy;
+            continue;
+        }
+
+        auto block_index_or_error = block_at(bi);
+        if (block_index_or_error.is_error())
+            return block_index_or_error.error();
+        auto block_index = block_index_or_error.value();
+        VERIFY(block_index.value());
+
+        if (offset_into_block == 0 && remaining_count >= (size_t)block_size) {
+            size_t run_length = contiguous_run_length(bi, min(last_block_logical_index - bi + 1, remaining_count / block_size));
+            size_t run_size = run_length * block_size;
+            if (run_length > 1 && (!allow_cache || run_size >= uncached_read_threshold)) {
+                auto result = fs().read_blocks(block_index, run_length, buffer_offset, false);
+                if (result.is_error()) {
+                    dmesgln("Ext2FS: read_bytes: read_blocks({}, {}) failed (bi: {})", block_index.value(), run_length, bi);
+                    return result;
+                }
+                remaining_count -= run_size;
+                nread += run_size;
+                bi += run_length - 1;
+                continue;
+            }
+        }
+
+        size_t num_bytes_to_copy = min(block_size - offset_into_block, remaining_count);
         int err = fs().read_block(block_index, &buffer_offset, num_bytes_to_copy, offset_into_block, allow_cache);
         if (err < 0) {
             dmesgln("Ext2FS: read_bytes: read_block({}) failed (bi: {})", block_index.value(), bi);
@@ -779,44 +1004,64 @@ KResult Ext2FSInode::resize(u64 new_size)
         dbgln("Ext2FSInode::resize(): blocks needed after  (size is  {}): {}", new_size, blocks_needed_after);
     }
 
+    if (!m_delayed_blocks.is_empty()) {
+        if (new_size > old_size) {
+            // Growing always happens from the allocated end of the file.
+            auto result = allocate_delayed_blocks();
+            if (result.is_error())
+                return result;
+        } else {
+            // Drop the delayed blocks that are cut off, and zero the tail of the new last one.
+            size_t first_delayed_block = allocated_block_count();
+            size_t delayed_blocks_to_keep = blocks_needed_after > first_delayed_block ? blocks_needed_after - first_delayed_block : 0;
+            size_t reservation_to_keep = delayed_reservation_size(first_delayed_block, delayed_blocks_to_keep);
+            fs().release_delayed_blocks(m_delayed_reserved_block_count - reservation_to_keep);
+            m_delayed_reserved_block_count = reservation_to_keep;
+            m_delayed_blocks.shrink(delayed_blocks_to_keep);
+            if (m_delayed_blocks.is_empty())
+                m_delayed_since_ms = 0;
+            else if (new_size % block_size)
+                memset(m_delayed_blocks.last().data() + new_size % block_size, 0, block_size - new_size % block_size);
+        }
+    }
+
     if (blocks_needed_after > blocks_needed_before) {
         u32 additional_blocks_needed = blocks_needed_after - blocks_needed_before;
-        if (additional_blocks_needed > fs().super_block().s_free_blocks_count)
+        if (additional_blocks_needed > fs().free_block_count())
             return ENOSPC;
     }
 
-    Vector<Ext2FS::BlockIndex> block_list;
-    if (!m_block_list.is_empty())
-        block_list = m_block_list;
-    else
-        block_list = fs().block_list_for_inode(m_raw_inode);
+    // Growing an inline symlink turns it into a regular one, so clear out the old target path.
+    if (block_count() == 0 && is_symlink())
+        memset(m_raw_inode.i_block, 0, sizeof(m_raw_inode.i_block));
+    blocks_needed_before = block_count();
 
     if (blocks_needed_after > blocks_needed_before) {
-        auto new_blocks = fs().allocate_blocks(fs().group_index_from_inode(index()), blocks_needed_after - blocks_needed_before);
-        block_list.append(move(new_blocks));
-    } else if (blocks_needed_after < blocks_needed_before) {
-        if constexpr (EXT2_DEBUG) {
-            dbgln("Ext2FS: Shrinking inode {}. Old block list is {} entries:", index(), block_list.size());
-            for (auto block_index : block_list) {
-                dbgln("    # {}", block_index);
-            }
+        // Try to continue right after the current last block of the file.
+        Ext2FS::BlockIndex goal = 0;
+        if (blocks_needed_before) {
+            auto last_block_or_error = block_at(blocks_needed_before - 1);
+            if (!last_block_or_error.is_error())
+                goal = last_block_or_error.value();
         }
-        while (block_list.size() != blocks_needed_after) {
-            auto block_index = block_list.take_last();
-            if (block_index.value())
-                fs().set_block_allocation_state(block_index, false);
+        auto new_blocks = fs().allocate_blocks(fs().group_index_from_inode(index()), blocks_needed_after - blocks_needed_before, goal, index());
+        m_raw_inode.i_blocks += new_blocks.size() * (block_size / 512);
+        for (size_t i = 0; i < new_blocks.size(); ++i) {
+            auto result = set_block_at(blocks_needed_before + i, new_blocks[i]);
+            if (result.is_error())
+                return result;
         }
+    } else if (blocks_needed_after < blocks_needed_before) {
+        dbgln_if(EXT2_DEBUG, "Ext2FS: Shrinking inode {} from {} to {} blocks", index(), blocks_needed_before, blocks_needed_after);
+        fs().discard_block_reservation(index());
+        auto result = shrink_block_map(blocks_needed_after);
+        if (result.is_error())
+            return result;
     }
 
-    auto result = fs().write_block_list_for_inode(index(), m_raw_inode, block_list);
-    if (result.is_error())
-        return result;
-
     m_raw_inode.i_size = new_size;
     set_metadata_dirty(true);
 
-    m_block_list = move(block_list);
-
     if (new_size > old_size) {
         // If we're growing the inode, make sure we zero out all the new space.
         // FIXME: There are definitely more efficient ways to achieve this.
@@ -864,6 +1109,17 @@ ssize_t Ext2FSInode::write_bytes(off_t offset, ssize_t count, const UserOrKernel
     bool allow_cache = !description || !description->is_direct();
 
     const size_t block_size = fs().block_size();
+    u64 allocated_size = (u64)allocated_block_count() * block_size;
+    if (static_cast<u64>(offset) + count > allocated_size) {
+        // Any hole before the write gets buffered as well, so large jumps past the end are better off allocated right away.
+        u64 delayed_size = ceil_div(max(static_cast<u64>(offset) + count, (u64)size()), (u64)block_size) * block_size - allocated_size;
+        if (allow_cache && Kernel::is_regular_file(m_raw_inode.i_mode) && delayed_size <= max_delayed_bytes_per_inode)
+            return write_delayed_bytes(offset, count, data, description);
+        result = allocate_delayed_blocks();
+        if (result.is_error())
+            return result;
+    }
+
     u64 old_size = size();
     u64 new_size = max(static_cast<u64>(offset) + count, (u64)size());
 
@@ -871,18 +1127,15 @@ ssize_t Ext2FSInode::write_bytes(off_t offset, ssize_t count, const UserOrKernel
     if (resize_result.is_error())
         return resize_result;
 
-    if (m_block_list.is_empty())
-        m_block_list = fs().block_list_for_inode(m_raw_inode);
-
-    if (m_block_list.is_empty()) {
+    if (block_count() == 0) {
         dbgln("Ext2FSInode::write_bytes(): empty block list for inode {}", index());
         return -EIO;
     }
 
     size_t first_block_logical_index = offset / block_size;
     size_t last_block_logical_index = (offset + count) / block_size;
-    if (last_block_logical_index >= m_block_list.size())
-        last_block_logical_index = m_block_list.size() - 1;
+    if (last_block_logical_index >= block_count())
+        last_block_logical_index = block_count() - 1;
 
     size_t offset_into_first_block = offset % block_size;
 
@@ -891,25 +1144,195 @@ ssize_t Ext2FSInode::write_bytes(off_t offset, ssize_t count, const UserOrKernel
 
     dbgln_if(EXT2_VERY_DEBUG, "Ext2FS: Writing {} bytes, {} bytes into inode {} from {}", count, offset, index(), data.user_or_kernel_ptr());
 
-    for (size_t bi = first_block_logical_index; remaining_count && bi <= last_block_logical_index; ++bi) {
-        size_t offset_into_block = (bi == first_block_logical_index) ? offset_into_first_block : 0;
-        size_t num_bytes_to_copy = min(block_size - offset_into_block, remaining_count);
-        dbgln_if(EXT2_DEBUG, "Ext2FS: Writing block {} (offset_into_block: {})", m_block_list[bi], offset_into_block);
-        result = fs().write_block(m_block_list[bi], data.offset(nwritten), num_bytes_to_copy, offset_into_block, allow_cache);
-        if (result.is_error()) {
-            dbgln("Ext2FS: write_block({}) failed (bi: {})", m_block_list[bi], bi);
-            return result;
-        }
-        remaining_count -= num_bytes_to_copy;
-        nwritten += num_bytes_to_copy;
+    for (size_t bi = first_block_logical_index; remaining_count && bi <= last_block_logical_index; ++bi) {
+        size_t offset_into_block = (bi == first_block_logical_index) ? offset_into_first_block : 0;
+        auto block_index_or_error = block_at(bi);
+        if (block_index_or_error.is_error())
+            return block_index_or_error.error();
+        auto block_index = block_index_or_error.value();
+
+        if (!allow_cache && offset_into_block == 0 && remaining_count >= block_size) {
+            size_t run_length = contiguous_run_length(bi, min(last_block_logical_index - bi + 1, remaining_count / block_size));
+            if (run_length > 1) {
+                size_t run_size = run_length * block_size;
+                result = fs().write_blocks(block_index, run_length, data.offset(nwritten), false);
+                if (result.is_error()) {
+                    dbgln("Ext2FS: write_blocks({}, {}) failed (bi: {})", block_index, run_length, bi);
+                    return result;
+                }
+                remaining_count -= run_size;
+                nwritten += run_size;
+                bi += run_length - 1;
+                continue;
+            }
+        }
+
+        size_t num_bytes_to_copy = min(block_size - offset_into_block, remaining_count);
+        dbgln_if(EXT2_DEBUG, "Ext2FS: Writing block {} (offset_into_block: {})", block_index, offset_into_block);
+        result = fs().write_block(block_index, data.offset(nwritten), num_bytes_to_copy, offset_into_block, allow_cache);
+        if (result.is_error()) {
+            dbgln("Ext2FS: write_block({}) failed (bi: {})", block_index, bi);
+            return result;
+        }
+        remaining_count -= num_bytes_to_copy;
+        nwritten += num_bytes_to_copy;
+    }
+
+    dbgln_if(EXT2_VERY_DEBUG, "Ext2FS: After write, i_size={}, i_blocks={} ({} blocks in map)", m_raw_inode.i_size, m_raw_inode.i_blocks, block_count());
+
+    if (old_size != new_size)
+        inode_size_changed(old_size, new_size);
+    inode_contents_changed(offset, count, data);
+    return nwritten;
+}
+
+ssize_t Ext2FSInode::write_delayed_bytes(off_t offset, size_t count, const UserOrKernelBuffer& data, FileDescription* description)
+{
+    const size_t block_size = fs().block_size();
+    u64 allocated_size = (u64)allocated_block_count() * block_size;
+    ssize_t nwritten = 0;
+
+    // Whatever lands in blocks we already have goes through the regular path.
+    if ((u64)offset < allocated_size) {
+        size_t head_count = allocated_size - offset;
+        auto head_nwritten = write_bytes(offset, head_count, data, description);
+        if (head_nwritten < 0)
+            return head_nwritten;
+        VERIFY((size_t)head_nwritten == head_count);
+        nwritten = head_count;
+    } else if (size() < allocated_size) {
+        // Zero out the rest of the last allocated block, it's about to be followed by delayed ones.
+        auto result = resize(allocated_size);
+        if (result.is_error())
+            return result;
+    }
+
+    u64 old_size = size();
+    u64 new_size = max((u64)offset + count, old_size);
+    size_t blocks_to_add = ceil_div(new_size, (u64)block_size) - block_count();
+    if (blocks_to_add) {
+        size_t reservation = delayed_reservation_size(allocated_block_count(), m_delayed_blocks.size() + blocks_to_add);
+        auto result = fs().reserve_delayed_blocks(reservation - m_delayed_reserved_block_count);
+        if (result.is_error())
+            return nwritten ? nwritten : (ssize_t)result;
+        m_delayed_reserved_block_count = reservation;
+        for (size_t i = 0; i < blocks_to_add; ++i)
+            m_delayed_blocks.append(ByteBuffer::create_zeroed(block_size));
+        if (!m_delayed_since_ms)
+            m_delayed_since_ms = TimeManagement::the().uptime_ms();
+    }
+    if (new_size != old_size) {
+        m_raw_inode.i_size = new_size;
+        set_metadata_dirty(true);
+    }
+
+    size_t first_delayed_block = allocated_block_count();
+    for (u64 position = offset + nwritten; position < (u64)offset + count;) {
+        size_t offset_into_block = position % block_size;
+        size_t num_bytes_to_copy = min(block_size - offset_into_block, (size_t)((u64)offset + count - position));
+        auto& delayed_block = m_delayed_blocks[position / block_size - first_delayed_block];
+        if (!data.offset(nwritten).read(delayed_block.data() + offset_into_block, num_bytes_to_copy))
+            return -EFAULT;
+        position += num_bytes_to_copy;
+        nwritten += num_bytes_to_copy;
+    }
+
+    dbgln_if(EXT2_VERY_DEBUG, "Ext2FS: Delayed write of {} bytes at {} into inode {}, {} delayed blocks", count, offset, index(), m_delayed_blocks.size());
+
+    if (old_size != new_size)
+        inode_size_changed(old_size, new_size);
+    inode_contents_changed(offset, count, data);
+
+    if (m_delayed_blocks.size() * block_size >= max_delayed_bytes_per_inode || fs().m_delayed_block_count * block_size >= max_delayed_bytes) {
+        // The data is still safely buffered if this fails, writeback will have another go at it.
+        auto result = allocate_delayed_blocks();
+        if (result.is_error())
+            dbgln("Ext2FS: Failed to allocate delayed blocks for inode {}: {}", index(), result.error());
+    }
+    return nwritten;
+}
+
+size_t Ext2FSInode::delayed_reservation_size(size_t first_logical_index, size_t count) const
+{
+    // Besides the data blocks themselves, mapping them may take new leaf pointer blocks,
+    // the intermediate blocks above those and the doubly and triply indirect roots.
+    size_t end_logical_index = first_logical_index + count;
+    if (end_logical_index <= EXT2_NDIR_BLOCKS)
+        return count;
+    const size_t entries_per_block = EXT2_ADDR_PER_BLOCK(&fs().super_block());
+    size_t first_past_direct_blocks = max(first_logical_index, (size_t)EXT2_NDIR_BLOCKS) - EXT2_NDIR_BLOCKS;
+    size_t leaf_count = (end_logical_index - EXT2_NDIR_BLOCKS - 1) / entries_per_block - first_past_direct_blocks / entries_per_block + 1;
+    return count + leaf_count + ceil_div(leaf_count, entries_per_block) + 3;
+}
+
+KResult Ext2FSInode::allocate_delayed_blocks()
+{
+    if (m_delayed_blocks.is_empty())
+        return KSuccess;
+
+    Locker fs_locker(fs().m_lock);
+    const size_t block_size = fs().block_size();
+    size_t first_delayed_block = allocated_block_count();
+    size_t delayed_block_count = m_delayed_blocks.size();
+
+    // Hand our reservation back while holding the FS lock, so that the allocations below (including
+    // the pointer blocks) can use it and nobody else can. Whatever is left over is reserved again on failure.
+    fs().release_delayed_blocks(m_delayed_reserved_block_count);
+    m_delayed_reserved_block_count = 0;
+    auto keep_remaining_delayed_blocks = [&](KResult error) {
+        m_delayed_reserved_block_count = delayed_reservation_size(allocated_block_count(), m_delayed_blocks.size());
+        fs().m_delayed_block_count += m_delayed_reserved_block_count;
+        return error;
+    };
+    if (delayed_reservation_size(first_delayed_block, delayed_block_count) > fs().free_block_count())
+        return keep_remaining_delayed_blocks(ENOSPC);
+
+    // Now that we know how much there is, try to place all of it in one run right after the file's current last block.
+    Ext2FS::BlockIndex goal = 0;
+    if (first_delayed_block) {
+        auto last_block_or_error = block_at(first_delayed_block - 1);
+        if (!last_block_or_error.is_error())
+            goal = last_block_or_error.value();
+    }
+    auto new_blocks = fs().allocate_blocks(fs().group_index_from_inode(index()), delayed_block_count, goal, index());
+    m_raw_inode.i_blocks += new_blocks.size() * (block_size / 512);
+    set_metadata_dirty(true);
+
+    // Write each block before mapping it, so a failure only ever leaves complete blocks in the file.
+    KResult result = KSuccess;
+    size_t mapped_count = 0;
+    for (; mapped_count < new_blocks.size(); ++mapped_count) {
+        result = fs().write_block(new_blocks[mapped_count], UserOrKernelBuffer::for_kernel_buffer(m_delayed_blocks[mapped_count].data()), block_size);
+        if (result.is_error())
+            break;
+        result = set_block_at(first_delayed_block + mapped_count, new_blocks[mapped_count]);
+        if (result.is_error())
+            break;
+    }
+    if (result.is_error()) {
+        for (size_t i = mapped_count; i < new_blocks.size(); ++i)
+            release_block(new_blocks[i]);
+        m_delayed_blocks.remove(0, mapped_count);
+        return keep_remaining_delayed_blocks(result);
     }
 
-    dbgln_if(EXT2_VERY_DEBUG, "Ext2FS: After write, i_size={}, i_blocks={} ({} blocks in list)", m_raw_inode.i_size, m_raw_inode.i_blocks, m_block_list.size());
+    dbgln_if(EXT2_DEBUG, "Ext2FS: Allocated {} delayed blocks for inode {}", delayed_block_count, index());
+    m_delayed_blocks.clear();
+    m_delayed_since_ms = 0;
+    return KSuccess;
+}
 
-    if (old_size != new_size)
-        inode_size_changed(old_size, new_size);
-    inode_contents_changed(offset, count, data);
-    return nwritten;
+void Ext2FSInode::discard_delayed_blocks()
+{
+    if (m_delayed_blocks.is_empty())
+        return;
+    u64 allocated_size = (u64)allocated_block_count() * fs().block_size();
+    if (size() > allocated_size)
+        m_raw_inode.i_size = allocated_size;
+    fs().release_delayed_blocks(m_delayed_reserved_block_count);
+    m_delayed_reserved_block_count = 0;
+    m_delayed_blocks.clear();
+    m_delayed_since_ms = 0;
 }
 
 u8 Ext2FS::internal_file_type_to_directory_entry_type(const DirectoryEntryView& entry) const
@@ -1010,6 +1433,583 @@ KResult Ext2FSInode::write_directory(const Vector<Ext2FSDirectoryEntry>& entries
     return KSuccess;
 }
 
+// NOTE: The upper bits of a directory index entry's block field are reserved.
+static constexpr u32 directory_index_block_mask = 0x0fffffff;
+
+struct Ext2FSHTreeFrame {
+    size_t block_logical_index { 0 };
+    ByteBuffer block;
+    size_t entries_offset { 0 };
+    size_t position { 0 };
+
+    ext2_dx_countlimit& countlimit() { return *reinterpret_cast<ext2_dx_countlimit*>(block.data() + entries_offset); }
+    ext2_dx_entry* entries() { return reinterpret_cast<ext2_dx_entry*>(block.data() + entries_offset); }
+    u32 followed_block() { return entries()[position].block & directory_index_block_mask; }
+};
+
+struct Ext2FSHTreePath {
+    u32 hash { 0 };
+    u8 hash_version { 0 };
+    Vector<Ext2FSHTreeFrame, 3> frames;
+};
+
+struct HashedDirectoryEntry {
+    u32 hash;
+    Ext2FSDirectoryEntry entry;
+};
+
+static ext2_dir_entry_2& directory_entry_at(ByteBuffer& block, size_t offset)
+{
+    return *reinterpret_cast<ext2_dir_entry_2*>(block.data() + offset);
+}
+
+static ext2_dx_root_info& directory_index_root_info(ByteBuffer& root)
+{
+    // The root info lives right after the "." and ".." entries in the first block.
+    return *reinterpret_cast<ext2_dx_root_info*>(root.data() + 24);
+}
+
+static bool directory_entry_matches(const ext2_dir_entry_2& entry, const StringView& name)
+{
+    return entry.inode != 0 && entry.name_len == name.length() && !memcmp(entry.name, name.characters_without_null_termination(), name.length());
+}
+
+template<typename Callback>
+static void for_each_entry_in_directory_block(ByteBuffer& block, Callback callback)
+{
+    Optional<size_t> previous_offset;
+    for (size_t offset = 0; offset + 8 <= block.size();) {
+        auto& entry = directory_entry_at(block, offset);
+        if (entry.rec_len < 8 || offset + entry.rec_len > block.size())
+            return;
+        if (callback(entry, offset, previous_offset) == IterationDecision::Break)
+            return;
+        previous_offset = offset;
+        offset += entry.rec_len;
+    }
+}
+
+static void write_directory_entry(ByteBuffer& block, size_t offset, size_t record_length, const StringView& name, InodeIndex inode_index, u8 file_type)
+{
+    auto& entry = directory_entry_at(block, offset);
+    entry.inode = inode_index.value();
+    entry.rec_len = record_length;
+    entry.name_len = name.length();
+    entry.file_type = file_type;
+    memcpy(entry.name, name.characters_without_null_termination(), name.length());
+}
+
+static bool insert_entry_into_directory_block(ByteBuffer& block, const StringView& name, InodeIndex inode_index, u8 file_type)
+{
+    size_t needed_length = EXT2_DIR_REC_LEN(name.length());
+    bool inserted = false;
+    for_each_entry_in_directory_block(block, [&](auto& entry, size_t offset, auto) {
+        size_t record_length = entry.rec_len;
+        size_t used_length = entry.inode ? EXT2_DIR_REC_LEN(entry.name_len) : 0;
+        if (record_length - used_length < needed_length)
+            return IterationDecision::Continue;
+        if (used_length)
+            entry.rec_len = used_length;
+        write_directory_entry(block, offset + used_length, record_length - used_length, name, inode_index, file_type);
+        inserted = true;
+        return IterationDecision::Break;
+    });
+    return inserted;
+}
+
+static Optional<InodeIndex> remove_entry_from_directory_block(ByteBuffer& block, const StringView& name)
+{
+    Optional<InodeIndex> removed_inode_index;
+    for_each_entry_in_directory_block(block, [&](auto& entry, size_t, Optional<size_t> previous_offset) {
+        if (!directory_entry_matches(entry, name))
+            return IterationDecision::Continue;
+        removed_inode_index = entry.inode;
+        if (previous_offset.has_value())
+            directory_entry_at(block, previous_offset.value()).rec_len += entry.rec_len;
+        else
+            entry.inode = 0;
+        return IterationDecision::Break;
+    });
+    return removed_inode_index;
+}
+
+static Optional<InodeIndex> find_entry_in_directory_block(ByteBuffer& block, const StringView& name)
+{
+    Optional<InodeIndex> inode_index;
+    for_each_entry_in_directory_block(block, [&](auto& entry, size_t, auto) {
+        if (!directory_entry_matches(entry, name))
+            return IterationDecision::Continue;
+        inode_index = entry.inode;
+        return IterationDecision::Break;
+    });
+    return inode_index;
+}
+
+static void write_entries_to_directory_block(ByteBuffer& block, const Vector<Ext2FSDirectoryEntry>& entries)
+{
+    block.zero_fill();
+    if (entries.is_empty()) {
+        directory_entry_at(block, 0).rec_len = block.size();
+        return;
+    }
+    size_t offset = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        auto& entry = entries[i];
+        size_t record_length = (i == entries.size() - 1) ? block.size() - offset : EXT2_DIR_REC_LEN(entry.name.length());
+        write_directory_entry(block, offset, record_length, entry.name, entry.inode_index, entry.file_type);
+        offset += record_length;
+    }
+}
+
+KResultOr<ByteBuffer> Ext2FSInode::read_directory_block(size_t logical_index) const
+{
+    const size_t block_size = fs().block_size();
+    auto block = ByteBuffer::create_uninitialized(block_size);
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(block.data());
+    ssize_t nread = read_bytes(logical_index * block_size, block_size, buffer, nullptr);
+    if (nread < 0)
+        return KResult((ErrnoCode)-nread);
+    if ((size_t)nread != block_size)
+        return EIO;
+    return block;
+}
+
+KResult Ext2FSInode::write_directory_block(size_t logical_index, const ByteBuffer& block)
+{
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(const_cast<u8*>(block.data()));
+    ssize_t nwritten = write_bytes(logical_index * block.size(), block.size(), buffer, nullptr);
+    if (nwritten < 0)
+        return KResult((ErrnoCode)-nwritten);
+    if ((size_t)nwritten != block.size())
+        return EIO;
+    return KSuccess;
+}
+
+KResultOr<size_t> Ext2FSInode::append_directory_block()
+{
+    size_t logical_index = block_count();
+    auto result = resize(size() + fs().block_size());
+    if (result.is_error())
+        return result;
+    return logical_index;
+}
+
+KResultOr<Ext2FSHTreePath> Ext2FSInode::probe_directory_index(const StringView& name) const
+{
+    // NOTE: EINVAL means that the index is damaged or uses features we don't understand.
+    const size_t block_size = fs().block_size();
+    Ext2FSHTreePath path;
+
+    auto root_or_error = read_directory_block(0);
+    if (root_or_error.is_error())
+        return root_or_error.error();
+    auto& root_info = directory_index_root_info(root_or_error.value());
+    if (root_info.reserved_zero != 0 || root_info.info_length != 8 || root_info.hash_version > EXT2_HASH_TEA || root_info.indirect_levels > 1)
+        return EINVAL;
+
+    path.hash_version = root_info.hash_version;
+    if (fs().super_block().s_flags & EXT2_FLAGS_UNSIGNED_HASH)
+        path.hash_version += 3;
+    path.hash = ext2_directory_hash(name, path.hash_version, fs().super_block().s_hash_seed);
+
+    unsigned levels = root_info.indirect_levels;
+    path.frames.append({ 0, root_or_error.release_value(), 24 + 8, 0 });
+    for (;;) {
+        auto& frame = path.frames.last();
+        auto& countlimit = frame.countlimit();
+        size_t expected_limit = (block_size - frame.entries_offset) / sizeof(ext2_dx_entry);
+        if (countlimit.limit != expected_limit || countlimit.count == 0 || countlimit.count > countlimit.limit)
+            return EINVAL;
+
+        // Find the last entry whose hash is not above ours. The first entry covers everything below the second one.
+        auto* entries = frame.entries();
+        size_t low = 1;
+        size_t high = countlimit.count;
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (entries[middle].hash > path.hash)
+                high = middle;
+            else
+                low = middle + 1;
+        }
+        frame.position = low - 1;
+
+        if (path.frames.size() > levels)
+            return path;
+
+        auto node_index = frame.followed_block();
+        if (node_index >= block_count())
+            return EINVAL;
+        auto node_or_error = read_directory_block(node_index);
+        if (node_or_error.is_error())
+            return node_or_error.error();
+        path.frames.append({ node_index, node_or_error.release_value(), 8, 0 });
+    }
+}
+
+KResultOr<bool> Ext2FSInode::advance_to_colliding_leaf(Ext2FSHTreePath& path) const
+{
+    // Entries with colliding hashes may continue in the next leaf, which is marked by the low bit of its hash.
+    // The next leaf may hang off the next index node, so step up until some level has an entry left.
+    size_t level = path.frames.size();
+    while (level > 0 && path.frames[level - 1].position + 1 >= path.frames[level - 1].countlimit().count)
+        --level;
+    if (level == 0)
+        return false;
+
+    auto& frame = path.frames[level - 1];
+    u32 next_hash = frame.entries()[frame.position + 1].hash;
+    if (!(next_hash & 1) || (next_hash & ~1u) != path.hash)
+        return false;
+    ++frame.position;
+
+    // Walk back down the new subtree, starting at its first entry on every level.
+    const size_t block_size = fs().block_size();
+    for (; level < path.frames.size(); ++level) {
+        auto node_index = path.frames[level - 1].followed_block();
+        if (node_index >= block_count())
+            return EINVAL;
+        auto node_or_error = read_directory_block(node_index);
+        if (node_or_error.is_error())
+            return node_or_error.error();
+        auto& child = path.frames[level];
+        child = { node_index, node_or_error.release_value(), 8, 0 };
+        auto& countlimit = child.countlimit();
+        if (countlimit.limit != (block_size - child.entries_offset) / sizeof(ext2_dx_entry) || countlimit.count == 0 || countlimit.count > countlimit.limit)
+            return EINVAL;
+    }
+    return true;
+}
+
+KResultOr<size_t> Ext2FSInode::find_leaf_in_directory_index(Ext2FSHTreePath& path, const StringView& name, ByteBuffer& leaf) const
+{
+    for (;;) {
+        auto leaf_index = path.frames.last().followed_block();
+        if (leaf_index >= block_count())
+            return EINVAL;
+        auto leaf_or_error = read_directory_block(leaf_index);
+        if (leaf_or_error.is_error())
+            return leaf_or_error.error();
+        leaf = leaf_or_error.release_value();
+        if (find_entry_in_directory_block(leaf, name).has_value())
+            return leaf_index;
+
+        auto advanced_or_error = advance_to_colliding_leaf(path);
+        if (advanced_or_error.is_error())
+            return advanced_or_error.error();
+        if (!advanced_or_error.value())
+            return ENOENT;
+    }
+}
+
+KResultOr<InodeIndex> Ext2FSInode::find_child_index(const StringView& name) const
+{
+    LOCKER(m_lock);
+    if (m_lookup_cache.is_empty() && is_indexed_directory()) {
+        auto path_or_error = probe_directory_index(name);
+        if (!path_or_error.is_error()) {
+            ByteBuffer leaf;
+            auto leaf_index_or_error = find_leaf_in_directory_index(path_or_error.value(), name, leaf);
+            if (!leaf_index_or_error.is_error())
+                return find_entry_in_directory_block(leaf, name).value();
+            if (leaf_index_or_error.error() == -ENOENT)
+                return InodeIndex(0);
+            if (leaf_index_or_error.error() != -EINVAL)
+                return leaf_index_or_error.error();
+        } else if (path_or_error.error() != -EINVAL) {
+            return path_or_error.error();
+        }
+        dbgln("Ext2FS: Ignoring damaged hash index of directory {}", index());
+    }
+
+    if (!populate_lookup_cache())
+        return EIO;
+    auto it = m_lookup_cache.find(name.hash(), [&](auto& entry) { return entry.key == name; });
+    if (it == m_lookup_cache.end())
+        return InodeIndex(0);
+    return (*it).value;
+}
+
+KResult Ext2FSInode::split_directory_leaf(Ext2FSHTreePath& path, size_t leaf_index, ByteBuffer& leaf)
+{
+    auto& frame = path.frames.last();
+    VERIFY(frame.countlimit().count < frame.countlimit().limit);
+
+    Vector<HashedDirectoryEntry> entries;
+    size_t total_length = 0;
+    for_each_entry_in_directory_block(leaf, [&](auto& entry, size_t, auto) {
+        if (entry.inode) {
+            StringView name { entry.name, entry.name_len };
+            entries.append({ ext2_directory_hash(name, path.hash_version, fs().super_block().s_hash_seed), { name, entry.inode, entry.file_type } });
+            total_length += EXT2_DIR_REC_LEN(entry.name_len);
+        }
+        return IterationDecision::Continue;
+    });
+    if (entries.size() < 2)
+        return EOVERFLOW;
+    quick_sort(entries, [](auto& a, auto& b) { return a.hash < b.hash; });
+
+    // Move the upper half (by size) of the hash range into a new leaf.
+    size_t split_index = 0;
+    for (size_t length = 0; split_index < entries.size() - 1 && length < total_length / 2; ++split_index)
+        length += EXT2_DIR_REC_LEN(entries[split_index].entry.name.length());
+    split_index = max(split_index, (size_t)1);
+    u32 split_hash = entries[split_index].hash;
+    bool continued = entries[split_index - 1].hash == split_hash;
+
+    Vector<Ext2FSDirectoryEntry> lower_entries;
+    Vector<Ext2FSDirectoryEntry> upper_entries;
+    for (size_t i = 0; i < entries.size(); ++i)
+        (i < split_index ? lower_entries : upper_entries).append(move(entries[i].entry));
+
+    auto new_leaf_index_or_error = append_directory_block();
+    if (new_leaf_index_or_error.is_error())
+        return new_leaf_index_or_error.error();
+    auto new_leaf_index = new_leaf_index_or_error.value();
+
+    auto new_leaf = ByteBuffer::create_uninitialized(leaf.size());
+    write_entries_to_directory_block(new_leaf, upper_entries);
+    auto result = write_directory_block(new_leaf_index, new_leaf);
+    if (result.is_error())
+        return result;
+    write_entries_to_directory_block(leaf, lower_entries);
+    result = write_directory_block(leaf_index, leaf);
+    if (result.is_error())
+        return result;
+
+    auto* index_entries = frame.entries();
+    auto& countlimit = frame.countlimit();
+    size_t insert_position = frame.position + 1;
+    memmove(&index_entries[insert_position + 1], &index_entries[insert_position], (countlimit.count - insert_position) * sizeof(ext2_dx_entry));
+    index_entries[insert_position].hash = split_hash | (continued ? 1 : 0);
+    index_entries[insert_position].block = new_leaf_index;
+    ++countlimit.count;
+    return write_directory_block(frame.block_logical_index, frame.block);
+}
+
+KResult Ext2FSInode::make_room_in_directory_index(Ext2FSHTreePath& path)
+{
+    const size_t block_size = fs().block_size();
+    auto& frame = path.frames.last();
+
+    if (path.frames.size() == 1) {
+        // The root is full, so push its entries down into a new index node.
+        auto node_index_or_error = append_directory_block();
+        if (node_index_or_error.is_error())
+            return node_index_or_error.error();
+        auto node = ByteBuffer::create_zeroed(block_size);
+        directory_entry_at(node, 0).rec_len = block_size;
+        size_t count = frame.countlimit().count;
+        memcpy(node.data() + 8, frame.entries(), count * sizeof(ext2_dx_entry));
+        auto& node_countlimit = *reinterpret_cast<ext2_dx_countlimit*>(node.data() + 8);
+        node_countlimit.limit = (block_size - 8) / sizeof(ext2_dx_entry);
+        node_countlimit.count = count;
+        auto result = write_directory_block(node_index_or_error.value(), node);
+        if (result.is_error())
+            return result;
+
+        frame.countlimit().count = 1;
+        frame.entries()[0].block = node_index_or_error.value();
+        directory_index_root_info(frame.block).indirect_levels = 1;
+        return write_directory_block(0, frame.block);
+    }
+
+    // Split the full index node in two and point the parent at the new half.
+    auto& parent = path.frames[path.frames.size() - 2];
+    if (parent.countlimit().count >= parent.countlimit().limit)
+        return EOVERFLOW;
+
+    auto node_index_or_error = append_directory_block();
+    if (node_index_or_error.is_error())
+        return node_index_or_error.error();
+    size_t count = frame.countlimit().count;
+    size_t kept_count = count / 2;
+    u32 split_hash = frame.entries()[kept_count].hash;
+
+    auto node = ByteBuffer::create_zeroed(block_size);
+    directory_entry_at(node, 0).rec_len = block_size;
+    memcpy(node.data() + 8, &frame.entries()[kept_count], (count - kept_count) * sizeof(ext2_dx_entry));
+    auto& node_countlimit = *reinterpret_cast<ext2_dx_countlimit*>(node.data() + 8);
+    node_countlimit.limit = (block_size - 8) / sizeof(ext2_dx_entry);
+    node_countlimit.count = count - kept_count;
+    auto result = write_directory_block(node_index_or_error.value(), node);
+    if (result.is_error())
+        return result;
+
+    frame.countlimit().count = kept_count;
+    result = write_directory_block(frame.block_logical_index, frame.block);
+    if (result.is_error())
+        return result;
+
+    auto* parent_entries = parent.entries();
+    size_t insert_position = parent.position + 1;
+    memmove(&parent_entries[insert_position + 1], &parent_entries[insert_position], (parent.countlimit().count - insert_position) * sizeof(ext2_dx_entry));
+    parent_entries[insert_position].hash = split_hash;
+    parent_entries[insert_position].block = node_index_or_error.value();
+    ++parent.countlimit().count;
+    return write_directory_block(parent.block_logical_index, parent.block);
+}
+
+KResult Ext2FSInode::add_directory_entry_to_index(const StringView& name, InodeIndex inode_index, u8 file_type)
+{
+    // Every pass either inserts the entry or makes room for it, after which we probe the index again.
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        auto path_or_error = probe_directory_index(name);
+        if (path_or_error.is_error())
+            return path_or_error.error();
+        auto& path = path_or_error.value();
+
+        auto leaf_index = path.frames.last().followed_block();
+        if (leaf_index >= block_count())
+            return EINVAL;
+        auto leaf_or_error = read_directory_block(leaf_index);
+        if (leaf_or_error.is_error())
+            return leaf_or_error.error();
+        auto& leaf = leaf_or_error.value();
+        if (insert_entry_into_directory_block(leaf, name, inode_index, file_type))
+            return write_directory_block(leaf_index, leaf);
+
+        auto& countlimit = path.frames.last().countlimit();
+        auto result = countlimit.count < countlimit.limit ? split_directory_leaf(path, leaf_index, leaf) : make_room_in_directory_index(path);
+        if (result.is_error())
+            return result;
+    }
+    return EOVERFLOW;
+}
+
+KResult Ext2FSInode::create_directory_index()
+{
+    const size_t block_size = fs().block_size();
+    VERIFY(block_count() == 1);
+
+    auto root_or_error = read_directory_block(0);
+    if (root_or_error.is_error())
+        return root_or_error.error();
+    auto& root = root_or_error.value();
+
+    // The index root has to fit in after the "." and ".." entries.
+    auto& dot = directory_entry_at(root, 0);
+    auto& dot_dot = directory_entry_at(root, 12);
+    if (dot.rec_len != 12 || dot.name_len != 1 || dot.name[0] != '.' || dot_dot.name_len != 2 || dot_dot.name[0] != '.' || dot_dot.name[1] != '.')
+        return EINVAL;
+
+    Vector<Ext2FSDirectoryEntry> entries;
+    for_each_entry_in_directory_block(root, [&](auto& entry, size_t offset, auto) {
+        if (offset > 12 && entry.inode)
+            entries.empend(String { entry.name, entry.name_len }, entry.inode, entry.file_type);
+        return IterationDecision::Continue;
+    });
+
+    auto leaf_index_or_error = append_directory_block();
+    if (leaf_index_or_error.is_error())
+        return leaf_index_or_error.error();
+    auto leaf = ByteBuffer::create_uninitialized(block_size);
+    write_entries_to_directory_block(leaf, entries);
+    auto result = write_directory_block(leaf_index_or_error.value(), leaf);
+    if (result.is_error())
+        return result;
+
+    dot_dot.rec_len = block_size - 12;
+    memset(root.data() + 24, 0, block_size - 24);
+    auto& root_info = directory_index_root_info(root);
+    root_info.hash_version = fs().super_block().s_def_hash_version;
+    root_info.info_length = 8;
+    auto& countlimit = *reinterpret_cast<ext2_dx_countlimit*>(root.data() + 32);
+    countlimit.limit = (block_size - 32) / sizeof(ext2_dx_entry);
+    countlimit.count = 1;
+    reinterpret_cast<ext2_dx_entry*>(root.data() + 32)->block = leaf_index_or_error.value();
+    result = write_directory_block(0, root);
+    if (result.is_error())
+        return result;
+
+    dbgln_if(EXT2_DEBUG, "Ext2FS: Created hash index for directory {}", index());
+    m_raw_inode.i_flags |= EXT2_INDEX_FL;
+    set_metadata_dirty(true);
+    return KSuccess;
+}
+
+void Ext2FSInode::drop_directory_index()
+{
+    // NOTE: Index blocks look like empty directory blocks, so the directory remains valid without the index.
+    dbgln("Ext2FS: Dropping hash index of directory {}", index());
+    m_raw_inode.i_flags &= ~EXT2_INDEX_FL;
+    set_metadata_dirty(true);
+}
+
+KResult Ext2FSInode::add_directory_entry(const StringView& name, InodeIndex inode_index, u8 file_type)
+{
+    if (is_indexed_directory()) {
+        auto result = add_directory_entry_to_index(name, inode_index, file_type);
+        if (result.error() != -EINVAL && result.error() != -EOVERFLOW)
+            return result;
+        drop_directory_index();
+    }
+
+    for (size_t block_index = 0; block_index < block_count(); ++block_index) {
+        auto block_or_error = read_directory_block(block_index);
+        if (block_or_error.is_error())
+            return block_or_error.error();
+        if (insert_entry_into_directory_block(block_or_error.value(), name, inode_index, file_type))
+            return write_directory_block(block_index, block_or_error.value());
+    }
+
+    // Once a directory outgrows its first block, index it so that it doesn't have to be scanned linearly.
+    if (block_count() == 1 && (fs().super_block().s_feature_compat & EXT2_FEATURE_COMPAT_DIR_INDEX) && fs().super_block().s_def_hash_version <= EXT2_HASH_TEA) {
+        auto result = create_directory_index();
+        if (result.is_success())
+            return add_directory_entry(name, inode_index, file_type);
+        if (result.error() != -EINVAL)
+            return result;
+    }
+
+    auto block_index_or_error = append_directory_block();
+    if (block_index_or_error.is_error())
+        return block_index_or_error.error();
+    auto block = ByteBuffer::create_uninitialized(fs().block_size());
+    Vector<Ext2FSDirectoryEntry> entries;
+    entries.empend(name, inode_index, file_type);
+    write_entries_to_directory_block(block, entries);
+    return write_directory_block(block_index_or_error.value(), block);
+}
+
+KResultOr<InodeIndex> Ext2FSInode::remove_directory_entry(const StringView& name)
+{
+    if (is_indexed_directory()) {
+        auto path_or_error = probe_directory_index(name);
+        if (!path_or_error.is_error()) {
+            ByteBuffer leaf;
+            auto leaf_index_or_error = find_leaf_in_directory_index(path_or_error.value(), name, leaf);
+            if (!leaf_index_or_error.is_error()) {
+                auto removed_inode_index = remove_entry_from_directory_block(leaf, name);
+                VERIFY(removed_inode_index.has_value());
+                auto result = write_directory_block(leaf_index_or_error.value(), leaf);
+                if (result.is_error())
+                    return result;
+                return removed_inode_index.value();
+            }
+            if (leaf_index_or_error.error() != -EINVAL)
+                return leaf_index_or_error.error();
+        } else if (path_or_error.error() != -EINVAL) {
+            return path_or_error.error();
+        }
+        drop_directory_index();
+    }
+
+    for (size_t block_index = 0; block_index < block_count(); ++block_index) {
+        auto block_or_error = read_directory_block(block_index);
+        if (block_or_error.is_error())
+            return block_or_error.error();
+        auto removed_inode_index = remove_entry_from_directory_block(block_or_error.value(), name);
+        if (!removed_inode_index.has_value())
+            continue;
+        auto result = write_directory_block(block_index, block_or_error.value());
+        if (result.is_error())
+            return result;
+        return removed_inode_index.value();
+    }
+    return ENOENT;
+}
+
 KResultOr<NonnullRefPtr<Inode>> Ext2FSInode::create_child(const String& name, mode_t mode, dev_t dev, uid_t uid, gid_t gid)
 {
     if (::is_directory(mode))
@@ -1027,35 +2027,24 @@ KResult Ext2FSInode::add_child(Inode& child, const StringView& name, mode_t mode
 
     dbgln_if(EXT2_DEBUG, "Ext2FSInode::add_child: Adding inode {} with name '{}' and mode {:o} to directory {}", child.index(), name, mode, index());
 
-    Vector<Ext2FSDirectoryEntry> entries;
-    bool name_already_exists = false;
-    KResult result = traverse_as_directory([&](auto& entry) {
-        if (name == entry.name) {
-            name_already_exists = true;
-            return false;
-        }
-        entries.append({ entry.name, entry.inode.index(), entry.file_type });
-        return true;
-    });
-
-    if (result.is_error())
-        return result;
-
-    if (name_already_exists) {
+    auto existing_index_or_error = find_child_index(name);
+    if (existing_index_or_error.is_error())
+        return existing_index_or_error.error();
+    if (existing_index_or_error.value().value()) {
         dbgln("Ext2FSInode::add_child: Name '{}' already exists in inode {}", name, index());
         return EEXIST;
     }
 
-    result = child.increment_link_count();
+    auto result = child.increment_link_count();
     if (result.is_error())
         return result;
 
-    entries.empend(name, child.index(), to_ext2_file_type(mode));
-    result = write_directory(entries);
+    result = add_directory_entry(name, child.index(), to_ext2_file_type(mode));
     if (result.is_error())
         return result;
 
-    m_lookup_cache.set(name, child.index());
+    if (!m_lookup_cache.is_empty())
+        m_lookup_cache.set(name, child.index());
     did_add_child(child.identifier());
     return KSuccess;
 }
@@ -1066,32 +2055,18 @@ KResult Ext2FSInode::remove_child(const StringView& name)
     dbgln_if(EXT2_DEBUG, "Ext2FSInode::remove_child('{}') in inode {}", name, index());
     VERIFY(is_directory());
 
-    auto it = m_lookup_cache.find(name);
-    if (it == m_lookup_cache.end())
-        return ENOENT;
-    auto child_inode_index = (*it).value;
-
-    InodeIdentifier child_id { fsid(), child_inode_index };
+    auto child_inode_index_or_error = remove_directory_entry(name);
+    if (child_inode_index_or_error.is_error())
+        return child_inode_index_or_error.error();
 
-    dbgln_if(EXT2_DEBUG, "Ext2FSInode::remove_child(): Removing '{}' in directory {}", name, index());
-
-    Vector<Ext2FSDirectoryEntry> entries;
-    KResult result = traverse_as_directory([&](auto& entry) {
-        if (name != entry.name)
-            entries.append({ entry.name, entry.inode.index(), entry.file_type });
-        return true;
-    });
-    if (result.is_error())
-        return result;
+    InodeIdentifier child_id { fsid(), child_inode_index_or_error.value() };
 
-    result = write_directory(entries);
-    if (result.is_error())
-        return result;
+    dbgln_if(EXT2_DEBUG, "Ext2FSInode::remove_child(): Removed '{}' in directory {}", name, index());
 
     m_lookup_cache.remove(name);
 
     auto child_inode = fs().get_inode(child_id);
-    result = child_inode->decrement_link_count();
+    auto result = child_inode->decrement_link_count();
     if (result.is_error())
         return result;
 
@@ -1129,56 +2104,141 @@ bool Ext2FS::write_ext2_inode(InodeIndex inode, const ext2_inode& e2inode)
     return write_block(block_index, buffer, inode_size(), offset) >= 0;
 }
 
-auto Ext2FS::allocate_blocks(GroupIndex preferred_group_index, size_t count) -> Vector<BlockIndex>
+Ext2FS::BlockIndex Ext2FS::first_block_in_group(GroupIndex group_index) const
+{
+    return (group_index.value() - 1) * blocks_per_group() + first_block_index().value();
+}
+
+size_t Ext2FS::blocks_in_group(GroupIndex group_index) const
+{
+    return min(blocks_per_group(), super_block().s_blocks_count - first_block_in_group(group_index).value());
+}
+
+bool Ext2FS::is_block_allocated(BlockIndex block_index) const
+{
+    auto group_index = group_index_from_block_index(block_index);
+    auto& cached_bitmap = const_cast<Ext2FS&>(*this).get_bitmap_block(group_descriptor(group_index).bg_block_bitmap);
+    return cached_bitmap.bitmap(blocks_in_group(group_index)).get(block_index.value() - first_block_in_group(group_index).value());
+}
+
+Optional<size_t> Ext2FS::find_free_extent_in_group(GroupIndex group_index, size_t& from_bit, size_t min_length, size_t max_length, Optional<InodeIndex> owner)
+{
+    // Finds a run of free blocks at or after from_bit and moves from_bit to its start.
+    // Unless owner is empty, blocks reserved for other inodes are not considered free.
+    auto& cached_bitmap = get_bitmap_block(group_descriptor(group_index).bg_block_bitmap);
+    auto bitmap = cached_bitmap.bitmap(blocks_in_group(group_index));
+    auto first_block = first_block_in_group(group_index).value();
+
+    while (from_bit < bitmap.size()) {
+        size_t start = from_bit;
+        auto length = bitmap.find_next_range_of_unset_bits(start, min_length, max_length);
+        if (!length.has_value())
+            return {};
+        size_t end = start + length.value();
+        bool skipped = false;
+        if (owner.has_value()) {
+            for (auto& it : m_block_reservations) {
+                if (it.key == owner.value())
+                    continue;
+                size_t reservation_start = it.value.first.value();
+                size_t reservation_end = reservation_start + it.value.count;
+                if (reservation_start >= first_block + end || reservation_end <= first_block + start)
+                    continue;
+                if (reservation_start > first_block + start && reservation_start - first_block - start >= min_length) {
+                    end = reservation_start - first_block;
+                    continue;
+                }
+                from_bit = reservation_end - first_block;
+                skipped = true;
+                break;
+            }
+        }
+        if (skipped)
+            continue;
+        from_bit = start;
+        return end - start;
+    }
+    return {};
+}
+
+auto Ext2FS::allocate_blocks(GroupIndex preferred_group_index, size_t count, BlockIndex goal, InodeIndex owner) -> Vector<BlockIndex>
 {
     LOCKER(m_lock);
-    dbgln_if(EXT2_DEBUG, "Ext2FS: allocate_blocks(preferred group: {}, count {})", preferred_group_index, count);
+    dbgln_if(EXT2_DEBUG, "Ext2FS: allocate_blocks(preferred group: {}, count {}, goal {}, owner {})", preferred_group_index, count, goal, owner);
     if (count == 0)
         return {};
 
     Vector<BlockIndex> blocks;
-    dbgln_if(EXT2_DEBUG, "Ext2FS: allocate_blocks:");
     blocks.ensure_capacity(count);
 
-    auto group_index = preferred_group_index;
+    auto allocate_run = [&](BlockIndex first, size_t length) {
+        auto previous = blocks.is_empty() ? goal : blocks.last();
+        if (!previous.value() || previous.value() + 1 != first.value())
+            ++m_allocated_extent_count;
+        m_allocated_block_count += length;
+        for (size_t i = 0; i < length; ++i) {
+            BlockIndex block_index = first.value() + i;
+            set_block_allocation_state(block_index, true);
+            blocks.unchecked_append(block_index);
+        }
+        dbgln_if(EXT2_DEBUG, "Ext2FS: allocated {} block(s) starting at {}", length, first);
+    };
 
-    if (!group_descriptor(preferred_group_index).bg_free_blocks_count) {
-        group_index = 1;
+    // If the file ends right before its reservation window, keep growing into it.
+    if (owner.value() && goal.value()) {
+        if (auto it = m_block_reservations.find(owner); it != m_block_reservations.end()) {
+            auto& reservation = it->value;
+            size_t length = 0;
+            if (reservation.first.value() == goal.value() + 1) {
+                while (length < min(count, reservation.count) && !is_block_allocated(reservation.first.value() + length))
+                    ++length;
+                if (length)
+                    allocate_run(reservation.first, length);
+                reservation.first = reservation.first.value() + length;
+                reservation.count -= length;
+            }
+            if (!length || !reservation.count)
+                m_block_reservations.remove(it);
+        }
     }
 
+    const size_t reservation_block_count = owner.value() ? block_reservation_size / block_size() : 0;
     while (blocks.size() < count) {
-
-        bool found_a_group = false;
-        if (group_descriptor(group_index).bg_free_blocks_count) {
-            found_a_group = true;
-        } else {
-            if (group_index == preferred_group_index)
-                group_index = 1;
-            for (; group_index <= m_block_group_count; group_index = GroupIndex { group_index.value() + 1 }) {
-                if (group_descriptor(group_index).bg_free_blocks_count) {
-                    found_a_group = true;
-                    break;
-                }
+        size_t wanted = count - blocks.size();
+        auto near = blocks.is_empty() ? goal : blocks.last();
+        auto start_group_index = near.value() ? group_index_from_block_index(near) : preferred_group_index;
+
+        // Look for a run that covers the whole request first, then settle for smaller ones,
+        // and only dip into other inodes' reservations when there's nothing else left.
+        Optional<size_t> length;
+        GroupIndex group_index;
+        size_t from_bit = 0;
+        const size_t min_lengths[] = { min(wanted, (size_t)2048), min(wanted, (size_t)16), 1, 1 };
+        for (size_t pass = 0; pass < 4 && !length.has_value(); ++pass) {
+            Optional<InodeIndex> respected_owner;
+            if (pass < 3)
+                respected_owner = owner;
+            for (unsigned i = 0; i <= m_block_group_count && !length.has_value(); ++i) {
+                // Start out right after the goal, then try every group from the beginning.
+                group_index = i == 0 ? start_group_index : GroupIndex { (start_group_index.value() - 1 + i - 1) % m_block_group_count + 1 };
+                from_bit = (i == 0 && near.value()) ? near.value() + 1 - first_block_in_group(group_index).value() : 0;
+                if (i == 0 && !near.value())
+                    continue;
+                if (!group_descriptor(group_index).bg_free_blocks_count)
+                    continue;
+                length = find_free_extent_in_group(group_index, from_bit, min_lengths[pass], wanted + reservation_block_count, respected_owner);
             }
         }
-
-        VERIFY(found_a_group);
-        auto& bgd = group_descriptor(group_index);
-        auto& cached_bitmap = get_bitmap_block(bgd.bg_block_bitmap);
-
-        int blocks_in_group = min(blocks_per_group(), super_block().s_blocks_count);
-        auto block_bitmap = Bitmap::wrap(cached_bitmap.buffer.data(), blocks_in_group);
-
-        BlockIndex first_block_in_group = (group_index.value() - 1) * blocks_per_group() + first_block_index().value();
-        size_t free_region_size = 0;
-        auto first_unset_bit_index = block_bitmap.find_longest_range_of_unset_bits(count - blocks.size(), free_region_size);
-        VERIFY(first_unset_bit_index.has_value());
-        dbgln_if(EXT2_DEBUG, "Ext2FS: allocating free region of size: {} [{}]", free_region_size, group_index);
-        for (size_t i = 0; i < free_region_size; ++i) {
-            BlockIndex block_index = (first_unset_bit_index.value() + i) + first_block_in_group.value();
-            set_block_allocation_state(block_index, true);
-            blocks.unchecked_append(block_index);
-            dbgln_if(EXT2_DEBUG, "  allocated > {}", block_index);
+        VERIFY(length.has_value());
+
+        BlockIndex first = first_block_in_group(group_index).value() + from_bit;
+        size_t run_length = min(length.value(), wanted);
+        allocate_run(first, run_length);
+        if (owner.value()) {
+            if (length.value() > run_length)
+                m_block_reservations.set(owner, { first.value() + run_length, length.value() - run_length });
+            else
+                m_block_reservations.remove(owner);
         }
     }
 
@@ -1186,6 +2246,34 @@ auto Ext2FS::allocate_blocks(GroupIndex preferred_group_index, size_t count) ->
     return blocks;
 }
 
+void Ext2FS::discard_block_reservation(InodeIndex owner)
+{
+    LOCKER(m_lock);
+    m_block_reservations.remove(owner);
+}
+
+Optional<FS::FragmentationInfo> Ext2FS::fragmentation_info() const
+{
+    LOCKER(m_lock);
+    FragmentationInfo info;
+    for (unsigned group = 1; group <= m_block_group_count; ++group) {
+        GroupIndex group_index = group;
+        auto& cached_bitmap = const_cast<Ext2FS&>(*this).get_bitmap_block(group_descriptor(group_index).bg_block_bitmap);
+        auto bitmap = cached_bitmap.bitmap(blocks_in_group(group_index));
+        for (size_t from_bit = 0; from_bit < bitmap.size();) {
+            auto length = bitmap.find_next_range_of_unset_bits(from_bit);
+            if (!length.has_value())
+                break;
+            ++info.free_extent_count;
+            info.largest_free_extent = max(info.largest_free_extent, length.value());
+            from_bit += length.value();
+        }
+    }
+    info.allocated_block_count = m_allocated_block_count;
+    info.allocated_extent_count = m_allocated_extent_count;
+    return info;
+}
+
 InodeIndex Ext2FS::find_a_free_inode(GroupIndex preferred_group)
 {
     LOCKER(m_lock);
@@ -1247,7 +2335,7 @@ Ext2FS::GroupIndex Ext2FS::group_index_from_block_index(BlockIndex block_index)
 {
     if (!block_index)
         return 0;
-    return (block_index.value() - 1) / blocks_per_group() + 1;
+    return (block_index.value() - first_block_index().value()) / blocks_per_group() + 1;
 }
 
 auto Ext2FS::group_index_from_inode(InodeIndex inode) const -> GroupIndex
@@ -1488,13 +2576,10 @@ bool Ext2FSInode::populate_lookup_cache() const
 RefPtr<Inode> Ext2FSInode::lookup(StringView name)
 {
     VERIFY(is_directory());
-    if (!populate_lookup_cache())
+    auto inode_index_or_error = find_child_index(name);
+    if (inode_index_or_error.is_error() || !inode_index_or_error.value().value())
         return {};
-    LOCKER(m_lock);
-    auto it = m_lookup_cache.find(name.hash(), [&](auto& entry) { return entry.key == name; });
-    if (it != m_lookup_cache.end())
-        return fs().get_inode({ fsid(), (*it).value });
-    return {};
+    return fs().get_inode({ fsid(), inode_index_or_error.value() });
 }
 
 void Ext2FSInode::one_ref_left()
@@ -1608,13 +2693,19 @@ KResultOr<int> Ext2FSInode::get_block_address(int index)
 {
     LOCKER(m_lock);
 
-    if (m_block_list.is_empty())
-        m_block_list = fs().block_list_for_inode(m_raw_inode);
-
-    if (index < 0 || (size_t)index >= m_block_list.size())
+    if (index < 0 || (size_t)index >= block_count())
         return 0;
 
-    return m_block_list[index].value();
+    if ((size_t)index >= allocated_block_count()) {
+        auto result = allocate_delayed_blocks();
+        if (result.is_error())
+            return result;
+    }
+
+    auto block_index_or_error = block_at(index);
+    if (block_index_or_error.is_error())
+        return block_index_or_error.error();
+    return block_index_or_error.value().value();
 }
 
 unsigned Ext2FS::total_block_count() const
@@ -1626,7 +2717,7 @@ unsigned Ext2FS::total_block_count() const
 unsigned Ext2FS::free_block_count() const
 {
     LOCKER(m_lock);
-    return super_block().s_free_blocks_count;
+    return super_block().s_free_blocks_count - min((size_t)super_block().s_free_blocks_count, m_delayed_block_count);
 }
 
 unsigned Ext2FS::total_inode_count() const
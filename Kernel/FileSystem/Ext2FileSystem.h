@@ -42,6 +42,7 @@ namespace Kernel {
 
 class Ext2FS;
 struct Ext2FSDirectoryEntry;
+struct Ext2FSHTreePath;
 
 class Ext2FSInode final : public Inode {
     friend class Ext2FS;
@@ -76,19 +77,60 @@ private:
     virtual KResult chmod(mode_t) override;
     virtual KResult chown(uid_t, gid_t) override;
     virtual KResult truncate(u64) override;
+    virtual void read_ahead(off_t, size_t) override;
+    virtual void evict_cached_data(off_t, size_t) override;
 
     virtual KResultOr<int> get_block_address(int) override;
 
     KResult write_directory(const Vector<Ext2FSDirectoryEntry>&);
     bool populate_lookup_cache() const;
+    bool is_indexed_directory() const { return m_raw_inode.i_flags & EXT2_INDEX_FL; }
+    KResultOr<ByteBuffer> read_directory_block(size_t logical_index) const;
+    KResult write_directory_block(size_t logical_index, const ByteBuffer&);
+    KResultOr<size_t> append_directory_block();
+    KResultOr<InodeIndex> find_child_index(const StringView& name) const;
+    KResult add_directory_entry(const StringView& name, InodeIndex, u8 file_type);
+    KResultOr<InodeIndex> remove_directory_entry(const StringView& name);
+    KResultOr<Ext2FSHTreePath> probe_directory_index(const StringView& name) const;
+    KResultOr<bool> advance_to_colliding_leaf(Ext2FSHTreePath&) const;
+    KResultOr<size_t> find_leaf_in_directory_index(Ext2FSHTreePath&, const StringView& name, ByteBuffer& leaf) const;
+    KResult add_directory_entry_to_index(const StringView& name, InodeIndex, u8 file_type);
+    KResult make_room_in_directory_index(Ext2FSHTreePath&);
+    KResult split_directory_leaf(Ext2FSHTreePath&, size_t leaf_index, ByteBuffer& leaf);
+    KResult create_directory_index();
+    void drop_directory_index();
     KResult resize(u64);
+    size_t block_count() const;
+    size_t allocated_block_count() const { return block_count() - m_delayed_blocks.size(); }
+    ssize_t write_delayed_bytes(off_t, size_t, const UserOrKernelBuffer& data, FileDescription*);
+    size_t delayed_reservation_size(size_t first_logical_index, size_t count) const;
+    KResult allocate_delayed_blocks();
+    void discard_delayed_blocks();
+    KResultOr<BlockBasedFS::BlockIndex> block_at(size_t logical_index) const;
+    KResult set_block_at(size_t logical_index, BlockBasedFS::BlockIndex);
+    KResult shrink_block_map(size_t new_block_count);
+    KResultOr<const Vector<u32>*> block_map_leaf(size_t leaf_index) const;
+    KResultOr<BlockBasedFS::BlockIndex> leaf_block(size_t leaf_index, bool allocate, BlockBasedFS::BlockIndex goal = 0);
+    KResultOr<BlockBasedFS::BlockIndex> allocate_pointer_block(BlockBasedFS::BlockIndex goal);
+    KResultOr<bool> truncate_pointer_block(BlockBasedFS::BlockIndex, unsigned depth, u64 first_logical_index, size_t new_block_count);
+    void release_block(BlockBasedFS::BlockIndex);
+    size_t contiguous_run_length(size_t first_logical_index, size_t max_length) const;
+    template<typename Callback>
+    void for_each_block_run_in_range(off_t offset, size_t count, Callback) const;
 
     Ext2FS& fs();
     const Ext2FS& fs() const;
     Ext2FSInode(Ext2FS&, InodeIndex);
 
-    mutable Vector<BlockBasedFS::BlockIndex> m_block_list;
+    // NOTE: Lazily populated cache of the leaf pointer blocks (the ones that map logical
+    //       blocks to physical ones), keyed by their position in the indirect block tree.
+    mutable HashMap<size_t, Vector<u32>> m_block_map_leaves;
     mutable HashMap<String, InodeIndex> m_lookup_cache;
+    // NOTE: Cached writes past the last allocated block of a regular file are buffered here (one buffer
+    //       per logical block) and only get physical blocks at writeback, or never if the file goes away first.
+    Vector<ByteBuffer> m_delayed_blocks;
+    size_t m_delayed_reserved_block_count { 0 };
+    u64 m_delayed_since_ms { 0 };
     ext2_inode m_raw_inode;
 };
 
@@ -112,6 +154,8 @@ public:
 
     virtual u8 internal_file_type_to_directory_entry_type(const DirectoryEntryView& entry) const override;
 
+    virtual Optional<FragmentationInfo> fragmentation_info() const override;
+
 private:
     TYPEDEF_DISTINCT_ORDERED_ID(unsigned, GroupIndex);
 
@@ -138,16 +182,26 @@ private:
     KResultOr<NonnullRefPtr<Inode>> create_inode(Ext2FSInode& parent_inode, const String& name, mode_t, dev_t, uid_t, gid_t);
     KResult create_directory(Ext2FSInode& parent_inode, const String& name, mode_t, uid_t, gid_t);
     virtual void flush_writes() override;
+    virtual void flush_expired_writes() override;
+    void flush_metadata_to_cache();
+    void uncache_unused_inodes();
+    void allocate_delayed_blocks(bool only_expired);
+    KResult reserve_delayed_blocks(size_t count);
+    void release_delayed_blocks(size_t count);
 
     BlockIndex first_block_index() const;
     InodeIndex find_a_free_inode(GroupIndex preferred_group = 0);
-    Vector<BlockIndex> allocate_blocks(GroupIndex preferred_group_index, size_t count);
+    Vector<BlockIndex> allocate_blocks(GroupIndex preferred_group_index, size_t count, BlockIndex goal = 0, InodeIndex owner = 0);
+    Optional<size_t> find_free_extent_in_group(GroupIndex, size_t& from_bit, size_t min_length, size_t max_length, Optional<InodeIndex> owner);
+    void discard_block_reservation(InodeIndex);
+    BlockIndex first_block_in_group(GroupIndex) const;
+    size_t blocks_in_group(GroupIndex) const;
+    bool is_block_allocated(BlockIndex) const;
     GroupIndex group_index_from_inode(InodeIndex) const;
     GroupIndex group_index_from_block_index(BlockIndex) const;
 
     Vector<BlockIndex> block_list_for_inode_impl(const ext2_inode&, bool include_block_list_blocks = false) const;
     Vector<BlockIndex> block_list_for_inode(const ext2_inode&, bool include_block_list_blocks = false) const;
-    KResult write_block_list_for_inode(InodeIndex, ext2_inode&, const Vector<BlockIndex>&);
 
     bool get_inode_allocation_state(InodeIndex) const;
     bool set_inode_allocation_state(InodeIndex, bool);
@@ -191,6 +245,21 @@ private:
     CachedBitmap& get_bitmap_block(BlockIndex);
 
     Vector<OwnPtr<CachedBitmap>> m_cached_bitmaps;
+
+    // NOTE: A reservation keeps the blocks following a file's last allocation free for that file,
+    //       so that files growing at the same time don't end up interleaved on disk.
+    struct BlockReservation {
+        BlockIndex first;
+        size_t count { 0 };
+    };
+    HashMap<InodeIndex, BlockReservation> m_block_reservations;
+
+    u64 m_allocated_block_count { 0 };
+    u64 m_allocated_extent_count { 0 };
+
+    // NOTE: Blocks promised to delayed writes (including the pointer blocks needed to map them),
+    //       they're kept out of the free block count until they're allocated.
+    size_t m_delayed_block_count { 0 };
 };
 
 inline Ext2FS& Ext2FSInode::fs()
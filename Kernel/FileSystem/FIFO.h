@@ -55,6 +55,9 @@ public:
     void attach(Direction);
     void detach(Direction);
 
+    unsigned readers() const { return m_readers; }
+    unsigned writers() const { return m_writers; }
+
 private:
     // ^File
     virtual KResultOr<size_t> write(FileDescription&, size_t, const UserOrKernelBuffer&, size_t) override;
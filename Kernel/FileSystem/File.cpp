@@ -25,11 +25,71 @@
  */
 
 #include <AK/StringView.h>
+#include <Kernel/FileSystem/EPoll.h>
 #include <Kernel/FileSystem/File.h>
 #include <Kernel/FileSystem/FileDescription.h>
 
 namespace Kernel {
 
+void FileBlockCondition::unblock()
+{
+    Vector<NonnullRefPtr<EPoll>, 4> epolls_to_wake;
+    {
+        ScopedSpinLock lock(m_lock);
+        do_unblock([&](auto& b, void* data, bool&) {
+            VERIFY(b.blocker_type() == Thread::Blocker::Type::File);
+            auto& blocker = static_cast<Thread::FileBlocker&>(b);
+            return blocker.unblock(false, data);
+        });
+        for (auto* entry : m_epoll_entries) {
+            if (!entry->epoll.notify({}, *entry))
+                continue;
+            // NOTE: The epoll may be in the middle of being destroyed, in which case nobody is waiting on it.
+            if (entry->epoll.try_ref())
+                epolls_to_wake.append(adopt(entry->epoll));
+        }
+    }
+    // Wake the epolls' waiters without holding our lock, as that evaluates their own block conditions.
+    for (auto& epoll : epolls_to_wake)
+        epoll->wake_waiters({});
+}
+
+void FileBlockCondition::add_epoll_entry(EPollEntry& entry)
+{
+    ScopedSpinLock lock(m_lock);
+    m_epoll_entries.append(&entry);
+}
+
+void FileBlockCondition::remove_epoll_entry(EPollEntry& entry)
+{
+    ScopedSpinLock lock(m_lock);
+    m_epoll_entries.remove_first_matching([&](auto* other) { return other == &entry; });
+}
+
+void FileBlockCondition::remove_epoll_entries_for(FileDescription& description)
+{
+    Vector<NonnullRefPtr<EPoll>, 4> epolls;
+    Vector<EPollEntry*, 4> entries;
+    {
+        ScopedSpinLock lock(m_lock);
+        if (m_epoll_entries.is_empty())
+            return;
+        m_epoll_entries.remove_all_matching([&](auto* entry) {
+            if (&entry->description != &description)
+                return false;
+            // NOTE: If the epoll is already dying, its destructor frees the entry. It reaches our block
+            //       condition through the entry's file, so the entry only has to be off our list by then.
+            if (entry->epoll.try_ref()) {
+                epolls.append(adopt(entry->epoll));
+                entries.append(entry);
+            }
+            return true;
+        });
+    }
+    for (size_t i = 0; i < entries.size(); ++i)
+        epolls[i]->forget({}, *entries[i]);
+}
+
 File::File()
     : m_block_condition(*this)
 {
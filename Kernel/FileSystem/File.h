@@ -30,6 +30,7 @@
 #include <AK/RefCounted.h>
 #include <AK/String.h>
 #include <AK/Types.h>
+#include <AK/Vector.h>
 #include <AK/Weakable.h>
 #include <Kernel/Forward.h>
 #include <Kernel/KResult.h>
@@ -40,6 +41,7 @@
 namespace Kernel {
 
 class File;
+struct EPollEntry;
 
 class FileBlockCondition : public Thread::BlockCondition {
 public:
@@ -55,18 +57,16 @@ public:
         return !blocker.unblock(true, data);
     }
 
-    void unblock()
-    {
-        ScopedSpinLock lock(m_lock);
-        do_unblock([&](auto& b, void* data, bool&) {
-            VERIFY(b.blocker_type() == Thread::Blocker::Type::File);
-            auto& blocker = static_cast<Thread::FileBlocker&>(b);
-            return blocker.unblock(false, data);
-        });
-    }
+    void unblock();
+
+    // NOTE: Unlike blockers, epoll entries stay registered across wakeups until they are removed.
+    void add_epoll_entry(EPollEntry&);
+    void remove_epoll_entry(EPollEntry&);
+    void remove_epoll_entries_for(FileDescription&);
 
 private:
     File& m_file;
+    Vector<EPollEntry*> m_epoll_entries;
 };
 
 // File is the base class for anything that can be referenced by a FileDescription.
@@ -135,6 +135,7 @@ public:
     virtual bool is_block_device() const { return false; }
     virtual bool is_character_device() const { return false; }
     virtual bool is_socket() const { return false; }
+    virtual bool is_epoll() const { return false; }
 
     virtual FileBlockCondition& block_condition() { return m_block_condition; }
 
@@ -139,6 +139,23 @@ public:
 
     FileBlockCondition& block_condition();
 
+    enum class AccessPattern : u8 {
+        Normal,
+        Sequential,
+        Random,
+    };
+
+    AccessPattern access_pattern() const { return m_access_pattern; }
+    void set_access_pattern(AccessPattern access_pattern) { m_access_pattern = access_pattern; }
+
+    struct ReadAheadState {
+        off_t next_offset { 0 };
+        off_t read_ahead_end { 0 };
+        size_t window_size { 0 };
+    };
+
+    ReadAheadState& read_ahead_state() { return m_read_ahead_state; }
+
 private:
     friend class VFS;
     explicit FileDescription(File&);
@@ -167,6 +184,8 @@ private:
     bool m_should_append : 1 { false };
     bool m_direct : 1 { false };
     FIFO::Direction m_fifo_direction { FIFO::Direction::Neither };
+    AccessPattern m_access_pattern { AccessPattern::Normal };
+    ReadAheadState m_read_ahead_state;
 
     Lock m_lock { "FileDescription" };
 };
@@ -26,6 +26,7 @@
 
 #pragma once
 
+#include <AK/Optional.h>
 #include <AK/RefCounted.h>
 #include <AK/RefPtr.h>
 #include <AK/String.h>
@@ -54,6 +55,7 @@ public:
     unsigned fsid() const { return m_fsid; }
     static FS* from_fsid(u32);
     static void sync();
+    static void write_back_expired();
     static void lock_all();
 
     virtual bool initialize() = 0;
@@ -70,6 +72,14 @@ public:
 
     virtual KResult prepare_to_unmount() const { return KSuccess; }
 
+    struct FragmentationInfo {
+        size_t free_extent_count { 0 };
+        size_t largest_free_extent { 0 };
+        u64 allocated_block_count { 0 };
+        u64 allocated_extent_count { 0 };
+    };
+    virtual Optional<FragmentationInfo> fragmentation_info() const { return {}; }
+
     struct DirectoryEntryView {
         DirectoryEntryView(const StringView& name, InodeIdentifier, u8 file_type);
 
@@ -79,6 +89,8 @@ public:
     };
 
     virtual void flush_writes() { }
+    // Called periodically to write back what has been dirty for a while.
+    virtual void flush_expired_writes() { flush_writes(); }
 
     size_t block_size() const { return m_block_size; }
 
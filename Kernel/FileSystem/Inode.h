@@ -83,6 +83,8 @@ public:
     virtual KResult chmod(mode_t) = 0;
     virtual KResult chown(uid_t, gid_t) = 0;
     virtual KResult truncate(u64) { return KSuccess; }
+    virtual void read_ahead(off_t, size_t) { }
+    virtual void evict_cached_data(off_t, size_t) { }
     virtual KResultOr<NonnullRefPtr<Custody>> resolve_as_link(Custody& base, RefPtr<Custody>* out_parent, int options, int symlink_recursion_level) const;
 
     virtual KResultOr<int> get_block_address(int) { return -ENOTSUP; }
@@ -30,6 +30,7 @@
 #include <Kernel/FileSystem/InodeFile.h>
 #include <Kernel/FileSystem/VirtualFileSystem.h>
 #include <Kernel/Process.h>
+#include <Kernel/Tasks/ReadAheadTask.h>
 #include <Kernel/VM/PrivateInodeVMObject.h>
 #include <Kernel/VM/SharedInodeVMObject.h>
 #include <LibC/errno_numbers.h>
@@ -46,6 +47,41 @@ InodeFile::~InodeFile()
 {
 }
 
+void InodeFile::read_ahead_if_sequential(FileDescription& description, off_t offset, size_t nread)
+{
+    static constexpr size_t initial_read_ahead_window_size = 16 * KiB;
+    static constexpr size_t max_read_ahead_window_size = 128 * KiB;
+
+    if (description.is_direct() || description.access_pattern() == FileDescription::AccessPattern::Random)
+        return;
+
+    auto& state = description.read_ahead_state();
+    bool is_sequential = offset == state.next_offset;
+    state.next_offset = offset + nread;
+
+    if (description.access_pattern() == FileDescription::AccessPattern::Sequential) {
+        state.window_size = max_read_ahead_window_size;
+    } else if (is_sequential) {
+        // The reader is keeping up with us, so keep doubling how far ahead we read.
+        state.window_size = state.window_size ? min(state.window_size * 2, max_read_ahead_window_size) : initial_read_ahead_window_size;
+    } else {
+        state.window_size = 0;
+        state.read_ahead_end = 0;
+        return;
+    }
+
+    // Only start the next batch once the reader has made its way into the second half
+    // of the last one, so that the read-ahead stays asynchronous without a request per read().
+    off_t window_end = min(state.next_offset + (off_t)state.window_size, (off_t)m_inode->size());
+    if (state.read_ahead_end - state.next_offset > (off_t)state.window_size / 2)
+        return;
+    off_t read_ahead_start = max(state.next_offset, state.read_ahead_end);
+    if (read_ahead_start >= window_end)
+        return;
+    ReadAheadTask::enqueue(*m_inode, read_ahead_start, window_end - read_ahead_start);
+    state.read_ahead_end = window_end;
+}
+
 KResultOr<size_t> InodeFile::read(FileDescription& description, size_t offset, UserOrKernelBuffer& buffer, size_t count)
 {
     if (Checked<off_t>::addition_would_overflow(offset, count))
@@ -55,6 +91,7 @@ KResultOr<size_t> InodeFile::read(FileDescription& description, size_t offset, U
     if (nread > 0) {
         Thread::current()->did_file_read(nread);
         evaluate_block_conditions();
+        read_ahead_if_sequential(description, offset, nread);
     }
     if (nread < 0)
         return KResult((ErrnoCode)-nread);
@@ -65,6 +65,7 @@ public:
 
 private:
     explicit InodeFile(NonnullRefPtr<Inode>&&);
+    void read_ahead_if_sequential(FileDescription&, off_t offset, size_t nread);
     NonnullRefPtr<Inode> m_inode;
 };
 
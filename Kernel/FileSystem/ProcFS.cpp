@@ -49,6 +49,7 @@
 #include <Kernel/KSyms.h>
 #include <Kernel/Module.h>
 #include <Kernel/Net/LocalSocket.h>
+#include <Kernel/Net/LoopbackAdapter.h>
 #include <Kernel/Net/NetworkAdapter.h>
 #include <Kernel/Net/Routing.h>
 #include <Kernel/Net/TCPSocket.h>
@@ -61,6 +62,7 @@
 #include <Kernel/TTY/TTY.h>
 #include <Kernel/VM/AnonymousVMObject.h>
 #include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/PhysicalRegion.h>
 #include <LibC/errno_numbers.h>
 
 namespace Kernel {
@@ -83,6 +85,11 @@ enum ProcFileType {
 
     __FI_Root_Start,
     FI_Root_df,
+    FI_Root_fragmentation,
+    FI_Root_blockio,
+    FI_Root_scheduler,
+    FI_Root_buddyinfo,
+    FI_Root_locks,
     FI_Root_all,
     FI_Root_memstat,
     FI_Root_cpuinfo,
@@ -545,6 +552,19 @@ static bool procfs$net_tcp(InodeIdentifier, KBufferBuilder& builder)
         obj.add("bytes_in", socket.bytes_in());
         obj.add("packets_out", socket.packets_out());
         obj.add("bytes_out", socket.bytes_out());
+        obj.add("mss", socket.maximum_segment_size());
+        obj.add("cwnd", socket.congestion_window());
+        obj.add("ssthresh", socket.slow_start_threshold());
+        obj.add("send_window", socket.send_window());
+        obj.add("receive_window", socket.receive_window());
+        obj.add("bytes_in_flight", socket.bytes_in_flight());
+        obj.add("srtt_usec", socket.smoothed_rtt_usec());
+        obj.add("rttvar_usec", socket.rtt_variance_usec());
+        obj.add("rto_usec", socket.retransmission_timeout_usec());
+        obj.add("retransmits", socket.retransmits());
+        obj.add("fast_retransmits", socket.fast_retransmits());
+        obj.add("timeouts", socket.retransmission_timeouts());
+        obj.add("out_of_order_packets", socket.out_of_order_packets());
     });
     array.finish();
     return true;
@@ -696,6 +716,112 @@ static bool procfs$df(InodeIdentifier, KBufferBuilder& builder)
     return true;
 }
 
+static bool procfs$fragmentation(InodeIdentifier, KBufferBuilder& builder)
+{
+    // FIXME: This is obviously racy against the VFS mounts changing.
+    JsonArraySerializer array { builder };
+    VFS::the().for_each_mount([&array](auto& mount) {
+        auto& fs = mount.guest_fs();
+        auto info = fs.fragmentation_info();
+        if (!info.has_value())
+            return;
+        auto fs_object = array.add_object();
+        fs_object.add("class_name", fs.class_name());
+        fs_object.add("mount_point", mount.absolute_path());
+        fs_object.add("free_block_count", fs.free_block_count());
+        fs_object.add("free_extent_count", info->free_extent_count);
+        fs_object.add("largest_free_extent", info->largest_free_extent);
+        fs_object.add("allocated_block_count", info->allocated_block_count);
+        fs_object.add("allocated_extent_count", info->allocated_extent_count);
+    });
+    array.finish();
+    return true;
+}
+
+static bool procfs$blockio(InodeIdentifier, KBufferBuilder& builder)
+{
+    JsonArraySerializer array { builder };
+    Device::for_each([&array](auto& device) {
+        if (!device.is_block_device())
+            return;
+        auto& block_device = static_cast<BlockDevice&>(device);
+        if (!block_device.schedules_requests())
+            return;
+        auto statistics = block_device.request_queue_statistics();
+        auto obj = array.add_object();
+        obj.add("device", block_device.device_name());
+        obj.add("queue_depth", statistics.queue_depth);
+        obj.add("max_queue_depth", statistics.max_queue_depth);
+        obj.add("read_requests", statistics.request_count[0]);
+        obj.add("write_requests", statistics.request_count[1]);
+        obj.add("read_blocks", statistics.block_count[0]);
+        obj.add("written_blocks", statistics.block_count[1]);
+        obj.add("merged_requests", statistics.merged_request_count);
+        auto add_histogram = [&](const char* name, const u64* buckets) {
+            auto histogram = obj.add_array(name);
+            for (size_t i = 0; i < BlockDevice::latency_bucket_count; ++i)
+                histogram.add(buckets[i]);
+            histogram.finish();
+        };
+        add_histogram("read_latency_histogram", statistics.latency_histogram[0]);
+        add_histogram("write_latency_histogram", statistics.latency_histogram[1]);
+    });
+    array.finish();
+    return true;
+}
+
+static bool procfs$scheduler(InodeIdentifier, KBufferBuilder& builder)
+{
+    JsonArraySerializer array { builder };
+    Processor::for_each(
+        [&](Processor& proc) -> IterationDecision {
+            auto statistics = Scheduler::processor_statistics(proc.get_id());
+            auto obj = array.add_object();
+            obj.add("processor", proc.get_id());
+            obj.add("runnable_threads", statistics.runnable_threads);
+            obj.add("context_switches", statistics.context_switches);
+            obj.add("stolen_threads", statistics.stolen_threads);
+            obj.add("cache_affine_wakeups", statistics.cache_affine_wakeups);
+            obj.add("migrated_wakeups", statistics.migrated_wakeups);
+            return IterationDecision::Continue;
+        });
+    array.finish();
+    return true;
+}
+
+static bool procfs$buddyinfo(InodeIdentifier, KBufferBuilder& builder)
+{
+    JsonArraySerializer array { builder };
+    MM.for_each_physical_region([&](auto& region, bool supervisor) {
+        auto obj = array.add_object();
+        obj.add("type", supervisor ? "super" : "user");
+        obj.add("lower", region.lower().get());
+        obj.add("upper", region.upper().get());
+        obj.add("total_pages", region.size());
+        obj.add("free_pages", region.free());
+        auto free_blocks = obj.add_array("free_blocks");
+        for (size_t order = 0; order <= PhysicalRegion::max_order; ++order)
+            free_blocks.add(region.free_blocks_of_order(order));
+        free_blocks.finish();
+    });
+    array.finish();
+    return true;
+}
+
+static bool procfs$locks(InodeIdentifier, KBufferBuilder& builder)
+{
+    JsonArraySerializer array { builder };
+    Lock::for_each_statistics([&](auto& statistics) {
+        auto obj = array.add_object();
+        obj.add("name", statistics.name.load());
+        obj.add("acquisitions", statistics.acquisitions.load());
+        obj.add("contentions", statistics.contentions.load());
+        obj.add("wait_time_ns", statistics.wait_time_ns.load());
+    });
+    array.finish();
+    return true;
+}
+
 static bool procfs$cpuinfo(InodeIdentifier, KBufferBuilder& builder)
 {
     JsonArraySerializer array { builder };
@@ -714,6 +840,9 @@ static bool procfs$cpuinfo(InodeIdentifier, KBufferBuilder& builder)
             obj.add("stepping", info.stepping());
             obj.add("type", info.type());
             obj.add("brandstr", info.brandstr());
+            obj.add("ipis_sent", proc.ipis_sent());
+            obj.add("ipis_received", proc.ipis_received());
+            obj.add("tlb_shootdowns_received", proc.tlb_shootdowns_received());
             return IterationDecision::Continue;
         });
     array.finish();
@@ -745,14 +874,25 @@ static bool procfs$memstat(InodeIdentifier, KBufferBuilder& builder)
     json.add("user_physical_available", user_physical_pages_total - user_physical_pages_used);
     json.add("user_physical_committed", user_physical_pages_committed);
     json.add("user_physical_uncommitted", user_physical_pages_uncommitted);
+    json.add("user_physical_cached", MM.cached_user_physical_pages());
+    json.add("zeroed_page_pool_pages", MM.zeroed_page_pool_size());
+    json.add("zeroed_page_pool_hits", MM.zeroed_page_pool_hits());
+    json.add("zeroed_page_pool_misses", MM.zeroed_page_pool_misses());
+    json.add("large_pages_mapped", MM.large_pages_mapped());
+    json.add("large_page_promotions", MM.large_page_promotions());
+    json.add("large_page_demotions", MM.large_page_demotions());
     json.add("super_physical_allocated", super_physical_used);
     json.add("super_physical_available", super_physical_total - super_physical_used);
     json.add("kmalloc_call_count", stats.kmalloc_call_count);
     json.add("kfree_call_count", stats.kfree_call_count);
-    slab_alloc_stats([&json](size_t slab_size, size_t num_allocated, size_t num_free) {
-        auto prefix = String::formatted("slab_{}", slab_size);
-        json.add(String::formatted("{}_num_allocated", prefix), num_allocated);
-        json.add(String::formatted("{}_num_free", prefix), num_free);
+    slab_alloc_stats([&json](const SlabAllocatorStatistics& slab) {
+        auto prefix = String::formatted("slab_{}", slab.slab_size);
+        json.add(String::formatted("{}_num_allocated", prefix), slab.num_allocated);
+        json.add(String::formatted("{}_num_free", prefix), slab.num_free);
+        json.add(String::formatted("{}_num_cached", prefix), slab.num_cached);
+        json.add(String::formatted("{}_allocations", prefix), slab.allocations);
+        json.add(String::formatted("{}_frees", prefix), slab.frees);
+        json.add(String::formatted("{}_magazine_hits", prefix), slab.magazine_hits);
     });
     json.finish();
     return true;
@@ -999,6 +1139,37 @@ bool ProcFS::initialize()
             g_dump_kmalloc_stacks = kmalloc_stack_helper->resource();
         });
     }
+
+    static Lockable<bool>* lock_statistics_helper;
+
+    if (lock_statistics_helper == nullptr) {
+        lock_statistics_helper = new Lockable<bool>();
+        lock_statistics_helper->resource() = g_lock_statistics_enabled;
+        ProcFS::add_sys_bool("lock_statistics", *lock_statistics_helper, [] {
+            g_lock_statistics_enabled = lock_statistics_helper->resource();
+        });
+    }
+
+    static Lockable<bool>* profile_lock_acquisitions_helper;
+
+    if (profile_lock_acquisitions_helper == nullptr) {
+        profile_lock_acquisitions_helper = new Lockable<bool>();
+        profile_lock_acquisitions_helper->resource() = g_profile_lock_acquisitions;
+        ProcFS::add_sys_bool("profile_lock_acquisitions", *profile_lock_acquisitions_helper, [] {
+            g_profile_lock_acquisitions = profile_lock_acquisitions_helper->resource();
+        });
+    }
+
+    static Lockable<String>* loopback_packet_loss_helper;
+
+    if (loopback_packet_loss_helper == nullptr) {
+        loopback_packet_loss_helper = new Lockable<String>("0");
+        ProcFS::add_sys_string("loopback_packet_loss", *loopback_packet_loss_helper, [] {
+            LOCKER(loopback_packet_loss_helper->lock(), Lock::Mode::Shared);
+            auto percentage = loopback_packet_loss_helper->resource().view().trim_whitespace().to_uint();
+            LoopbackAdapter::the().set_packet_loss_percentage(min(percentage.value_or(0), 100u));
+        });
+    }
     return true;
 }
 
@@ -1689,6 +1860,11 @@ ProcFS::ProcFS()
     m_root_inode = adopt(*new ProcFSInode(*this, 1));
     m_entries.resize(FI_MaxStaticFileIndex);
     m_entries[FI_Root_df] = { "df", FI_Root_df, false, procfs$df };
+    m_entries[FI_Root_fragmentation] = { "fragmentation", FI_Root_fragmentation, false, procfs$fragmentation };
+    m_entries[FI_Root_blockio] = { "blockio", FI_Root_blockio, false, procfs$blockio };
+    m_entries[FI_Root_scheduler] = { "scheduler", FI_Root_scheduler, false, procfs$scheduler };
+    m_entries[FI_Root_buddyinfo] = { "buddyinfo", FI_Root_buddyinfo, false, procfs$buddyinfo };
+    m_entries[FI_Root_locks] = { "locks", FI_Root_locks, false, procfs$locks };
     m_entries[FI_Root_all] = { "all", FI_Root_all, false, procfs$all };
     m_entries[FI_Root_memstat] = { "memstat", FI_Root_memstat, false, procfs$memstat };
     m_entries[FI_Root_cpuinfo] = { "cpuinfo", FI_Root_cpuinfo, false, procfs$cpuinfo };
@@ -26,6 +26,7 @@
 
 #include <AK/Assertions.h>
 #include <AK/Memory.h>
+#include <Kernel/Arch/i386/CPU.h>
 #include <Kernel/Heap/SlabAllocator.h>
 #include <Kernel/Heap/kmalloc.h>
 #include <Kernel/SpinLock.h>
@@ -51,64 +52,78 @@ public:
         }
         slabs[0].next = nullptr;
         m_freelist = &slabs[m_slab_count - 1];
-        m_num_allocated = 0;
+        m_freelist_count = m_slab_count;
     }
 
     constexpr size_t slab_size() const { return templated_slab_size; }
     size_t slab_count() const { return m_slab_count; }
 
-    void* alloc()
+    bool contains(void* ptr) const { return ptr >= m_base && ptr < m_end; }
+
+    // Returns nullptr once all slabs are in use.
+    void* try_alloc()
     {
-        FreeSlab* free_slab;
+        void* ptr = nullptr;
         {
-            // We want to avoid being swapped out in the middle of this
-            ScopedCritical critical;
-            FreeSlab* next_free;
-            free_slab = m_freelist.load(AK::memory_order_consume);
-            do {
-                if (!free_slab)
-                    return kmalloc(slab_size());
-                // It's possible another processor is doing the same thing at
-                // the same time, so next_free *can* be a bogus pointer. However,
-                // in that case compare_exchange_strong would fail and we would
-                // try again.
-                next_free = free_slab->next;
-            } while (!m_freelist.compare_exchange_strong(free_slab, next_free, AK::memory_order_acq_rel));
-
-            m_num_allocated++;
+            // The magazine belongs to this processor, so all we need to do is keep
+            // interrupt handlers from allocating in the middle of this.
+            InterruptDisabler disabler;
+            auto& magazine = m_magazines[Processor::id()];
+            if (magazine.count > 0) {
+                ++magazine.magazine_hits;
+            } else if (!refill(magazine)) {
+                return nullptr;
+            }
+            ptr = magazine.objects[--magazine.count];
+            ++magazine.allocations;
         }
 
 #ifdef SANITIZE_SLABS
-        memset(free_slab, SLAB_ALLOC_SCRUB_BYTE, slab_size());
+        memset(ptr, SLAB_ALLOC_SCRUB_BYTE, slab_size());
 #endif
-        return free_slab;
+        return ptr;
+    }
+
+    void* alloc()
+    {
+        if (auto* ptr = try_alloc())
+            return ptr;
+        return kmalloc(slab_size());
     }
 
     void dealloc(void* ptr)
     {
         VERIFY(ptr);
-        if (ptr < m_base || ptr >= m_end) {
+        if (!contains(ptr)) {
             kfree(ptr);
             return;
         }
-        FreeSlab* free_slab = (FreeSlab*)ptr;
 #ifdef SANITIZE_SLABS
-        if (slab_size() > sizeof(FreeSlab*))
-            memset(free_slab->padding, SLAB_DEALLOC_SCRUB_BYTE, sizeof(FreeSlab::padding));
+        memset(ptr, SLAB_DEALLOC_SCRUB_BYTE, slab_size());
 #endif
 
-        // We want to avoid being swapped out in the middle of this
-        ScopedCritical critical;
-        FreeSlab* next_free = m_freelist.load(AK::memory_order_consume);
-        do {
-            free_slab->next = next_free;
-        } while (!m_freelist.compare_exchange_strong(next_free, free_slab, AK::memory_order_acq_rel));
-
-        m_num_allocated--;
+        InterruptDisabler disabler;
+        auto& magazine = m_magazines[Processor::id()];
+        if (magazine.count == magazine_capacity)
+            flush(magazine);
+        magazine.objects[magazine.count++] = ptr;
+        ++magazine.frees;
     }
 
-    size_t num_allocated() const { return m_num_allocated; }
-    size_t num_free() const { return m_slab_count - m_num_allocated; }
+    SlabAllocatorStatistics statistics() const
+    {
+        SlabAllocatorStatistics statistics;
+        statistics.slab_size = slab_size();
+        for (auto& magazine : m_magazines) {
+            statistics.num_cached += magazine.count;
+            statistics.allocations += magazine.allocations;
+            statistics.frees += magazine.frees;
+            statistics.magazine_hits += magazine.magazine_hits;
+        }
+        statistics.num_free = min(m_freelist_count + statistics.num_cached, m_slab_count);
+        statistics.num_allocated = m_slab_count - statistics.num_free;
+        return statistics;
+    }
 
 private:
     struct FreeSlab {
@@ -116,11 +131,46 @@ private:
         char padding[templated_slab_size - sizeof(FreeSlab*)];
     };
 
-    Atomic<FreeSlab*> m_freelist { nullptr };
-    Atomic<ssize_t, AK::MemoryOrder::memory_order_relaxed> m_num_allocated;
-    size_t m_slab_count;
+    // Each processor keeps a few free slabs of its own, and only goes to the shared
+    // freelist to move half a magazine at a time.
+    static constexpr size_t magazine_capacity = 16;
+    struct Magazine {
+        void* objects[magazine_capacity];
+        size_t count { 0 };
+        size_t allocations { 0 };
+        size_t frees { 0 };
+        size_t magazine_hits { 0 };
+    };
+
+    bool refill(Magazine& magazine)
+    {
+        ScopedSpinLock lock(m_freelist_lock);
+        while (magazine.count < magazine_capacity / 2 && m_freelist) {
+            magazine.objects[magazine.count++] = m_freelist;
+            m_freelist = m_freelist->next;
+            --m_freelist_count;
+        }
+        return magazine.count > 0;
+    }
+
+    void flush(Magazine& magazine)
+    {
+        ScopedSpinLock lock(m_freelist_lock);
+        while (magazine.count > magazine_capacity / 2) {
+            auto* free_slab = (FreeSlab*)magazine.objects[--magazine.count];
+            free_slab->next = m_freelist;
+            m_freelist = free_slab;
+            ++m_freelist_count;
+        }
+    }
+
+    SpinLock<u8> m_freelist_lock;
+    FreeSlab* m_freelist { nullptr };
+    size_t m_freelist_count { 0 };
+    size_t m_slab_count { 0 };
     void* m_base { nullptr };
     void* m_end { nullptr };
+    Magazine m_magazines[Processor::max_count];
 
     static_assert(sizeof(FreeSlab) == templated_slab_size);
 };
@@ -129,6 +179,8 @@ static SlabAllocator<16> s_slab_allocator_16;
 static SlabAllocator<32> s_slab_allocator_32;
 static SlabAllocator<64> s_slab_allocator_64;
 static SlabAllocator<128> s_slab_allocator_128;
+static SlabAllocator<256> s_slab_allocator_256;
+static SlabAllocator<512> s_slab_allocator_512;
 
 #if ARCH(I386)
 static_assert(sizeof(Region) <= s_slab_allocator_128.slab_size());
@@ -141,14 +193,18 @@ void for_each_allocator(Callback callback)
     callback(s_slab_allocator_32);
     callback(s_slab_allocator_64);
     callback(s_slab_allocator_128);
+    callback(s_slab_allocator_256);
+    callback(s_slab_allocator_512);
 }
 
 UNMAP_AFTER_INIT void slab_alloc_init()
 {
     s_slab_allocator_16.init(128 * KiB);
     s_slab_allocator_32.init(128 * KiB);
-    s_slab_allocator_64.init(512 * KiB);
-    s_slab_allocator_128.init(512 * KiB);
+    s_slab_allocator_64.init(384 * KiB);
+    s_slab_allocator_128.init(384 * KiB);
+    s_slab_allocator_256.init(128 * KiB);
+    s_slab_allocator_512.init(128 * KiB);
 }
 
 void* slab_alloc(size_t slab_size)
@@ -161,6 +217,10 @@ void* slab_alloc(size_t slab_size)
         return s_slab_allocator_64.alloc();
     if (slab_size <= 128)
         return s_slab_allocator_128.alloc();
+    if (slab_size <= 256)
+        return s_slab_allocator_256.alloc();
+    if (slab_size <= 512)
+        return s_slab_allocator_512.alloc();
     VERIFY_NOT_REACHED();
 }
 
@@ -174,15 +234,56 @@ void slab_dealloc(void* ptr, size_t slab_size)
         return s_slab_allocator_64.dealloc(ptr);
     if (slab_size <= 128)
         return s_slab_allocator_128.dealloc(ptr);
+    if (slab_size <= 256)
+        return s_slab_allocator_256.dealloc(ptr);
+    if (slab_size <= 512)
+        return s_slab_allocator_512.dealloc(ptr);
     VERIFY_NOT_REACHED();
 }
 
-void slab_alloc_stats(Function<void(size_t slab_size, size_t allocated, size_t free)> callback)
+void* slab_try_alloc(size_t size)
+{
+    if (size <= 16)
+        return s_slab_allocator_16.try_alloc();
+    if (size <= 32)
+        return s_slab_allocator_32.try_alloc();
+    if (size <= 64)
+        return s_slab_allocator_64.try_alloc();
+    if (size <= 128)
+        return s_slab_allocator_128.try_alloc();
+    if (size <= 256)
+        return s_slab_allocator_256.try_alloc();
+    if (size <= 512)
+        return s_slab_allocator_512.try_alloc();
+    return nullptr;
+}
+
+size_t slab_size_of(void* ptr)
+{
+    size_t slab_size = 0;
+    for_each_allocator([&](auto& allocator) {
+        if (allocator.contains(ptr))
+            slab_size = allocator.slab_size();
+    });
+    return slab_size;
+}
+
+bool slab_try_dealloc(void* ptr)
+{
+    bool did_dealloc = false;
+    for_each_allocator([&](auto& allocator) {
+        if (!did_dealloc && allocator.contains(ptr)) {
+            allocator.dealloc(ptr);
+            did_dealloc = true;
+        }
+    });
+    return did_dealloc;
+}
+
+void slab_alloc_stats(Function<void(const SlabAllocatorStatistics&)> callback)
 {
     for_each_allocator([&](auto& allocator) {
-        auto num_allocated = allocator.num_allocated();
-        auto num_free = allocator.slab_count() - num_allocated;
-        callback(allocator.slab_size(), num_allocated, num_free);
+        callback(allocator.statistics());
     });
 }
 
@@ -34,10 +34,25 @@ namespace Kernel {
 #define SLAB_ALLOC_SCRUB_BYTE 0xab
 #define SLAB_DEALLOC_SCRUB_BYTE 0xbc
 
+struct SlabAllocatorStatistics {
+    size_t slab_size { 0 };
+    size_t num_allocated { 0 };
+    size_t num_free { 0 };
+    size_t num_cached { 0 };
+    size_t allocations { 0 };
+    size_t frees { 0 };
+    size_t magazine_hits { 0 };
+};
+
 void* slab_alloc(size_t slab_size);
 void slab_dealloc(void*, size_t slab_size);
 void slab_alloc_init();
-void slab_alloc_stats(Function<void(size_t slab_size, size_t allocated, size_t free)>);
+void slab_alloc_stats(Function<void(const SlabAllocatorStatistics&)>);
+
+// Used by kmalloc() to serve small allocations from the slab allocators.
+void* slab_try_alloc(size_t size);
+bool slab_try_dealloc(void*);
+size_t slab_size_of(void*);
 
 #define MAKE_SLAB_ALLOCATED(type)                                        \
 public:                                                                  \
@@ -36,6 +36,7 @@
 #include <AK/Types.h>
 #include <Kernel/Arch/i386/CPU.h>
 #include <Kernel/Heap/Heap.h>
+#include <Kernel/Heap/SlabAllocator.h>
 #include <Kernel/Heap/kmalloc.h>
 #include <Kernel/KSyms.h>
 #include <Kernel/Panic.h>
@@ -238,6 +239,13 @@ void* kmalloc_eternal(size_t size)
 
 void* kmalloc_impl(size_t size)
 {
+    // NOTE: Small allocations are served from the per-processor slab magazines
+    //       without touching s_lock, unless we want to see where they come from.
+    if (!g_dump_kmalloc_stacks) {
+        if (auto* ptr = Kernel::slab_try_alloc(size))
+            return ptr;
+    }
+
     ScopedSpinLock lock(s_lock);
     ++g_kmalloc_call_count;
 
@@ -259,6 +267,9 @@ void kfree(void* ptr)
     if (!ptr)
         return;
 
+    if (Kernel::slab_try_dealloc(ptr))
+        return;
+
     ScopedSpinLock lock(s_lock);
     ++g_kfree_call_count;
 
@@ -267,6 +278,15 @@ void kfree(void* ptr)
 
 void* krealloc(void* ptr, size_t new_size)
 {
+    if (auto slab_size = Kernel::slab_size_of(ptr)) {
+        if (new_size <= slab_size)
+            return ptr;
+        void* new_ptr = kmalloc(new_size);
+        memcpy(new_ptr, ptr, slab_size);
+        kfree(ptr);
+        return new_ptr;
+    }
+
     ScopedSpinLock lock(s_lock);
     return g_kmalloc_global->m_heap.reallocate(ptr, new_size);
 }
@@ -289,4 +309,8 @@ void get_kmalloc_stats(kmalloc_stats& stats)
     stats.bytes_eternal = g_kmalloc_bytes_eternal;
     stats.kmalloc_call_count = g_kmalloc_call_count;
     stats.kfree_call_count = g_kfree_call_count;
+    Kernel::slab_alloc_stats([&](auto& slab) {
+        stats.kmalloc_call_count += slab.allocations;
+        stats.kfree_call_count += slab.frees;
+    });
 }
@@ -606,6 +606,7 @@ void APICIPIInterruptHandler::handle_interrupt(const RegisterState&)
 #if APIC_SMP_DEBUG
     klog() << "APIC IPI on cpu #" << Processor::id();
 #endif
+    Processor::current().did_receive_ipi();
 }
 
 bool APICIPIInterruptHandler::eoi()
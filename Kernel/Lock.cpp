@@ -28,10 +28,143 @@
 #include <Kernel/Debug.h>
 #include <Kernel/KSyms.h>
 #include <Kernel/Lock.h>
+#include <Kernel/PerformanceEventBuffer.h>
+#include <Kernel/Process.h>
 #include <Kernel/Thread.h>
+#include <Kernel/Time/TimeManagement.h>
 
 namespace Kernel {
 
+bool g_lock_statistics_enabled;
+// NOTE: Off by default, since the big lock alone is taken on every syscall and each
+//       acquisition event would fill the profile with a backtrace.
+bool g_profile_lock_acquisitions;
+
+static constexpr size_t lock_statistics_capacity = 256;
+static LockStatistics s_lock_statistics[lock_statistics_capacity];
+
+static LockStatistics* lock_statistics_for(const char* name)
+{
+    if (!name)
+        name = "(unnamed)";
+    auto hash = ptr_hash(name);
+    for (size_t i = 0; i < lock_statistics_capacity; ++i) {
+        auto& entry = s_lock_statistics[(hash + i) % lock_statistics_capacity];
+        const char* entry_name = entry.name.load(AK::MemoryOrder::memory_order_acquire);
+        if (!entry_name && entry.name.compare_exchange_strong(entry_name, name, AK::MemoryOrder::memory_order_acq_rel))
+            return &entry;
+        if (entry_name == name)
+            return &entry;
+    }
+    // NOTE: The table is full, so this lock just doesn't get counted.
+    return nullptr;
+}
+
+void Lock::for_each_statistics(Function<void(const LockStatistics&)> callback)
+{
+    for (auto& entry : s_lock_statistics) {
+        if (entry.name.load(AK::MemoryOrder::memory_order_acquire))
+            callback(entry);
+    }
+}
+
+static u64 monotonic_time_ns()
+{
+    auto now = TimeManagement::the().monotonic_time(TimePrecision::Precise);
+    return (u64)now.tv_sec * 1'000'000'000 + now.tv_nsec;
+}
+
+bool Lock::try_lock(Mode mode, Thread* current_thread, u32 count)
+{
+    if (mode == Mode::Exclusive) {
+        u32 expected = 0;
+        if (!m_state.compare_exchange_strong(expected, exclusive_bit, AK::MemoryOrder::memory_order_acquire))
+            return false;
+        VERIFY(!m_holder.load(AK::MemoryOrder::memory_order_relaxed));
+        VERIFY(m_times_locked == 0);
+        m_holder.store(current_thread, AK::MemoryOrder::memory_order_relaxed);
+        m_times_locked = count;
+        return true;
+    }
+
+    VERIFY(mode == Mode::Shared);
+    u32 state = m_state.load(AK::MemoryOrder::memory_order_relaxed);
+    for (;;) {
+        if (state & exclusive_bit)
+            return false;
+        // Let queued writers go first while other readers still hold the lock, unless
+        // we are one of those readers, since the writers would be waiting for us.
+        if (state != 0 && m_exclusive_waiters.load() != 0 && current_thread && !current_thread->holds_shared_lock(*this))
+            return false;
+        VERIFY(((state + count) & shared_count_mask) > state);
+        if (m_state.compare_exchange_strong(state, state + count, AK::MemoryOrder::memory_order_acquire)) {
+            if (current_thread)
+                current_thread->add_shared_lock_hold(*this, count);
+            return true;
+        }
+    }
+}
+
+bool Lock::try_lock_spinning(Mode mode, Thread* current_thread, u32 count)
+{
+    // Spin while the exclusive holder is running, it's likely to let go soon.
+    for (u32 i = 0; i < max_spin_iterations; ++i) {
+        auto* holder = m_holder.load(AK::MemoryOrder::memory_order_relaxed);
+        if (!holder || !Processor::is_thread_running_on_other_processor(*holder))
+            return false;
+        Processor::wait_check();
+        if (try_lock(mode, current_thread, count))
+            return true;
+    }
+    return false;
+}
+
+void Lock::lock_slow(Mode mode, Thread* current_thread, u32 count)
+{
+    auto* statistics = g_lock_statistics_enabled ? lock_statistics_for(m_name) : nullptr;
+    bool is_profiling = current_thread && current_thread->process().is_profiling();
+    u64 wait_start = (statistics || is_profiling) ? monotonic_time_ns() : 0;
+
+    if (mode == Mode::Exclusive)
+        m_exclusive_waiters++;
+
+    while (!try_lock_spinning(mode, current_thread, count)) {
+        // NOTE: Whoever unlocks after we've registered as a waiter is going to wake us.
+        m_waiters++;
+        if (try_lock(mode, current_thread, count)) {
+            m_waiters--;
+            break;
+        }
+        dbgln_if(LOCK_TRACE_DEBUG, "Lock::lock @ {} ({}) waiting...", this, m_name);
+        m_queue.wait_forever(m_name);
+        dbgln_if(LOCK_TRACE_DEBUG, "Lock::lock @ {} ({}) waited", this, m_name);
+        m_waiters--;
+        if (try_lock(mode, current_thread, count))
+            break;
+    }
+
+    if (mode == Mode::Exclusive)
+        m_exclusive_waiters--;
+
+    if (statistics || is_profiling) {
+        u64 wait_time_ns = monotonic_time_ns() - wait_start;
+        if (statistics) {
+            statistics->contentions++;
+            statistics->wait_time_ns += wait_time_ns;
+        }
+        if (is_profiling)
+            PerformanceEventBuffer::record_lock_event(PERF_EVENT_LOCK_CONTENTION, this, m_name, wait_time_ns);
+    }
+}
+
+void Lock::wake_waiters()
+{
+    if (m_waiters.load() == 0)
+        return;
+    u32 did_wake = m_queue.wake_all();
+    dbgln_if(LOCK_TRACE_DEBUG, "Lock::unlock @ {} ({}) wake all ({})", this, m_name, did_wake);
+}
+
 #if LOCK_DEBUG
 void Lock::lock(Mode mode)
 {
@@ -49,87 +182,27 @@ void Lock::lock(Mode mode)
     VERIFY(mode != Mode::Unlocked);
     auto current_thread = Thread::current();
     ScopedCritical critical; // in case we're not in a critical section already
-    for (;;) {
-        if (m_lock.exchange(true, AK::memory_order_acq_rel) != false) {
-            // I don't know *who* is using "m_lock", so just yield.
-            Scheduler::yield_from_critical();
-            continue;
-        }
 
-        // FIXME: Do not add new readers if writers are queued.
-        Mode current_mode = m_mode;
-        switch (current_mode) {
-        case Mode::Unlocked: {
-            dbgln_if(LOCK_TRACE_DEBUG, "Lock::lock @ ({}) {}: acquire {}, currently unlocked", this, m_name, mode_to_string(mode));
-            m_mode = mode;
-            VERIFY(!m_holder);
-            VERIFY(m_shared_holders.is_empty());
-            if (mode == Mode::Exclusive) {
-                m_holder = current_thread;
-            } else {
-                VERIFY(mode == Mode::Shared);
-                m_shared_holders.set(current_thread, 1);
-            }
-            VERIFY(m_times_locked == 0);
-            m_times_locked++;
-#if LOCK_DEBUG
-            current_thread->holding_lock(*this, 1, file, line);
-#endif
-            m_queue.should_block(true);
-            m_lock.store(false, AK::memory_order_release);
-            return;
-        }
-        case Mode::Exclusive: {
-            VERIFY(m_holder);
-            if (m_holder != current_thread)
-                break;
-            VERIFY(m_shared_holders.is_empty());
-
-            if constexpr (LOCK_TRACE_DEBUG) {
-                if (mode == Mode::Exclusive)
-                    dbgln("Lock::lock @ {} ({}): acquire {}, currently exclusive, holding: {}", this, m_name, mode_to_string(mode), m_times_locked);
-                else
-                    dbgln("Lock::lock @ {} ({}): acquire exclusive (requested {}), currently exclusive, holding: {}", this, m_name, mode_to_string(mode), m_times_locked);
-            }
-
-            VERIFY(mode == Mode::Exclusive || mode == Mode::Shared);
-            VERIFY(m_times_locked > 0);
-            m_times_locked++;
-#if LOCK_DEBUG
-            current_thread->holding_lock(*this, 1, file, line);
-#endif
-            m_lock.store(false, AK::memory_order_release);
-            return;
-        }
-        case Mode::Shared: {
-            VERIFY(!m_holder);
-            if (mode != Mode::Shared)
-                break;
-
-            dbgln_if(LOCK_TRACE_DEBUG, "Lock::lock @ {} ({}): acquire {}, currently shared, locks held {}", this, m_name, mode_to_string(mode), m_times_locked);
-
-            VERIFY(m_times_locked > 0);
-            m_times_locked++;
-            VERIFY(!m_shared_holders.is_empty());
-            auto it = m_shared_holders.find(current_thread);
-            if (it != m_shared_holders.end())
-                it->value++;
-            else
-                m_shared_holders.set(current_thread, 1);
+    if (g_lock_statistics_enabled) {
+        if (auto* statistics = lock_statistics_for(m_name))
+            statistics->acquisitions++;
+    }
+
+    if (is_exclusively_held_by(current_thread)) {
+        // We already hold the lock exclusively, which also covers shared requests.
+        dbgln_if(LOCK_TRACE_DEBUG, "Lock::lock @ {} ({}): acquire {}, currently exclusive, holding: {}", this, m_name, mode_to_string(mode), m_times_locked);
+        VERIFY(m_times_locked > 0);
+        m_times_locked++;
+    } else if (!try_lock(mode, current_thread, 1)) {
+        lock_slow(mode, current_thread, 1);
+    }
+
+    dbgln_if(LOCK_TRACE_DEBUG, "Lock::lock @ {} ({}): acquired {}", this, m_name, mode_to_string(mode));
+    if (g_profile_lock_acquisitions && current_thread && current_thread->process().is_profiling())
+        PerformanceEventBuffer::record_lock_event(PERF_EVENT_LOCK_ACQUIRE, this, m_name);
 #if LOCK_DEBUG
-            current_thread->holding_lock(*this, 1, file, line);
+    current_thread->holding_lock(*this, 1, file, line);
 #endif
-            m_lock.store(false, AK::memory_order_release);
-            return;
-        }
-        default:
-            VERIFY_NOT_REACHED();
-        }
-        m_lock.store(false, AK::memory_order_release);
-        dbgln_if(LOCK_TRACE_DEBUG, "Lock::lock @ {} ({}) waiting...", this, m_name);
-        m_queue.wait_forever(m_name);
-        dbgln_if(LOCK_TRACE_DEBUG, "Lock::lock @ {} ({}) waited", this, m_name);
-    }
 }
 
 void Lock::unlock()
@@ -139,65 +212,30 @@ void Lock::unlock()
     VERIFY(!Processor::current().in_irq());
     auto current_thread = Thread::current();
     ScopedCritical critical; // in case we're not in a critical section already
-    for (;;) {
-        if (m_lock.exchange(true, AK::memory_order_acq_rel) == false) {
-            Mode current_mode = m_mode;
-            if constexpr (LOCK_TRACE_DEBUG) {
-                if (current_mode == Mode::Shared)
-                    dbgln("Lock::unlock @ {} ({}): release {}, locks held: {}", this, m_name, mode_to_string(current_mode), m_times_locked);
-                else
-                    dbgln("Lock::unlock @ {} ({}): release {}, holding: {}", this, m_name, mode_to_string(current_mode), m_times_locked);
-            }
-
-            VERIFY(current_mode != Mode::Unlocked);
-
-            VERIFY(m_times_locked > 0);
-            m_times_locked--;
-
-            switch (current_mode) {
-            case Mode::Exclusive:
-                VERIFY(m_holder == current_thread);
-                VERIFY(m_shared_holders.is_empty());
-                if (m_times_locked == 0)
-                    m_holder = nullptr;
-                break;
-            case Mode::Shared: {
-                VERIFY(!m_holder);
-                auto it = m_shared_holders.find(current_thread);
-                VERIFY(it != m_shared_holders.end());
-                if (it->value > 1) {
-                    it->value--;
-                } else {
-                    VERIFY(it->value > 0);
-                    m_shared_holders.remove(it);
-                }
-                break;
-            }
-            default:
-                VERIFY_NOT_REACHED();
-            }
-
-            bool unlocked_last = (m_times_locked == 0);
-            if (unlocked_last) {
-                VERIFY(current_mode == Mode::Exclusive ? !m_holder : m_shared_holders.is_empty());
-                m_mode = Mode::Unlocked;
-                m_queue.should_block(false);
-            }
 
 #if LOCK_DEBUG
-            current_thread->holding_lock(*this, -1);
+    current_thread->holding_lock(*this, -1);
 #endif
 
-            m_lock.store(false, AK::memory_order_release);
-            if (unlocked_last) {
-                u32 did_wake = m_queue.wake_one();
-                dbgln_if(LOCK_TRACE_DEBUG, "Lock::unlock @ {} ({})  wake one ({})", this, m_name, did_wake);
-            }
+    if (is_exclusively_held_by(current_thread)) {
+        dbgln_if(LOCK_TRACE_DEBUG, "Lock::unlock @ {} ({}): release exclusive, holding: {}", this, m_name, m_times_locked);
+        VERIFY(m_times_locked > 0);
+        if (--m_times_locked > 0)
             return;
-        }
-        // I don't know *who* is using "m_lock", so just yield.
-        Scheduler::yield_from_critical();
+        m_holder.store(nullptr, AK::MemoryOrder::memory_order_relaxed);
+        m_state.store(0, AK::MemoryOrder::memory_order_seq_cst);
+        wake_waiters();
+        return;
     }
+
+    if (current_thread)
+        current_thread->remove_shared_lock_hold(*this);
+    auto previous_state = m_state.fetch_sub(1, AK::MemoryOrder::memory_order_seq_cst);
+    dbgln_if(LOCK_TRACE_DEBUG, "Lock::unlock @ {} ({}): release shared, locks held: {}", this, m_name, previous_state);
+    VERIFY(!(previous_state & exclusive_bit));
+    VERIFY(previous_state > 0);
+    if (previous_state == 1)
+        wake_waiters();
 }
 
 auto Lock::force_unlock_if_locked(u32& lock_count_to_restore) -> Mode
@@ -207,76 +245,35 @@ auto Lock::force_unlock_if_locked(u32& lock_count_to_restore) -> Mode
     VERIFY(!Processor::current().in_irq());
     auto current_thread = Thread::current();
     ScopedCritical critical; // in case we're not in a critical section already
-    for (;;) {
-        if (m_lock.exchange(true, AK::memory_order_acq_rel) == false) {
-            Mode previous_mode;
-            auto current_mode = m_mode.load(AK::MemoryOrder::memory_order_relaxed);
-            switch (current_mode) {
-            case Mode::Exclusive: {
-                if (m_holder != current_thread) {
-                    m_lock.store(false, AK::MemoryOrder::memory_order_release);
-                    lock_count_to_restore = 0;
-                    return Mode::Unlocked;
-                }
-
-                dbgln_if(LOCK_RESTORE_DEBUG, "Lock::force_unlock_if_locked @ {}: unlocking exclusive with lock count: {}", this, m_times_locked);
+
+    if (is_exclusively_held_by(current_thread)) {
+        dbgln_if(LOCK_RESTORE_DEBUG, "Lock::force_unlock_if_locked @ {}: unlocking exclusive with lock count: {}", this, m_times_locked);
+        VERIFY(m_times_locked > 0);
+        lock_count_to_restore = m_times_locked;
 #if LOCK_DEBUG
-                m_holder->holding_lock(*this, -(int)lock_count_to_restore);
+        current_thread->holding_lock(*this, -(int)lock_count_to_restore);
 #endif
-                m_holder = nullptr;
-                VERIFY(m_times_locked > 0);
-                lock_count_to_restore = m_times_locked;
-                m_times_locked = 0;
-                m_mode = Mode::Unlocked;
-                m_queue.should_block(false);
-                m_lock.store(false, AK::memory_order_release);
-                previous_mode = Mode::Exclusive;
-                break;
-            }
-            case Mode::Shared: {
-                VERIFY(!m_holder);
-                auto it = m_shared_holders.find(current_thread);
-                if (it == m_shared_holders.end()) {
-                    m_lock.store(false, AK::MemoryOrder::memory_order_release);
-                    lock_count_to_restore = 0;
-                    return Mode::Unlocked;
-                }
-
-                dbgln_if(LOCK_RESTORE_DEBUG, "Lock::force_unlock_if_locked @ {}: unlocking exclusive with lock count: {}, total locks: {}",
-                    this, it->value, m_times_locked);
-
-                VERIFY(it->value > 0);
-                lock_count_to_restore = it->value;
-                VERIFY(lock_count_to_restore > 0);
+        m_times_locked = 0;
+        m_holder.store(nullptr, AK::MemoryOrder::memory_order_relaxed);
+        m_state.store(0, AK::MemoryOrder::memory_order_seq_cst);
+        wake_waiters();
+        return Mode::Exclusive;
+    }
+
+    lock_count_to_restore = current_thread ? current_thread->take_shared_lock_holds(*this) : 0;
+    if (lock_count_to_restore == 0)
+        return Mode::Unlocked;
+
+    dbgln_if(LOCK_RESTORE_DEBUG, "Lock::force_unlock_if_locked @ {}: unlocking shared with lock count: {}", this, lock_count_to_restore);
 #if LOCK_DEBUG
-                m_holder->holding_lock(*this, -(int)lock_count_to_restore);
+    current_thread->holding_lock(*this, -(int)lock_count_to_restore);
 #endif
-                m_shared_holders.remove(it);
-                VERIFY(m_times_locked >= lock_count_to_restore);
-                m_times_locked -= lock_count_to_restore;
-                if (m_times_locked == 0) {
-                    m_mode = Mode::Unlocked;
-                    m_queue.should_block(false);
-                }
-                m_lock.store(false, AK::memory_order_release);
-                previous_mode = Mode::Shared;
-                break;
-            }
-            case Mode::Unlocked: {
-                m_lock.store(false, AK::memory_order_relaxed);
-                lock_count_to_restore = 0;
-                previous_mode = Mode::Unlocked;
-                break;
-            }
-            default:
-                VERIFY_NOT_REACHED();
-            }
-            m_queue.wake_one();
-            return previous_mode;
-        }
-        // I don't know *who* is using "m_lock", so just yield.
-        Scheduler::yield_from_critical();
-    }
+    auto previous_state = m_state.fetch_sub(lock_count_to_restore, AK::MemoryOrder::memory_order_seq_cst);
+    VERIFY(!(previous_state & exclusive_bit));
+    VERIFY(previous_state >= lock_count_to_restore);
+    if (previous_state == lock_count_to_restore)
+        wake_waiters();
+    return Mode::Shared;
 }
 
 #if LOCK_DEBUG
@@ -295,64 +292,19 @@ void Lock::restore_lock(Mode mode, u32 lock_count)
     VERIFY(!Processor::current().in_irq());
     auto current_thread = Thread::current();
     ScopedCritical critical; // in case we're not in a critical section already
-    for (;;) {
-        if (m_lock.exchange(true, AK::memory_order_acq_rel) == false) {
-            switch (mode) {
-            case Mode::Exclusive: {
-                auto expected_mode = Mode::Unlocked;
-                if (!m_mode.compare_exchange_strong(expected_mode, Mode::Exclusive))
-                    break;
-
-                dbgln_if(LOCK_RESTORE_DEBUG, "Lock::restore_lock @ {}: restoring {} with lock count {}, was unlocked", this, mode_to_string(mode), lock_count);
-
-                VERIFY(m_times_locked == 0);
-                m_times_locked = lock_count;
-                VERIFY(!m_holder);
-                VERIFY(m_shared_holders.is_empty());
-                m_holder = current_thread;
-                m_queue.should_block(true);
-                m_lock.store(false, AK::memory_order_release);
-#if LOCK_DEBUG
-                m_holder->holding_lock(*this, (int)lock_count, file, line);
-#endif
-                return;
-            }
-            case Mode::Shared: {
-                auto expected_mode = Mode::Unlocked;
-                if (!m_mode.compare_exchange_strong(expected_mode, Mode::Shared) && expected_mode != Mode::Shared)
-                    break;
-
-                dbgln_if(LOCK_RESTORE_DEBUG, "Lock::restore_lock @ {}: restoring {} with lock count {}, was {}",
-                    this, mode_to_string(mode), lock_count, mode_to_string(expected_mode));
-
-                VERIFY(expected_mode == Mode::Shared || m_times_locked == 0);
-                m_times_locked += lock_count;
-                VERIFY(!m_holder);
-                VERIFY((expected_mode == Mode::Unlocked) == m_shared_holders.is_empty());
-                auto set_result = m_shared_holders.set(current_thread, lock_count);
-                // There may be other shared lock holders already, but we should not have an entry yet
-                VERIFY(set_result == AK::HashSetResult::InsertedNewEntry);
-                m_queue.should_block(true);
-                m_lock.store(false, AK::memory_order_release);
+
+    dbgln_if(LOCK_RESTORE_DEBUG, "Lock::restore_lock @ {}: restoring {} with lock count {}", this, mode_to_string(mode), lock_count);
+    VERIFY(!is_exclusively_held_by(current_thread));
+    if (!try_lock(mode, current_thread, lock_count))
+        lock_slow(mode, current_thread, lock_count);
 #if LOCK_DEBUG
-                m_holder->holding_lock(*this, (int)lock_count, file, line);
+    current_thread->holding_lock(*this, (int)lock_count, file, line);
 #endif
-                return;
-            }
-            default:
-                VERIFY_NOT_REACHED();
-            }
-
-            m_lock.store(false, AK::memory_order_relaxed);
-        }
-        // I don't know *who* is using "m_lock", so just yield.
-        Scheduler::yield_from_critical();
-    }
 }
 
 void Lock::clear_waiters()
 {
-    VERIFY(m_mode != Mode::Shared);
+    VERIFY(!(m_state.load() & shared_count_mask));
     m_queue.wake_all();
 }
 
@@ -28,7 +28,7 @@
 
 #include <AK/Assertions.h>
 #include <AK/Atomic.h>
-#include <AK/HashMap.h>
+#include <AK/Function.h>
 #include <AK/Types.h>
 #include <Kernel/Arch/i386/CPU.h>
 #include <Kernel/Forward.h>
@@ -37,6 +37,16 @@
 
 namespace Kernel {
 
+struct LockStatistics {
+    Atomic<const char*> name { nullptr };
+    Atomic<u64, AK::MemoryOrder::memory_order_relaxed> acquisitions { 0 };
+    Atomic<u64, AK::MemoryOrder::memory_order_relaxed> contentions { 0 };
+    Atomic<u64, AK::MemoryOrder::memory_order_relaxed> wait_time_ns { 0 };
+};
+
+extern bool g_lock_statistics_enabled;
+extern bool g_profile_lock_acquisitions;
+
 class Lock {
     AK_MAKE_NONCOPYABLE(Lock);
     AK_MAKE_NONMOVABLE(Lock);
@@ -58,7 +68,7 @@ public:
     void unlock();
     [[nodiscard]] Mode force_unlock_if_locked(u32&);
     void restore_lock(Mode, u32);
-    [[nodiscard]] bool is_locked() const { return m_mode != Mode::Unlocked; }
+    [[nodiscard]] bool is_locked() const { return m_state.load(AK::MemoryOrder::memory_order_relaxed) != 0; }
     void clear_waiters();
 
     [[nodiscard]] const char* name() const { return m_name; }
@@ -77,23 +87,37 @@ public:
         }
     }
 
+    // Statistics are collected per lock name while g_lock_statistics_enabled is set.
+    static void for_each_statistics(Function<void(const LockStatistics&)>);
+
 private:
-    Atomic<bool> m_lock { false };
+    static constexpr u32 exclusive_bit = 1u << 31;
+    static constexpr u32 shared_count_mask = ~exclusive_bit;
+    static constexpr u32 max_spin_iterations = 1000;
+
+    bool is_exclusively_held_by(const Thread* thread) const
+    {
+        return (m_state.load(AK::MemoryOrder::memory_order_relaxed) & exclusive_bit) && m_holder.load(AK::MemoryOrder::memory_order_relaxed) == thread;
+    }
+
+    bool try_lock(Mode, Thread*, u32 count);
+    bool try_lock_spinning(Mode, Thread*, u32 count);
+    void lock_slow(Mode, Thread*, u32 count);
+    void wake_waiters();
+
     const char* m_name { nullptr };
     WaitQueue m_queue;
-    Atomic<Mode, AK::MemoryOrder::memory_order_relaxed> m_mode { Mode::Unlocked };
 
-    // When locked exclusively, only the thread already holding the lock can
-    // lock it again. When locked in shared mode, any thread can do that.
-    u32 m_times_locked { 0 };
+    // Either exclusive_bit, or the number of outstanding shared holds.
+    Atomic<u32> m_state { 0 };
+    Atomic<u32> m_waiters { 0 };
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> m_exclusive_waiters { 0 };
 
-    // One of the threads that hold this lock, or nullptr. When locked in shared
-    // mode, this is stored on best effort basis: nullptr value does *not* mean
-    // the lock is unlocked, it just means we don't know which threads hold it.
-    // When locked exclusively, this is always the one thread that holds the
-    // lock.
-    RefPtr<Thread> m_holder;
-    HashMap<Thread*, u32> m_shared_holders;
+    // When locked exclusively, this is the one thread that holds the lock, and
+    // the number of times it has locked it. Shared holders are tracked by the
+    // threads themselves (see Thread::add_shared_lock_hold()).
+    Atomic<Thread*> m_holder { nullptr };
+    u32 m_times_locked { 0 };
 };
 
 class Locker {
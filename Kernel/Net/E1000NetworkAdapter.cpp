@@ -25,6 +25,7 @@
  */
 
 #include <AK/MACAddress.h>
+#include <Kernel/CommandLine.h>
 #include <Kernel/Debug.h>
 #include <Kernel/IO.h>
 #include <Kernel/Net/E1000NetworkAdapter.h>
@@ -139,8 +140,43 @@ namespace Kernel {
 #define INTERRUPT_PHYINT (1 << 12)
 #define INTERRUPT_TXD_LOW (1 << 15)
 #define INTERRUPT_SRPD (1 << 16)
+
+#define RSTA_DD (1 << 0)  // Descriptor Done
+#define RSTA_EOP (1 << 1) // End of Packet
 // clang-format on
 
+// All of these mean "there is something in the RX ring", and all of them are masked while we poll.
+static constexpr u32 receive_interrupts = INTERRUPT_RXT0 | INTERRUPT_RXO | INTERRUPT_RXDMT0;
+
+// The ring lengths have to be a multiple of 128 bytes, i.e. 8 descriptors.
+static constexpr size_t minimum_descriptor_count = 8;
+static constexpr size_t maximum_descriptor_count = 4096;
+
+static constexpr u32 default_interrupts_per_second = 20000;
+
+static size_t descriptor_count_from_command_line(const String& key, size_t default_count)
+{
+    auto value = kernel_command_line().lookup(key);
+    if (!value.has_value())
+        return default_count;
+    auto count = value.value().to_uint();
+    if (!count.has_value()) {
+        dmesgln("E1000: Ignoring invalid {}={}", key, value.value());
+        return default_count;
+    }
+    size_t clamped_count = min(max((size_t)count.value(), minimum_descriptor_count), maximum_descriptor_count);
+    return clamped_count - (clamped_count % minimum_descriptor_count);
+}
+
+static u32 interrupt_throttle_from_command_line()
+{
+    auto interrupts_per_second = kernel_command_line().lookup("e1000_itr").value_or("").to_uint().value_or(default_interrupts_per_second);
+    if (interrupts_per_second == 0)
+        return 0;
+    // ITR is the minimum gap between two interrupts, in units of 256 nanoseconds.
+    return max(1000000000u / (interrupts_per_second * 256u), 1u);
+}
+
 // https://www.intel.com/content/dam/doc/manual/pci-pci-x-family-gbe-controllers-software-dev-manual.pdf Section 5.2
 static bool is_valid_device_id(u16 device_id)
 {
@@ -196,8 +232,10 @@ UNMAP_AFTER_INIT void E1000NetworkAdapter::detect()
 UNMAP_AFTER_INIT E1000NetworkAdapter::E1000NetworkAdapter(PCI::Address address, u8 irq)
     : PCI::Device(address, irq)
     , m_io_base(PCI::get_BAR1(pci_address()) & ~1)
-    , m_rx_descriptors_region(MM.allocate_contiguous_kernel_region(page_round_up(sizeof(e1000_rx_desc) * number_of_rx_descriptors + 16), "E1000 RX", Region::Access::Read | Region::Access::Write))
-    , m_tx_descriptors_region(MM.allocate_contiguous_kernel_region(page_round_up(sizeof(e1000_tx_desc) * number_of_tx_descriptors + 16), "E1000 TX", Region::Access::Read | Region::Access::Write))
+    , m_rx_descriptor_count(descriptor_count_from_command_line("e1000_rx_descriptors", default_rx_descriptor_count))
+    , m_tx_descriptor_count(descriptor_count_from_command_line("e1000_tx_descriptors", default_tx_descriptor_count))
+    , m_rx_descriptors_region(MM.allocate_contiguous_kernel_region(page_round_up(sizeof(e1000_rx_desc) * m_rx_descriptor_count + 16), "E1000 RX", Region::Access::Read | Region::Access::Write))
+    , m_tx_descriptors_region(MM.allocate_contiguous_kernel_region(page_round_up(sizeof(e1000_tx_desc) * m_tx_descriptor_count + 16), "E1000 TX", Region::Access::Read | Region::Access::Write))
 {
     set_interface_name("e1k");
 
@@ -223,13 +261,19 @@ UNMAP_AFTER_INIT E1000NetworkAdapter::E1000NetworkAdapter(PCI::Address address,
     u32 flags = in32(REG_CTRL);
     out32(REG_CTRL, flags | ECTRL_SLU);
 
-    out32(REG_INTERRUPT_RATE, 6000); // Interrupt rate of 1.536 milliseconds
+    u32 interrupt_throttle = interrupt_throttle_from_command_line();
+    out32(REG_INTERRUPT_RATE, interrupt_throttle);
+    // Let a few frames accumulate before the RX timer fires, but never hold one back for more than ~64us.
+    out32(REG_RDTR, 16);
+    out32(REG_RADV, 64);
 
     initialize_rx_descriptors();
     initialize_tx_descriptors();
 
-    out32(REG_INTERRUPT_MASK_SET, 0x1f6dc);
-    out32(REG_INTERRUPT_MASK_SET, INTERRUPT_LSC | INTERRUPT_RXT0);
+    klog() << "E1000: " << m_rx_descriptor_count << " RX / " << m_tx_descriptor_count << " TX descriptors, ITR " << interrupt_throttle;
+
+    out32(REG_INTERRUPT_MASK_CLEAR, 0xffffffff);
+    out32(REG_INTERRUPT_MASK_SET, INTERRUPT_LSC | INTERRUPT_RXSEQ | receive_interrupts);
     in32(REG_INTERRUPT_CAUSE_READ);
 
     enable_irq();
@@ -241,26 +285,25 @@ UNMAP_AFTER_INIT E1000NetworkAdapter::~E1000NetworkAdapter()
 
 void E1000NetworkAdapter::handle_irq(const RegisterState&)
 {
-    out32(REG_INTERRUPT_MASK_CLEAR, 0xffffffff);
-
+    // NOTE: Reading ICR acknowledges every pending cause and deasserts the interrupt.
     u32 status = in32(REG_INTERRUPT_CAUSE_READ);
 
     m_entropy_source.add_random_event(status);
 
-    if (status & 4) {
+    if (status & INTERRUPT_LSC) {
         u32 flags = in32(REG_CTRL);
         out32(REG_CTRL, flags | ECTRL_SLU);
     }
-    if (status & 0x80) {
-        receive();
+    if (status & receive_interrupts) {
+        // Stay quiet until NetworkTask has drained the RX ring, see poll_receive().
+        out32(REG_INTERRUPT_MASK_CLEAR, receive_interrupts);
+        request_poll();
     }
-    if (status & 0x10) {
-        // Threshold OK?
+    if (status & INTERRUPT_TXDW) {
+        // Only unmasked while send_raw() is waiting for a free TX descriptor.
+        out32(REG_INTERRUPT_MASK_CLEAR, INTERRUPT_TXDW);
+        m_wait_queue.wake_all();
     }
-
-    m_wait_queue.wake_all();
-
-    out32(REG_INTERRUPT_MASK_SET, INTERRUPT_LSC | INTERRUPT_RXT0 | INTERRUPT_RXO);
 }
 
 UNMAP_AFTER_INIT void E1000NetworkAdapter::detect_eeprom()
@@ -319,40 +362,43 @@ bool E1000NetworkAdapter::link_up()
 
 UNMAP_AFTER_INIT void E1000NetworkAdapter::initialize_rx_descriptors()
 {
-    auto* rx_descriptors = (e1000_tx_desc*)m_rx_descriptors_region->vaddr().as_ptr();
-    for (size_t i = 0; i < number_of_rx_descriptors; ++i) {
+    auto* rx_descriptors = (e1000_rx_desc*)m_rx_descriptors_region->vaddr().as_ptr();
+    m_rx_buffers_region = MM.allocate_contiguous_kernel_region(page_round_up(rx_buffer_size * m_rx_descriptor_count), "E1000 RX buffers", Region::Access::Read | Region::Access::Write);
+    VERIFY(m_rx_buffers_region);
+    auto rx_buffers_base = m_rx_buffers_region->physical_page(0)->paddr().get();
+    for (size_t i = 0; i < m_rx_descriptor_count; ++i) {
         auto& descriptor = rx_descriptors[i];
-        auto region = MM.allocate_contiguous_kernel_region(8192, "E1000 RX buffer", Region::Access::Read | Region::Access::Write);
-        VERIFY(region);
-        m_rx_buffers_regions.append(region.release_nonnull());
-        descriptor.addr = m_rx_buffers_regions[i].physical_page(0)->paddr().get();
+        descriptor.addr = rx_buffers_base + i * rx_buffer_size;
         descriptor.status = 0;
     }
 
     out32(REG_RXDESCLO, m_rx_descriptors_region->physical_page(0)->paddr().get());
     out32(REG_RXDESCHI, 0);
-    out32(REG_RXDESCLEN, number_of_rx_descriptors * sizeof(e1000_rx_desc));
+    out32(REG_RXDESCLEN, m_rx_descriptor_count * sizeof(e1000_rx_desc));
     out32(REG_RXDESCHEAD, 0);
-    out32(REG_RXDESCTAIL, number_of_rx_descriptors - 1);
+    out32(REG_RXDESCTAIL, m_rx_descriptor_count - 1);
 
-    out32(REG_RCTRL, RCTL_EN | RCTL_SBP | RCTL_UPE | RCTL_MPE | RCTL_LBM_NONE | RTCL_RDMTS_HALF | RCTL_BAM | RCTL_SECRC | RCTL_BSIZE_8192);
+    // NOTE: Long packet reception is off, so every frame fits into a single 2 KiB buffer.
+    out32(REG_RCTRL, RCTL_EN | RCTL_SBP | RCTL_UPE | RCTL_MPE | RCTL_LBM_NONE | RTCL_RDMTS_HALF | RCTL_BAM | RCTL_SECRC | RCTL_BSIZE_2048);
 }
 
 UNMAP_AFTER_INIT void E1000NetworkAdapter::initialize_tx_descriptors()
 {
     auto* tx_descriptors = (e1000_tx_desc*)m_tx_descriptors_region->vaddr().as_ptr();
-    for (size_t i = 0; i < number_of_tx_descriptors; ++i) {
+    m_tx_buffers_region = MM.allocate_contiguous_kernel_region(page_round_up(tx_buffer_size * m_tx_descriptor_count), "E1000 TX buffers", Region::Access::Read | Region::Access::Write);
+    VERIFY(m_tx_buffers_region);
+    auto tx_buffers_base = m_tx_buffers_region->physical_page(0)->paddr().get();
+    for (size_t i = 0; i < m_tx_descriptor_count; ++i) {
         auto& descriptor = tx_descriptors[i];
-        auto region = MM.allocate_contiguous_kernel_region(8192, "E1000 TX buffer", Region::Access::Read | Region::Access::Write);
-        VERIFY(region);
-        m_tx_buffers_regions.append(region.release_nonnull());
-        descriptor.addr = m_tx_buffers_regions[i].physical_page(0)->paddr().get();
+        descriptor.addr = tx_buffers_base + i * tx_buffer_size;
         descriptor.cmd = 0;
+        // Every descriptor starts out as ours, send_raw() only waits on ones the hardware still owns.
+        descriptor.status = TSTA_DD;
     }
 
     out32(REG_TXDESCLO, m_tx_descriptors_region->physical_page(0)->paddr().get());
     out32(REG_TXDESCHI, 0);
-    out32(REG_TXDESCLEN, number_of_tx_descriptors * sizeof(e1000_tx_desc));
+    out32(REG_TXDESCLEN, m_tx_descriptor_count * sizeof(e1000_tx_desc));
     out32(REG_TXDESCHEAD, 0);
     out32(REG_TXDESCTAIL, 0);
 
@@ -419,59 +465,65 @@ u32 E1000NetworkAdapter::in32(u16 address)
 
 void E1000NetworkAdapter::send_raw(ReadonlyBytes payload)
 {
-    disable_irq();
-    size_t tx_current = in32(REG_TXDESCTAIL) % number_of_tx_descriptors;
+    VERIFY(payload.size() <= tx_buffer_size);
+    Locker locker(m_tx_lock);
 #if E1000_DEBUG
     klog() << "E1000: Sending packet (" << payload.size() << " bytes)";
 #endif
     auto* tx_descriptors = (e1000_tx_desc*)m_tx_descriptors_region->vaddr().as_ptr();
-    auto& descriptor = tx_descriptors[tx_current];
-    VERIFY(payload.size() <= 8192);
-    auto* vptr = (void*)m_tx_buffers_regions[tx_current].vaddr().as_ptr();
+    auto& descriptor = tx_descriptors[m_tx_current];
+    // The ring is only full if the hardware hasn't finished with the slot we're about to reuse.
+    while (!(descriptor.status & TSTA_DD)) {
+        out32(REG_INTERRUPT_MASK_SET, INTERRUPT_TXDW);
+        if (descriptor.status & TSTA_DD)
+            break;
+        m_wait_queue.wait_forever("E1000NetworkAdapter");
+    }
+    auto* vptr = m_tx_buffers_region->vaddr().offset(m_tx_current * tx_buffer_size).as_ptr();
     memcpy(vptr, payload.data(), payload.size());
     descriptor.length = payload.size();
     descriptor.status = 0;
     descriptor.cmd = CMD_EOP | CMD_IFCS | CMD_RS;
 #if E1000_DEBUG
-    klog() << "E1000: Using tx descriptor " << tx_current << " (head is at " << in32(REG_TXDESCHEAD) << ")";
-#endif
-    tx_current = (tx_current + 1) % number_of_tx_descriptors;
-    cli();
-    enable_irq();
-    out32(REG_TXDESCTAIL, tx_current);
-    for (;;) {
-        if (descriptor.status) {
-            sti();
-            break;
-        }
-        m_wait_queue.wait_forever("E1000NetworkAdapter");
-    }
-#if E1000_DEBUG
-    dbgln("E1000: Sent packet, status is now {:#02x}!", (u8)descriptor.status);
+    klog() << "E1000: Using tx descriptor " << m_tx_current << " (head is at " << in32(REG_TXDESCHEAD) << ")";
 #endif
+    m_tx_current = (m_tx_current + 1) % m_tx_descriptor_count;
+    atomic_thread_fence(AK::MemoryOrder::memory_order_seq_cst);
+    out32(REG_TXDESCTAIL, m_tx_current);
 }
 
-void E1000NetworkAdapter::receive()
+size_t E1000NetworkAdapter::poll_receive(size_t budget)
 {
-    auto* rx_descriptors = (e1000_tx_desc*)m_rx_descriptors_region->vaddr().as_ptr();
-    u32 rx_current;
-    for (;;) {
-        rx_current = in32(REG_RXDESCTAIL) % number_of_rx_descriptors;
-        if (rx_current == (in32(REG_RXDESCHEAD) % number_of_rx_descriptors))
-            return;
-        rx_current = (rx_current + 1) % number_of_rx_descriptors;
-        if (!(rx_descriptors[rx_current].status & 1))
+    auto* rx_descriptors = (e1000_rx_desc*)m_rx_descriptors_region->vaddr().as_ptr();
+    size_t received = 0;
+    Optional<size_t> last_processed;
+    while (received < budget) {
+        auto& descriptor = rx_descriptors[m_rx_current];
+        if (!(descriptor.status & RSTA_DD))
             break;
-        auto* buffer = m_rx_buffers_regions[rx_current].vaddr().as_ptr();
-        u16 length = rx_descriptors[rx_current].length;
-        VERIFY(length <= 8192);
+        auto* buffer = m_rx_buffers_region->vaddr().offset(m_rx_current * rx_buffer_size).as_ptr();
+        u16 length = descriptor.length;
+        VERIFY(length <= rx_buffer_size);
 #if E1000_DEBUG
         klog() << "E1000: Received 1 packet @ " << buffer << " (" << length << ") bytes!";
 #endif
         did_receive({ buffer, length });
-        rx_descriptors[rx_current].status = 0;
-        out32(REG_RXDESCTAIL, rx_current);
+        descriptor.status = 0;
+        last_processed = m_rx_current;
+        m_rx_current = (m_rx_current + 1) % m_rx_descriptor_count;
+        ++received;
     }
+    // Hand the whole batch back to the hardware with a single tail update.
+    if (last_processed.has_value()) {
+        atomic_thread_fence(AK::MemoryOrder::memory_order_seq_cst);
+        out32(REG_RXDESCTAIL, last_processed.value());
+    }
+    return received;
+}
+
+void E1000NetworkAdapter::enable_receive_interrupts()
+{
+    out32(REG_INTERRUPT_MASK_SET, receive_interrupts);
 }
 
 }
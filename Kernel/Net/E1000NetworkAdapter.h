@@ -26,10 +26,10 @@
 
 #pragma once
 
-#include <AK/NonnullOwnPtrVector.h>
 #include <AK/OwnPtr.h>
 #include <Kernel/IO.h>
 #include <Kernel/Interrupts/IRQHandler.h>
+#include <Kernel/Lock.h>
 #include <Kernel/Net/NetworkAdapter.h>
 #include <Kernel/PCI/Access.h>
 #include <Kernel/PCI/Device.h>
@@ -53,6 +53,8 @@ public:
 private:
     virtual void handle_irq(const RegisterState&) override;
     virtual const char* class_name() const override { return "E1000NetworkAdapter"; }
+    virtual size_t poll_receive(size_t budget) override;
+    virtual void enable_receive_interrupts() override;
 
     struct [[gnu::packed]] e1000_rx_desc {
         volatile uint64_t addr { 0 };
@@ -90,23 +92,30 @@ private:
     u16 in16(u16 address);
     u32 in32(u16 address);
 
-    void receive();
-
     IOAddress m_io_base;
     VirtualAddress m_mmio_base;
+    size_t m_rx_descriptor_count { 0 };
+    size_t m_tx_descriptor_count { 0 };
     OwnPtr<Region> m_rx_descriptors_region;
     OwnPtr<Region> m_tx_descriptors_region;
-    NonnullOwnPtrVector<Region> m_rx_buffers_regions;
-    NonnullOwnPtrVector<Region> m_tx_buffers_regions;
+    OwnPtr<Region> m_rx_buffers_region;
+    OwnPtr<Region> m_tx_buffers_region;
     OwnPtr<Region> m_mmio_region;
     u8 m_interrupt_line { 0 };
     bool m_has_eeprom { false };
     bool m_use_mmio { false };
     EntropySource m_entropy_source;
 
-    static const size_t number_of_rx_descriptors = 32;
-    static const size_t number_of_tx_descriptors = 8;
+    static constexpr size_t default_rx_descriptor_count = 256;
+    static constexpr size_t default_tx_descriptor_count = 256;
+    static constexpr size_t rx_buffer_size = 2048;
+    static constexpr size_t tx_buffer_size = 2048;
+
+    // Next descriptor the hardware will hand back to us, on either ring.
+    size_t m_rx_current { 0 };
+    size_t m_tx_current { 0 };
 
+    Lock m_tx_lock { "E1000 TX" };
     WaitQueue m_wait_queue;
 };
 }
@@ -37,6 +37,7 @@
 
 namespace Kernel {
 
+class Inode;
 class NetworkAdapter;
 class TCPPacket;
 class TCPSocket;
@@ -65,6 +66,9 @@ public:
 
     bool did_receive(const IPv4Address& peer_address, u16 peer_port, KBuffer&&, const timeval&);
 
+    // NOTE: Lets stream protocols build packets straight from file contents, see sys$sendfile().
+    virtual KResultOr<size_t> send_from_inode(Inode&, off_t, size_t) { return ENOTSUP; }
+
     const IPv4Address& local_address() const { return m_local_address; }
     u16 local_port() const { return m_local_port; }
     void set_local_port(u16 port) { m_local_port = port; }
@@ -87,7 +91,7 @@ public:
     BufferMode buffer_mode() const { return m_buffer_mode; }
 
 protected:
-    IPv4Socket(int type, int protocol);
+    IPv4Socket(int type, int protocol, size_t receive_buffer_size = 64 * KiB);
     virtual const char* class_name() const override { return "IPv4Socket"; }
 
     int allocate_local_port_if_needed();
@@ -99,6 +103,9 @@ protected:
     virtual KResult protocol_connect(FileDescription&, ShouldBlock) { return KSuccess; }
     virtual int protocol_allocate_local_port() { return 0; }
     virtual bool protocol_is_disconnected() const { return false; }
+    virtual void protocol_did_read(size_t) { }
+
+    size_t receive_buffer_space() const { return m_receive_buffer.space_for_writing(); }
 
     virtual void shut_down_for_reading() override;
 
@@ -26,6 +26,7 @@
 
 #include <AK/Singleton.h>
 #include <Kernel/Net/LoopbackAdapter.h>
+#include <Kernel/Random.h>
 
 namespace Kernel {
 
@@ -49,6 +50,11 @@ LoopbackAdapter::~LoopbackAdapter()
 
 void LoopbackAdapter::send_raw(ReadonlyBytes payload)
 {
+    if (m_packet_loss_percentage && get_fast_random<u32>() % 100 < m_packet_loss_percentage) {
+        ++m_packets_dropped;
+        dbgln("LoopbackAdapter: Dropping {} byte(s) on purpose ({} so far).", payload.size(), m_packets_dropped);
+        return;
+    }
     dbgln("LoopbackAdapter: Sending {} byte(s) to myself.", payload.size());
     did_receive(payload);
 }
@@ -40,6 +40,14 @@ public:
 
     virtual void send_raw(ReadonlyBytes) override;
     virtual const char* class_name() const override { return "LoopbackAdapter"; }
+
+    // NOTE: Dropping packets on purpose lets us exercise loss recovery in the protocols (see /proc/sys/loopback_packet_loss).
+    void set_packet_loss_percentage(u32 percentage) { m_packet_loss_percentage = percentage; }
+    u32 packet_loss_percentage() const { return m_packet_loss_percentage; }
+
+private:
+    u32 m_packet_loss_percentage { 0 };
+    u32 m_packets_dropped { 0 };
 };
 
 }
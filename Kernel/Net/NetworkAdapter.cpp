@@ -174,47 +174,69 @@ KResult NetworkAdapter::send_ipv4_fragmented(const MACAddress& destination_mac,
 
 void NetworkAdapter::did_receive(ReadonlyBytes payload)
 {
-    InterruptDisabler disabler;
-    m_packets_in++;
-    m_bytes_in += payload.size();
-
-    Optional<KBuffer> buffer;
-
-    if (m_unused_packet_buffers.is_empty()) {
-        buffer = KBuffer::copy(payload.data(), payload.size());
-    } else {
-        buffer = m_unused_packet_buffers.take_first();
-        --m_unused_packet_buffers_count;
-        if (payload.size() <= buffer.value().size()) {
-            memcpy(buffer.value().data(), payload.data(), payload.size());
-            buffer.value().set_size(payload.size());
-        } else {
+    {
+        ScopedSpinLock lock(m_packet_queue_lock);
+        m_packets_in++;
+        m_bytes_in += payload.size();
+
+        Optional<KBuffer> buffer;
+
+        if (m_unused_packet_buffers.is_empty()) {
             buffer = KBuffer::copy(payload.data(), payload.size());
+        } else {
+            buffer = m_unused_packet_buffers.take_first();
+            --m_unused_packet_buffers_count;
+            if (payload.size() <= buffer.value().size()) {
+                memcpy(buffer.value().data(), payload.data(), payload.size());
+                buffer.value().set_size(payload.size());
+            } else {
+                buffer = KBuffer::copy(payload.data(), payload.size());
+            }
         }
+
+        m_packet_queue.append({ buffer.value(), kgettimeofday() });
     }
 
-    m_packet_queue.append({ buffer.value(), kgettimeofday() });
+    if (on_receive)
+        on_receive();
+}
 
+void NetworkAdapter::request_poll()
+{
+    m_wants_poll.store(true, AK::MemoryOrder::memory_order_release);
     if (on_receive)
         on_receive();
 }
 
-size_t NetworkAdapter::dequeue_packet(u8* buffer, size_t buffer_size, timeval& packet_timestamp)
+size_t NetworkAdapter::poll(size_t budget)
+{
+    size_t received = poll_receive(budget);
+    if (received < budget) {
+        // The ring is empty, go back to waiting for an interrupt.
+        m_wants_poll.store(false, AK::MemoryOrder::memory_order_release);
+        enable_receive_interrupts();
+    }
+    return received;
+}
+
+size_t NetworkAdapter::dequeue_packets(Vector<PacketWithTimestamp>& packets, size_t max_packets)
+{
+    ScopedSpinLock lock(m_packet_queue_lock);
+    size_t dequeued = 0;
+    while (dequeued < max_packets && !m_packet_queue.is_empty()) {
+        packets.append(m_packet_queue.take_first());
+        ++dequeued;
+    }
+    return dequeued;
+}
+
+void NetworkAdapter::release_packet_buffer(KBuffer&& packet)
 {
-    InterruptDisabler disabler;
-    if (m_packet_queue.is_empty())
-        return 0;
-    auto packet_with_timestamp = m_packet_queue.take_first();
-    packet_timestamp = packet_with_timestamp.timestamp;
-    auto packet = move(packet_with_timestamp.packet);
-    size_t packet_size = packet.size();
-    VERIFY(packet_size <= buffer_size);
-    memcpy(buffer, packet.data(), packet_size);
+    ScopedSpinLock lock(m_packet_queue_lock);
     if (m_unused_packet_buffers_count < 100) {
-        m_unused_packet_buffers.append(packet);
+        m_unused_packet_buffers.append(move(packet));
         ++m_unused_packet_buffers_count;
     }
-    return packet_size;
 }
 
 void NetworkAdapter::set_ipv4_address(const IPv4Address& address)
@@ -26,17 +26,20 @@
 
 #pragma once
 
+#include <AK/Atomic.h>
 #include <AK/ByteBuffer.h>
 #include <AK/Function.h>
 #include <AK/MACAddress.h>
 #include <AK/SinglyLinkedList.h>
 #include <AK/Types.h>
+#include <AK/Vector.h>
 #include <AK/WeakPtr.h>
 #include <AK/Weakable.h>
 #include <Kernel/KBuffer.h>
 #include <Kernel/Net/ARP.h>
 #include <Kernel/Net/ICMP.h>
 #include <Kernel/Net/IPv4.h>
+#include <Kernel/SpinLock.h>
 #include <Kernel/UserOrKernelBuffer.h>
 
 namespace Kernel {
@@ -67,10 +70,24 @@ public:
     KResult send_ipv4(const MACAddress&, const IPv4Address&, IPv4Protocol, const UserOrKernelBuffer& payload, size_t payload_size, u8 ttl);
     KResult send_ipv4_fragmented(const MACAddress&, const IPv4Address&, IPv4Protocol, const UserOrKernelBuffer& payload, size_t payload_size, u8 ttl);
 
-    size_t dequeue_packet(u8* buffer, size_t buffer_size, timeval& packet_timestamp);
+    struct PacketWithTimestamp {
+        KBuffer packet;
+        timeval timestamp;
+    };
+
+    // Moves up to `max_packets` received packets onto the end of `packets`.
+    size_t dequeue_packets(Vector<PacketWithTimestamp>& packets, size_t max_packets);
+    // Hands a dequeued packet's buffer back so the next received packet can reuse it.
+    void release_packet_buffer(KBuffer&&);
 
     bool has_queued_packets() const { return !m_packet_queue.is_empty(); }
 
+    // NOTE: Adapters that support polling mask their receive interrupt as soon as a frame
+    //       arrives and call request_poll(). NetworkTask then drains them in batches of at
+    //       most `budget` frames until they run dry, at which point interrupts are re-armed.
+    bool wants_poll() const { return m_wants_poll.load(AK::MemoryOrder::memory_order_relaxed); }
+    size_t poll(size_t budget);
+
     u32 mtu() const { return m_mtu; }
     void set_mtu(u32 mtu) { m_mtu = mtu; }
 
@@ -86,7 +103,10 @@ protected:
     void set_interface_name(const StringView& basename);
     void set_mac_address(const MACAddress& mac_address) { m_mac_address = mac_address; }
     virtual void send_raw(ReadonlyBytes) = 0;
+    virtual size_t poll_receive(size_t) { return 0; }
+    virtual void enable_receive_interrupts() { }
     void did_receive(ReadonlyBytes);
+    void request_poll();
 
 private:
     MACAddress m_mac_address;
@@ -94,11 +114,7 @@ private:
     IPv4Address m_ipv4_netmask;
     IPv4Address m_ipv4_gateway;
 
-    struct PacketWithTimestamp {
-        KBuffer packet;
-        timeval timestamp;
-    };
-
+    SpinLock<u8> m_packet_queue_lock;
     SinglyLinkedList<PacketWithTimestamp> m_packet_queue;
     SinglyLinkedList<KBuffer> m_unused_packet_buffers;
     size_t m_unused_packet_buffers_count { 0 };
@@ -108,6 +124,7 @@ private:
     u32 m_packets_out { 0 };
     u32 m_bytes_out { 0 };
     u32 m_mtu { 1500 };
+    Atomic<bool> m_wants_poll { false };
 };
 
 }
@@ -43,13 +43,60 @@
 
 namespace Kernel {
 
+static void handle_frame(const KBuffer&, const timeval& packet_timestamp);
 static void handle_arp(const EthernetFrameHeader&, size_t frame_size);
 static void handle_ipv4(const EthernetFrameHeader&, size_t frame_size, const timeval& packet_timestamp);
 static void handle_icmp(const EthernetFrameHeader&, const IPv4Packet&, const timeval& packet_timestamp);
 static void handle_udp(const IPv4Packet&, const timeval& packet_timestamp);
 static void handle_tcp(const IPv4Packet&, const timeval& packet_timestamp);
+static void retransmit_tcp_packets();
 
 [[noreturn]] static void NetworkTask_main(void*);
+[[noreturn]] static void NetworkWorker_main(void*);
+
+// Pull at most this many frames out of each polled adapter before handling them, so that
+// a flood on one interface can't keep us from ever getting to the protocol layers.
+static constexpr size_t poll_budget = 64;
+
+// NOTE: NetworkTask itself only polls adapters and runs the retransmit timer. Received frames
+//       are hashed by flow onto one worker thread per CPU, so every packet of a connection is
+//       handled in order, while a busy connection only holds up the flows that share its worker.
+static constexpr size_t max_worker_count = 8;
+static constexpr size_t max_queued_packets_per_worker = 1024;
+
+struct QueuedPacket {
+    NonnullRefPtr<NetworkAdapter> adapter;
+    KBuffer packet;
+    timeval timestamp;
+};
+
+struct NetworkWorker {
+    SpinLock<u8> lock;
+    Vector<QueuedPacket> queue;
+    WaitQueue wait_queue;
+};
+
+static NetworkWorker* s_workers;
+static size_t s_worker_count;
+
+static unsigned flow_hash(const KBuffer& packet)
+{
+    if (packet.size() < sizeof(EthernetFrameHeader) + sizeof(IPv4Packet))
+        return 0;
+    auto& eth = *(const EthernetFrameHeader*)packet.data();
+    if (eth.ether_type() != EtherType::IPv4)
+        return 0;
+    auto& ipv4_packet = *static_cast<const IPv4Packet*>(eth.payload());
+    auto address_hash = pair_int_hash(ipv4_packet.source().to_u32(), ipv4_packet.destination().to_u32());
+    auto protocol = (IPv4Protocol)ipv4_packet.protocol();
+    if ((protocol != IPv4Protocol::TCP && protocol != IPv4Protocol::UDP) || ipv4_packet.is_a_fragment())
+        return address_hash;
+    // Both TCP and UDP headers start out with the source and destination port.
+    if (packet.size() < sizeof(EthernetFrameHeader) + sizeof(IPv4Packet) + 2 * sizeof(u16))
+        return address_hash;
+    auto* ports = static_cast<const NetworkOrdered<u16>*>(ipv4_packet.payload());
+    return pair_int_hash(address_hash, pair_int_hash(ports[0], ports[1]));
+}
 
 void NetworkTask::spawn()
 {
@@ -61,7 +108,6 @@ void NetworkTask_main(void*)
 {
     WaitQueue packet_wait_queue;
     u8 octet = 15;
-    int pending_packets = 0;
     NetworkAdapter::for_each([&](auto& adapter) {
         if (String(adapter.class_name()) == "LoopbackAdapter") {
             adapter.set_ipv4_address({ 127, 0, 0, 1 });
@@ -76,82 +122,147 @@ void NetworkTask_main(void*)
         klog() << "NetworkTask: " << adapter.class_name() << " network adapter found: hw=" << adapter.mac_address().to_string().characters() << " address=" << adapter.ipv4_address().to_string().characters() << " netmask=" << adapter.ipv4_netmask().to_string().characters() << " gateway=" << adapter.ipv4_gateway().to_string().characters();
 
         adapter.on_receive = [&]() {
-            pending_packets++;
             packet_wait_queue.wake_all();
         };
     });
 
-    auto dequeue_packet = [&pending_packets](u8* buffer, size_t buffer_size, timeval& packet_timestamp) -> size_t {
-        if (pending_packets == 0)
-            return 0;
-        size_t packet_size = 0;
+    s_worker_count = min((size_t)Processor::count(), max_worker_count);
+    s_workers = new NetworkWorker[s_worker_count];
+    for (size_t i = 0; i < s_worker_count; ++i)
+        Process::current()->create_kernel_thread(NetworkWorker_main, &s_workers[i], THREAD_PRIORITY_NORMAL, String::formatted("NetworkWorker #{}", i), 1u << i, false);
+
+    Vector<NetworkAdapter::PacketWithTimestamp> packets;
+    auto dispatch_packets = [&] {
+        size_t dispatched = 0;
+        u32 workers_to_wake = 0;
         NetworkAdapter::for_each([&](auto& adapter) {
-            if (packet_size || !adapter.has_queued_packets())
+            if (!adapter.has_queued_packets())
                 return;
-            packet_size = adapter.dequeue_packet(buffer, buffer_size, packet_timestamp);
-            pending_packets--;
+            packets.clear_with_capacity();
+            adapter.dequeue_packets(packets, poll_budget);
 #if NETWORK_TASK_DEBUG
-            klog() << "NetworkTask: Dequeued packet from " << adapter.name().characters() << " (" << packet_size << " bytes)";
+            klog() << "NetworkTask: Dequeued " << packets.size() << " packets from " << adapter.name().characters();
 #endif
+            for (auto& packet : packets) {
+                size_t worker_index = flow_hash(packet.packet) % s_worker_count;
+                auto& worker = s_workers[worker_index];
+                ScopedSpinLock lock(worker.lock);
+                if (worker.queue.size() >= max_queued_packets_per_worker) {
+                    // The worker is falling behind, drop the packet just like a full RX ring would.
+                    lock.unlock();
+                    adapter.release_packet_buffer(move(packet.packet));
+                    continue;
+                }
+                worker.queue.append({ adapter, move(packet.packet), packet.timestamp });
+                workers_to_wake |= 1u << worker_index;
+            }
+            dispatched += packets.size();
+        });
+        for (size_t i = 0; i < s_worker_count; ++i) {
+            if (workers_to_wake & (1u << i))
+                s_workers[i].wait_queue.wake_all();
+        }
+        return dispatched;
+    };
+
+    auto poll_adapters = [] {
+        size_t received = 0;
+        NetworkAdapter::for_each([&](auto& adapter) {
+            if (adapter.wants_poll())
+                received += adapter.poll(poll_budget);
         });
-        return packet_size;
+        return received;
     };
 
-    size_t buffer_size = 64 * KiB;
-    auto buffer_region = MM.allocate_kernel_region(buffer_size, "Kernel Packet Buffer", Region::Access::Read | Region::Access::Write);
-    auto buffer = (u8*)buffer_region->vaddr().get();
-    timeval packet_timestamp;
+    timeval last_retransmit_check = kgettimeofday();
+    auto retransmit_if_due = [&] {
+        auto now = kgettimeofday();
+        timeval elapsed;
+        timeval_sub(now, last_retransmit_check, elapsed);
+        if (elapsed.tv_sec == 0 && elapsed.tv_usec < (suseconds_t)TCPSocket::retransmit_timer_interval_ms * 1000)
+            return;
+        last_retransmit_check = now;
+        retransmit_tcp_packets();
+    };
 
-    klog() << "NetworkTask: Enter main loop.";
+    klog() << "NetworkTask: Enter main loop with " << s_worker_count << " worker(s).";
     for (;;) {
-        size_t packet_size = dequeue_packet(buffer, buffer_size, packet_timestamp);
-        if (!packet_size) {
-            packet_wait_queue.wait_forever("NetworkTask");
+        retransmit_if_due();
+        if (dispatch_packets())
+            continue;
+        if (poll_adapters())
             continue;
+        timespec timeout { 0, (long)TCPSocket::retransmit_timer_interval_ms * 1000000 };
+        [[maybe_unused]] auto result = packet_wait_queue.wait_on(Thread::BlockTimeout(false, &timeout), "NetworkTask");
+    }
+}
+
+void NetworkWorker_main(void* data)
+{
+    auto& worker = *static_cast<NetworkWorker*>(data);
+    Vector<QueuedPacket> batch;
+    for (;;) {
+        {
+            ScopedSpinLock lock(worker.lock);
+            swap(batch, worker.queue);
         }
-        if (packet_size < sizeof(EthernetFrameHeader)) {
-            klog() << "NetworkTask: Packet is too small to be an Ethernet packet! (" << packet_size << ")";
+        if (batch.is_empty()) {
+            worker.wait_queue.wait_forever("NetworkWorker");
             continue;
         }
-        auto& eth = *(const EthernetFrameHeader*)buffer;
+        for (auto& queued_packet : batch) {
+            handle_frame(queued_packet.packet, queued_packet.timestamp);
+            queued_packet.adapter->release_packet_buffer(move(queued_packet.packet));
+        }
+        batch.clear_with_capacity();
+    }
+}
+
+void handle_frame(const KBuffer& packet, const timeval& packet_timestamp)
+{
+    size_t packet_size = packet.size();
+    if (packet_size < sizeof(EthernetFrameHeader)) {
+        klog() << "handle_frame: Packet is too small to be an Ethernet packet! (" << packet_size << ")";
+        return;
+    }
+    auto& eth = *(const EthernetFrameHeader*)packet.data();
 #if ETHERNET_DEBUG
-        dbgln("NetworkTask: From {} to {}, ether_type={:#04x}, packet_size={}", eth.source().to_string(), eth.destination().to_string(), eth.ether_type(), packet_size);
+    dbgln("handle_frame: From {} to {}, ether_type={:#04x}, packet_size={}", eth.source().to_string(), eth.destination().to_string(), eth.ether_type(), packet_size);
 #endif
 
 #if ETHERNET_VERY_DEBUG
-        for (size_t i = 0; i < packet_size; i++) {
-            klog() << String::format("%#02x", buffer[i]);
-
-            switch (i % 16) {
-            case 7:
-                klog() << "  ";
-                break;
-            case 15:
-                klog() << "";
-                break;
-            default:
-                klog() << " ";
-                break;
-            }
-        }
-
-        klog() << "";
-#endif
+    for (size_t i = 0; i < packet_size; i++) {
+        klog() << String::format("%#02x", packet.data()[i]);
 
-        switch (eth.ether_type()) {
-        case EtherType::ARP:
-            handle_arp(eth, packet_size);
+        switch (i % 16) {
+        case 7:
+            klog() << "  ";
             break;
-        case EtherType::IPv4:
-            handle_ipv4(eth, packet_size, packet_timestamp);
-            break;
-        case EtherType::IPv6:
-            // ignore
+        case 15:
+            klog() << "";
             break;
         default:
-            klog() << "NetworkTask: Unknown ethernet type 0x" << String::format("%x", eth.ether_type());
+            klog() << " ";
+            break;
         }
     }
+
+    klog() << "";
+#endif
+
+    switch (eth.ether_type()) {
+    case EtherType::ARP:
+        handle_arp(eth, packet_size);
+        break;
+    case EtherType::IPv4:
+        handle_ipv4(eth, packet_size, packet_timestamp);
+        break;
+    case EtherType::IPv6:
+        // ignore
+        break;
+    default:
+        klog() << "handle_frame: Unknown ethernet type 0x" << String::format("%x", eth.ether_type());
+    }
 }
 
 void handle_arp(const EthernetFrameHeader& eth, size_t frame_size)
@@ -428,6 +539,7 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
 #if TCP_DEBUG
             klog() << "handle_tcp: created new client socket with tuple " << client->tuple().to_string().characters();
 #endif
+            client->receive_tcp_options(tcp_packet);
             client->set_sequence_number(1000);
             client->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
             [[maybe_unused]] auto rc2 = client->send_tcp_packet(TCPFlags::SYN | TCPFlags::ACK);
@@ -477,9 +589,11 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
         }
     case TCPSocket::State::SynReceived:
         switch (tcp_packet.flags()) {
+        case TCPFlags::SYN:
+            // Our SYN/ACK got lost, it will be retransmitted.
+            return;
         case TCPFlags::ACK:
-            socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
-
+        case TCPFlags::ACK | TCPFlags::PUSH:
             switch (socket->direction()) {
             case TCPSocket::Direction::Incoming:
                 if (!socket->has_originator()) {
@@ -492,11 +606,16 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
                 socket->set_state(TCPSocket::State::Established);
                 socket->set_setup_state(Socket::SetupState::Completed);
                 socket->release_to_originator();
+                // The final ACK of the handshake may already carry data.
+                if (payload_size)
+                    socket->receive_payload(ipv4_packet, tcp_packet, payload_size, packet_timestamp);
                 return;
             case TCPSocket::Direction::Outgoing:
                 socket->set_state(TCPSocket::State::Established);
                 socket->set_setup_state(Socket::SetupState::Completed);
                 socket->set_connected(true);
+                if (payload_size)
+                    socket->receive_payload(ipv4_packet, tcp_packet, payload_size, packet_timestamp);
                 return;
             default:
                 klog() << "handle_tcp: got ACK in SynReceived state but direction is invalid (" << TCPSocket::to_string(socket->direction()) << ")";
@@ -514,6 +633,12 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
         }
     case TCPSocket::State::CloseWait:
         switch (tcp_packet.flags()) {
+        case TCPFlags::ACK:
+            return;
+        case TCPFlags::FIN | TCPFlags::ACK:
+            // Our ACK of their FIN got lost.
+            unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
+            return;
         default:
             klog() << "handle_tcp: unexpected flags in CloseWait state";
             unused_rc = socket->send_tcp_packet(TCPFlags::RST);
@@ -523,9 +648,14 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
     case TCPSocket::State::LastAck:
         switch (tcp_packet.flags()) {
         case TCPFlags::ACK:
-            socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
+            // Wait for our FIN, and everything queued in front of it, to be acknowledged.
+            if (socket->has_unacknowledged_data())
+                return;
             socket->set_state(TCPSocket::State::Closed);
             return;
+        case TCPFlags::FIN | TCPFlags::ACK:
+            unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
+            return;
         default:
             klog() << "handle_tcp: unexpected flags in LastAck state";
             unused_rc = socket->send_tcp_packet(TCPFlags::RST);
@@ -535,12 +665,15 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
     case TCPSocket::State::FinWait1:
         switch (tcp_packet.flags()) {
         case TCPFlags::ACK:
-            socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
+            if (socket->has_unacknowledged_data())
+                return;
             socket->set_state(TCPSocket::State::FinWait2);
             return;
         case TCPFlags::FIN:
+        case TCPFlags::FIN | TCPFlags::ACK:
             socket->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
-            socket->set_state(TCPSocket::State::Closing);
+            unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
+            socket->set_state(socket->has_unacknowledged_data() ? TCPSocket::State::Closing : TCPSocket::State::TimeWait);
             return;
         default:
             klog() << "handle_tcp: unexpected flags in FinWait1 state";
@@ -550,8 +683,12 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
         }
     case TCPSocket::State::FinWait2:
         switch (tcp_packet.flags()) {
+        case TCPFlags::ACK:
+            return;
         case TCPFlags::FIN:
+        case TCPFlags::FIN | TCPFlags::ACK:
             socket->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
+            unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
             socket->set_state(TCPSocket::State::TimeWait);
             return;
         case TCPFlags::ACK | TCPFlags::RST:
@@ -566,7 +703,8 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
     case TCPSocket::State::Closing:
         switch (tcp_packet.flags()) {
         case TCPFlags::ACK:
-            socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
+            if (socket->has_unacknowledged_data())
+                return;
             socket->set_state(TCPSocket::State::TimeWait);
             return;
         default:
@@ -576,7 +714,13 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
             return;
         }
     case TCPSocket::State::Established:
-        if (tcp_packet.has_fin()) {
+        if (tcp_packet.has_syn()) {
+            // The peer is still retransmitting its SYN/ACK, so our ACK got lost.
+            unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
+            return;
+        }
+
+        if (tcp_packet.has_fin() && tcp_packet.sequence_number() == socket->ack_number()) {
             if (payload_size != 0)
                 socket->did_receive(ipv4_packet.source(), tcp_packet.source_port(), KBuffer::copy(&ipv4_packet, sizeof(IPv4Packet) + ipv4_packet.payload_size()), packet_timestamp);
 
@@ -587,17 +731,22 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
             return;
         }
 
-        socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
-
 #if TCP_DEBUG
-        klog() << "Got packet with ack_no=" << tcp_packet.ack_number() << ", seq_no=" << tcp_packet.sequence_number() << ", payload_size=" << payload_size << ", acking it with new ack_no=" << socket->ack_number() << ", seq_no=" << socket->sequence_number();
+        klog() << "Got packet with ack_no=" << tcp_packet.ack_number() << ", seq_no=" << tcp_packet.sequence_number() << ", payload_size=" << payload_size << ", expecting seq_no=" << socket->ack_number() << ", our seq_no=" << socket->sequence_number();
 #endif
 
-        if (payload_size) {
-            if (socket->did_receive(ipv4_packet.source(), tcp_packet.source_port(), KBuffer::copy(&ipv4_packet, sizeof(IPv4Packet) + ipv4_packet.payload_size()), packet_timestamp))
-                unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
-        }
+        // NOTE: A FIN that arrives ahead of missing data is held on to until the hole is filled.
+        if (payload_size || tcp_packet.has_fin())
+            socket->receive_payload(ipv4_packet, tcp_packet, payload_size, packet_timestamp);
     }
 }
 
+void retransmit_tcp_packets()
+{
+    // NOTE: We hold references so the sockets can't go away while we work on them.
+    auto sockets = TCPSocket::sockets_with_outstanding_data();
+    for (auto& socket : sockets)
+        socket.retransmit_packets();
+}
+
 }
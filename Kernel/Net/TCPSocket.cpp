@@ -40,9 +40,11 @@ namespace Kernel {
 
 void TCPSocket::for_each(Function<void(const TCPSocket&)> callback)
 {
-    LOCKER(sockets_by_tuple().lock(), Lock::Mode::Shared);
-    for (auto& it : sockets_by_tuple().resource())
-        callback(*it.value);
+    for_each_socket_table([&](auto& table) {
+        LOCKER(table.lock(), Lock::Mode::Shared);
+        for (auto& it : table.resource())
+            callback(*it.value);
+    });
 }
 
 void TCPSocket::set_state(State new_state)
@@ -73,32 +75,41 @@ Lockable<HashMap<IPv4SocketTuple, RefPtr<TCPSocket>>>& TCPSocket::closing_socket
     return *s_socket_closing;
 }
 
-static AK::Singleton<Lockable<HashMap<IPv4SocketTuple, TCPSocket*>>> s_socket_tuples;
+static AK::Singleton<Array<TCPSocket::SocketTable, TCPSocket::socket_table_shard_count>> s_socket_tuples;
 
-Lockable<HashMap<IPv4SocketTuple, TCPSocket*>>& TCPSocket::sockets_by_tuple()
+TCPSocket::SocketTable& TCPSocket::sockets_by_tuple(const IPv4SocketTuple& tuple)
 {
-    return *s_socket_tuples;
+    return (*s_socket_tuples)[Traits<IPv4SocketTuple>::hash(tuple) % socket_table_shard_count];
 }
 
-RefPtr<TCPSocket> TCPSocket::from_tuple(const IPv4SocketTuple& tuple)
+void TCPSocket::for_each_socket_table(Function<void(SocketTable&)> callback)
 {
-    LOCKER(sockets_by_tuple().lock(), Lock::Mode::Shared);
+    for (auto& table : *s_socket_tuples)
+        callback(table);
+}
 
-    auto exact_match = sockets_by_tuple().resource().get(tuple);
-    if (exact_match.has_value())
-        return { *exact_match.value() };
+static RefPtr<TCPSocket> lookup_in_socket_table(const IPv4SocketTuple& tuple)
+{
+    auto& table = TCPSocket::sockets_by_tuple(tuple);
+    LOCKER(table.lock(), Lock::Mode::Shared);
+    auto match = table.resource().get(tuple);
+    // NOTE: The socket may already be on its way out, waiting for us to let go of the table.
+    if (!match.has_value() || !match.value()->try_ref())
+        return {};
+    return adopt(*match.value());
+}
+
+RefPtr<TCPSocket> TCPSocket::from_tuple(const IPv4SocketTuple& tuple)
+{
+    if (auto exact_match = lookup_in_socket_table(tuple))
+        return exact_match;
 
     auto address_tuple = IPv4SocketTuple(tuple.local_address(), tuple.local_port(), IPv4Address(), 0);
-    auto address_match = sockets_by_tuple().resource().get(address_tuple);
-    if (address_match.has_value())
-        return { *address_match.value() };
+    if (auto address_match = lookup_in_socket_table(address_tuple))
+        return address_match;
 
     auto wildcard_tuple = IPv4SocketTuple(IPv4Address(), tuple.local_port(), IPv4Address(), 0);
-    auto wildcard_match = sockets_by_tuple().resource().get(wildcard_tuple);
-    if (wildcard_match.has_value())
-        return { *wildcard_match.value() };
-
-    return {};
+    return lookup_in_socket_table(wildcard_tuple);
 }
 
 RefPtr<TCPSocket> TCPSocket::from_endpoints(const IPv4Address& local_address, u16 local_port, const IPv4Address& peer_address, u16 peer_port)
@@ -110,8 +121,9 @@ RefPtr<TCPSocket> TCPSocket::create_client(const IPv4Address& new_local_address,
 {
     auto tuple = IPv4SocketTuple(new_local_address, new_local_port, new_peer_address, new_peer_port);
 
-    LOCKER(sockets_by_tuple().lock());
-    if (sockets_by_tuple().resource().contains(tuple))
+    auto& table = sockets_by_tuple(tuple);
+    LOCKER(table.lock());
+    if (table.resource().contains(tuple))
         return {};
 
     auto client = TCPSocket::create(protocol());
@@ -125,9 +137,9 @@ RefPtr<TCPSocket> TCPSocket::create_client(const IPv4Address& new_local_address,
     client->set_originator(*this);
 
     m_pending_release_for_accept.set(tuple, client);
-    sockets_by_tuple().resource().set(tuple, client);
+    table.resource().set(tuple, client);
 
-    return from_tuple(tuple);
+    return client;
 }
 
 void TCPSocket::release_to_originator()
@@ -138,6 +150,8 @@ void TCPSocket::release_to_originator()
 
 void TCPSocket::release_for_accept(RefPtr<TCPSocket> socket)
 {
+    // NOTE: This runs on behalf of the client, so another network worker may be creating clients for us right now.
+    LOCKER(lock());
     VERIFY(m_pending_release_for_accept.contains(socket->tuple()));
     m_pending_release_for_accept.remove(socket->tuple());
     // FIXME: Should we observe this error somehow?
@@ -145,14 +159,17 @@ void TCPSocket::release_for_accept(RefPtr<TCPSocket> socket)
 }
 
 TCPSocket::TCPSocket(int protocol)
-    : IPv4Socket(SOCK_STREAM, protocol)
+    : IPv4Socket(SOCK_STREAM, protocol, receive_buffer_size)
 {
+    while ((receive_buffer_size >> m_receive_window_scale) > NumericLimits<u16>::max())
+        ++m_receive_window_scale;
 }
 
 TCPSocket::~TCPSocket()
 {
-    LOCKER(sockets_by_tuple().lock());
-    sockets_by_tuple().resource().remove(tuple());
+    auto& table = sockets_by_tuple(tuple());
+    LOCKER(table.lock());
+    table.resource().remove(tuple());
 
     dbgln_if(TCP_SOCKET_DEBUG, "~TCPSocket in state {}", to_string(state()));
 }
@@ -162,6 +179,127 @@ NonnullRefPtr<TCPSocket> TCPSocket::create(int protocol)
     return adopt(*new TCPSocket(protocol));
 }
 
+static constexpr u32 default_maximum_segment_size = 536;
+// NOTE: Capping the segment size keeps several segments in flight even on the loopback
+//       adapter, so a single lost segment can be repaired by fast retransmit.
+static constexpr u32 maximum_segment_size_limit = 8 * KiB;
+static constexpr u32 minimum_retransmission_timeout_usec = 200000;
+static constexpr u32 maximum_retransmission_timeout_usec = 60000000;
+
+static inline bool sequence_before(u32 a, u32 b)
+{
+    return (i32)(a - b) < 0;
+}
+
+static inline bool sequence_before_or_equal(u32 a, u32 b)
+{
+    return (i32)(a - b) <= 0;
+}
+
+static u32 usec_between(const timeval& start, const timeval& end)
+{
+    timeval diff;
+    timeval_sub(end, start, diff);
+    if (diff.tv_sec < 0)
+        return 0;
+    return min<u64>((u64)diff.tv_sec * 1000000 + diff.tv_usec, NumericLimits<u32>::max());
+}
+
+// RFC 3390: min(4 * MSS, max(2 * MSS, 4380 bytes))
+static u32 initial_congestion_window(u32 maximum_segment_size)
+{
+    return min(4 * maximum_segment_size, max(2 * maximum_segment_size, 4380u));
+}
+
+void TCPSocket::set_sequence_number(u32 n)
+{
+    LOCKER(m_not_acked_lock);
+    m_sequence_number = n;
+    m_send_unacknowledged = n;
+    m_send_next = n;
+    m_send_maximum = n;
+    m_recovery_point = n;
+    m_congestion_window = initial_congestion_window(m_maximum_segment_size);
+}
+
+u32 TCPSocket::receive_window() const
+{
+    return receive_buffer_space();
+}
+
+u16 TCPSocket::advertised_window_field(bool is_syn)
+{
+    // NOTE: The window in a SYN segment is never scaled (RFC 7323).
+    u8 scale = (is_syn || !m_peer_sent_window_scale) ? 0 : m_receive_window_scale;
+    u32 window = min(receive_window() >> scale, (u32)NumericLimits<u16>::max());
+    m_last_advertised_window = window << scale;
+    return window;
+}
+
+u32 TCPSocket::local_maximum_segment_size() const
+{
+    auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
+    if (routing_decision.is_zero())
+        return default_maximum_segment_size;
+    return min((u32)(routing_decision.adapter->mtu() - sizeof(IPv4Packet) - sizeof(TCPPacket)), maximum_segment_size_limit);
+}
+
+size_t TCPSocket::build_syn_options(u8* options, bool is_reply) const
+{
+    u16 maximum_segment_size = local_maximum_segment_size();
+    options[0] = TCPOptionKind::MSS;
+    options[1] = 4;
+    options[2] = maximum_segment_size >> 8;
+    options[3] = maximum_segment_size & 0xff;
+
+    // We may only answer with a window scale if the peer offered one first.
+    if (is_reply && !m_peer_sent_window_scale)
+        return 4;
+
+    options[4] = TCPOptionKind::Nop;
+    options[5] = TCPOptionKind::WindowScale;
+    options[6] = 3;
+    options[7] = m_receive_window_scale;
+    return 8;
+}
+
+void TCPSocket::receive_tcp_options(const TCPPacket& packet)
+{
+    u32 peer_maximum_segment_size = default_maximum_segment_size;
+    Optional<u8> peer_window_scale;
+
+    auto* options = packet.options();
+    size_t options_size = packet.options_size();
+    for (size_t i = 0; i < options_size;) {
+        u8 kind = options[i];
+        if (kind == TCPOptionKind::End)
+            break;
+        if (kind == TCPOptionKind::Nop) {
+            ++i;
+            continue;
+        }
+        if (i + 1 >= options_size)
+            break;
+        u8 length = options[i + 1];
+        if (length < 2 || i + length > options_size)
+            break;
+        if (kind == TCPOptionKind::MSS && length == 4)
+            peer_maximum_segment_size = (options[i + 2] << 8) | options[i + 3];
+        else if (kind == TCPOptionKind::WindowScale && length == 3)
+            peer_window_scale = min(options[i + 2], (u8)14);
+        i += length;
+    }
+
+    auto local_segment_size = local_maximum_segment_size();
+
+    LOCKER(m_not_acked_lock);
+    m_peer_sent_window_scale = peer_window_scale.has_value();
+    m_send_window_scale = peer_window_scale.value_or(0);
+    m_send_window = packet.window_size();
+    m_maximum_segment_size = max(min(peer_maximum_segment_size, local_segment_size), 64u);
+    m_congestion_window = initial_congestion_window(m_maximum_segment_size);
+}
+
 KResultOr<size_t> TCPSocket::protocol_receive(ReadonlyBytes raw_ipv4_packet, UserOrKernelBuffer& buffer, size_t buffer_size, [[maybe_unused]] int flags)
 {
     auto& ipv4_packet = *reinterpret_cast<const IPv4Packet*>(raw_ipv4_packet.data());
@@ -178,124 +316,467 @@ KResultOr<size_t> TCPSocket::protocol_receive(ReadonlyBytes raw_ipv4_packet, Use
 
 KResultOr<size_t> TCPSocket::protocol_send(const UserOrKernelBuffer& data, size_t data_length)
 {
-    int err = send_tcp_packet(TCPFlags::PUSH | TCPFlags::ACK, &data, data_length);
-    if (err < 0)
-        return KResult((ErrnoCode)-err);
+    size_t segment_size = m_maximum_segment_size;
+    for (size_t offset = 0; offset < data_length; offset += segment_size) {
+        auto segment = data.offset(offset);
+        auto result = send_tcp_packet(TCPFlags::PUSH | TCPFlags::ACK, &segment, min(segment_size, data_length - offset));
+        if (result.is_error()) {
+            if (offset)
+                return offset;
+            return result;
+        }
+    }
     return data_length;
 }
 
-KResult TCPSocket::send_tcp_packet(u16 flags, const UserOrKernelBuffer* payload, size_t payload_size)
+bool TCPSocket::can_write(const FileDescription& description, size_t size) const
+{
+    if (!IPv4Socket::can_write(description, size))
+        return false;
+    return m_sequence_number - m_send_unacknowledged < send_buffer_size;
+}
+
+ByteBuffer TCPSocket::create_packet(u16 flags, size_t payload_size) const
 {
-    const size_t buffer_size = sizeof(TCPPacket) + payload_size;
-    auto buffer = ByteBuffer::create_zeroed(buffer_size);
+    u8 options[8];
+    size_t options_size = 0;
+    if (flags & TCPFlags::SYN)
+        options_size = build_syn_options(options, flags & TCPFlags::ACK);
+
+    // NOTE: Only the header is cleared, the caller fills in the entire payload.
+    const size_t header_size = sizeof(TCPPacket) + options_size;
+    auto buffer = ByteBuffer::create_uninitialized(header_size + payload_size);
+    memset(buffer.data(), 0, header_size);
     auto& tcp_packet = *(TCPPacket*)(buffer.data());
     VERIFY(local_port());
     tcp_packet.set_source_port(local_port());
     tcp_packet.set_destination_port(peer_port());
-    tcp_packet.set_window_size(1024);
-    tcp_packet.set_sequence_number(m_sequence_number);
-    tcp_packet.set_data_offset(sizeof(TCPPacket) / sizeof(u32));
+    tcp_packet.set_data_offset(header_size / sizeof(u32));
     tcp_packet.set_flags(flags);
+    if (options_size)
+        memcpy(tcp_packet.options(), options, options_size);
+    return buffer;
+}
 
-    if (flags & TCPFlags::ACK)
-        tcp_packet.set_ack_number(m_ack_number);
-
+KResult TCPSocket::send_tcp_packet(u16 flags, const UserOrKernelBuffer* payload, size_t payload_size)
+{
+    auto buffer = create_packet(flags, payload_size);
+    auto& tcp_packet = *(TCPPacket*)(buffer.data());
     if (payload && !payload->read(tcp_packet.payload(), payload_size))
         return EFAULT;
+    return send_packet(move(buffer), payload_size);
+}
 
-    if (flags & TCPFlags::SYN) {
-        ++m_sequence_number;
-    } else {
-        m_sequence_number += payload_size;
-    }
-
-    tcp_packet.set_checksum(compute_tcp_checksum(local_address(), peer_address(), tcp_packet, payload_size));
+KResult TCPSocket::send_packet(ByteBuffer&& buffer, size_t payload_size)
+{
+    auto& tcp_packet = *(TCPPacket*)(buffer.data());
 
-    if (tcp_packet.has_syn() || payload_size > 0) {
-        LOCKER(m_not_acked_lock);
-        m_not_acked.append({ m_sequence_number, move(buffer) });
+    // SYN, FIN and data occupy sequence space, so they are queued until acknowledged
+    // and go out as the send and congestion windows allow.
+    if (tcp_packet.has_syn() || tcp_packet.has_fin() || payload_size > 0) {
+        {
+            LOCKER(m_not_acked_lock);
+            auto sequence_number = m_sequence_number;
+            tcp_packet.set_sequence_number(sequence_number);
+            if (tcp_packet.has_syn() || tcp_packet.has_fin())
+                ++m_sequence_number;
+            m_sequence_number += payload_size;
+            m_not_acked.append({ sequence_number, m_sequence_number, move(buffer) });
+        }
         send_outgoing_packets();
         return KSuccess;
     }
 
+    tcp_packet.set_sequence_number(m_send_next);
+    if (tcp_packet.has_ack())
+        tcp_packet.set_ack_number(m_ack_number);
+    tcp_packet.set_window_size(advertised_window_field(false));
+    tcp_packet.set_checksum(compute_tcp_checksum(local_address(), peer_address(), tcp_packet, payload_size));
+
     auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
     VERIFY(!routing_decision.is_zero());
 
     auto packet_buffer = UserOrKernelBuffer::for_kernel_buffer(buffer.data());
     auto result = routing_decision.adapter->send_ipv4(
         routing_decision.next_hop, peer_address(), IPv4Protocol::TCP,
-        packet_buffer, buffer_size, ttl());
+        packet_buffer, buffer.size(), ttl());
     if (result.is_error())
         return result;
 
     m_packets_out++;
-    m_bytes_out += buffer_size;
+    m_bytes_out += buffer.size();
     return KSuccess;
 }
 
+KResultOr<size_t> TCPSocket::send_from_inode(Inode& inode, off_t offset, size_t count)
+{
+    // NOTE: Like write(), a connection that has gone away is a broken pipe.
+    if (is_shut_down_for_writing())
+        return EPIPE;
+    if (state() != State::Established && state() != State::CloseWait)
+        return (m_role == Role::Connected || m_role == Role::Accepted) ? EPIPE : ENOTCONN;
+
+    // Each segment is read straight from the inode (and so the disk cache) into its packet buffer.
+    size_t segment_size = m_maximum_segment_size;
+    size_t nsent = 0;
+    while (nsent < count) {
+        size_t size = min(segment_size, count - nsent);
+        auto buffer = create_packet(TCPFlags::PUSH | TCPFlags::ACK, size);
+        auto& tcp_packet = *(TCPPacket*)(buffer.data());
+        auto payload = UserOrKernelBuffer::for_kernel_buffer((u8*)tcp_packet.payload());
+        auto nread = inode.read_bytes(offset + nsent, size, payload, nullptr);
+        if (nread <= 0) {
+            if (nread < 0 && !nsent)
+                return KResult((ErrnoCode)-nread);
+            break;
+        }
+        buffer.trim(tcp_packet.header_size() + nread);
+        auto result = send_packet(move(buffer), nread);
+        if (result.is_error()) {
+            if (nsent)
+                break;
+            return result;
+        }
+        nsent += nread;
+        if ((size_t)nread < size)
+            break;
+    }
+    return nsent;
+}
+
+void TCPSocket::transmit(OutgoingPacket& packet, RoutingDecision& routing_decision)
+{
+    VERIFY(m_not_acked_lock.is_locked());
+
+    // The acknowledgement and window may have moved on since the packet was queued.
+    auto& tcp_packet = *(TCPPacket*)(packet.buffer.data());
+    if (tcp_packet.has_ack())
+        tcp_packet.set_ack_number(m_ack_number);
+    tcp_packet.set_window_size(advertised_window_field(tcp_packet.has_syn()));
+    tcp_packet.set_checksum(0);
+    tcp_packet.set_checksum(compute_tcp_checksum(local_address(), peer_address(), tcp_packet, packet.buffer.size() - tcp_packet.header_size()));
+
+    packet.tx_time = kgettimeofday();
+    if (packet.tx_counter++)
+        m_retransmits++;
+
+#if TCP_SOCKET_DEBUG
+    klog() << "sending tcp packet from " << local_address().to_string().characters() << ":" << local_port() << " to " << peer_address().to_string().characters() << ":" << peer_port() << " with (" << (tcp_packet.has_syn() ? "SYN " : "") << (tcp_packet.has_ack() ? "ACK " : "") << (tcp_packet.has_fin() ? "FIN " : "") << (tcp_packet.has_rst() ? "RST " : "") << ") seq_no=" << tcp_packet.sequence_number() << ", ack_no=" << tcp_packet.ack_number() << ", tx_counter=" << packet.tx_counter;
+#endif
+    auto packet_buffer = UserOrKernelBuffer::for_kernel_buffer(packet.buffer.data());
+    int err = routing_decision.adapter->send_ipv4(
+        routing_decision.next_hop, peer_address(), IPv4Protocol::TCP,
+        packet_buffer, packet.buffer.size(), ttl());
+    if (err < 0) {
+        klog() << "Error (" << err << ") sending tcp packet from " << local_address().to_string().characters() << ":" << local_port() << " to " << peer_address().to_string().characters() << ":" << peer_port() << " with (" << (tcp_packet.has_syn() ? "SYN " : "") << (tcp_packet.has_ack() ? "ACK " : "") << (tcp_packet.has_fin() ? "FIN " : "") << (tcp_packet.has_rst() ? "RST " : "") << ") seq_no=" << tcp_packet.sequence_number() << ", ack_no=" << tcp_packet.ack_number() << ", tx_counter=" << packet.tx_counter;
+    } else {
+        m_packets_out++;
+        m_bytes_out += packet.buffer.size();
+    }
+}
+
+void TCPSocket::split_off_zero_window_probe(SinglyLinkedList<OutgoingPacket>::Iterator it)
+{
+    VERIFY(m_not_acked_lock.is_locked());
+
+    // RFC 1122, 4.2.2.17: Probe a closed window with a single byte, the rest goes out once it opens up.
+    auto& packet = *it;
+    auto& tcp_packet = *(const TCPPacket*)(packet.buffer.data());
+    size_t header_size = tcp_packet.header_size();
+    size_t payload_size = packet.buffer.size() - header_size;
+    if (tcp_packet.has_syn() || payload_size <= 1)
+        return;
+    u16 flags = tcp_packet.flags();
+
+    auto rest = ByteBuffer::create_uninitialized(packet.buffer.size() - 1);
+    memcpy(rest.data(), packet.buffer.data(), header_size);
+    memcpy(rest.data() + header_size, packet.buffer.data() + header_size + 1, payload_size - 1);
+    ((TCPPacket*)rest.data())->set_sequence_number(packet.sequence_number + 1);
+    OutgoingPacket rest_packet { packet.sequence_number + 1, packet.ack_number, move(rest) };
+
+    packet.buffer = ByteBuffer::copy(packet.buffer.data(), header_size + 1);
+    ((TCPPacket*)packet.buffer.data())->set_flags(flags & ~TCPFlags::FIN);
+    packet.ack_number = packet.sequence_number + 1;
+    m_not_acked.insert_after(it, move(rest_packet));
+}
+
+void TCPSocket::send_new_packets(RoutingDecision& routing_decision)
+{
+    VERIFY(m_not_acked_lock.is_locked());
+
+    for (auto it = m_not_acked.begin(); !it.is_end(); ++it) {
+        auto& packet = *it;
+        if (sequence_before(packet.sequence_number, m_send_next))
+            continue;
+
+        // NOTE: With nothing in flight we always send one segment, which doubles as a zero window probe.
+        if (bytes_in_flight() == 0 && m_send_window == 0)
+            split_off_zero_window_probe(it);
+        u32 window = min(m_congestion_window, m_send_window);
+        u32 segment_size = packet.ack_number - packet.sequence_number;
+        if (bytes_in_flight() > 0 && bytes_in_flight() + segment_size > window)
+            break;
+
+        if (bytes_in_flight() == 0)
+            m_retransmit_timer_start = kgettimeofday();
+        transmit(packet, routing_decision);
+        m_send_next = packet.ack_number;
+        if (sequence_before(m_send_maximum, m_send_next))
+            m_send_maximum = m_send_next;
+    }
+}
+
 void TCPSocket::send_outgoing_packets()
 {
+    if (m_send_next == m_sequence_number)
+        return;
+
     auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
     VERIFY(!routing_decision.is_zero());
 
+    LOCKER(m_not_acked_lock);
+    send_new_packets(routing_decision);
+}
+
+void TCPSocket::retransmit_packets()
+{
+    auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
+    if (routing_decision.is_zero())
+        return;
+
     auto now = kgettimeofday();
 
-    LOCKER(m_not_acked_lock, Lock::Mode::Shared);
-    for (auto& packet : m_not_acked) {
-        timeval diff;
-        timeval_sub(packet.tx_time, now, diff);
-        if (diff.tv_sec == 0 && diff.tv_usec <= 500000)
-            continue;
-        packet.tx_time = now;
-        packet.tx_counter++;
+    LOCKER(m_not_acked_lock);
+    if (m_not_acked.is_empty())
+        return;
 
-#if TCP_SOCKET_DEBUG
-        auto& tcp_packet = *(TCPPacket*)(packet.buffer.data());
-        klog() << "sending tcp packet from " << local_address().to_string().characters() << ":" << local_port() << " to " << peer_address().to_string().characters() << ":" << peer_port() << " with (" << (tcp_packet.has_syn() ? "SYN " : "") << (tcp_packet.has_ack() ? "ACK " : "") << (tcp_packet.has_fin() ? "FIN " : "") << (tcp_packet.has_rst() ? "RST " : "") << ") seq_no=" << tcp_packet.sequence_number() << ", ack_no=" << tcp_packet.ack_number() << ", tx_counter=" << packet.tx_counter;
-#endif
-        auto packet_buffer = UserOrKernelBuffer::for_kernel_buffer(packet.buffer.data());
-        int err = routing_decision.adapter->send_ipv4(
-            routing_decision.next_hop, peer_address(), IPv4Protocol::TCP,
-            packet_buffer, packet.buffer.size(), ttl());
-        if (err < 0) {
-            auto& tcp_packet = *(TCPPacket*)(packet.buffer.data());
-            klog() << "Error (" << err << ") sending tcp packet from " << local_address().to_string().characters() << ":" << local_port() << " to " << peer_address().to_string().characters() << ":" << peer_port() << " with (" << (tcp_packet.has_syn() ? "SYN " : "") << (tcp_packet.has_ack() ? "ACK " : "") << (tcp_packet.has_fin() ? "FIN " : "") << (tcp_packet.has_rst() ? "RST " : "") << ") seq_no=" << tcp_packet.sequence_number() << ", ack_no=" << tcp_packet.ack_number() << ", tx_counter=" << packet.tx_counter;
-        } else {
-            m_packets_out++;
-            m_bytes_out += packet.buffer.size();
-        }
+    if (bytes_in_flight() == 0) {
+        send_new_packets(routing_decision);
+        return;
     }
+
+    if (usec_between(m_retransmit_timer_start, now) < m_retransmission_timeout_usec)
+        return;
+
+    // RFC 5681, section 3.1: Collapse to one segment and start over in slow start.
+    // RFC 6298, section 5: Back off the timer and resend the oldest unacknowledged segment.
+    dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket({}): Retransmission timeout after {} us", this, m_retransmission_timeout_usec);
+    m_retransmission_timeouts++;
+    m_slow_start_threshold = max((m_send_maximum - m_send_unacknowledged) / 2, 2 * m_maximum_segment_size);
+    m_congestion_window = m_maximum_segment_size;
+    m_duplicate_acks = 0;
+    m_in_fast_recovery = false;
+    m_recovery_point = m_send_maximum;
+    m_retransmission_timeout_usec = min(m_retransmission_timeout_usec * 2, maximum_retransmission_timeout_usec);
+
+    // Everything after the first segment goes out again as the congestion window reopens.
+    auto& packet = m_not_acked.first();
+    transmit(packet, routing_decision);
+    m_send_next = packet.ack_number;
+    m_retransmit_timer_start = now;
 }
 
-void TCPSocket::receive_tcp_packet(const TCPPacket& packet, u16 size)
+void TCPSocket::update_rtt_estimate(u32 rtt_usec)
 {
-    if (packet.has_ack()) {
-        u32 ack_number = packet.ack_number();
+    // RFC 6298, section 2
+    rtt_usec = max(rtt_usec, 1u);
+    if (m_smoothed_rtt_usec == 0) {
+        m_smoothed_rtt_usec = rtt_usec;
+        m_rtt_variance_usec = rtt_usec / 2;
+    } else {
+        u32 delta = m_smoothed_rtt_usec > rtt_usec ? m_smoothed_rtt_usec - rtt_usec : rtt_usec - m_smoothed_rtt_usec;
+        m_rtt_variance_usec = (3 * m_rtt_variance_usec + delta) / 4;
+        m_smoothed_rtt_usec = (7 * m_smoothed_rtt_usec + rtt_usec) / 8;
+    }
+    u32 timeout = m_smoothed_rtt_usec + max(retransmit_timer_interval_ms * 1000, 4 * m_rtt_variance_usec);
+    m_retransmission_timeout_usec = clamp(timeout, minimum_retransmission_timeout_usec, maximum_retransmission_timeout_usec);
+}
+
+bool TCPSocket::process_ack(const TCPPacket& packet, size_t payload_size)
+{
+    u32 ack_number = packet.ack_number();
+    u32 window = packet.has_syn() ? packet.window_size() : (u32)packet.window_size() << m_send_window_scale;
+    auto now = kgettimeofday();
 
-        dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: receive_tcp_packet: {}", ack_number);
+    LOCKER(m_not_acked_lock);
 
-        int removed = 0;
-        LOCKER(m_not_acked_lock);
-        while (!m_not_acked.is_empty()) {
-            auto& packet = m_not_acked.first();
+    if (sequence_before(ack_number, m_send_unacknowledged) || sequence_before(m_send_maximum, ack_number))
+        return false;
 
-            dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: iterate: {}", packet.ack_number);
+    if (ack_number == m_send_unacknowledged) {
+        bool is_duplicate = payload_size == 0 && !packet.has_syn() && !packet.has_fin()
+            && window == m_send_window && bytes_in_flight() > 0;
+        m_send_window = window;
+        if (!is_duplicate)
+            return false;
+
+        ++m_duplicate_acks;
+        if (m_in_fast_recovery) {
+            // RFC 5681, section 3.2, step 4: Every further duplicate means a segment has left the network.
+            m_congestion_window += m_maximum_segment_size;
+            return false;
+        }
 
-            if (packet.ack_number <= ack_number) {
-                m_not_acked.take_first();
-                removed++;
-            } else {
-                break;
-            }
+        // RFC 6582, section 3.2, step 2: Don't restart recovery for losses we already repaired.
+        if (m_duplicate_acks != 3 || !sequence_before(m_recovery_point, ack_number))
+            return false;
+
+        auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
+        if (routing_decision.is_zero())
+            return false;
+
+        dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket({}): Fast retransmit of {}", this, ack_number);
+        m_fast_retransmits++;
+        m_slow_start_threshold = max(bytes_in_flight() / 2, 2 * m_maximum_segment_size);
+        m_congestion_window = m_slow_start_threshold + 3 * m_maximum_segment_size;
+        m_recovery_point = m_send_maximum;
+        m_in_fast_recovery = true;
+        transmit(m_not_acked.first(), routing_decision);
+        m_retransmit_timer_start = now;
+        return false;
+    }
+
+    u32 acked_bytes = ack_number - m_send_unacknowledged;
+    Optional<u32> rtt_sample;
+    while (!m_not_acked.is_empty() && sequence_before_or_equal(m_not_acked.first().ack_number, ack_number)) {
+        auto packet = m_not_acked.take_first();
+        // Karn's algorithm: Retransmitted segments give ambiguous samples.
+        if (packet.tx_counter == 1 && !rtt_sample.has_value())
+            rtt_sample = usec_between(packet.tx_time, now);
+    }
+
+    m_send_unacknowledged = ack_number;
+    if (sequence_before(m_send_next, ack_number))
+        m_send_next = ack_number;
+    m_send_window = window;
+    m_retransmit_timer_start = now;
+    if (rtt_sample.has_value())
+        update_rtt_estimate(rtt_sample.value());
+
+    if (m_in_fast_recovery) {
+        if (!sequence_before(ack_number, m_recovery_point)) {
+            // RFC 6582, section 3.2, step 3: Full acknowledgement, deflate the window.
+            m_congestion_window = min(m_slow_start_threshold, max(bytes_in_flight(), m_maximum_segment_size) + m_maximum_segment_size);
+            m_in_fast_recovery = false;
+            m_duplicate_acks = 0;
+        } else if (!m_not_acked.is_empty()) {
+            // Partial acknowledgement: The next hole is right after what was just acknowledged.
+            auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
+            if (!routing_decision.is_zero())
+                transmit(m_not_acked.first(), routing_decision);
+            m_congestion_window -= min(acked_bytes, m_congestion_window);
+            if (acked_bytes >= m_maximum_segment_size)
+                m_congestion_window += m_maximum_segment_size;
         }
+        return true;
+    }
+
+    m_duplicate_acks = 0;
+    if (m_congestion_window < m_slow_start_threshold)
+        m_congestion_window += min(acked_bytes, m_maximum_segment_size);
+    else
+        m_congestion_window += max(m_maximum_segment_size * m_maximum_segment_size / m_congestion_window, 1u);
+    return true;
+}
+
+void TCPSocket::receive_tcp_packet(const TCPPacket& packet, u16 size)
+{
+    if (packet.has_syn() && state() != State::Listen)
+        receive_tcp_options(packet);
 
-        dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: receive_tcp_packet acknowledged {} packets", removed);
+    if (packet.has_ack()) {
+        dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: receive_tcp_packet: {}", packet.ack_number());
+
+        if (process_ack(packet, size - packet.header_size()))
+            evaluate_block_conditions();
+        send_outgoing_packets();
     }
 
     m_packets_in++;
     m_bytes_in += packet.header_size() + size;
 }
 
+void TCPSocket::receive_payload(const IPv4Packet& ipv4_packet, const TCPPacket& tcp_packet, size_t payload_size, const timeval& packet_timestamp)
+{
+    auto sequence_number = tcp_packet.sequence_number();
+    auto packet_data = KBuffer::copy(&ipv4_packet, sizeof(IPv4Packet) + ipv4_packet.payload_size());
+
+    if (sequence_number == m_ack_number) {
+        if (did_receive(ipv4_packet.source(), tcp_packet.source_port(), move(packet_data), packet_timestamp)) {
+            m_ack_number += payload_size;
+
+            // The hole may have been filled, hand over whatever we were holding on to.
+            while (!m_out_of_order.is_empty()) {
+                auto& next = m_out_of_order.first();
+                if (sequence_before(m_ack_number, next.sequence_number))
+                    break;
+                if (next.sequence_number == m_ack_number) {
+                    if (next.payload_size && !did_receive(peer_address(), peer_port(), KBuffer(next.data), next.timestamp))
+                        break;
+                    m_ack_number += next.payload_size;
+                    if (next.has_fin) {
+                        // The peer's FIN was waiting for the hole to be filled, nothing can come after it.
+                        m_ack_number++;
+                        m_out_of_order.clear();
+                        [[maybe_unused]] auto rc = send_tcp_packet(TCPFlags::ACK);
+                        set_state(State::CloseWait);
+                        set_connected(false);
+                        return;
+                    }
+                }
+                m_out_of_order.remove(0);
+            }
+        }
+    } else if (sequence_before(m_ack_number, sequence_number)) {
+        m_out_of_order_packets++;
+        bool fits_in_window = sequence_number + payload_size - m_ack_number <= receive_buffer_size;
+        if ((payload_size > 0 || tcp_packet.has_fin()) && fits_in_window && m_out_of_order.size() < maximum_out_of_order_packets) {
+            size_t index = 0;
+            while (index < m_out_of_order.size() && sequence_before(m_out_of_order[index].sequence_number, sequence_number))
+                ++index;
+            if (index == m_out_of_order.size() || m_out_of_order[index].sequence_number != sequence_number)
+                m_out_of_order.insert(index, { sequence_number, payload_size, tcp_packet.has_fin(), packet_timestamp, move(packet_data) });
+            else if (tcp_packet.has_fin() && m_out_of_order[index].payload_size == payload_size)
+                m_out_of_order[index].has_fin = true;
+        }
+    }
+
+    // NOTE: Anything but the next in-order segment gets a duplicate ACK right away (RFC 5681, section 4.2),
+    //       which is what lets the sender detect the loss without waiting for a timeout.
+    [[maybe_unused]] auto rc = send_tcp_packet(TCPFlags::ACK);
+}
+
+void TCPSocket::protocol_did_read(size_t)
+{
+    if (state() != State::Established)
+        return;
+
+    // Only announce the window once it has opened up by a useful amount (RFC 1122, 4.2.3.3).
+    u32 window = receive_window();
+    if (window <= m_last_advertised_window)
+        return;
+    if (window - m_last_advertised_window < min(receive_buffer_size / 2, 2 * m_maximum_segment_size))
+        return;
+    [[maybe_unused]] auto rc = send_tcp_packet(TCPFlags::ACK);
+}
+
+NonnullRefPtrVector<TCPSocket> TCPSocket::sockets_with_outstanding_data()
+{
+    NonnullRefPtrVector<TCPSocket> sockets;
+    for_each_socket_table([&](auto& table) {
+        LOCKER(table.lock(), Lock::Mode::Shared);
+        for (auto& it : table.resource()) {
+            auto& socket = *it.value;
+            if (socket.m_send_unacknowledged == socket.m_sequence_number)
+                continue;
+            // NOTE: The socket may already be on its way out, waiting for us to let go of the table.
+            if (socket.try_ref())
+                sockets.append(adopt(socket));
+        }
+    });
+    return sockets;
+}
+
 NetworkOrdered<u16> TCPSocket::compute_tcp_checksum(const IPv4Address& source, const IPv4Address& destination, const TCPPacket& packet, u16 payload_size)
 {
     struct [[gnu::packed]] PseudoHeader {
@@ -306,7 +787,7 @@ NetworkOrdered<u16> TCPSocket::compute_tcp_checksum(const IPv4Address& source, c
         NetworkOrdered<u16> payload_size;
     };
 
-    PseudoHeader pseudo_header { source, destination, 0, (u8)IPv4Protocol::TCP, sizeof(TCPPacket) + payload_size };
+    PseudoHeader pseudo_header { source, destination, 0, (u8)IPv4Protocol::TCP, (u16)(packet.header_size() + payload_size) };
 
     u32 checksum = 0;
     auto* w = (const NetworkOrdered<u16>*)&pseudo_header;
@@ -316,12 +797,11 @@ NetworkOrdered<u16> TCPSocket::compute_tcp_checksum(const IPv4Address& source, c
             checksum = (checksum >> 16) + (checksum & 0xffff);
     }
     w = (const NetworkOrdered<u16>*)&packet;
-    for (size_t i = 0; i < sizeof(packet) / sizeof(u16); ++i) {
+    for (size_t i = 0; i < packet.header_size() / sizeof(u16); ++i) {
         checksum += w[i];
         if (checksum > 0xffff)
             checksum = (checksum >> 16) + (checksum & 0xffff);
     }
-    VERIFY(packet.data_offset() * 4 == sizeof(TCPPacket));
     w = (const NetworkOrdered<u16>*)packet.payload();
     for (size_t i = 0; i < payload_size / sizeof(u16); ++i) {
         checksum += w[i];
@@ -350,10 +830,11 @@ KResult TCPSocket::protocol_bind()
 
 KResult TCPSocket::protocol_listen()
 {
-    LOCKER(sockets_by_tuple().lock());
-    if (sockets_by_tuple().resource().contains(tuple()))
+    auto& table = sockets_by_tuple(tuple());
+    LOCKER(table.lock());
+    if (table.resource().contains(tuple()))
         return EADDRINUSE;
-    sockets_by_tuple().resource().set(tuple(), this);
+    table.resource().set(tuple(), this);
     set_direction(Direction::Passive);
     set_state(State::Listen);
     set_setup_state(SetupState::Completed);
@@ -372,7 +853,7 @@ KResult TCPSocket::protocol_connect(FileDescription& description, ShouldBlock sh
 
     allocate_local_port_if_needed();
 
-    m_sequence_number = get_good_random<u32>();
+    set_sequence_number(get_good_random<u32>());
     m_ack_number = 0;
 
     set_setup_state(SetupState::InProgress);
@@ -409,14 +890,15 @@ int TCPSocket::protocol_allocate_local_port()
     static const u16 ephemeral_port_range_size = last_ephemeral_port - first_ephemeral_port;
     u16 first_scan_port = first_ephemeral_port + get_good_random<u16>() % ephemeral_port_range_size;
 
-    LOCKER(sockets_by_tuple().lock());
     for (u16 port = first_scan_port;;) {
         IPv4SocketTuple proposed_tuple(local_address(), port, peer_address(), peer_port());
 
-        auto it = sockets_by_tuple().resource().find(proposed_tuple);
-        if (it == sockets_by_tuple().resource().end()) {
+        auto& table = sockets_by_tuple(proposed_tuple);
+        LOCKER(table.lock());
+        auto it = table.resource().find(proposed_tuple);
+        if (it == table.resource().end()) {
             set_local_port(port);
-            sockets_by_tuple().resource().set(proposed_tuple, this);
+            table.resource().set(proposed_tuple, this);
             return port;
         }
         ++port;
@@ -28,12 +28,17 @@
 
 #include <AK/Function.h>
 #include <AK/HashMap.h>
+#include <AK/NonnullRefPtrVector.h>
+#include <AK/NumericLimits.h>
 #include <AK/SinglyLinkedList.h>
+#include <AK/Vector.h>
 #include <AK/WeakPtr.h>
 #include <Kernel/Net/IPv4Socket.h>
 
 namespace Kernel {
 
+struct RoutingDecision;
+
 class TCPSocket final : public IPv4Socket {
 public:
     static void for_each(Function<void(const TCPSocket&)>);
@@ -140,7 +145,7 @@ public:
     void set_error(Error error) { m_error = error; }
 
     void set_ack_number(u32 n) { m_ack_number = n; }
-    void set_sequence_number(u32 n) { m_sequence_number = n; }
+    void set_sequence_number(u32 n);
     u32 ack_number() const { return m_ack_number; }
     u32 sequence_number() const { return m_sequence_number; }
     u32 packets_in() const { return m_packets_in; }
@@ -148,15 +153,42 @@ public:
     u32 packets_out() const { return m_packets_out; }
     u32 bytes_out() const { return m_bytes_out; }
 
+    u32 maximum_segment_size() const { return m_maximum_segment_size; }
+    u32 congestion_window() const { return m_congestion_window; }
+    u32 slow_start_threshold() const { return m_slow_start_threshold; }
+    u32 send_window() const { return m_send_window; }
+    u32 receive_window() const;
+    u32 bytes_in_flight() const { return m_send_next - m_send_unacknowledged; }
+    bool has_unacknowledged_data() const { return m_send_unacknowledged != m_sequence_number; }
+    u32 smoothed_rtt_usec() const { return m_smoothed_rtt_usec; }
+    u32 rtt_variance_usec() const { return m_rtt_variance_usec; }
+    u32 retransmission_timeout_usec() const { return m_retransmission_timeout_usec; }
+    u32 retransmits() const { return m_retransmits; }
+    u32 fast_retransmits() const { return m_fast_retransmits; }
+    u32 retransmission_timeouts() const { return m_retransmission_timeouts; }
+    u32 out_of_order_packets() const { return m_out_of_order_packets; }
+
     KResult send_tcp_packet(u16 flags, const UserOrKernelBuffer* = nullptr, size_t = 0);
+    virtual KResultOr<size_t> send_from_inode(Inode&, off_t, size_t) override;
     void send_outgoing_packets();
+    void retransmit_packets();
     void receive_tcp_packet(const TCPPacket&, u16 size);
+    void receive_tcp_options(const TCPPacket&);
+    void receive_payload(const IPv4Packet&, const TCPPacket&, size_t payload_size, const timeval& packet_timestamp);
 
-    static Lockable<HashMap<IPv4SocketTuple, TCPSocket*>>& sockets_by_tuple();
+    // NOTE: The socket table is split into shards by tuple hash, so that packets for
+    //       unrelated connections can be looked up in parallel.
+    static constexpr size_t socket_table_shard_count = 16;
+    using SocketTable = Lockable<HashMap<IPv4SocketTuple, TCPSocket*>>;
+    static SocketTable& sockets_by_tuple(const IPv4SocketTuple&);
+    static void for_each_socket_table(Function<void(SocketTable&)>);
     static RefPtr<TCPSocket> from_tuple(const IPv4SocketTuple& tuple);
     static RefPtr<TCPSocket> from_endpoints(const IPv4Address& local_address, u16 local_port, const IPv4Address& peer_address, u16 peer_port);
 
     static Lockable<HashMap<IPv4SocketTuple, RefPtr<TCPSocket>>>& closing_sockets();
+    static NonnullRefPtrVector<TCPSocket> sockets_with_outstanding_data();
+
+    static constexpr u32 retransmit_timer_interval_ms = 100;
 
     RefPtr<TCPSocket> create_client(const IPv4Address& local_address, u16 local_port, const IPv4Address& peer_address, u16 peer_port);
     void set_originator(TCPSocket& originator) { m_originator = originator; }
@@ -165,6 +197,7 @@ public:
     void release_for_accept(RefPtr<TCPSocket>);
 
     virtual KResult close() override;
+    virtual bool can_write(const FileDescription&, size_t) const override;
 
 protected:
     void set_direction(Direction direction) { m_direction = direction; }
@@ -184,6 +217,30 @@ private:
     virtual bool protocol_is_disconnected() const override;
     virtual KResult protocol_bind() override;
     virtual KResult protocol_listen() override;
+    virtual void protocol_did_read(size_t) override;
+
+    struct OutgoingPacket {
+        u32 sequence_number { 0 };
+        u32 ack_number { 0 };
+        ByteBuffer buffer;
+        int tx_counter { 0 };
+        timeval tx_time { 0, 0 };
+    };
+
+    ByteBuffer create_packet(u16 flags, size_t payload_size) const;
+    KResult send_packet(ByteBuffer&&, size_t payload_size);
+    void transmit(OutgoingPacket&, RoutingDecision&);
+    void send_new_packets(RoutingDecision&);
+    void split_off_zero_window_probe(SinglyLinkedList<OutgoingPacket>::Iterator);
+    bool process_ack(const TCPPacket&, size_t payload_size);
+    void update_rtt_estimate(u32 rtt_usec);
+    u16 advertised_window_field(bool is_syn);
+    u32 local_maximum_segment_size() const;
+    size_t build_syn_options(u8* options, bool is_reply) const;
+
+    static constexpr size_t receive_buffer_size = 128 * KiB;
+    static constexpr size_t send_buffer_size = 256 * KiB;
+    static constexpr size_t maximum_out_of_order_packets = 64;
 
     WeakPtr<TCPSocket> m_originator;
     HashMap<IPv4SocketTuple, NonnullRefPtr<TCPSocket>> m_pending_release_for_accept;
@@ -198,15 +255,48 @@ private:
     u32 m_packets_out { 0 };
     u32 m_bytes_out { 0 };
 
-    struct OutgoingPacket {
-        u32 ack_number { 0 };
-        ByteBuffer buffer;
-        int tx_counter { 0 };
-        timeval tx_time { 0, 0 };
-    };
+    // Send sequence space: m_send_unacknowledged <= m_send_next <= m_send_maximum <= m_sequence_number.
+    // m_send_next only falls behind m_send_maximum while going back after a retransmission timeout.
+    // Everything past m_send_maximum is queued, waiting for the window to open.
+    u32 m_send_unacknowledged { 0 };
+    u32 m_send_next { 0 };
+    u32 m_send_maximum { 0 };
+    u32 m_send_window { 0 };
+    u8 m_send_window_scale { 0 };
+    u8 m_receive_window_scale { 0 };
+    bool m_peer_sent_window_scale { false };
+    u32 m_last_advertised_window { 0 };
+
+    u32 m_maximum_segment_size { 536 };
+    u32 m_congestion_window { 0 };
+    u32 m_slow_start_threshold { NumericLimits<u32>::max() };
+    u32 m_duplicate_acks { 0 };
+    u32 m_recovery_point { 0 };
+    bool m_in_fast_recovery { false };
+
+    u32 m_smoothed_rtt_usec { 0 };
+    u32 m_rtt_variance_usec { 0 };
+    u32 m_retransmission_timeout_usec { 1000000 };
+    timeval m_retransmit_timer_start { 0, 0 };
+
+    u32 m_retransmits { 0 };
+    u32 m_fast_retransmits { 0 };
+    u32 m_retransmission_timeouts { 0 };
+    u32 m_out_of_order_packets { 0 };
 
     Lock m_not_acked_lock { "TCPSocket unacked packets" };
     SinglyLinkedList<OutgoingPacket> m_not_acked;
+
+    struct OutOfOrderPacket {
+        u32 sequence_number { 0 };
+        size_t payload_size { 0 };
+        bool has_fin { false };
+        timeval timestamp { 0, 0 };
+        KBuffer data;
+    };
+
+    // Sorted by sequence number. Only the NetworkWorker that the flow hashes to touches it, with the socket lock held.
+    Vector<OutOfOrderPacket> m_out_of_order;
 };
 
 }
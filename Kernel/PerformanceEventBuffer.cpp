@@ -31,6 +31,7 @@
 #include <Kernel/KBufferBuilder.h>
 #include <Kernel/PerformanceEventBuffer.h>
 #include <Kernel/Process.h>
+#include <Kernel/Time/TimeManagement.h>
 
 namespace Kernel {
 
@@ -94,12 +95,81 @@ KResult PerformanceEventBuffer::append_with_eip_and_ebp(u32 eip, u32 ebp, int ty
         return EINVAL;
     }
 
+    return commit(event, eip, ebp);
+}
+
+KResult PerformanceEventBuffer::append_lock_event_with_eip_and_ebp(u32 eip, u32 ebp, int type, const void* lock, const char* name, u64 duration_ns)
+{
+    VERIFY(type == PERF_EVENT_LOCK_ACQUIRE || type == PERF_EVENT_LOCK_CONTENTION || type == PERF_EVENT_BLOCK);
+    if (count() >= capacity())
+        return ENOBUFS;
+
+    PerformanceEvent event;
+    event.type = type;
+    event.data.lock.lock = (FlatPtr)lock;
+    event.data.lock.duration_ns = duration_ns;
+    // NOTE: Copy the name, the event may well outlive the lock.
+    size_t name_length = 0;
+    if (name) {
+        for (; name[name_length] && name_length < LockPerformanceEvent::max_name_length - 1; ++name_length)
+            event.data.lock.name[name_length] = name[name_length];
+    }
+    event.data.lock.name[name_length] = '\0';
+
+    return commit(event, eip, ebp);
+}
+
+NEVER_INLINE void PerformanceEventBuffer::record_lock_event(int type, const void* lock, const char* name, u64 duration_ns)
+{
+    auto current_thread = Thread::current();
+    if (!current_thread || !current_thread->process().is_profiling())
+        return;
+    auto* perf_events = current_thread->process().perf_events();
+    if (!perf_events)
+        return;
+    // Start the backtrace at our caller.
+    auto* frame = (FlatPtr*)__builtin_frame_address(0);
+    [[maybe_unused]] auto rc = perf_events->append_lock_event_with_eip_and_ebp(frame[1], frame[0], type, lock, name, duration_ns);
+}
+
+static u64 monotonic_time_ns()
+{
+    auto now = TimeManagement::the().monotonic_time(TimePrecision::Precise);
+    return (u64)now.tv_sec * 1'000'000'000 + now.tv_nsec;
+}
+
+u64 spin_lock_contention_begin()
+{
+    auto current_thread = Thread::current();
+    if (!current_thread || !current_thread->process().is_profiling())
+        return 0;
+    return monotonic_time_ns();
+}
+
+void spin_lock_contention_end(const void* lock, const char* name, u64 start)
+{
+    if (!start)
+        return;
+    // NOTE: Recording must not take any spinlocks itself, the buffer only uses atomics.
+    PerformanceEventBuffer::record_lock_event(PERF_EVENT_LOCK_CONTENTION, lock, name, monotonic_time_ns() - start);
+}
+
+KResult PerformanceEventBuffer::commit(PerformanceEvent& event, u32 eip, u32 ebp)
+{
     auto backtrace = raw_backtrace(ebp, eip);
     event.stack_size = min(sizeof(event.stack) / sizeof(FlatPtr), static_cast<size_t>(backtrace.size()));
     memcpy(event.stack, backtrace.data(), event.stack_size * sizeof(FlatPtr));
 
     event.timestamp = TimeManagement::the().uptime_ms();
-    at(m_count++) = event;
+    if (auto* current_thread = Thread::current())
+        event.tid = current_thread->tid().value();
+
+    size_t index = m_count.load(AK::MemoryOrder::memory_order_relaxed);
+    do {
+        if (index >= capacity())
+            return ENOBUFS;
+    } while (!m_count.compare_exchange_strong(index, index + 1, AK::MemoryOrder::memory_order_relaxed));
+    at(index) = event;
     return KSuccess;
 }
 
@@ -140,7 +210,8 @@ bool PerformanceEventBuffer::to_json(KBufferBuilder& builder, ProcessID pid, con
     }
 
     auto array = object.add_array("events");
-    for (size_t i = 0; i < m_count; ++i) {
+    size_t event_count = count();
+    for (size_t i = 0; i < event_count; ++i) {
         auto& event = at(i);
         auto event_object = array.add_object();
         switch (event.type) {
@@ -156,6 +227,19 @@ bool PerformanceEventBuffer::to_json(KBufferBuilder& builder, ProcessID pid, con
             event_object.add("type", "free");
             event_object.add("ptr", static_cast<u64>(event.data.free.ptr));
             break;
+        case PERF_EVENT_LOCK_ACQUIRE:
+        case PERF_EVENT_LOCK_CONTENTION:
+        case PERF_EVENT_BLOCK:
+            if (event.type == PERF_EVENT_LOCK_ACQUIRE)
+                event_object.add("type", "lock_acquire");
+            else if (event.type == PERF_EVENT_LOCK_CONTENTION)
+                event_object.add("type", "lock_contention");
+            else
+                event_object.add("type", "block");
+            event_object.add("lock", static_cast<u64>(event.data.lock.lock));
+            event_object.add("name", event.data.lock.name);
+            event_object.add("duration_ns", event.data.lock.duration_ns);
+            break;
         }
         event_object.add("tid", event.tid);
         event_object.add("timestamp", event.timestamp);
@@ -26,6 +26,7 @@
 
 #pragma once
 
+#include <AK/Atomic.h>
 #include <Kernel/KBuffer.h>
 #include <Kernel/KResult.h>
 
@@ -43,6 +44,14 @@ struct [[gnu::packed]] FreePerformanceEvent {
     FlatPtr ptr;
 };
 
+// Recorded by the kernel for Lock, SpinLock and Thread::block() when the process is being profiled.
+struct [[gnu::packed]] LockPerformanceEvent {
+    FlatPtr lock;
+    u64 duration_ns;
+    static constexpr size_t max_name_length = 32;
+    char name[max_name_length];
+};
+
 struct [[gnu::packed]] PerformanceEvent {
     u8 type { 0 };
     u8 stack_size { 0 };
@@ -51,6 +60,7 @@ struct [[gnu::packed]] PerformanceEvent {
     union {
         MallocPerformanceEvent malloc;
         FreePerformanceEvent free;
+        LockPerformanceEvent lock;
     } data;
     static constexpr size_t max_stack_frame_count = 32;
     FlatPtr stack[max_stack_frame_count];
@@ -62,6 +72,10 @@ public:
 
     KResult append(int type, FlatPtr arg1, FlatPtr arg2);
     KResult append_with_eip_and_ebp(u32 eip, u32 ebp, int type, FlatPtr arg1, FlatPtr arg2);
+    KResult append_lock_event_with_eip_and_ebp(u32 eip, u32 ebp, int type, const void* lock, const char* name, u64 duration_ns);
+
+    // Records a lock event with the current kernel stack, if the current process is being profiled.
+    static void record_lock_event(int type, const void* lock, const char* name, u64 duration_ns = 0);
 
     void clear()
     {
@@ -85,8 +99,10 @@ public:
 
 private:
     PerformanceEvent& at(size_t index);
+    KResult commit(PerformanceEvent&, u32 eip, u32 ebp);
 
-    size_t m_count { 0 };
+    // NOTE: Events can be appended from several processors at once, so slots are claimed atomically.
+    Atomic<size_t> m_count { 0 };
     OwnPtr<KBuffer> m_buffer;
 };
 
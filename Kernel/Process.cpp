@@ -188,6 +188,10 @@ RefPtr<Process> Process::create_user_process(RefPtr<Thread>& first_thread, const
         g_processes->prepend(process);
         process->ref();
     }
+    {
+        ScopedSpinLock lock(g_scheduler_lock);
+        first_thread->set_state(Thread::State::Runnable);
+    }
     error = 0;
     return process;
 }
@@ -224,6 +224,7 @@ public:
     pid_t sys$gettid();
     int sys$donate(pid_t tid);
     int sys$ftruncate(int fd, off_t);
+    int sys$posix_fadvise(Userspace<const Syscall::SC_posix_fadvise_params*>);
     pid_t sys$setsid();
     pid_t sys$getsid(pid_t);
     int sys$setpgid(pid_t pid, pid_t pgid);
@@ -244,6 +245,8 @@ public:
     ssize_t sys$readv(int fd, Userspace<const struct iovec*> iov, int iov_count);
     ssize_t sys$write(int fd, const u8*, ssize_t);
     ssize_t sys$writev(int fd, Userspace<const struct iovec*> iov, int iov_count);
+    ssize_t sys$sendfile(Userspace<const Syscall::SC_sendfile_params*>);
+    ssize_t sys$splice(Userspace<const Syscall::SC_splice_params*>);
     int sys$fstat(int fd, Userspace<stat*>);
     int sys$stat(Userspace<const Syscall::SC_stat_params*>);
     int sys$lseek(int fd, off_t, int whence);
@@ -261,6 +264,9 @@ public:
     int sys$purge(int mode);
     int sys$select(const Syscall::SC_select_params*);
     int sys$poll(Userspace<const Syscall::SC_poll_params*>);
+    int sys$epoll_create(int flags);
+    int sys$epoll_ctl(Userspace<const Syscall::SC_epoll_ctl_params*>);
+    int sys$epoll_wait(Userspace<const Syscall::SC_epoll_wait_params*>);
     ssize_t sys$get_dir_entries(int fd, void*, ssize_t);
     int sys$getcwd(Userspace<char*>, size_t);
     int sys$chdir(Userspace<const char*>, size_t);
@@ -278,6 +284,7 @@ public:
     int sys$ptsname(int fd, Userspace<char*>, size_t);
     pid_t sys$fork(RegisterState&);
     int sys$execve(Userspace<const Syscall::SC_execve_params*>);
+    pid_t sys$posix_spawn(Userspace<const Syscall::SC_posix_spawn_params*>);
     int sys$dup2(int old_fd, int new_fd);
     int sys$sigaction(int signum, const sigaction* act, sigaction* old_act);
     int sys$sigprocmask(int how, Userspace<const sigset_t*> set, Userspace<sigset_t*> old_set);
@@ -474,12 +481,14 @@ private:
     static ProcessID allocate_pid();
 
     void kill_threads_except_self();
+    void copy_inherited_state_to(Process& child);
     void kill_all_threads();
     bool dump_core();
     bool dump_perfcore();
 
     KResult do_exec(NonnullRefPtr<FileDescription> main_program_description, Vector<String> arguments, Vector<String> environment, RefPtr<FileDescription> interpreter_description, Thread*& new_main_thread, u32& prev_flags, const Elf32_Ehdr& main_program_header);
     ssize_t do_write(FileDescription&, const UserOrKernelBuffer&, size_t);
+    ssize_t do_splice(FileDescription& in, Optional<off_t> in_offset, FileDescription& out, size_t count);
 
     KResultOr<RefPtr<FileDescription>> find_elf_interpreter_for_executable(const String& path, const Elf32_Ehdr& elf_header, int nread, size_t file_size);
 
@@ -72,15 +72,28 @@ READONLY_AFTER_INIT static Process* s_colonel_process;
 struct ThreadReadyQueue {
     IntrusiveList<Thread, &Thread::m_ready_queue_node> thread_list;
 };
-static SpinLock<u8> g_ready_queues_lock;
-static u32 g_ready_queues_mask;
-static constexpr u32 g_ready_queue_buckets = sizeof(g_ready_queues_mask) * 8;
-READONLY_AFTER_INIT static ThreadReadyQueue* g_ready_queues; // g_ready_queue_buckets entries
+static constexpr u32 g_ready_queue_buckets = sizeof(u32) * 8;
+
+// A thread woken up on a processor that is at most this many runnable threads busier
+// than the least busy candidate stays there, since its caches are likely still warm.
+static constexpr u32 cache_affinity_slack = 1;
+
+// NOTE: Each processor's queues are protected by their own lock. Queueing and dequeueing a thread is
+//       part of changing its state, which still happens under g_scheduler_lock, so the per-processor
+//       lock mostly keeps out work stealing and statistics readers from other processors.
+struct ProcessorReadyQueues {
+    SpinLock<u8> lock;
+    u32 mask { 0 };
+    ThreadReadyQueue queues[g_ready_queue_buckets];
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> runnable_count { 0 };
+    SchedulerProcessorStatistics statistics;
+};
+READONLY_AFTER_INIT static ProcessorReadyQueues* g_ready_queues; // Processor::max_count entries
 
 static inline u32 thread_priority_to_priority_index(u32 thread_priority)
 {
     // Converts the priority in the range of THREAD_PRIORITY_MIN...THREAD_PRIORITY_MAX
-    // to a index into g_ready_queues where 0 is the highest priority bucket
+    // to a index into ProcessorReadyQueues::queues where 0 is the highest priority bucket
     VERIFY(thread_priority >= THREAD_PRIORITY_MIN && thread_priority <= THREAD_PRIORITY_MAX);
     constexpr u32 thread_priority_count = THREAD_PRIORITY_MAX - THREAD_PRIORITY_MIN + 1;
     static_assert(thread_priority_count > 0);
@@ -89,16 +102,60 @@ static inline u32 thread_priority_to_priority_index(u32 thread_priority)
     return priority_bucket;
 }
 
-Thread& Scheduler::pull_next_runnable_thread()
+static u32 schedulable_processor_mask()
 {
-    auto affinity_mask = 1u << Processor::current().id();
+#if SCHEDULE_ON_ALL_PROCESSORS
+    auto count = Processor::count();
+    if (count >= Processor::max_count)
+        return 0xffffffff;
+    return (1u << count) - 1;
+#else
+    return 1;
+#endif
+}
 
-    ScopedSpinLock lock(g_ready_queues_lock);
-    auto priority_mask = g_ready_queues_mask;
+static u32 pick_processor_for(const Thread& thread, bool& is_cache_affine)
+{
+    auto candidates = thread.affinity() & schedulable_processor_mask();
+    if (!candidates) {
+        // The thread may only run on a processor that doesn't schedule yet, so park it there.
+        candidates = thread.affinity();
+        VERIFY(candidates);
+        is_cache_affine = false;
+        return __builtin_ffsl(candidates) - 1;
+    }
+
+    u32 least_busy_cpu = 0;
+    u32 least_busy_count = 0xffffffff;
+    for (auto remaining = candidates; remaining;) {
+        u32 cpu = __builtin_ffsl(remaining) - 1;
+        remaining &= ~(1u << cpu);
+        auto count = g_ready_queues[cpu].runnable_count.load();
+        if (count < least_busy_count) {
+            least_busy_cpu = cpu;
+            least_busy_count = count;
+        }
+    }
+
+    u32 last_cpu = thread.cpu();
+    if ((candidates & (1u << last_cpu)) && g_ready_queues[last_cpu].runnable_count.load() <= least_busy_count + cache_affinity_slack) {
+        is_cache_affine = true;
+        return last_cpu;
+    }
+    is_cache_affine = false;
+    return least_busy_cpu;
+}
+
+Thread* Scheduler::pull_runnable_thread_from(ProcessorReadyQueues& ready_queues, u32 cpu)
+{
+    auto affinity_mask = 1u << cpu;
+
+    ScopedSpinLock lock(ready_queues.lock);
+    auto priority_mask = ready_queues.mask;
     while (priority_mask != 0) {
         auto priority = __builtin_ffsl(priority_mask);
         VERIFY(priority > 0);
-        auto& ready_queue = g_ready_queues[--priority];
+        auto& ready_queue = ready_queues.queues[--priority];
         for (auto& thread : ready_queue.thread_list) {
             VERIFY(thread.m_runnable_priority == (int)priority);
             if (thread.is_active())
@@ -106,9 +163,11 @@ Thread& Scheduler::pull_next_runnable_thread()
             if (!(thread.affinity() & affinity_mask))
                 continue;
             thread.m_runnable_priority = -1;
+            thread.m_runnable_processor = -1;
             ready_queue.thread_list.remove(thread);
             if (ready_queue.thread_list.is_empty())
-                g_ready_queues_mask &= ~(1u << priority);
+                ready_queues.mask &= ~(1u << priority);
+            ready_queues.runnable_count--;
             // Mark it as active because we are using this thread. This is similar
             // to comparing it with Processor::current_thread, but when there are
             // multiple processors there's no easy way to check whether the thread
@@ -120,34 +179,89 @@ Thread& Scheduler::pull_next_runnable_thread()
             // switching to it.
             // FIXME: Figure out a better way maybe?
             thread.set_active(true);
-            return thread;
+            return &thread;
         }
         priority_mask &= ~(1u << priority);
     }
-    return *Processor::current().idle_thread();
+    return nullptr;
+}
+
+Thread* Scheduler::steal_runnable_thread(u32 cpu)
+{
+    auto victims = schedulable_processor_mask() & ~(1u << cpu);
+    while (victims) {
+        // Try the busiest processor first, it benefits the most from sharing its work.
+        u32 busiest_cpu = 0;
+        u32 busiest_count = 0;
+        for (auto remaining = victims; remaining;) {
+            u32 victim = __builtin_ffsl(remaining) - 1;
+            remaining &= ~(1u << victim);
+            auto count = g_ready_queues[victim].runnable_count.load();
+            if (count > busiest_count) {
+                busiest_cpu = victim;
+                busiest_count = count;
+            }
+        }
+        if (busiest_count == 0)
+            return nullptr;
+        victims &= ~(1u << busiest_cpu);
+
+        if (auto* thread = pull_runnable_thread_from(g_ready_queues[busiest_cpu], cpu)) {
+            dbgln_if(SCHEDULER_DEBUG, "Scheduler[{}]: Stole {} from processor {}", cpu, *thread, busiest_cpu);
+            auto& ready_queues = g_ready_queues[cpu];
+            ScopedSpinLock lock(ready_queues.lock);
+            ready_queues.statistics.stolen_threads++;
+            return thread;
+        }
+    }
+    return nullptr;
+}
+
+Thread& Scheduler::pull_next_runnable_thread()
+{
+    auto& processor = Processor::current();
+    auto cpu = processor.id();
+
+    if (auto* thread = pull_runnable_thread_from(g_ready_queues[cpu], cpu))
+        return *thread;
+
+    // Nothing to do here, see if another processor has work to spare.
+    if (auto* thread = steal_runnable_thread(cpu))
+        return *thread;
+
+    return *processor.idle_thread();
 }
 
 bool Scheduler::dequeue_runnable_thread(Thread& thread, bool check_affinity)
 {
     if (&thread == Processor::current().idle_thread())
         return true;
-    ScopedSpinLock lock(g_ready_queues_lock);
-    auto priority = thread.m_runnable_priority;
-    if (priority < 0) {
-        VERIFY(!thread.m_ready_queue_node.is_in_list());
-        return false;
-    }
-
     if (check_affinity && !(thread.affinity() & (1 << Processor::current().id())))
         return false;
 
-    VERIFY(g_ready_queues_mask & (1u << priority));
-    auto& ready_queue = g_ready_queues[priority];
-    thread.m_runnable_priority = -1;
-    ready_queue.thread_list.remove(thread);
-    if (ready_queue.thread_list.is_empty())
-        g_ready_queues_mask &= ~(1u << priority);
-    return true;
+    // The processor owning the thread can only be trusted once we hold its queue lock,
+    // since another processor may pull the thread off that queue in the meantime.
+    for (;;) {
+        int cpu = thread.m_runnable_processor.load();
+        if (cpu < 0)
+            return false;
+        auto& ready_queues = g_ready_queues[cpu];
+        ScopedSpinLock lock(ready_queues.lock);
+        if (thread.m_runnable_processor.load() != cpu)
+            continue;
+
+        auto priority = thread.m_runnable_priority;
+        VERIFY(priority >= 0);
+        VERIFY(ready_queues.mask & (1u << priority));
+        auto& ready_queue = ready_queues.queues[priority];
+        thread.m_runnable_priority = -1;
+        thread.m_runnable_processor = -1;
+        ready_queue.thread_list.remove(thread);
+        if (ready_queue.thread_list.is_empty())
+            ready_queues.mask &= ~(1u << priority);
+        ready_queues.runnable_count--;
+        return true;
+    }
 }
 
 void Scheduler::queue_runnable_thread(Thread& thread)
@@ -156,16 +270,41 @@ void Scheduler::queue_runnable_thread(Thread& thread)
     if (&thread == Processor::current().idle_thread())
         return;
     auto priority = thread_priority_to_priority_index(thread.priority());
+    bool is_cache_affine = false;
+    auto cpu = pick_processor_for(thread, is_cache_affine);
+
+    {
+        auto& ready_queues = g_ready_queues[cpu];
+        ScopedSpinLock lock(ready_queues.lock);
+        VERIFY(thread.m_runnable_priority < 0);
+        thread.m_runnable_priority = (int)priority;
+        thread.m_runnable_processor = (int)cpu;
+        VERIFY(!thread.m_ready_queue_node.is_in_list());
+        auto& ready_queue = ready_queues.queues[priority];
+        bool was_empty = ready_queue.thread_list.is_empty();
+        ready_queue.thread_list.append(thread);
+        if (was_empty)
+            ready_queues.mask |= (1u << priority);
+        ready_queues.runnable_count++;
+        if (is_cache_affine)
+            ready_queues.statistics.cache_affine_wakeups++;
+        else
+            ready_queues.statistics.migrated_wakeups++;
+    }
+
+    // Kick the chosen processor if it's idle. Otherwise, any idle processor may steal the thread.
+    if (cpu == Processor::id() || !Processor::smp_wake_idle_processor(cpu))
+        Processor::smp_wake_n_idle_processors(1);
+}
 
-    ScopedSpinLock lock(g_ready_queues_lock);
-    VERIFY(thread.m_runnable_priority < 0);
-    thread.m_runnable_priority = (int)priority;
-    VERIFY(!thread.m_ready_queue_node.is_in_list());
-    auto& ready_queue = g_ready_queues[priority];
-    bool was_empty = ready_queue.thread_list.is_empty();
-    ready_queue.thread_list.append(thread);
-    if (was_empty)
-        g_ready_queues_mask |= (1u << priority);
+SchedulerProcessorStatistics Scheduler::processor_statistics(u32 cpu)
+{
+    VERIFY(cpu < Processor::max_count);
+    auto& ready_queues = g_ready_queues[cpu];
+    ScopedSpinLock lock(ready_queues.lock);
+    auto statistics = ready_queues.statistics;
+    statistics.runnable_threads = ready_queues.runnable_count.load();
+    return statistics;
 }
 
 UNMAP_AFTER_INIT void Scheduler::start()
@@ -390,6 +529,12 @@ bool Scheduler::context_switch(Thread* thread)
     if (from_thread == thread)
         return false;
 
+    {
+        auto& ready_queues = g_ready_queues[Processor::id()];
+        ScopedSpinLock lock(ready_queues.lock);
+        ready_queues.statistics.context_switches++;
+    }
+
     if (from_thread) {
         // If the last process hasn't blocked (still marked as running),
         // mark it as runnable for the next round.
@@ -494,7 +639,7 @@ UNMAP_AFTER_INIT void Scheduler::initialize()
 
     RefPtr<Thread> idle_thread;
     g_finalizer_wait_queue = new WaitQueue;
-    g_ready_queues = new ThreadReadyQueue[g_ready_queue_buckets];
+    g_ready_queues = new ProcessorReadyQueues[Processor::max_count];
 
     g_finalizer_has_work.store(false, AK::MemoryOrder::memory_order_release);
     s_colonel_process = Process::create_kernel_process(idle_thread, "colonel", idle_loop, nullptr, 1).leak_ref();
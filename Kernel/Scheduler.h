@@ -37,6 +37,7 @@
 namespace Kernel {
 
 class Process;
+struct ProcessorReadyQueues;
 class Thread;
 class WaitQueue;
 struct RegisterState;
@@ -46,6 +47,14 @@ extern WaitQueue* g_finalizer_wait_queue;
 extern Atomic<bool> g_finalizer_has_work;
 extern RecursiveSpinLock g_scheduler_lock;
 
+struct SchedulerProcessorStatistics {
+    u32 runnable_threads { 0 };
+    u64 context_switches { 0 };
+    u64 stolen_threads { 0 };
+    u64 cache_affine_wakeups { 0 };
+    u64 migrated_wakeups { 0 };
+};
+
 class Scheduler {
 public:
     static void initialize();
@@ -70,6 +79,11 @@ public:
     static Thread& pull_next_runnable_thread();
     static bool dequeue_runnable_thread(Thread&, bool = false);
     static void queue_runnable_thread(Thread&);
+    static SchedulerProcessorStatistics processor_statistics(u32 cpu);
+
+private:
+    static Thread* pull_runnable_thread_from(ProcessorReadyQueues&, u32 cpu);
+    static Thread* steal_runnable_thread(u32 cpu);
 };
 
 }
@@ -33,6 +33,10 @@
 
 namespace Kernel {
 
+// NOTE: These only do any work while the current process is being profiled.
+u64 spin_lock_contention_begin();
+void spin_lock_contention_end(const void* lock, const char* name, u64 start);
+
 template<typename BaseType = u32>
 class SpinLock {
     AK_MAKE_NONCOPYABLE(SpinLock);
@@ -45,8 +49,12 @@ public:
     {
         u32 prev_flags;
         Processor::current().enter_critical(prev_flags);
-        while (m_lock.exchange(1, AK::memory_order_acquire) != 0) {
-            Processor::wait_check();
+        if (m_lock.exchange(1, AK::memory_order_acquire) != 0) [[unlikely]] {
+            u64 contention_start = spin_lock_contention_begin();
+            do {
+                Processor::wait_check();
+            } while (m_lock.exchange(1, AK::memory_order_acquire) != 0);
+            spin_lock_contention_end(this, "SpinLock", contention_start);
         }
         return prev_flags;
     }
@@ -86,11 +94,13 @@ public:
         u32 prev_flags;
         proc.enter_critical(prev_flags);
         FlatPtr expected = 0;
-        while (!m_lock.compare_exchange_strong(expected, cpu, AK::memory_order_acq_rel)) {
-            if (expected == cpu)
-                break;
-            Processor::wait_check();
-            expected = 0;
+        if (!m_lock.compare_exchange_strong(expected, cpu, AK::memory_order_acq_rel) && expected != cpu) [[unlikely]] {
+            u64 contention_start = spin_lock_contention_begin();
+            do {
+                Processor::wait_check();
+                expected = 0;
+            } while (!m_lock.compare_exchange_strong(expected, cpu, AK::memory_order_acq_rel) && expected != cpu);
+            spin_lock_contention_end(this, "RecursiveSpinLock", contention_start);
         }
         m_recursions++;
         return prev_flags;
@@ -166,6 +166,7 @@ void IDEChannel::start_request(AsyncBlockDeviceRequest& request, bool use_dma, b
     m_current_request = &request;
     m_current_request_block_index = 0;
     m_current_request_uses_dma = use_dma;
+    m_current_request_uses_bounce_buffer = false;
     m_current_request_flushing_cache = false;
 
     if (request.request_type() == AsyncBlockDeviceRequest::Read) {
@@ -199,8 +200,16 @@ void IDEChannel::complete_current_request(AsyncDeviceRequest::RequestResult resu
 
         if (m_current_request_uses_dma) {
             if (result == AsyncDeviceRequest::Success) {
-                if (request.request_type() == AsyncBlockDeviceRequest::Read) {
-                    if (!request.write_to_buffer(request.buffer(), m_dma_buffer_page->paddr().offset(0xc0000000).as_ptr(), 512 * request.block_count())) {
+                if (request.request_type() == AsyncBlockDeviceRequest::Read && m_current_request_uses_bounce_buffer) {
+                    bool copied = request.write_to_buffer(request.buffer(), m_dma_bounce_buffer->vaddr().as_ptr(), 512 * request.block_count());
+                    size_t offset = 512 * request.block_count();
+                    for (auto& merged_request : request.merged_requests()) {
+                        if (!copied)
+                            break;
+                        copied = merged_request.write_to_buffer(merged_request.buffer(), m_dma_bounce_buffer->vaddr().offset(offset).as_ptr(), 512 * merged_request.block_count());
+                        offset += 512 * merged_request.block_count();
+                    }
+                    if (!copied) {
                         request.complete(AsyncDeviceRequest::MemoryFault);
                         return;
                     }
@@ -231,8 +240,95 @@ UNMAP_AFTER_INIT void IDEChannel::initialize(bool force_pio)
     // Let's try to set up DMA transfers.
     PCI::enable_bus_mastering(m_parent_controller->pci_address());
     m_prdt_page = MM.allocate_supervisor_physical_page();
-    prdt().end_of_table = 0x8000;
-    m_dma_buffer_page = MM.allocate_supervisor_physical_page();
+    m_dma_bounce_buffer = MM.allocate_kernel_region(max_sectors_per_dma_request * 512, "IDE DMA Bounce Buffer", Region::Access::Read | Region::Access::Write, AllocationStrategy::AllocateNow);
+    VERIFY(m_dma_bounce_buffer);
+}
+
+bool IDEChannel::add_to_prdt(VirtualAddress buffer, size_t size, Direction direction, size_t& descriptor_count)
+{
+    // The controller wants word-aligned buffers, and no descriptor may cross a 64 KiB boundary.
+    if (buffer.get() & 1)
+        return false;
+
+    static constexpr size_t max_descriptor_count = PAGE_SIZE / sizeof(PhysicalRegionDescriptor);
+    auto* descriptors = prdt();
+    // NOTE: A size of 0 means 64 KiB.
+    u32 last_descriptor_size = 0;
+    if (descriptor_count)
+        last_descriptor_size = descriptors[descriptor_count - 1].size ? descriptors[descriptor_count - 1].size : 64 * KiB;
+    for (size_t offset = 0; offset < size;) {
+        auto vaddr = buffer.offset(offset);
+        auto paddr = MM.physical_address_for_kernel_vaddr(vaddr);
+        if (!paddr.has_value())
+            return false;
+        // NOTE: Pages that haven't been touched yet may still map the shared zero or lazy committed page.
+        //       Those are fine to read from, but the controller must never write into them.
+        if (direction == Direction::Read && (paddr.value() == MM.shared_zero_page().paddr() || paddr.value() == MM.lazy_committed_page().paddr()))
+            return false;
+        size_t chunk_size = min(PAGE_SIZE - (vaddr.get() & ~PAGE_MASK), size - offset);
+
+        if (descriptor_count) {
+            auto& last = descriptors[descriptor_count - 1];
+            bool is_contiguous = last.offset.offset(last_descriptor_size) == paddr.value();
+            bool is_same_window = (last.offset.get() & 0xffff0000) == ((paddr.value().get() + chunk_size - 1) & 0xffff0000);
+            if (is_contiguous && is_same_window) {
+                last_descriptor_size += chunk_size;
+                last.size = (u16)last_descriptor_size;
+                offset += chunk_size;
+                continue;
+            }
+        }
+
+        if (descriptor_count == max_descriptor_count)
+            return false;
+        auto& descriptor = descriptors[descriptor_count++];
+        descriptor.offset = paddr.value();
+        descriptor.size = (u16)chunk_size;
+        descriptor.end_of_table = 0;
+        last_descriptor_size = chunk_size;
+        offset += chunk_size;
+    }
+    return true;
+}
+
+bool IDEChannel::prepare_dma_transfer(AsyncBlockDeviceRequest& request)
+{
+    size_t size = 512 * request.total_block_count();
+    VERIFY(size <= m_dma_bounce_buffer->size());
+
+    // The controller can scatter/gather straight from the pages of kernel buffers (and from those of the
+    // requests merged into this one), as long as add_to_prdt() finds them all backed by private pages.
+    // User buffers may not be resident, so they're bounced through our own buffer instead, as is
+    // anything add_to_prdt() rejects.
+    auto direction = request.request_type() == AsyncBlockDeviceRequest::Read ? Direction::Read : Direction::Write;
+    size_t descriptor_count = 0;
+    bool is_direct = request.buffer().is_kernel_buffer() && add_to_prdt(VirtualAddress(request.buffer().user_or_kernel_ptr()), 512 * request.block_count(), direction, descriptor_count);
+    for (auto& merged_request : request.merged_requests()) {
+        if (!is_direct)
+            break;
+        is_direct = merged_request.buffer().is_kernel_buffer() && add_to_prdt(VirtualAddress(merged_request.buffer().user_or_kernel_ptr()), 512 * merged_request.block_count(), direction, descriptor_count);
+    }
+
+    m_current_request_uses_bounce_buffer = !is_direct;
+    if (m_current_request_uses_bounce_buffer) {
+        if (request.request_type() == AsyncBlockDeviceRequest::Write) {
+            if (!request.read_from_buffer(request.buffer(), m_dma_bounce_buffer->vaddr().as_ptr(), 512 * request.block_count()))
+                return false;
+            size_t offset = 512 * request.block_count();
+            for (auto& merged_request : request.merged_requests()) {
+                if (!merged_request.read_from_buffer(merged_request.buffer(), m_dma_bounce_buffer->vaddr().offset(offset).as_ptr(), 512 * merged_request.block_count()))
+                    return false;
+                offset += 512 * merged_request.block_count();
+            }
+        }
+        descriptor_count = 0;
+        bool added = add_to_prdt(m_dma_bounce_buffer->vaddr(), size, direction, descriptor_count);
+        VERIFY(added);
+    }
+
+    VERIFY(descriptor_count);
+    prdt()[descriptor_count - 1].end_of_table = 0x8000;
+    return true;
 }
 
 static void print_ide_status(u8 status)
@@ -310,6 +406,12 @@ void IDEChannel::handle_irq(const RegisterState&)
     }
     m_device_error = 0;
     if (m_current_request_uses_dma) {
+        // Stop bus master
+        m_io_group.bus_master_base().out<u8>(0);
+        // NOTE: The next request is started once the deferred completion has run, not from here.
+        //       Building its PRDT means looking up physical pages under the MM lock, which the
+        //       code this IRQ interrupted may already be holding, and a bounced read still has
+        //       to be copied out of the bounce buffer before anything may DMA into it again.
         complete_current_request(AsyncDeviceRequest::Success);
         return;
     }
@@ -320,9 +422,9 @@ void IDEChannel::handle_irq(const RegisterState&)
     Processor::deferred_call_queue([this]() {
         ScopedSpinLock lock(m_request_lock);
         if (m_current_request->request_type() == AsyncBlockDeviceRequest::Read) {
-            dbgln_if(PATA_DEBUG, "IDEChannel: Read block {}/{}", m_current_request_block_index, m_current_request->block_count());
+            dbgln_if(PATA_DEBUG, "IDEChannel: Read block {}/{}", m_current_request_block_index, m_current_request->total_block_count());
             if (ata_do_read_sector()) {
-                if (++m_current_request_block_index >= m_current_request->block_count()) {
+                if (++m_current_request_block_index >= m_current_request->total_block_count()) {
                     complete_current_request(AsyncDeviceRequest::Success);
                     return;
                 }
@@ -331,8 +433,8 @@ void IDEChannel::handle_irq(const RegisterState&)
             }
         } else {
             if (!m_current_request_flushing_cache) {
-                dbgln_if(PATA_DEBUG, "IDEChannel: Wrote block {}/{}", m_current_request_block_index, m_current_request->block_count());
-                if (++m_current_request_block_index >= m_current_request->block_count()) {
+                dbgln_if(PATA_DEBUG, "IDEChannel: Wrote block {}/{}", m_current_request_block_index, m_current_request->total_block_count());
+                if (++m_current_request_block_index >= m_current_request->total_block_count()) {
                     // We read the last block, flush cache
                     VERIFY(!m_current_request_flushing_cache);
                     m_current_request_flushing_cache = true;
@@ -457,7 +559,7 @@ UNMAP_AFTER_INIT void IDEChannel::detect_disks()
     }
 }
 
-void IDEChannel::ata_access(Direction direction, bool slave_request, u32 lba, u8 block_count, u16 capabilities, bool use_dma)
+void IDEChannel::ata_access(Direction direction, bool slave_request, u32 lba, u16 block_count, u16 capabilities, bool use_dma)
 {
     LBAMode lba_mode;
     u8 head = 0;
@@ -486,13 +588,14 @@ void IDEChannel::ata_access(Direction direction, bool slave_request, u32 lba, u8
         m_io_group.io_base().offset(ATA_REG_HDDEVSEL).out<u8>(0xE0 | (static_cast<u8>(slave_request) << 4) | head);
 
     if (lba_mode == LBAMode::FortyEightBit) {
-        m_io_group.io_base().offset(ATA_REG_SECCOUNT1).out<u8>(0);
+        m_io_group.io_base().offset(ATA_REG_SECCOUNT1).out<u8>((block_count >> 8) & 0xFF);
         m_io_group.io_base().offset(ATA_REG_LBA3).out<u8>((lba & 0xFF000000) >> 24);
         m_io_group.io_base().offset(ATA_REG_LBA4).out<u8>(0);
         m_io_group.io_base().offset(ATA_REG_LBA5).out<u8>(0);
     }
 
-    m_io_group.io_base().offset(ATA_REG_SECCOUNT0).out<u8>(block_count);
+    // NOTE: For 28-bit commands, a count of 0 means 256 sectors.
+    m_io_group.io_base().offset(ATA_REG_SECCOUNT0).out<u8>(block_count & 0xFF);
     if (lba_mode == LBAMode::FortyEightBit || lba_mode == LBAMode::TwentyEightBit) {
         m_io_group.io_base().offset(ATA_REG_LBA0).out<u8>((lba & 0x000000FF) >> 0);
         m_io_group.io_base().offset(ATA_REG_LBA1).out<u8>((lba & 0x0000FF00) >> 8);
@@ -527,12 +630,12 @@ void IDEChannel::ata_read_sectors_with_dma(bool slave_request, u16 capabilities)
 {
     auto& request = *m_current_request;
     u32 lba = request.block_index();
-    dbgln_if(PATA_DEBUG, "IDEChannel::ata_read_sectors_with_dma ({} x {})", lba, request.block_count());
-
-    prdt().offset = m_dma_buffer_page->paddr();
-    prdt().size = 512 * request.block_count();
+    dbgln_if(PATA_DEBUG, "IDEChannel::ata_read_sectors_with_dma ({} x {})", lba, request.total_block_count());
 
-    VERIFY(prdt().size <= PAGE_SIZE);
+    if (!prepare_dma_transfer(request)) {
+        complete_current_request(AsyncDeviceRequest::MemoryFault);
+        return;
+    }
 
     // Stop bus master
     m_io_group.bus_master_base().out<u8>(0);
@@ -546,7 +649,7 @@ void IDEChannel::ata_read_sectors_with_dma(bool slave_request, u16 capabilities)
     // Set transfer direction
     m_io_group.bus_master_base().out<u8>(0x8);
 
-    ata_access(Direction::Read, slave_request, lba, request.block_count(), capabilities, true);
+    ata_access(Direction::Read, slave_request, lba, request.total_block_count(), capabilities, true);
 
     // Start bus master
     m_io_group.bus_master_base().out<u8>(0x9);
@@ -556,7 +659,7 @@ bool IDEChannel::ata_do_read_sector()
 {
     dbgln_if(PATA_DEBUG, "IDEChannel::ata_do_read_sector");
     auto& request = *m_current_request;
-    auto out_buffer = request.buffer().offset(m_current_request_block_index * 512);
+    auto out_buffer = request.buffer_for_block(m_current_request_block_index);
     ssize_t nwritten = request.write_to_buffer_buffered<512>(out_buffer, 512, [&](u8* buffer, size_t buffer_bytes) {
         for (size_t i = 0; i < buffer_bytes; i += sizeof(u16))
             *(u16*)&buffer[i] = IO::in16(m_io_group.io_base().offset(ATA_REG_DATA).get());
@@ -574,31 +677,26 @@ bool IDEChannel::ata_do_read_sector()
 void IDEChannel::ata_read_sectors(bool slave_request, u16 capabilities)
 {
     auto& request = *m_current_request;
-    VERIFY(request.block_count() <= 256);
+    VERIFY(request.total_block_count() <= 256);
     dbgln_if(PATA_DEBUG, "IDEChannel::ata_read_sectors");
 
     auto lba = request.block_index();
-    dbgln_if(PATA_DEBUG, "IDEChannel: Reading {} sector(s) @ LBA {}", request.block_count(), lba);
+    dbgln_if(PATA_DEBUG, "IDEChannel: Reading {} sector(s) @ LBA {}", request.total_block_count(), lba);
 
-    ata_access(Direction::Read, slave_request, lba, request.block_count(), capabilities, false);
+    ata_access(Direction::Read, slave_request, lba, request.total_block_count(), capabilities, false);
 }
 
 void IDEChannel::ata_write_sectors_with_dma(bool slave_request, u16 capabilities)
 {
     auto& request = *m_current_request;
     u32 lba = request.block_index();
-    dbgln_if(PATA_DEBUG, "IDEChannel::ata_write_sectors_with_dma ({} x {})", lba, request.block_count());
-
-    prdt().offset = m_dma_buffer_page->paddr();
-    prdt().size = 512 * request.block_count();
+    dbgln_if(PATA_DEBUG, "IDEChannel::ata_write_sectors_with_dma ({} x {})", lba, request.total_block_count());
 
-    if (!request.read_from_buffer(request.buffer(), m_dma_buffer_page->paddr().offset(0xc0000000).as_ptr(), 512 * request.block_count())) {
+    if (!prepare_dma_transfer(request)) {
         complete_current_request(AsyncDeviceRequest::MemoryFault);
         return;
     }
 
-    VERIFY(prdt().size <= PAGE_SIZE);
-
     // Stop bus master
     m_io_group.bus_master_base().out<u8>(0);
 
@@ -608,7 +706,7 @@ void IDEChannel::ata_write_sectors_with_dma(bool slave_request, u16 capabilities
     // Turn on "Interrupt" and "Error" flag. The error flag should be cleared by hardware.
     m_io_group.bus_master_base().offset(2).out<u8>(m_io_group.bus_master_base().offset(2).in<u8>() | 0x6);
 
-    ata_access(Direction::Write, slave_request, lba, request.block_count(), capabilities, true);
+    ata_access(Direction::Write, slave_request, lba, request.total_block_count(), capabilities, true);
 
     // Start bus master
     m_io_group.bus_master_base().out<u8>(0x1);
@@ -625,7 +723,7 @@ void IDEChannel::ata_do_write_sector()
     u8 status = m_io_group.control_base().in<u8>();
     VERIFY(status & ATA_SR_DRQ);
 
-    auto in_buffer = request.buffer().offset(m_current_request_block_index * 512);
+    auto in_buffer = request.buffer_for_block(m_current_request_block_index);
     dbgln_if(PATA_DEBUG, "IDEChannel: Writing 512 bytes (part {}) (status={:#02x})...", m_current_request_block_index, status);
     ssize_t nread = request.read_from_buffer_buffered<512>(in_buffer, 512, [&](const u8* buffer, size_t buffer_bytes) {
         for (size_t i = 0; i < buffer_bytes; i += sizeof(u16))
@@ -641,12 +739,12 @@ void IDEChannel::ata_write_sectors(bool slave_request, u16 capabilities)
 {
     auto& request = *m_current_request;
 
-    VERIFY(request.block_count() <= 256);
+    VERIFY(request.total_block_count() <= 256);
     u32 start_sector = request.block_index();
-    u32 count = request.block_count();
+    u32 count = request.total_block_count();
     dbgln_if(PATA_DEBUG, "IDEChannel: Writing {} sector(s) @ LBA {}", count, start_sector);
 
-    ata_access(Direction::Write, slave_request, start_sector, request.block_count(), capabilities, false);
+    ata_access(Direction::Write, slave_request, start_sector, request.total_block_count(), capabilities, false);
     ata_do_write_sector();
 }
 }
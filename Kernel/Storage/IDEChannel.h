@@ -47,6 +47,7 @@
 #include <Kernel/Random.h>
 #include <Kernel/Storage/StorageDevice.h>
 #include <Kernel/VM/PhysicalPage.h>
+#include <Kernel/VM/Region.h>
 #include <Kernel/WaitQueue.h>
 
 namespace Kernel {
@@ -113,6 +114,9 @@ public:
 
     virtual const char* purpose() const override { return "PATA Channel"; }
 
+    // NOTE: 256 sectors is the most a 28-bit LBA command can transfer.
+    static constexpr size_t max_sectors_per_dma_request = 256;
+
 private:
     //^ IRQHandler
     virtual void handle_irq(const RegisterState&) override;
@@ -140,7 +144,10 @@ private:
 
     void clear_pending_interrupts() const;
 
-    void ata_access(Direction, bool, u32, u8, u16, bool);
+    bool prepare_dma_transfer(AsyncBlockDeviceRequest&);
+    bool add_to_prdt(VirtualAddress, size_t, Direction, size_t& descriptor_count);
+
+    void ata_access(Direction, bool, u32, u16, u16, bool);
     void ata_read_sectors_with_dma(bool, u16);
     void ata_read_sectors(bool, u16);
     bool ata_do_read_sector();
@@ -153,9 +160,10 @@ private:
 
     volatile u8 m_device_error { 0 };
 
-    PhysicalRegionDescriptor& prdt() { return *reinterpret_cast<PhysicalRegionDescriptor*>(m_prdt_page->paddr().offset(0xc0000000).as_ptr()); }
+    PhysicalRegionDescriptor* prdt() { return reinterpret_cast<PhysicalRegionDescriptor*>(m_prdt_page->paddr().offset(0xc0000000).as_ptr()); }
     RefPtr<PhysicalPage> m_prdt_page;
-    RefPtr<PhysicalPage> m_dma_buffer_page;
+    // NOTE: Only used for requests whose buffer can't be handed to the controller directly.
+    OwnPtr<Region> m_dma_bounce_buffer;
     Lockable<bool> m_dma_enabled;
     EntropySource m_entropy_source;
 
@@ -165,6 +173,7 @@ private:
     AsyncBlockDeviceRequest* m_current_request { nullptr };
     u32 m_current_request_block_index { 0 };
     bool m_current_request_uses_dma { false };
+    bool m_current_request_uses_bounce_buffer { false };
     bool m_current_request_flushing_cache { false };
     SpinLock<u8> m_request_lock;
 
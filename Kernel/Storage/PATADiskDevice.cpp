@@ -75,6 +75,21 @@ size_t PATADiskDevice::max_addressable_block() const
     return m_cylinders * m_heads * m_sectors_per_track;
 }
 
+size_t PATADiskDevice::max_blocks_per_request() const
+{
+    if (m_channel.m_io_group.bus_master_base().is_null() || !m_channel.m_dma_enabled.resource())
+        return StorageDevice::max_blocks_per_request();
+    return IDEChannel::max_sectors_per_dma_request;
+}
+
+size_t PATADiskDevice::max_merged_request_blocks() const
+{
+    // NOTE: Only DMA transfers can take the blocks of merged requests from several buffers in one go.
+    if (m_channel.m_io_group.bus_master_base().is_null() || !m_channel.m_dma_enabled.resource())
+        return 0;
+    return IDEChannel::max_sectors_per_dma_request;
+}
+
 bool PATADiskDevice::is_slave() const
 {
     return m_drive_type == DriveType::Slave;
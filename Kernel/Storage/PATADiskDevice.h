@@ -63,6 +63,8 @@ public:
     // ^StorageDevice
     virtual Type type() const override { return StorageDevice::Type::IDE; }
     virtual size_t max_addressable_block() const override;
+    virtual size_t max_blocks_per_request() const override;
+    virtual size_t max_merged_request_blocks() const override;
 
     // ^BlockDevice
     virtual void start_request(AsyncBlockDeviceRequest&) override;
@@ -44,6 +44,7 @@ public:
     virtual bool can_read(const FileDescription&, size_t) const override;
     virtual KResultOr<size_t> write(FileDescription&, size_t, const UserOrKernelBuffer&, size_t) override;
     virtual bool can_write(const FileDescription&, size_t) const override;
+    virtual bool schedules_requests() const override { return false; }
 
     // ^Device
     virtual mode_t required_mode() const override { return 0600; }
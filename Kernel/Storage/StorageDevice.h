@@ -47,6 +47,8 @@ public:
 public:
     virtual Type type() const = 0;
     virtual size_t max_addressable_block() const { return m_max_addressable_block; }
+    // NOTE: Reads and writes are split into requests of at most this many blocks.
+    virtual size_t max_blocks_per_request() const { return PAGE_SIZE / block_size(); }
 
     NonnullRefPtr<StorageController> controller() const;
 
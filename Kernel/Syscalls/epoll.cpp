@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/ScopeGuard.h>
+#include <Kernel/FileSystem/EPoll.h>
+#include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/Process.h>
+
+namespace Kernel {
+
+int Process::sys$epoll_create(int flags)
+{
+    REQUIRE_PROMISE(stdio);
+    // Reject flags other than O_CLOEXEC.
+    if ((flags & O_CLOEXEC) != flags)
+        return -EINVAL;
+
+    int fd = alloc_fd();
+    if (fd < 0)
+        return fd;
+
+    auto description = FileDescription::create(*EPoll::create());
+    if (description.is_error())
+        return description.error();
+
+    m_fds[fd].set(description.release_value(), (flags & O_CLOEXEC) ? FD_CLOEXEC : 0);
+    m_fds[fd].description()->set_readable(true);
+    return fd;
+}
+
+int Process::sys$epoll_ctl(Userspace<const Syscall::SC_epoll_ctl_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_epoll_ctl_params params;
+    if (!copy_from_user(&params, user_params))
+        return -EFAULT;
+
+    auto epoll_description = file_description(params.epoll_fd);
+    if (!epoll_description)
+        return -EBADF;
+    if (!epoll_description->file().is_epoll())
+        return -EINVAL;
+    auto description = file_description(params.fd);
+    if (!description)
+        return -EBADF;
+    // NOTE: We don't support watching an epoll from another epoll, or from itself.
+    if (description->file().is_epoll())
+        return -EINVAL;
+    auto& epoll = static_cast<EPoll&>(epoll_description->file());
+
+    epoll_event event {};
+    if (params.op != EPOLL_CTL_DEL) {
+        Userspace<const epoll_event*> user_event((FlatPtr)params.event);
+        if (!copy_from_user(&event, user_event))
+            return -EFAULT;
+    }
+
+    switch (params.op) {
+    case EPOLL_CTL_ADD:
+        return epoll.add(*description, event);
+    case EPOLL_CTL_MOD:
+        return epoll.modify(*description, event);
+    case EPOLL_CTL_DEL:
+        return epoll.remove(*description);
+    default:
+        return -EINVAL;
+    }
+}
+
+int Process::sys$epoll_wait(Userspace<const Syscall::SC_epoll_wait_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_epoll_wait_params params;
+    if (!copy_from_user(&params, user_params))
+        return -EFAULT;
+
+    if (params.max_events <= 0)
+        return -EINVAL;
+
+    auto description = file_description(params.epoll_fd);
+    if (!description)
+        return -EBADF;
+    if (!description->file().is_epoll())
+        return -EINVAL;
+    auto& epoll = static_cast<EPoll&>(description->file());
+
+    Thread::BlockTimeout timeout;
+    if (params.timeout) {
+        timespec timeout_copy;
+        if (!copy_from_user(&timeout_copy, params.timeout))
+            return -EFAULT;
+        timeout = Thread::BlockTimeout(false, &timeout_copy);
+    }
+
+    auto current_thread = Thread::current();
+
+    u32 previous_signal_mask = 0;
+    if (params.sigmask) {
+        sigset_t sigmask_copy;
+        if (!copy_from_user(&sigmask_copy, params.sigmask))
+            return -EFAULT;
+        previous_signal_mask = current_thread->update_signal_mask(sigmask_copy);
+    }
+    ScopeGuard rollback_signal_mask([&]() {
+        if (params.sigmask)
+            current_thread->update_signal_mask(previous_signal_mask);
+    });
+
+    // NOTE: Only entries that were notified are looked at, however many descriptions are registered.
+    size_t max_events = min((size_t)params.max_events, (size_t)m_max_open_file_descriptors);
+    Vector<epoll_event, 32> events;
+    for (;;) {
+        epoll.collect_ready_events(events, max_events);
+        if (!events.is_empty())
+            break;
+        auto unblock_flags = Thread::FileBlocker::BlockFlags::None;
+        auto result = current_thread->block<Thread::ReadBlocker>(timeout, *description, unblock_flags);
+        if (result.was_interrupted())
+            return -EINTR;
+        if (result == Thread::BlockResult::InterruptedByTimeout)
+            break;
+    }
+
+    Userspace<epoll_event*> user_events((FlatPtr)params.events);
+    if (!events.is_empty() && !copy_n_to_user(user_events, events.data(), events.size()))
+        return -EFAULT;
+    return events.size();
+}
+
+}
@@ -38,6 +38,7 @@
 #include <Kernel/VM/AllocationStrategy.h>
 #include <Kernel/VM/MemoryManager.h>
 #include <Kernel/VM/PageDirectory.h>
+#include <Kernel/VM/ProcessPagingScope.h>
 #include <Kernel/VM/Region.h>
 #include <Kernel/VM/SharedInodeVMObject.h>
 #include <LibC/limits.h>
@@ -544,7 +545,8 @@ KResult Process::do_exec(NonnullRefPtr<FileDescription> main_program_description
     m_coredump_metadata.clear();
 
     auto current_thread = Thread::current();
-    current_thread->clear_signals();
+    if (&current_thread->process() == this)
+        current_thread->clear_signals();
 
     clear_futex_queues_on_exec();
 
@@ -624,7 +626,9 @@ KResult Process::do_exec(NonnullRefPtr<FileDescription> main_program_description
     if (m_perf_event_buffer)
         m_perf_event_buffer->clear();
 
-    {
+    // NOTE: When setting up a brand new process, the caller makes the thread runnable
+    //       once the process is in the process list.
+    if (&current_thread->process() == this) {
         ScopedSpinLock lock(g_scheduler_lock);
         new_main_thread->set_state(Thread::State::Runnable);
     }
@@ -876,6 +880,27 @@ KResult Process::exec(String path, Vector<String> arguments, Vector<String> envi
     return KSuccess;
 }
 
+static bool copy_user_strings(const Syscall::StringListArgument& list, Vector<String>& output)
+{
+    if (!list.length)
+        return true;
+    Checked size = sizeof(*list.strings);
+    size *= list.length;
+    if (size.has_overflow())
+        return false;
+    Vector<Syscall::StringArgument, 32> strings;
+    strings.resize(list.length);
+    if (!copy_from_user(strings.data(), list.strings, list.length * sizeof(*list.strings)))
+        return false;
+    for (size_t i = 0; i < list.length; ++i) {
+        auto string = copy_string_from_user(strings[i]);
+        if (string.is_null())
+            return false;
+        output.append(move(string));
+    }
+    return true;
+}
+
 int Process::sys$execve(Userspace<const Syscall::SC_execve_params*> user_params)
 {
     REQUIRE_PROMISE(exec);
@@ -897,26 +922,6 @@ int Process::sys$execve(Userspace<const Syscall::SC_execve_params*> user_params)
         path = path_arg.value();
     }
 
-    auto copy_user_strings = [](const auto& list, auto& output) {
-        if (!list.length)
-            return true;
-        Checked size = sizeof(*list.strings);
-        size *= list.length;
-        if (size.has_overflow())
-            return false;
-        Vector<Syscall::StringArgument, 32> strings;
-        strings.resize(list.length);
-        if (!copy_from_user(strings.data(), list.strings, list.length * sizeof(*list.strings)))
-            return false;
-        for (size_t i = 0; i < list.length; ++i) {
-            auto string = copy_string_from_user(strings[i]);
-            if (string.is_null())
-                return false;
-            output.append(move(string));
-        }
-        return true;
-    };
-
     Vector<String> arguments;
     if (!copy_user_strings(params.arguments, arguments))
         return -EFAULT;
@@ -930,4 +935,68 @@ int Process::sys$execve(Userspace<const Syscall::SC_execve_params*> user_params)
     return result.error();
 }
 
+pid_t Process::sys$posix_spawn(Userspace<const Syscall::SC_posix_spawn_params*> user_params)
+{
+    REQUIRE_PROMISE(proc);
+    REQUIRE_PROMISE(exec);
+
+    Syscall::SC_posix_spawn_params params;
+    if (!copy_from_user(&params, user_params))
+        return -EFAULT;
+
+    if (params.arguments.length > ARG_MAX || params.environment.length > ARG_MAX)
+        return -E2BIG;
+
+    String path;
+    {
+        auto path_arg = get_syscall_path_argument(params.path);
+        if (path_arg.is_error())
+            return path_arg.error();
+        path = path_arg.value();
+    }
+
+    Vector<String> arguments;
+    if (!copy_user_strings(params.arguments, arguments))
+        return -EFAULT;
+
+    Vector<String> environment;
+    if (!copy_user_strings(params.environment, environment))
+        return -EFAULT;
+
+    // Unlike fork(), the child starts out with an empty address space, so there is nothing to copy or COW.
+    RefPtr<Thread> child_first_thread;
+    auto child = adopt(*new Process(child_first_thread, m_name, m_uid, m_gid, m_pid, false, m_cwd, m_executable, m_tty));
+    if (!child_first_thread)
+        return -ENOMEM;
+    copy_inherited_state_to(*child);
+    child_first_thread->m_signal_mask = Thread::current()->m_signal_mask;
+
+    dbgln_if(FORK_DEBUG, "posix_spawn: child={} path={}", child, path);
+
+    {
+        // NOTE: exec() switches us over to the child's address space to set it up.
+        ProcessPagingScope paging_scope(*this);
+        auto result = child->exec(move(path), move(arguments), move(environment));
+        if (result.is_error()) {
+            // The child never got to run, so it can simply go away again.
+            child_first_thread->drop_thread_count(true);
+            return result.error();
+        }
+    }
+
+    {
+        ScopedSpinLock processes_lock(g_processes_lock);
+        g_processes->prepend(child);
+    }
+
+    ScopedSpinLock lock(g_scheduler_lock);
+    child_first_thread->set_state(Thread::State::Runnable);
+
+    auto child_pid = child->pid().value();
+    // We need to leak one reference so we don't destroy the Process,
+    // which will be dropped by Process::reap
+    (void)child.leak_ref();
+    return child_pid;
+}
+
 }
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/Process.h>
+#include <Kernel/Tasks/ReadAheadTask.h>
+
+namespace Kernel {
+
+int Process::sys$posix_fadvise(Userspace<const Syscall::SC_posix_fadvise_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+
+    Syscall::SC_posix_fadvise_params params;
+    if (!copy_from_user(&params, user_params))
+        return -EFAULT;
+
+    if (params.offset < 0 || params.length < 0)
+        return -EINVAL;
+    auto description = file_description(params.fd);
+    if (!description)
+        return -EBADF;
+    // NOTE: Advice only makes sense for something backed by an inode, which rules out pipes, sockets and devices alike.
+    auto* inode = description->inode();
+    if (!inode || description->is_fifo())
+        return -ESPIPE;
+
+    auto range_size = [&]() -> size_t {
+        // A length of zero means "until the end of the file".
+        if (params.length)
+            return params.length;
+        if ((u64)params.offset >= inode->size())
+            return 0;
+        return inode->size() - params.offset;
+    };
+
+    switch (params.advice) {
+    case POSIX_FADV_NORMAL:
+        description->set_access_pattern(FileDescription::AccessPattern::Normal);
+        return 0;
+    case POSIX_FADV_SEQUENTIAL:
+        description->set_access_pattern(FileDescription::AccessPattern::Sequential);
+        return 0;
+    case POSIX_FADV_RANDOM:
+        description->set_access_pattern(FileDescription::AccessPattern::Random);
+        return 0;
+    case POSIX_FADV_WILLNEED:
+        ReadAheadTask::enqueue(*inode, params.offset, range_size());
+        return 0;
+    case POSIX_FADV_DONTNEED:
+        inode->evict_cached_data(params.offset, range_size());
+        return 0;
+    case POSIX_FADV_NOREUSE:
+        return 0;
+    default:
+        return -EINVAL;
+    }
+}
+
+}
@@ -29,9 +29,28 @@
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/Process.h>
 #include <Kernel/VM/Region.h>
+#include <Kernel/VM/TLBFlushBatch.h>
 
 namespace Kernel {
 
+void Process::copy_inherited_state_to(Process& child)
+{
+    child.m_root_directory = m_root_directory;
+    child.m_root_directory_relative_to_global_root = m_root_directory_relative_to_global_root;
+    child.m_promises = m_promises;
+    child.m_execpromises = m_execpromises;
+    child.m_has_promises = m_has_promises;
+    child.m_has_execpromises = m_has_execpromises;
+    child.m_veil_state = m_veil_state;
+    child.m_unveiled_paths = m_unveiled_paths.deep_copy();
+    child.m_fds = m_fds;
+    child.m_sid = m_sid;
+    child.m_pg = m_pg;
+    child.m_umask = m_umask;
+    child.m_extra_gids = m_extra_gids;
+    child.m_signal_trampoline = m_signal_trampoline;
+}
+
 pid_t Process::sys$fork(RegisterState& regs)
 {
     REQUIRE_PROMISE(proc);
@@ -39,20 +58,7 @@ pid_t Process::sys$fork(RegisterState& regs)
     auto child = adopt(*new Process(child_first_thread, m_name, m_uid, m_gid, m_pid, m_is_kernel_process, m_cwd, m_executable, m_tty, this));
     if (!child_first_thread)
         return -ENOMEM;
-    child->m_root_directory = m_root_directory;
-    child->m_root_directory_relative_to_global_root = m_root_directory_relative_to_global_root;
-    child->m_promises = m_promises;
-    child->m_execpromises = m_execpromises;
-    child->m_has_promises = m_has_promises;
-    child->m_has_execpromises = m_has_execpromises;
-    child->m_veil_state = m_veil_state;
-    child->m_unveiled_paths = m_unveiled_paths.deep_copy();
-    child->m_fds = m_fds;
-    child->m_sid = m_sid;
-    child->m_pg = m_pg;
-    child->m_umask = m_umask;
-    child->m_extra_gids = m_extra_gids;
-    child->m_signal_trampoline = m_signal_trampoline;
+    copy_inherited_state_to(*child);
 
     dbgln_if(FORK_DEBUG, "fork: child={}", child);
     child->space().set_enforces_syscall_regions(space().enforces_syscall_regions());
@@ -78,6 +84,8 @@ pid_t Process::sys$fork(RegisterState& regs)
     dbgln_if(FORK_DEBUG, "fork: child will begin executing at {:04x}:{:08x} with stack {:04x}:{:08x}, kstack {:04x}:{:08x}", child_tss.cs, child_tss.eip, child_tss.ss, child_tss.esp, child_tss.ss0, child_tss.esp0);
 
     {
+        // NOTE: Write-protecting our own regions for COW only needs one TLB shootdown at the end.
+        TLBFlushBatch tlb_flush_batch(space().page_directory());
         ScopedSpinLock lock(space().get_lock());
         for (auto& region : space().regions()) {
             dbgln_if(FORK_DEBUG, "fork: cloning Region({}) '{}' @ {}", &region, region.name(), region.vaddr());
@@ -89,7 +97,7 @@ pid_t Process::sys$fork(RegisterState& regs)
             }
 
             auto& child_region = child->space().add_region(region_clone.release_nonnull());
-            child_region.map(child->space().page_directory());
+            child_region.map_lazily(child->space().page_directory());
 
             if (&region == m_master_tls_region.unsafe_ptr())
                 child->m_master_tls_region = child_region;
@@ -27,11 +27,13 @@
 #include <AK/WeakPtr.h>
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/Process.h>
+#include <Kernel/Tasks/ReadAheadTask.h>
 #include <Kernel/VM/MemoryManager.h>
 #include <Kernel/VM/PageDirectory.h>
 #include <Kernel/VM/PrivateInodeVMObject.h>
 #include <Kernel/VM/Region.h>
 #include <Kernel/VM/SharedInodeVMObject.h>
+#include <Kernel/VM/TLBFlushBatch.h>
 #include <LibC/limits.h>
 #include <LibELF/Validation.h>
 
@@ -210,6 +212,10 @@ FlatPtr Process::sys$mmap(Userspace<const Syscall::SC_mmap_params*> user_params)
     Region* region = nullptr;
     Optional<Range> range;
 
+    // Place big mappings so that they can be mapped with large pages.
+    if (!addr)
+        alignment = max(alignment, virtual_alignment_for_size(page_round_up(size)));
+
     if (map_randomized) {
         range = space().page_directory().range_allocator().allocate_randomized(page_round_up(size), alignment);
     } else {
@@ -339,19 +345,26 @@ int Process::sys$mprotect(void* addr, size_t size, int prot)
             return -EACCES;
         }
 
+        // Unmapping the old region and mapping the split ones only needs a single TLB shootdown.
+        TLBFlushBatch tlb_flush_batch(space().page_directory());
+
+        // Remove the old region from the space first, since one of the split regions will start at the same address.
+        auto region = space().take_region(*old_region);
+        VERIFY(region);
+
         // This vector is the region(s) adjacent to our range.
         // We need to allocate a new region for the range we wanted to change permission bits on.
-        auto adjacent_regions = space().split_region_around_range(*old_region, range_to_mprotect);
+        auto adjacent_regions = space().split_region_around_range(*region, range_to_mprotect);
 
-        size_t new_range_offset_in_vmobject = old_region->offset_in_vmobject() + (range_to_mprotect.base().get() - old_region->range().base().get());
-        auto& new_region = space().allocate_split_region(*old_region, range_to_mprotect, new_range_offset_in_vmobject);
+        size_t new_range_offset_in_vmobject = region->offset_in_vmobject() + (range_to_mprotect.base().get() - region->range().base().get());
+        auto& new_region = space().allocate_split_region(*region, range_to_mprotect, new_range_offset_in_vmobject);
         new_region.set_readable(prot & PROT_READ);
         new_region.set_writable(prot & PROT_WRITE);
         new_region.set_executable(prot & PROT_EXEC);
 
         // Unmap the old region here, specifying that we *don't* want the VM deallocated.
-        old_region->unmap(Region::ShouldDeallocateVirtualMemoryRange::No);
-        space().deallocate_region(*old_region);
+        region->unmap(Region::ShouldDeallocateVirtualMemoryRange::No);
+        region = nullptr;
 
         // Map the new regions using our page directory (they were just allocated and don't have one).
         for (auto* adjacent_region : adjacent_regions) {
@@ -412,6 +425,20 @@ int Process::sys$madvise(void* address, size_t size, int advice)
             return -EPERM;
         return region->is_volatile(VirtualAddress(address), size) ? 0 : 1;
     }
+    switch (advice) {
+    case MADV_NORMAL:
+    case MADV_RANDOM:
+    case MADV_SEQUENTIAL:
+        region->set_accessed_sequentially(advice == MADV_SEQUENTIAL);
+        return 0;
+    case MADV_WILLNEED:
+        if (region->vmobject().is_inode()) {
+            auto& inode = static_cast<InodeVMObject&>(region->vmobject()).inode();
+            auto offset_in_inode = region->offset_in_vmobject() + (range_to_madvise.base().get() - region->vaddr().get());
+            ReadAheadTask::enqueue(inode, offset_in_inode, range_to_madvise.size());
+        }
+        return 0;
+    }
     return -EINVAL;
 }
 
@@ -473,19 +500,28 @@ int Process::sys$munmap(void* addr, size_t size)
         if (!old_region->is_mmap())
             return -EPERM;
 
-        auto new_regions = space().split_region_around_range(*old_region, range_to_unmap);
+        {
+            // Unmapping the old region and mapping the split ones only needs a single TLB shootdown.
+            TLBFlushBatch tlb_flush_batch(space().page_directory());
 
-        // We manually unmap the old region here, specifying that we *don't* want the VM deallocated.
-        old_region->unmap(Region::ShouldDeallocateVirtualMemoryRange::No);
-        space().deallocate_region(*old_region);
+            // Remove the old region from the space first, since one of the split regions may start at the same address.
+            auto region = space().take_region(*old_region);
+            VERIFY(region);
 
-        // Instead we give back the unwanted VM manually.
-        space().page_directory().range_allocator().deallocate(range_to_unmap);
+            auto new_regions = space().split_region_around_range(*region, range_to_unmap);
 
-        // And finally we map the new region(s) using our page directory (they were just allocated and don't have one).
-        for (auto* new_region : new_regions) {
-            new_region->map(space().page_directory());
+            // We manually unmap the old region here, specifying that we *don't* want the VM deallocated.
+            region->unmap(Region::ShouldDeallocateVirtualMemoryRange::No);
+            region = nullptr;
+
+            // And we map the new region(s) using our page directory (they were just allocated and don't have one).
+            for (auto* new_region : new_regions) {
+                new_region->map(space().page_directory());
+            }
         }
+
+        // Finally we give back the unwanted VM manually, now that no processor can have stale translations for it.
+        space().page_directory().range_allocator().deallocate(range_to_unmap);
         return 0;
     }
 
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/FileSystem/Inode.h>
+#include <Kernel/KBuffer.h>
+#include <Kernel/Net/IPv4Socket.h>
+#include <Kernel/Process.h>
+
+namespace Kernel {
+
+static constexpr size_t splice_chunk_size = 64 * KiB;
+
+// Data read from a pipe or a socket can't be put back, so once we have it, all of it has to go out.
+static ssize_t write_all_consumed(FileDescription& out, const UserOrKernelBuffer& buffer, size_t size)
+{
+    size_t nwritten = 0;
+    while (nwritten < size) {
+        if (!out.can_write()) {
+            auto unblock_flags = Thread::FileBlocker::BlockFlags::None;
+            if (Thread::current()->block<Thread::WriteBlocker>({}, out, unblock_flags).was_interrupted())
+                break;
+            continue;
+        }
+        auto result = out.write(buffer.offset(nwritten), size - nwritten);
+        if (result.is_error()) {
+            if (nwritten)
+                break;
+            return result.error();
+        }
+        if (result.value() == 0)
+            break;
+        nwritten += result.value();
+    }
+    return nwritten;
+}
+
+ssize_t Process::do_splice(FileDescription& in, Optional<off_t> in_offset, FileDescription& out, size_t count)
+{
+    // NOTE: Regular files are read straight from their inode, so an explicit offset never touches the description.
+    RefPtr<Inode> inode = in.file().is_inode() ? in.inode() : nullptr;
+    if (!inode && in_offset.has_value())
+        return -ESPIPE;
+    off_t offset = inode ? in_offset.value_or(in.offset()) : 0;
+
+    // Stream sockets can build their packets directly from the inode, which avoids the bounce buffer.
+    IPv4Socket* socket = nullptr;
+    if (inode && out.is_socket() && out.socket()->is_ipv4())
+        socket = static_cast<IPv4Socket*>(out.socket());
+
+    OwnPtr<KBuffer> bounce_buffer;
+    size_t total_nsent = 0;
+    while (total_nsent < count) {
+        size_t chunk_size = min(splice_chunk_size, count - total_nsent);
+        ssize_t nsent = 0;
+        if (socket) {
+            if (!out.can_write()) {
+                if (total_nsent)
+                    break;
+                if (!out.is_blocking())
+                    return -EAGAIN;
+                auto unblock_flags = Thread::FileBlocker::BlockFlags::None;
+                if (Thread::current()->block<Thread::WriteBlocker>({}, out, unblock_flags).was_interrupted())
+                    return -EINTR;
+                continue;
+            }
+            auto result = socket->send_from_inode(*inode, offset, chunk_size);
+            if (result.is_error()) {
+                if (result.error() == -ENOTSUP) {
+                    socket = nullptr;
+                    continue;
+                }
+                if (total_nsent)
+                    break;
+                return result.error();
+            }
+            nsent = result.value();
+        } else {
+            if (!bounce_buffer) {
+                bounce_buffer = KBuffer::try_create_with_size(splice_chunk_size, Region::Access::Read | Region::Access::Write, "splice");
+                if (!bounce_buffer)
+                    return -ENOMEM;
+            }
+            auto buffer = UserOrKernelBuffer::for_kernel_buffer(bounce_buffer->data());
+            ssize_t nread = 0;
+            if (inode) {
+                nread = inode->read_bytes(offset, chunk_size, buffer, &in);
+            } else {
+                // Only take data out of the input once the output can take some of it.
+                if (!out.can_write()) {
+                    if (total_nsent)
+                        break;
+                    if (!out.is_blocking())
+                        return -EAGAIN;
+                    auto unblock_flags = Thread::FileBlocker::BlockFlags::None;
+                    if (Thread::current()->block<Thread::WriteBlocker>({}, out, unblock_flags).was_interrupted())
+                        return -EINTR;
+                    continue;
+                }
+                if (!in.can_read()) {
+                    if (total_nsent)
+                        break;
+                    if (!in.is_blocking())
+                        return -EAGAIN;
+                    auto unblock_flags = Thread::FileBlocker::BlockFlags::None;
+                    if (Thread::current()->block<Thread::ReadBlocker>({}, in, unblock_flags).was_interrupted())
+                        return -EINTR;
+                    if (!((u32)unblock_flags & (u32)Thread::FileBlocker::BlockFlags::Read))
+                        return -EAGAIN;
+                }
+                auto result = in.read(buffer, chunk_size);
+                nread = result.is_error() ? (ssize_t)result.error() : (ssize_t)result.value();
+            }
+            if (nread < 0) {
+                if (total_nsent)
+                    break;
+                return nread;
+            }
+            if (nread == 0)
+                break;
+            nsent = inode ? do_write(out, buffer, nread) : write_all_consumed(out, buffer, nread);
+            if (nsent < 0) {
+                if (total_nsent)
+                    break;
+                return nsent;
+            }
+        }
+        if (nsent == 0)
+            break;
+        total_nsent += nsent;
+        offset += nsent;
+        if ((size_t)nsent < chunk_size)
+            break;
+    }
+
+    if (inode && !in_offset.has_value())
+        in.seek(offset, SEEK_SET);
+    return total_nsent;
+}
+
+static KResultOr<NonnullRefPtr<FileDescription>> splice_description(Process& process, int fd, bool for_reading)
+{
+    auto description = process.file_description(fd);
+    if (!description)
+        return EBADF;
+    if (for_reading ? !description->is_readable() : !description->is_writable())
+        return EBADF;
+    if (description->is_directory())
+        return EISDIR;
+    return description.release_nonnull();
+}
+
+ssize_t Process::sys$sendfile(Userspace<const Syscall::SC_sendfile_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_sendfile_params params;
+    if (!copy_from_user(&params, user_params))
+        return -EFAULT;
+    if ((ssize_t)params.count < 0)
+        return -EINVAL;
+
+    auto in_description_or_error = splice_description(*this, params.in_fd, true);
+    if (in_description_or_error.is_error())
+        return in_description_or_error.error();
+    auto out_description_or_error = splice_description(*this, params.out_fd, false);
+    if (out_description_or_error.is_error())
+        return out_description_or_error.error();
+
+    Userspace<off_t*> user_offset((FlatPtr)params.offset);
+    Optional<off_t> offset;
+    if (user_offset) {
+        off_t value;
+        if (!copy_from_user(&value, user_offset))
+            return -EFAULT;
+        if (value < 0)
+            return -EINVAL;
+        offset = value;
+    }
+
+    auto nsent = do_splice(in_description_or_error.value(), offset, out_description_or_error.value(), params.count);
+    if (nsent > 0 && offset.has_value()) {
+        off_t new_offset = offset.value() + nsent;
+        if (!copy_to_user(user_offset, &new_offset))
+            return -EFAULT;
+    }
+    return nsent;
+}
+
+ssize_t Process::sys$splice(Userspace<const Syscall::SC_splice_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_splice_params params;
+    if (!copy_from_user(&params, user_params))
+        return -EFAULT;
+    if ((ssize_t)params.length < 0)
+        return -EINVAL;
+    // FIXME: Support writing to an explicit output offset.
+    if (params.out_offset)
+        return -EINVAL;
+
+    auto in_description_or_error = splice_description(*this, params.in_fd, true);
+    if (in_description_or_error.is_error())
+        return in_description_or_error.error();
+    auto out_description_or_error = splice_description(*this, params.out_fd, false);
+    if (out_description_or_error.is_error())
+        return out_description_or_error.error();
+
+    Userspace<off_t*> user_in_offset((FlatPtr)params.in_offset);
+    Optional<off_t> in_offset;
+    if (user_in_offset) {
+        off_t value;
+        if (!copy_from_user(&value, user_in_offset))
+            return -EFAULT;
+        if (value < 0)
+            return -EINVAL;
+        in_offset = value;
+    }
+
+    auto nsent = do_splice(in_description_or_error.value(), in_offset, out_description_or_error.value(), params.length);
+    if (nsent > 0 && in_offset.has_value()) {
+        off_t new_offset = in_offset.value() + nsent;
+        if (!copy_to_user(user_in_offset, &new_offset))
+            return -EFAULT;
+    }
+    return nsent;
+}
+
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Singleton.h>
+#include <Kernel/FileSystem/Inode.h>
+#include <Kernel/Process.h>
+#include <Kernel/Tasks/ReadAheadTask.h>
+#include <Kernel/WaitQueue.h>
+
+namespace Kernel {
+
+struct ReadAheadRequest {
+    NonnullRefPtr<Inode> inode;
+    off_t offset { 0 };
+    size_t count { 0 };
+};
+
+static constexpr size_t max_pending_read_ahead_requests = 64;
+
+static AK::Singleton<WaitQueue> s_read_ahead_wait_queue;
+static AK::Singleton<Vector<ReadAheadRequest>> s_pending_requests;
+static SpinLock<u8> s_pending_requests_lock;
+
+void ReadAheadTask::spawn()
+{
+    RefPtr<Thread> read_ahead_thread;
+    Process::create_kernel_process(read_ahead_thread, "ReadAheadTask", [] {
+        Thread::current()->set_priority(THREAD_PRIORITY_LOW);
+        for (;;) {
+            Vector<ReadAheadRequest> requests;
+            {
+                ScopedSpinLock lock(s_pending_requests_lock);
+                swap(requests, *s_pending_requests);
+            }
+            if (requests.is_empty()) {
+                s_read_ahead_wait_queue->wait_forever("ReadAheadTask");
+                continue;
+            }
+            for (auto& request : requests)
+                request.inode->read_ahead(request.offset, request.count);
+        }
+    });
+}
+
+void ReadAheadTask::enqueue(Inode& inode, off_t offset, size_t count)
+{
+    if (!count)
+        return;
+    {
+        ScopedSpinLock lock(s_pending_requests_lock);
+        if (s_pending_requests->size() >= max_pending_read_ahead_requests)
+            return;
+        s_pending_requests->append({ inode, offset, count });
+    }
+    s_read_ahead_wait_queue->wake_all();
+}
+
+}
@@ -24,23 +24,38 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <Kernel/FileSystem/VirtualFileSystem.h>
+#include <AK/Singleton.h>
+#include <Kernel/FileSystem/FileSystem.h>
 #include <Kernel/Process.h>
 #include <Kernel/Tasks/SyncTask.h>
 #include <Kernel/Time/TimeManagement.h>
+#include <Kernel/WaitQueue.h>
 
 namespace Kernel {
 
+static AK::Singleton<WaitQueue> s_sync_wait_queue;
+static Atomic<bool> s_sync_requested;
+
 void SyncTask::spawn()
 {
     RefPtr<Thread> syncd_thread;
     Process::create_kernel_process(syncd_thread, "SyncTask", [] {
         dbgln("SyncTask is running");
         for (;;) {
-            VFS::the().sync();
-            (void)Thread::current()->sleep({ 1, 0 });
+            s_sync_requested.store(false, AK::MemoryOrder::memory_order_release);
+            FS::write_back_expired();
+            timespec timeout { 1, 0 };
+            (void)s_sync_wait_queue->wait_on(Thread::BlockTimeout(false, &timeout), "SyncTask");
         }
     });
 }
 
+void SyncTask::notify()
+{
+    // Ask for an early writeback, e.g. because a disk cache is filling up with dirty blocks.
+    if (s_sync_requested.exchange(true, AK::MemoryOrder::memory_order_acq_rel))
+        return;
+    s_sync_wait_queue->wake_all();
+}
+
 }
@@ -30,5 +30,6 @@ namespace Kernel {
 class SyncTask {
 public:
     static void spawn();
+    static void notify();
 };
 }
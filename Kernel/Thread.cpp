@@ -38,6 +38,7 @@
 #include <Kernel/Scheduler.h>
 #include <Kernel/Thread.h>
 #include <Kernel/ThreadTracer.h>
+#include <Kernel/Time/TimeManagement.h>
 #include <Kernel/TimerQueue.h>
 #include <Kernel/VM/MemoryManager.h>
 #include <Kernel/VM/PageDirectory.h>
@@ -308,6 +309,22 @@ void Thread::donate_without_holding_big_lock(RefPtr<Thread>& thread, const char*
     relock_process(previous_locked, lock_count_to_restore);
 }
 
+u64 Thread::profiling_block_begin() const
+{
+    if (!process().is_profiling())
+        return 0;
+    auto now = TimeManagement::the().monotonic_time(TimePrecision::Precise);
+    return (u64)now.tv_sec * 1'000'000'000 + now.tv_nsec;
+}
+
+void Thread::profiling_block_end(const Blocker& blocker, u64 start) const
+{
+    auto now = TimeManagement::the().monotonic_time(TimePrecision::Precise);
+    u64 duration_ns = (u64)now.tv_sec * 1'000'000'000 + now.tv_nsec - start;
+    // NOTE: Queue blockers are named after what they wait for, e.g. the Lock.
+    PerformanceEventBuffer::record_lock_event(PERF_EVENT_BLOCK, &blocker, blocker.state_string(), duration_ns);
+}
+
 LockMode Thread::unlock_process_if_locked(u32& lock_count_to_restore)
 {
     return process().big_lock().force_unlock_if_locked(lock_count_to_restore);
@@ -333,6 +350,52 @@ void Thread::relock_process(LockMode previous_locked, u32 lock_count_to_restore)
     }
 }
 
+bool Thread::holds_shared_lock(const Lock& lock) const
+{
+    for (auto& hold : m_shared_lock_holds) {
+        if (hold.lock == &lock)
+            return true;
+    }
+    return false;
+}
+
+void Thread::add_shared_lock_hold(Lock& lock, u32 count)
+{
+    for (auto& hold : m_shared_lock_holds) {
+        if (hold.lock == &lock) {
+            hold.count += count;
+            return;
+        }
+    }
+    m_shared_lock_holds.append({ &lock, count });
+}
+
+void Thread::remove_shared_lock_hold(Lock& lock)
+{
+    for (size_t i = 0; i < m_shared_lock_holds.size(); ++i) {
+        auto& hold = m_shared_lock_holds[i];
+        if (hold.lock != &lock)
+            continue;
+        VERIFY(hold.count > 0);
+        if (--hold.count == 0)
+            m_shared_lock_holds.remove(i);
+        return;
+    }
+    VERIFY_NOT_REACHED();
+}
+
+u32 Thread::take_shared_lock_holds(Lock& lock)
+{
+    for (size_t i = 0; i < m_shared_lock_holds.size(); ++i) {
+        if (m_shared_lock_holds[i].lock != &lock)
+            continue;
+        auto count = m_shared_lock_holds[i].count;
+        m_shared_lock_holds.remove(i);
+        return count;
+    }
+    return 0;
+}
+
 auto Thread::sleep(clockid_t clock_id, const timespec& duration, timespec* remaining_time) -> BlockResult
 {
     VERIFY(state() == Thread::Running);
@@ -925,7 +988,6 @@ void Thread::set_state(State new_state, u8 stop_signal)
 
     if (m_state == Runnable) {
         Scheduler::queue_runnable_thread(*this);
-        Processor::smp_wake_n_idle_processors(1);
     } else if (m_state == Stopped) {
         // We don't want to restore to Running state, only Runnable!
         m_stop_state = previous_state != Running ? previous_state : Runnable;
@@ -889,6 +889,7 @@ public:
         bool did_timeout = false;
         u32 lock_count_to_restore = 0;
         auto previous_locked = unlock_process_if_locked(lock_count_to_restore);
+        u64 block_start = profiling_block_begin();
         for (;;) {
             // Yield to the scheduler, and wait for us to resume unblocked.
             VERIFY(!g_scheduler_lock.own_lock());
@@ -920,6 +921,8 @@ public:
             m_in_block = false;
             break;
         }
+        if (block_start)
+            profiling_block_end(t, block_start);
 
         if (t.was_interrupted_by_signal()) {
             ScopedSpinLock scheduler_lock(g_scheduler_lock);
@@ -1151,11 +1154,23 @@ public:
     }
     void set_handling_page_fault(bool b) { m_handling_page_fault = b; }
 
+    TLBFlushBatch* tlb_flush_batch() const { return m_tlb_flush_batch; }
+    void set_tlb_flush_batch(TLBFlushBatch* batch) { m_tlb_flush_batch = batch; }
+
+    // NOTE: Shared Lock holds are tracked here so that Lock doesn't need to keep a list of its readers.
+    //       The first few fit inline, only threads holding more than that many locks allocate.
+    bool holds_shared_lock(const Lock&) const;
+    void add_shared_lock_hold(Lock&, u32 count);
+    void remove_shared_lock_hold(Lock&);
+    u32 take_shared_lock_holds(Lock&);
+
 private:
     Thread(NonnullRefPtr<Process>, NonnullOwnPtr<Region> kernel_stack_region);
 
     IntrusiveListNode m_process_thread_list_node;
     int m_runnable_priority { -1 };
+    // NOTE: Only changed with the ready queue lock of the processor it names (or named) held.
+    Atomic<int, AK::MemoryOrder::memory_order_relaxed> m_runnable_processor { -1 };
 
     friend class WaitQueue;
 
@@ -1217,6 +1232,8 @@ private:
 
     LockMode unlock_process_if_locked(u32&);
     void relock_process(LockMode, u32);
+    u64 profiling_block_begin() const;
+    void profiling_block_end(const Blocker&, u64 start) const;
     String backtrace();
     void reset_fpu_state();
 
@@ -1259,6 +1276,13 @@ private:
     Atomic<bool, AK::MemoryOrder::memory_order_relaxed> m_is_active { false };
     bool m_is_joinable { true };
     bool m_handling_page_fault { false };
+    TLBFlushBatch* m_tlb_flush_batch { nullptr };
+
+    struct SharedLockHold {
+        Lock* lock { nullptr };
+        u32 count { 0 };
+    };
+    Vector<SharedLockHold, 8> m_shared_lock_holds;
     PreviousMode m_previous_mode { PreviousMode::UserMode };
 
     unsigned m_syscall_count { 0 };
@@ -102,8 +102,19 @@ AnonymousVMObject::AnonymousVMObject(size_t size, AllocationStrategy strategy)
 {
     if (strategy == AllocationStrategy::AllocateNow) {
         // Allocate all pages right now. We know we can get all because we committed the amount needed
-        for (size_t i = 0; i < page_count(); ++i)
-            physical_pages()[i] = MM.allocate_committed_user_physical_page(MemoryManager::ShouldZeroFill::Yes);
+        size_t i = 0;
+        while (i < page_count()) {
+            // Try to back every 2 MiB of the object with a large page, so that it can be mapped as one.
+            if (!(i % pages_per_large_page) && page_count() - i >= pages_per_large_page) {
+                auto large_page = MM.allocate_committed_user_large_page();
+                if (!large_page.is_empty()) {
+                    for (auto& page : large_page)
+                        physical_pages()[i++] = page;
+                    continue;
+                }
+            }
+            physical_pages()[i++] = MM.allocate_committed_user_physical_page(MemoryManager::ShouldZeroFill::Yes);
+        }
     } else {
         auto& initial_page = (strategy == AllocationStrategy::Reserve) ? MM.lazy_committed_page() : MM.shared_zero_page();
         for (size_t i = 0; i < page_count(); ++i)
@@ -393,6 +404,43 @@ RefPtr<PhysicalPage> AnonymousVMObject::allocate_committed_page(size_t page_inde
     return MM.allocate_committed_user_physical_page(MemoryManager::ShouldZeroFill::Yes);
 }
 
+bool AnonymousVMObject::is_lazy_committed_large_page(size_t first_page_index) const
+{
+    VERIFY(m_lock.is_locked());
+    if (first_page_index % pages_per_large_page || first_page_index + pages_per_large_page > page_count())
+        return false;
+    if (m_unused_committed_pages < pages_per_large_page)
+        return false;
+    for (size_t i = 0; i < pages_per_large_page; ++i) {
+        if (!physical_pages()[first_page_index + i]->is_lazy_committed_page())
+            return false;
+    }
+    return true;
+}
+
+bool AnonymousVMObject::can_commit_large_page(size_t first_page_index) const
+{
+    ScopedSpinLock lock(m_lock);
+    return is_lazy_committed_large_page(first_page_index);
+}
+
+bool AnonymousVMObject::commit_large_page(size_t first_page_index, NonnullRefPtrVector<PhysicalPage>& large_page)
+{
+    VERIFY(large_page.size() == pages_per_large_page);
+    ScopedSpinLock lock(m_lock);
+    // NOTE: The page fault handler zeroes the large page without holding any locks,
+    //       so someone else may have committed a part of this range in the meantime.
+    if (!is_lazy_committed_large_page(first_page_index))
+        return false;
+
+    // The large page was taken from the uncommitted pool, give back what we had reserved for this range.
+    m_unused_committed_pages -= pages_per_large_page;
+    MM.uncommit_user_physical_pages(pages_per_large_page);
+    for (size_t i = 0; i < pages_per_large_page; ++i)
+        physical_pages()[first_page_index + i] = large_page[i];
+    return true;
+}
+
 Bitmap& AnonymousVMObject::ensure_cow_map()
 {
     if (!m_cow_map)
@@ -46,6 +46,8 @@ public:
     virtual RefPtr<VMObject> clone() override;
 
     RefPtr<PhysicalPage> allocate_committed_page(size_t);
+    bool can_commit_large_page(size_t first_page_index) const;
+    bool commit_large_page(size_t first_page_index, NonnullRefPtrVector<PhysicalPage>&);
     PageFaultResponse handle_cow_fault(size_t, VirtualAddress);
     size_t cow_pages() const;
     bool should_cow(size_t page_index, bool) const;
@@ -132,6 +134,7 @@ private:
     size_t count_needed_commit_pages_for_nonvolatile_range(const VolatilePageRange&);
     size_t mark_committed_pages_for_nonvolatile_range(const VolatilePageRange&, size_t);
     bool is_nonvolatile(size_t page_index);
+    bool is_lazy_committed_large_page(size_t first_page_index) const;
 
     AnonymousVMObject& operator=(const AnonymousVMObject&) = delete;
     AnonymousVMObject& operator=(AnonymousVMObject&&) = delete;
@@ -26,6 +26,7 @@
 
 #include <AK/Assertions.h>
 #include <AK/Memory.h>
+#include <AK/ScopeGuard.h>
 #include <AK/StringView.h>
 #include <Kernel/Arch/i386/CPU.h>
 #include <Kernel/CMOS.h>
@@ -34,12 +35,14 @@
 #include <Kernel/Multiboot.h>
 #include <Kernel/Process.h>
 #include <Kernel/StdLib.h>
+#include <Kernel/Tasks/PageZeroingTask.h>
 #include <Kernel/VM/AnonymousVMObject.h>
 #include <Kernel/VM/ContiguousVMObject.h>
 #include <Kernel/VM/MemoryManager.h>
 #include <Kernel/VM/PageDirectory.h>
 #include <Kernel/VM/PhysicalRegion.h>
 #include <Kernel/VM/SharedInodeVMObject.h>
+#include <Kernel/VM/TLBFlushBatch.h>
 
 extern u8* start_of_kernel_image;
 extern u8* end_of_kernel_image;
@@ -332,12 +335,27 @@ PageTableEntry* MemoryManager::pte(PageDirectory& page_directory, VirtualAddress
 
     auto* pd = quickmap_pd(const_cast<PageDirectory&>(page_directory), page_directory_table_index);
     const PageDirectoryEntry& pde = pd[page_directory_index];
-    if (!pde.is_present())
+    if (!pde.is_present() || pde.is_huge())
         return nullptr;
 
     return &quickmap_pt(PhysicalAddress((FlatPtr)pde.page_table_base()))[page_table_index];
 }
 
+Optional<PhysicalAddress> MemoryManager::physical_address_for_kernel_vaddr(VirtualAddress vaddr)
+{
+    VERIFY(!is_user_address(vaddr));
+    ScopedSpinLock lock(s_mm_lock);
+    ScopedSpinLock page_lock(kernel_page_directory().get_lock());
+    auto* pd = quickmap_pd(kernel_page_directory(), (vaddr.get() >> 30) & 0x3);
+    auto& pde = pd[(vaddr.get() >> 21) & 0x1ff];
+    if (pde.is_present() && pde.is_huge())
+        return PhysicalAddress((FlatPtr)pde.page_table_base()).offset(vaddr.get() & (large_page_size - 1));
+    auto* pte = this->pte(kernel_page_directory(), vaddr);
+    if (!pte || !pte->is_present())
+        return {};
+    return PhysicalAddress((FlatPtr)pte->physical_page_base()).offset(vaddr.get() & ~PAGE_MASK);
+}
+
 PageTableEntry* MemoryManager::ensure_pte(PageDirectory& page_directory, VirtualAddress vaddr)
 {
     VERIFY_INTERRUPTS_DISABLED();
@@ -349,6 +367,13 @@ PageTableEntry* MemoryManager::ensure_pte(PageDirectory& page_directory, Virtual
 
     auto* pd = quickmap_pd(page_directory, page_directory_table_index);
     PageDirectoryEntry& pde = pd[page_directory_index];
+    if (pde.is_present() && pde.is_huge()) {
+        // Someone wants to change a single page, so we have to split up the large page.
+        if (!demote_large_page(page_directory, vaddr))
+            return nullptr;
+        pd = quickmap_pd(page_directory, page_directory_table_index);
+        VERIFY(&pde == &pd[page_directory_index]);
+    }
     if (!pde.is_present()) {
         bool did_purge = false;
         auto page_table = allocate_user_physical_page(ShouldZeroFill::Yes, &did_purge);
@@ -390,6 +415,12 @@ void MemoryManager::release_pte(PageDirectory& page_directory, VirtualAddress va
 
     auto* pd = quickmap_pd(page_directory, page_directory_table_index);
     PageDirectoryEntry& pde = pd[page_directory_index];
+    if (pde.is_present() && pde.is_huge()) {
+        // Large pages are only used for whole 2 MiB chunks of a region, so the whole chunk goes away.
+        pde.clear();
+        --m_large_pages_mapped;
+        return;
+    }
     if (pde.is_present()) {
         auto* page_table = quickmap_pt(PhysicalAddress((FlatPtr)pde.page_table_base()));
         auto& pte = page_table[page_table_index];
@@ -408,11 +439,146 @@ void MemoryManager::release_pte(PageDirectory& page_directory, VirtualAddress va
             if (all_clear) {
                 pde.clear();
 
-                auto result = page_directory.m_page_tables.remove(vaddr.get() & ~0x1fffff);
-                VERIFY(result);
+                auto it = page_directory.m_page_tables.find(vaddr.get() & ~0x1fffff);
+                VERIFY(it != page_directory.m_page_tables.end());
+                auto page_table = move(it->value);
+                page_directory.m_page_tables.remove(it);
+                // NOTE: Other processors may walk the page table until the pending flush is done.
+                if (auto* batch = TLBFlushBatch::current_for(page_directory))
+                    batch->defer_release(page_table.release_nonnull());
+            }
+        }
+    }
+}
+
+size_t MemoryManager::write_protect_range(PageDirectory& page_directory, VirtualAddress vaddr, size_t page_count)
+{
+    VERIFY_INTERRUPTS_DISABLED();
+    VERIFY(s_mm_lock.own_lock());
+    VERIFY(page_directory.get_lock().own_lock());
+    VERIFY(vaddr.page_base() == vaddr);
+
+    // NOTE: This only touches page tables that already exist, unmapped parts of the range are skipped a whole page table at a time.
+    size_t pages_protected = 0;
+    FlatPtr address = vaddr.get();
+    FlatPtr end = address + page_count * PAGE_SIZE;
+    while (address < end) {
+        FlatPtr chunk_end = min(end, (address & ~(large_page_size - 1)) + large_page_size);
+        u32 page_directory_table_index = (address >> 30) & 0x3;
+        u32 page_directory_index = (address >> 21) & 0x1ff;
+
+        auto* pd = quickmap_pd(page_directory, page_directory_table_index);
+        PageDirectoryEntry& pde = pd[page_directory_index];
+        if (pde.is_present() && pde.is_huge()) {
+            // The first write will split up the large page.
+            if (pde.is_writable()) {
+                pde.set_writable(false);
+                pages_protected += pages_per_large_page;
+            }
+        } else if (pde.is_present()) {
+            auto* page_table = quickmap_pt(PhysicalAddress((FlatPtr)pde.page_table_base()));
+            for (FlatPtr page = address; page < chunk_end; page += PAGE_SIZE) {
+                auto& pte = page_table[(page >> 12) & 0x1ff];
+                if (pte.is_present() && pte.is_writable()) {
+                    pte.set_writable(false);
+                    ++pages_protected;
+                }
             }
         }
+        address = chunk_end;
+    }
+    return pages_protected;
+}
+
+bool MemoryManager::map_large_page(PageDirectory& page_directory, VirtualAddress vaddr, PhysicalAddress paddr, bool writable, bool user_allowed, bool executable, bool cacheable)
+{
+    VERIFY_INTERRUPTS_DISABLED();
+    VERIFY(s_mm_lock.own_lock());
+    VERIFY(page_directory.get_lock().own_lock());
+    VERIFY(!(vaddr.get() & (large_page_size - 1)));
+    VERIFY(!(paddr.get() & (large_page_size - 1)));
+    u32 page_directory_table_index = (vaddr.get() >> 30) & 0x3;
+    u32 page_directory_index = (vaddr.get() >> 21) & 0x1ff;
+
+    auto* pd = quickmap_pd(page_directory, page_directory_table_index);
+    PageDirectoryEntry& pde = pd[page_directory_index];
+    bool was_huge = pde.is_present() && pde.is_huge();
+    if (pde.is_present() && !pde.is_huge()) {
+        // We can only throw away page tables that we allocated ourselves, not the ones set up at boot.
+        auto it = page_directory.m_page_tables.find(vaddr.get());
+        if (it == page_directory.m_page_tables.end())
+            return false;
+        auto page_table = move(it->value);
+        page_directory.m_page_tables.remove(it);
+        if (auto* batch = TLBFlushBatch::current_for(page_directory))
+            batch->defer_release(page_table.release_nonnull());
+    }
+
+    pde.clear();
+    pde.set_page_table_base(paddr.get());
+    pde.set_huge(true);
+    pde.set_present(true);
+    pde.set_writable(writable);
+    pde.set_user_allowed(user_allowed);
+    pde.set_cache_disabled(!cacheable);
+    pde.set_global(&page_directory == m_kernel_page_directory.ptr());
+    if (Processor::current().has_feature(CPUFeature::NX))
+        pde.set_execute_disabled(!executable);
+
+    if (!was_huge) {
+        ++m_large_pages_mapped;
+        ++m_large_page_promotions;
+    }
+    return true;
+}
+
+bool MemoryManager::demote_large_page(PageDirectory& page_directory, VirtualAddress vaddr)
+{
+    VERIFY_INTERRUPTS_DISABLED();
+    VERIFY(s_mm_lock.own_lock());
+    VERIFY(page_directory.get_lock().own_lock());
+    auto large_page_vaddr = VirtualAddress(vaddr.get() & ~(large_page_size - 1));
+    u32 page_directory_table_index = (vaddr.get() >> 30) & 0x3;
+    u32 page_directory_index = (vaddr.get() >> 21) & 0x1ff;
+
+    auto page_table = allocate_user_physical_page(ShouldZeroFill::No);
+    if (!page_table) {
+        dbgln("MM: Unable to allocate page table to split large page at {}", large_page_vaddr);
+        return false;
+    }
+
+    // NOTE: Allocating may have purged memory and changed the quickmapped page directory.
+    auto* pd = quickmap_pd(page_directory, page_directory_table_index);
+    PageDirectoryEntry& pde = pd[page_directory_index];
+    VERIFY(pde.is_present() && pde.is_huge());
+
+    auto* ptes = quickmap_pt(page_table->paddr());
+    auto large_page_paddr = PhysicalAddress((FlatPtr)pde.page_table_base());
+    for (size_t i = 0; i < pages_per_large_page; ++i) {
+        auto& pte = ptes[i];
+        pte.clear();
+        pte.set_physical_page_base(large_page_paddr.offset(i * PAGE_SIZE).get());
+        pte.set_present(true);
+        pte.set_writable(pde.is_writable());
+        pte.set_user_allowed(pde.is_user_allowed());
+        pte.set_cache_disabled(pde.is_cache_disabled());
+        pte.set_global(pde.is_global());
+        pte.set_execute_disabled(pde.is_execute_disabled());
     }
+
+    pde.clear();
+    pde.set_page_table_base(page_table->paddr().get());
+    pde.set_user_allowed(true);
+    pde.set_present(true);
+    pde.set_writable(true);
+    pde.set_global(&page_directory == m_kernel_page_directory.ptr());
+    auto result = page_directory.m_page_tables.set(large_page_vaddr.get(), move(page_table));
+    VERIFY(result == AK::HashSetResult::InsertedNewEntry);
+
+    --m_large_pages_mapped;
+    ++m_large_page_demotions;
+    flush_tlb(&page_directory, large_page_vaddr, pages_per_large_page);
+    return true;
 }
 
 UNMAP_AFTER_INIT void MemoryManager::initialize(u32 cpu)
@@ -429,22 +595,19 @@ UNMAP_AFTER_INIT void MemoryManager::initialize(u32 cpu)
 Region* MemoryManager::kernel_region_from_vaddr(VirtualAddress vaddr)
 {
     ScopedSpinLock lock(s_mm_lock);
-    for (auto& region : MM.m_kernel_regions) {
-        if (region.contains(vaddr))
-            return &region;
-    }
-    return nullptr;
+    auto* region = MM.m_kernel_regions.find_largest_not_above(vaddr.get());
+    if (!region || !region->contains(vaddr))
+        return nullptr;
+    return region;
 }
 
 Region* MemoryManager::user_region_from_vaddr(Space& space, VirtualAddress vaddr)
 {
-    // FIXME: Use a binary search tree (maybe red/black?) or some other more appropriate data structure!
     ScopedSpinLock lock(space.get_lock());
-    for (auto& region : space.regions()) {
-        if (region.contains(vaddr))
-            return &region;
-    }
-    return nullptr;
+    auto* region = space.regions().find_largest_not_above(vaddr.get());
+    if (!region || !region->contains(vaddr))
+        return nullptr;
+    return region;
 }
 
 Region* MemoryManager::find_region_from_vaddr(Space& space, VirtualAddress vaddr)
@@ -493,7 +656,7 @@ OwnPtr<Region> MemoryManager::allocate_contiguous_kernel_region(size_t size, Str
 {
     VERIFY(!(size % PAGE_SIZE));
     ScopedSpinLock lock(s_mm_lock);
-    auto range = kernel_page_directory().range_allocator().allocate_anywhere(size);
+    auto range = kernel_page_directory().range_allocator().allocate_anywhere(size, virtual_alignment_for_size(size));
     if (!range.has_value())
         return {};
     auto vmobject = ContiguousVMObject::create_with_size(size, physical_alignment);
@@ -504,7 +667,7 @@ OwnPtr<Region> MemoryManager::allocate_kernel_region(size_t size, String name, u
 {
     VERIFY(!(size % PAGE_SIZE));
     ScopedSpinLock lock(s_mm_lock);
-    auto range = kernel_page_directory().range_allocator().allocate_anywhere(size);
+    auto range = kernel_page_directory().range_allocator().allocate_anywhere(size, virtual_alignment_for_size(size));
     if (!range.has_value())
         return {};
     auto vmobject = AnonymousVMObject::create_with_size(size, strategy);
@@ -517,7 +680,7 @@ OwnPtr<Region> MemoryManager::allocate_kernel_region(PhysicalAddress paddr, size
 {
     VERIFY(!(size % PAGE_SIZE));
     ScopedSpinLock lock(s_mm_lock);
-    auto range = kernel_page_directory().range_allocator().allocate_anywhere(size);
+    auto range = kernel_page_directory().range_allocator().allocate_anywhere(size, virtual_alignment_for_size(size));
     if (!range.has_value())
         return {};
     auto vmobject = AnonymousVMObject::create_for_physical_range(paddr, size);
@@ -552,20 +715,28 @@ OwnPtr<Region> MemoryManager::allocate_kernel_region_with_vmobject(VMObject& vmo
 {
     VERIFY(!(size % PAGE_SIZE));
     ScopedSpinLock lock(s_mm_lock);
-    auto range = kernel_page_directory().range_allocator().allocate_anywhere(size);
+    auto range = kernel_page_directory().range_allocator().allocate_anywhere(size, virtual_alignment_for_size(size));
     if (!range.has_value())
         return {};
     return allocate_kernel_region_with_vmobject(range.value(), vmobject, move(name), access, cacheable);
 }
 
+bool MemoryManager::take_uncommitted_user_physical_pages(size_t page_count)
+{
+    auto uncommitted = m_user_physical_pages_uncommitted.load();
+    do {
+        if (uncommitted < page_count)
+            return false;
+    } while (!m_user_physical_pages_uncommitted.compare_exchange_strong(uncommitted, uncommitted - page_count));
+    return true;
+}
+
 bool MemoryManager::commit_user_physical_pages(size_t page_count)
 {
     VERIFY(page_count > 0);
-    ScopedSpinLock lock(s_mm_lock);
-    if (m_user_physical_pages_uncommitted < page_count)
+    if (!take_uncommitted_user_physical_pages(page_count))
         return false;
 
-    m_user_physical_pages_uncommitted -= page_count;
     m_user_physical_pages_committed += page_count;
     return true;
 }
@@ -573,78 +744,212 @@ bool MemoryManager::commit_user_physical_pages(size_t page_count)
 void MemoryManager::uncommit_user_physical_pages(size_t page_count)
 {
     VERIFY(page_count > 0);
-    ScopedSpinLock lock(s_mm_lock);
-    VERIFY(m_user_physical_pages_committed >= page_count);
+    auto previously_committed = m_user_physical_pages_committed.fetch_sub(page_count);
+    VERIFY(previously_committed >= page_count);
 
     m_user_physical_pages_uncommitted += page_count;
-    m_user_physical_pages_committed -= page_count;
 }
 
-void MemoryManager::deallocate_user_physical_page(const PhysicalPage& page)
+void MemoryManager::return_user_physical_page_to_region(PhysicalAddress paddr)
 {
-    ScopedSpinLock lock(s_mm_lock);
+    VERIFY(s_mm_lock.own_lock());
     for (auto& region : m_user_physical_regions) {
-        if (!region.contains(page))
+        if (!region.contains(paddr))
             continue;
 
-        region.return_page(page);
-        --m_user_physical_pages_used;
-
-        // Always return pages to the uncommitted pool. Pages that were
-        // committed and allocated are only freed upon request. Once
-        // returned there is no guarantee being able to get them back.
-        ++m_user_physical_pages_uncommitted;
+        region.return_page(paddr);
         return;
     }
 
-    dmesgln("MM: deallocate_user_physical_page couldn't figure out region for user page @ {}", page.paddr());
+    dmesgln("MM: deallocate_user_physical_page couldn't figure out region for user page @ {}", paddr);
     VERIFY_NOT_REACHED();
 }
 
-RefPtr<PhysicalPage> MemoryManager::find_free_user_physical_page(bool committed)
+void MemoryManager::drain_physical_page_caches()
 {
-    VERIFY(s_mm_lock.is_locked());
-    RefPtr<PhysicalPage> page;
-    if (committed) {
-        // Draw from the committed pages pool. We should always have these pages available
-        VERIFY(m_user_physical_pages_committed > 0);
-        m_user_physical_pages_committed--;
-    } else {
-        // We need to make sure we don't touch pages that we have committed to
-        if (m_user_physical_pages_uncommitted == 0)
-            return {};
-        m_user_physical_pages_uncommitted--;
+    VERIFY(s_mm_lock.own_lock());
+    for (auto& cache : m_physical_page_caches) {
+        ScopedSpinLock cache_lock(cache.lock);
+        while (cache.count > 0)
+            return_user_physical_page_to_region(cache.pages[--cache.count]);
     }
-    for (auto& region : m_user_physical_regions) {
-        page = region.take_free_page(false);
-        if (!page.is_null()) {
-            ++m_user_physical_pages_used;
-            break;
+}
+
+size_t MemoryManager::cached_user_physical_pages() const
+{
+    size_t count = 0;
+    for (auto& cache : m_physical_page_caches)
+        count += cache.count;
+    return count;
+}
+
+Optional<PhysicalAddress> MemoryManager::take_user_physical_page()
+{
+    {
+        auto& cache = m_physical_page_caches[Processor::id()];
+        ScopedSpinLock cache_lock(cache.lock);
+        if (cache.count > 0)
+            return cache.pages[--cache.count];
+    }
+
+    // Our cache is empty, refill half of it from the physical regions.
+    // NOTE: s_mm_lock is always taken before a cache lock, never the other way around.
+    ScopedSpinLock lock(s_mm_lock);
+    auto& cache = m_physical_page_caches[Processor::id()];
+    ScopedSpinLock cache_lock(cache.lock);
+    auto take_from_regions = [&] {
+        for (auto& region : m_user_physical_regions) {
+            if (cache.count >= PhysicalPageCache::capacity / 2)
+                break;
+            cache.count += region.take_free_pages({ cache.pages + cache.count, PhysicalPageCache::capacity / 2 - cache.count });
         }
+    };
+    take_from_regions();
+    if (cache.count == 0) {
+        // The remaining free pages might all be sitting in other processors' caches.
+        cache_lock.unlock();
+        drain_physical_page_caches();
+        cache_lock.lock();
+        take_from_regions();
     }
-    VERIFY(!committed || !page.is_null());
-    return page;
+    if (cache.count == 0)
+        return {};
+    return cache.pages[--cache.count];
 }
 
-NonnullRefPtr<PhysicalPage> MemoryManager::allocate_committed_user_physical_page(ShouldZeroFill should_zero_fill)
+void MemoryManager::return_user_physical_page(PhysicalAddress paddr)
 {
+    {
+        auto& cache = m_physical_page_caches[Processor::id()];
+        ScopedSpinLock cache_lock(cache.lock);
+        if (cache.count < PhysicalPageCache::capacity) {
+            cache.pages[cache.count++] = paddr;
+            return;
+        }
+    }
+
+    // Our cache is full, give half of it back to the physical regions.
     ScopedSpinLock lock(s_mm_lock);
-    auto page = find_free_user_physical_page(true);
+    auto& cache = m_physical_page_caches[Processor::id()];
+    ScopedSpinLock cache_lock(cache.lock);
+    while (cache.count > PhysicalPageCache::capacity / 2)
+        return_user_physical_page_to_region(cache.pages[--cache.count]);
+    cache.pages[cache.count++] = paddr;
+}
+
+void MemoryManager::deallocate_user_physical_page(const PhysicalPage& page)
+{
+    return_user_physical_page(page.paddr());
+    --m_user_physical_pages_used;
+
+    // Always return pages to the uncommitted pool. Pages that were
+    // committed and allocated are only freed upon request. Once
+    // returned there is no guarantee being able to get them back.
+    ++m_user_physical_pages_uncommitted;
+}
+
+Optional<PhysicalAddress> MemoryManager::take_zeroed_user_physical_page()
+{
+    Optional<PhysicalAddress> paddr;
+    bool should_refill = false;
+    {
+        ScopedSpinLock lock(m_zeroed_page_pool_lock);
+        if (m_zeroed_page_pool_count > 0)
+            paddr = m_zeroed_page_pool[--m_zeroed_page_pool_count];
+        should_refill = m_zeroed_page_pool_count < zeroed_page_pool_capacity / 2;
+    }
+    if (should_refill)
+        PageZeroingTask::notify();
+    return paddr;
+}
+
+bool MemoryManager::add_page_to_zeroed_page_pool()
+{
+    if (m_zeroed_page_pool_count >= zeroed_page_pool_capacity)
+        return false;
+
+    // NOTE: We hold on to an uncommitted page while the page is neither in the pool nor
+    //       in a page cache, so that nobody else counts on finding it there.
+    if (!take_uncommitted_user_physical_pages(1))
+        return false;
+    ScopeGuard give_back_uncommitted_page = [&] { ++m_user_physical_pages_uncommitted; };
+
+    auto paddr = take_user_physical_page();
+    if (!paddr.has_value())
+        return false;
+
+    {
+        InterruptDisabler disabler;
+        auto* ptr = quickmap_page(paddr.value());
+        memset(ptr, 0, PAGE_SIZE);
+        unquickmap_page();
+    }
+
+    {
+        ScopedSpinLock lock(m_zeroed_page_pool_lock);
+        if (m_zeroed_page_pool_count < zeroed_page_pool_capacity) {
+            m_zeroed_page_pool[m_zeroed_page_pool_count++] = paddr.value();
+            return true;
+        }
+    }
+    return_user_physical_page(paddr.value());
+    return false;
+}
+
+RefPtr<PhysicalPage> MemoryManager::find_free_user_physical_page(bool committed, ShouldZeroFill should_zero_fill)
+{
+    if (committed) {
+        // Draw from the committed pages pool. We should always have these pages available
+        auto previously_committed = m_user_physical_pages_committed.fetch_sub(1);
+        VERIFY(previously_committed > 0);
+    } else {
+        // We need to make sure we don't touch pages that we have committed to
+        if (!take_uncommitted_user_physical_pages(1))
+            return {};
+    }
+
+    Optional<PhysicalAddress> paddr;
+    bool is_zeroed = false;
     if (should_zero_fill == ShouldZeroFill::Yes) {
+        paddr = take_zeroed_user_physical_page();
+        is_zeroed = paddr.has_value();
+        if (is_zeroed)
+            ++m_zeroed_page_pool_hits;
+        else
+            ++m_zeroed_page_pool_misses;
+    }
+    if (!paddr.has_value())
+        paddr = take_user_physical_page();
+    if (!paddr.has_value()) {
+        // The only free pages left might be the pre-zeroed ones.
+        paddr = take_zeroed_user_physical_page();
+        is_zeroed = paddr.has_value();
+    }
+    VERIFY(paddr.has_value());
+    ++m_user_physical_pages_used;
+
+    auto page = PhysicalPage::create(paddr.value(), false);
+    if (should_zero_fill == ShouldZeroFill::Yes && !is_zeroed) {
+        InterruptDisabler disabler;
         auto* ptr = quickmap_page(*page);
         memset(ptr, 0, PAGE_SIZE);
         unquickmap_page();
     }
-    return page.release_nonnull();
+    return page;
+}
+
+NonnullRefPtr<PhysicalPage> MemoryManager::allocate_committed_user_physical_page(ShouldZeroFill should_zero_fill)
+{
+    return find_free_user_physical_page(true, should_zero_fill).release_nonnull();
 }
 
 RefPtr<PhysicalPage> MemoryManager::allocate_user_physical_page(ShouldZeroFill should_zero_fill, bool* did_purge)
 {
-    ScopedSpinLock lock(s_mm_lock);
-    auto page = find_free_user_physical_page(false);
+    auto page = find_free_user_physical_page(false, should_zero_fill);
     bool purged_pages = false;
 
     if (!page) {
+        ScopedSpinLock lock(s_mm_lock);
         // We didn't have a single free physical page. Let's try to free something up!
         // First, we look for a purgeable VMObject in the volatile state.
         for_each_vmobject([&](auto& vmobject) {
@@ -653,7 +958,7 @@ RefPtr<PhysicalPage> MemoryManager::allocate_user_physical_page(ShouldZeroFill s
             int purged_page_count = static_cast<AnonymousVMObject&>(vmobject).purge_with_interrupts_disabled({});
             if (purged_page_count) {
                 dbgln("MM: Purge saved the day! Purged {} pages from AnonymousVMObject", purged_page_count);
-                page = find_free_user_physical_page(false);
+                page = find_free_user_physical_page(false, should_zero_fill);
                 purged_pages = true;
                 VERIFY(page);
                 return IterationDecision::Break;
@@ -666,12 +971,6 @@ RefPtr<PhysicalPage> MemoryManager::allocate_user_physical_page(ShouldZeroFill s
         }
     }
 
-    if (should_zero_fill == ShouldZeroFill::Yes) {
-        auto* ptr = quickmap_page(*page);
-        memset(ptr, 0, PAGE_SIZE);
-        unquickmap_page();
-    }
-
     if (did_purge)
         *did_purge = purged_pages;
     return page;
@@ -705,7 +1004,7 @@ NonnullRefPtrVector<PhysicalPage> MemoryManager::allocate_contiguous_supervisor_
     for (auto& region : m_super_physical_regions) {
         physical_pages = region.take_contiguous_free_pages(count, true, physical_alignment);
         if (!physical_pages.is_empty())
-            continue;
+            break;
     }
 
     if (physical_pages.is_empty()) {
@@ -724,6 +1023,58 @@ NonnullRefPtrVector<PhysicalPage> MemoryManager::allocate_contiguous_supervisor_
     return physical_pages;
 }
 
+NonnullRefPtrVector<PhysicalPage> MemoryManager::take_user_large_page()
+{
+    ScopedSpinLock lock(s_mm_lock);
+    NonnullRefPtrVector<PhysicalPage> physical_pages;
+    for (auto& region : m_user_physical_regions) {
+        physical_pages = region.take_contiguous_free_pages(pages_per_large_page, false, large_page_size);
+        if (!physical_pages.is_empty())
+            break;
+    }
+    if (!physical_pages.is_empty())
+        m_user_physical_pages_used += pages_per_large_page;
+    return physical_pages;
+}
+
+void MemoryManager::zero_user_large_page(NonnullRefPtrVector<PhysicalPage>& physical_pages)
+{
+    for (auto& page : physical_pages) {
+        InterruptDisabler disabler;
+        auto* ptr = quickmap_page(page);
+        memset(ptr, 0, PAGE_SIZE);
+        unquickmap_page();
+    }
+}
+
+NonnullRefPtrVector<PhysicalPage> MemoryManager::allocate_committed_user_large_page()
+{
+    auto physical_pages = take_user_large_page();
+    if (physical_pages.is_empty())
+        return {};
+
+    auto previously_committed = m_user_physical_pages_committed.fetch_sub(pages_per_large_page);
+    VERIFY(previously_committed >= pages_per_large_page);
+    zero_user_large_page(physical_pages);
+    return physical_pages;
+}
+
+NonnullRefPtrVector<PhysicalPage> MemoryManager::allocate_user_large_page()
+{
+    // NOTE: Zeroing 2 MiB takes a while, don't make everyone else wait for s_mm_lock meanwhile.
+    VERIFY(!s_mm_lock.own_lock());
+    if (!take_uncommitted_user_physical_pages(pages_per_large_page))
+        return {};
+
+    auto physical_pages = take_user_large_page();
+    if (physical_pages.is_empty()) {
+        m_user_physical_pages_uncommitted += pages_per_large_page;
+        return {};
+    }
+    zero_user_large_page(physical_pages);
+    return physical_pages;
+}
+
 RefPtr<PhysicalPage> MemoryManager::allocate_supervisor_physical_page()
 {
     ScopedSpinLock lock(s_mm_lock);
@@ -772,6 +1123,10 @@ void MemoryManager::flush_tlb_local(VirtualAddress vaddr, size_t page_count)
 
 void MemoryManager::flush_tlb(const PageDirectory* page_directory, VirtualAddress vaddr, size_t page_count)
 {
+    if (auto* batch = TLBFlushBatch::current_for(*page_directory)) {
+        batch->add(vaddr, page_count);
+        return;
+    }
     Processor::flush_tlb(page_directory, vaddr, page_count);
 }
 
@@ -829,6 +1184,11 @@ PageTableEntry* MemoryManager::quickmap_pt(PhysicalAddress pt_paddr)
 }
 
 u8* MemoryManager::quickmap_page(PhysicalPage& physical_page)
+{
+    return quickmap_page(physical_page.paddr());
+}
+
+u8* MemoryManager::quickmap_page(PhysicalAddress paddr)
 {
     VERIFY_INTERRUPTS_DISABLED();
     auto& mm_data = get_data();
@@ -839,8 +1199,8 @@ u8* MemoryManager::quickmap_page(PhysicalPage& physical_page)
     VirtualAddress vaddr(0xffe00000 + pte_idx * PAGE_SIZE);
 
     auto& pte = boot_pd3_pt1023[pte_idx];
-    if (pte.physical_page_base() != physical_page.paddr().as_ptr()) {
-        pte.set_physical_page_base(physical_page.paddr().get());
+    if (pte.physical_page_base() != paddr.as_ptr()) {
+        pte.set_physical_page_base(paddr.get());
         pte.set_present(true);
         pte.set_writable(true);
         pte.set_user_allowed(false);
@@ -888,7 +1248,7 @@ void MemoryManager::register_region(Region& region)
 {
     ScopedSpinLock lock(s_mm_lock);
     if (region.is_kernel())
-        m_kernel_regions.append(&region);
+        m_kernel_regions.insert(region.vaddr().get(), region);
     else
         m_user_regions.append(&region);
 }
@@ -897,7 +1257,7 @@ void MemoryManager::unregister_region(Region& region)
 {
     ScopedSpinLock lock(s_mm_lock);
     if (region.is_kernel())
-        m_kernel_regions.remove(&region);
+        m_kernel_regions.remove(region.vaddr().get());
     else
         m_user_regions.remove(&region);
 }
@@ -57,6 +57,16 @@ constexpr FlatPtr page_round_down(FlatPtr x)
     return ((FlatPtr)(x)) & ~(PAGE_SIZE - 1);
 }
 
+// NOTE: With PAE paging, a page directory entry can map a 2 MiB large page instead of a page table.
+constexpr size_t large_page_size = 2 * MiB;
+constexpr size_t pages_per_large_page = large_page_size / PAGE_SIZE;
+
+// Big enough ranges are aligned so that they can be mapped with large pages.
+constexpr size_t virtual_alignment_for_size(size_t size)
+{
+    return size >= large_page_size ? large_page_size : PAGE_SIZE;
+}
+
 inline u32 low_physical_to_virtual(u32 physical)
 {
     return physical + 0xc0000000;
@@ -117,6 +127,16 @@ struct MemoryManagerData {
     PhysicalAddress m_last_quickmap_pt;
 };
 
+// Free user physical pages held by one processor, so that most page allocations
+// and deallocations don't have to go to the physical regions under s_mm_lock.
+struct PhysicalPageCache {
+    static constexpr size_t capacity = 32;
+
+    SpinLock<u8> lock;
+    size_t count { 0 };
+    PhysicalAddress pages[capacity];
+};
+
 extern RecursiveSpinLock s_mm_lock;
 
 class MemoryManager {
@@ -160,6 +180,8 @@ public:
     RefPtr<PhysicalPage> allocate_user_physical_page(ShouldZeroFill = ShouldZeroFill::Yes, bool* did_purge = nullptr);
     RefPtr<PhysicalPage> allocate_supervisor_physical_page();
     NonnullRefPtrVector<PhysicalPage> allocate_contiguous_supervisor_physical_pages(size_t size, size_t physical_alignment = PAGE_SIZE);
+    NonnullRefPtrVector<PhysicalPage> allocate_committed_user_large_page();
+    NonnullRefPtrVector<PhysicalPage> allocate_user_large_page();
     void deallocate_user_physical_page(const PhysicalPage&);
     void deallocate_supervisor_physical_page(const PhysicalPage&);
 
@@ -170,6 +192,8 @@ public:
     OwnPtr<Region> allocate_kernel_region_with_vmobject(VMObject&, size_t, String name, u8 access, Region::Cacheable = Region::Cacheable::Yes);
     OwnPtr<Region> allocate_kernel_region_with_vmobject(const Range&, VMObject&, String name, u8 access, Region::Cacheable = Region::Cacheable::Yes);
 
+    Optional<PhysicalAddress> physical_address_for_kernel_vaddr(VirtualAddress);
+
     unsigned user_physical_pages() const { return m_user_physical_pages; }
     unsigned user_physical_pages_used() const { return m_user_physical_pages_used; }
     unsigned user_physical_pages_committed() const { return m_user_physical_pages_committed; }
@@ -177,6 +201,29 @@ public:
     unsigned super_physical_pages() const { return m_super_physical_pages; }
     unsigned super_physical_pages_used() const { return m_super_physical_pages_used; }
 
+    template<typename Callback>
+    void for_each_physical_region(Callback callback)
+    {
+        ScopedSpinLock lock(s_mm_lock);
+        for (auto& region : m_user_physical_regions)
+            callback(region, false);
+        for (auto& region : m_super_physical_regions)
+            callback(region, true);
+    }
+
+    size_t cached_user_physical_pages() const;
+
+    // Zeroes one free page and adds it to the pool of pre-zeroed pages.
+    // Returns false once the pool is full or there are no free pages to spare.
+    bool add_page_to_zeroed_page_pool();
+    size_t zeroed_page_pool_size() const { return m_zeroed_page_pool_count; }
+    u32 zeroed_page_pool_hits() const { return m_zeroed_page_pool_hits; }
+    u32 zeroed_page_pool_misses() const { return m_zeroed_page_pool_misses; }
+
+    u32 large_pages_mapped() const { return m_large_pages_mapped; }
+    u32 large_page_promotions() const { return m_large_page_promotions; }
+    u32 large_page_demotions() const { return m_large_page_demotions; }
+
     template<typename Callback>
     static void for_each_vmobject(Callback callback)
     {
@@ -219,8 +266,17 @@ private:
 
     static Region* find_region_from_vaddr(VirtualAddress);
 
-    RefPtr<PhysicalPage> find_free_user_physical_page(bool);
+    RefPtr<PhysicalPage> find_free_user_physical_page(bool committed, ShouldZeroFill);
+    bool take_uncommitted_user_physical_pages(size_t);
+    Optional<PhysicalAddress> take_user_physical_page();
+    void return_user_physical_page(PhysicalAddress);
+    void return_user_physical_page_to_region(PhysicalAddress);
+    void drain_physical_page_caches();
+    Optional<PhysicalAddress> take_zeroed_user_physical_page();
+    NonnullRefPtrVector<PhysicalPage> take_user_large_page();
+    void zero_user_large_page(NonnullRefPtrVector<PhysicalPage>&);
     u8* quickmap_page(PhysicalPage&);
+    u8* quickmap_page(PhysicalAddress);
     void unquickmap_page();
 
     PageDirectoryEntry* quickmap_pd(PageDirectory&, size_t pdpt_index);
@@ -229,6 +285,9 @@ private:
     PageTableEntry* pte(PageDirectory&, VirtualAddress);
     PageTableEntry* ensure_pte(PageDirectory&, VirtualAddress);
     void release_pte(PageDirectory&, VirtualAddress, bool);
+    size_t write_protect_range(PageDirectory&, VirtualAddress, size_t page_count);
+    bool map_large_page(PageDirectory&, VirtualAddress, PhysicalAddress, bool writable, bool user_allowed, bool executable, bool cacheable);
+    bool demote_large_page(PageDirectory&, VirtualAddress);
 
     RefPtr<PageDirectory> m_kernel_page_directory;
 
@@ -244,9 +303,21 @@ private:
 
     NonnullRefPtrVector<PhysicalRegion> m_user_physical_regions;
     NonnullRefPtrVector<PhysicalRegion> m_super_physical_regions;
+    PhysicalPageCache m_physical_page_caches[Processor::max_count];
+
+    static constexpr size_t zeroed_page_pool_capacity = 512;
+    SpinLock<u8> m_zeroed_page_pool_lock;
+    size_t m_zeroed_page_pool_count { 0 };
+    PhysicalAddress m_zeroed_page_pool[zeroed_page_pool_capacity];
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> m_zeroed_page_pool_hits { 0 };
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> m_zeroed_page_pool_misses { 0 };
+
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> m_large_pages_mapped { 0 };
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> m_large_page_promotions { 0 };
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> m_large_page_demotions { 0 };
 
     InlineLinkedList<Region> m_user_regions;
-    InlineLinkedList<Region> m_kernel_regions;
+    RegionTree m_kernel_regions;
     Vector<UsedMemoryRange> m_used_memory_ranges;
     Vector<PhysicalMemoryRange> m_physical_memory_ranges;
     Vector<ContiguousReservedMemoryRange> m_reserved_memory_ranges;
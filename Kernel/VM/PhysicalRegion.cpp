@@ -24,17 +24,82 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <AK/Bitmap.h>
 #include <AK/NonnullRefPtr.h>
 #include <AK/RefPtr.h>
 #include <AK/Vector.h>
 #include <Kernel/Assertions.h>
-#include <Kernel/Random.h>
 #include <Kernel/VM/PhysicalPage.h>
 #include <Kernel/VM/PhysicalRegion.h>
 
 namespace Kernel {
 
+static size_t order_for_page_count(size_t count)
+{
+    size_t order = 0;
+    while ((1u << order) < count)
+        ++order;
+    return order;
+}
+
+void PhysicalRegion::FreeBlockSet::initialize(size_t size)
+{
+    m_size = size;
+    m_count = 0;
+    m_level_count = 0;
+    size_t bits = size;
+    do {
+        VERIFY(m_level_count < max_levels);
+        auto& level = m_levels[m_level_count++];
+        size_t words = ceil_div(bits, (size_t)32);
+        level.resize(words);
+        for (auto& word : level)
+            word = 0;
+        bits = words;
+    } while (bits > 1);
+}
+
+void PhysicalRegion::FreeBlockSet::add(size_t index)
+{
+    VERIFY(index < m_size);
+    VERIFY(!contains(index));
+    ++m_count;
+    for (size_t level = 0; level < m_level_count; ++level) {
+        auto& word = m_levels[level][index / 32];
+        bool was_empty = word == 0;
+        word |= 1u << (index % 32);
+        if (!was_empty)
+            break;
+        index /= 32;
+    }
+}
+
+void PhysicalRegion::FreeBlockSet::remove(size_t index)
+{
+    VERIFY(index < m_size);
+    VERIFY(contains(index));
+    --m_count;
+    for (size_t level = 0; level < m_level_count; ++level) {
+        auto& word = m_levels[level][index / 32];
+        word &= ~(1u << (index % 32));
+        if (word != 0)
+            break;
+        index /= 32;
+    }
+}
+
+Optional<size_t> PhysicalRegion::FreeBlockSet::first() const
+{
+    if (m_count == 0)
+        return {};
+    size_t index = 0;
+    for (size_t level = m_level_count; level > 0; --level) {
+        auto word = m_levels[level - 1][index];
+        VERIFY(word != 0);
+        index = index * 32 + count_trailing_zeroes_32(word);
+    }
+    return index;
+}
+
 NonnullRefPtr<PhysicalRegion> PhysicalRegion::create(PhysicalAddress lower, PhysicalAddress upper)
 {
     return adopt(*new PhysicalRegion(lower, upper));
@@ -43,7 +108,6 @@ NonnullRefPtr<PhysicalRegion> PhysicalRegion::create(PhysicalAddress lower, Phys
 PhysicalRegion::PhysicalRegion(PhysicalAddress lower, PhysicalAddress upper)
     : m_lower(lower)
     , m_upper(upper)
-    , m_bitmap(Bitmap::create())
 {
 }
 
@@ -60,133 +124,137 @@ unsigned PhysicalRegion::finalize_capacity()
     VERIFY(!m_pages);
 
     m_pages = (m_upper.get() - m_lower.get()) / PAGE_SIZE;
-    m_bitmap.grow(m_pages, false);
+    m_first_pfn = m_lower.get() / PAGE_SIZE;
+    if (!m_pages)
+        return 0;
+
+    auto last_pfn = m_first_pfn + m_pages - 1;
+    for (size_t order = 0; order <= max_order; ++order)
+        m_buckets[order].initialize((last_pfn >> order) - (m_first_pfn >> order) + 1);
+
+    // Every page starts out free, in blocks that are as large as possible.
+    m_used = m_pages;
+    deallocate_range(m_first_pfn, m_pages);
+    VERIFY(m_used == 0);
 
     return size();
 }
 
-NonnullRefPtrVector<PhysicalPage> PhysicalRegion::take_contiguous_free_pages(size_t count, bool supervisor, size_t physical_alignment)
+Optional<size_t> PhysicalRegion::allocate_block(size_t order)
 {
-    VERIFY(m_pages);
-    VERIFY(m_used != m_pages);
+    for (size_t bucket_order = order; bucket_order <= max_order; ++bucket_order) {
+        auto index = m_buckets[bucket_order].first();
+        if (!index.has_value())
+            continue;
 
-    NonnullRefPtrVector<PhysicalPage> physical_pages;
-    physical_pages.ensure_capacity(count);
+        m_buckets[bucket_order].remove(index.value());
+        auto pfn = pfn_of_block(index.value(), bucket_order);
 
-    auto first_contiguous_page = find_contiguous_free_pages(count, physical_alignment);
+        // Split the block, handing the upper halves back to the smaller orders.
+        while (bucket_order > order) {
+            --bucket_order;
+            auto upper_half_pfn = pfn + (1u << bucket_order);
+            m_buckets[bucket_order].add(block_index(upper_half_pfn, bucket_order));
+        }
 
-    for (size_t index = 0; index < count; index++)
-        physical_pages.append(PhysicalPage::create(m_lower.offset(PAGE_SIZE * (index + first_contiguous_page)), supervisor));
-    return physical_pages;
+        m_used += 1u << order;
+        return pfn;
+    }
+    return {};
 }
 
-unsigned PhysicalRegion::find_contiguous_free_pages(size_t count, size_t physical_alignment)
+void PhysicalRegion::deallocate_block(size_t pfn, size_t order)
 {
-    VERIFY(count != 0);
-    VERIFY(physical_alignment % PAGE_SIZE == 0);
-    // search from the last page we allocated
-    auto range = find_and_allocate_contiguous_range(count, physical_alignment / PAGE_SIZE);
-    VERIFY(range.has_value());
-    return range.value();
-}
-
-Optional<unsigned> PhysicalRegion::find_one_free_page()
-{
-    if (m_used == m_pages) {
-        // We know we don't have any free pages, no need to check the bitmap
-        // Check if we can draw one from the return queue
-        if (m_recently_returned.size() > 0) {
-            u8 index = get_fast_random<u8>() % m_recently_returned.size();
-            Checked<FlatPtr> local_offset = m_recently_returned[index].get();
-            local_offset -= m_lower.get();
-            m_recently_returned.remove(index);
-            VERIFY(!local_offset.has_overflow());
-            VERIFY(local_offset.value() < (FlatPtr)(m_pages * PAGE_SIZE));
-            return local_offset.value() / PAGE_SIZE;
-        }
-        return {};
+    VERIFY(order <= max_order);
+    VERIFY(!(pfn & ((1u << order) - 1)));
+    VERIFY(pfn >= m_first_pfn && pfn + (1u << order) <= m_first_pfn + m_pages);
+    VERIFY(m_used >= (1u << order));
+    m_used -= 1u << order;
+
+    // Merge with our buddy for as long as it is free as a whole.
+    while (order < max_order) {
+        auto buddy_pfn = pfn ^ (1u << order);
+        if (buddy_pfn < m_first_pfn || buddy_pfn + (1u << order) > m_first_pfn + m_pages)
+            break;
+        auto buddy_index = block_index(buddy_pfn, order);
+        if (!m_buckets[order].contains(buddy_index))
+            break;
+        m_buckets[order].remove(buddy_index);
+        pfn &= ~(1u << order);
+        ++order;
     }
-    auto free_index = m_bitmap.find_one_anywhere_unset(m_free_hint);
-    if (!free_index.has_value())
-        return {};
 
-    auto page_index = free_index.value();
-    m_bitmap.set(page_index, true);
-    m_used++;
-    m_free_hint = free_index.value() + 1; // Just a guess
-    if (m_free_hint >= m_bitmap.size())
-        m_free_hint = 0;
-    return page_index;
+    m_buckets[order].add(block_index(pfn, order));
 }
 
-Optional<unsigned> PhysicalRegion::find_and_allocate_contiguous_range(size_t count, unsigned alignment)
+void PhysicalRegion::deallocate_range(size_t pfn, size_t count)
 {
+    auto end_pfn = pfn + count;
+    while (pfn < end_pfn) {
+        size_t order = 0;
+        while (order < max_order && !(pfn & ((2u << order) - 1)) && pfn + (2u << order) <= end_pfn)
+            ++order;
+        deallocate_block(pfn, order);
+        pfn += 1u << order;
+    }
+}
+
+NonnullRefPtrVector<PhysicalPage> PhysicalRegion::take_contiguous_free_pages(size_t count, bool supervisor, size_t physical_alignment)
+{
+    VERIFY(m_pages);
     VERIFY(count != 0);
-    size_t found_pages_count = 0;
-    // TODO: Improve how we deal with alignment != 1
-    auto first_index = m_bitmap.find_longest_range_of_unset_bits(count + alignment - 1, found_pages_count);
-    if (!first_index.has_value())
+    VERIFY(physical_alignment % PAGE_SIZE == 0);
+    VERIFY(!(physical_alignment & (physical_alignment - 1)));
+
+    // Blocks are naturally aligned, so asking for a large enough block takes care of the alignment.
+    auto order = order_for_page_count(max(count, physical_alignment / PAGE_SIZE));
+    if (order > max_order)
         return {};
 
-    auto page = first_index.value();
-    if (alignment != 1) {
-        auto lower_page = m_lower.get() / PAGE_SIZE;
-        page = ((lower_page + page + alignment - 1) & ~(alignment - 1)) - lower_page;
-    }
-    if (found_pages_count >= count) {
-        m_bitmap.set_range<true>(page, count);
-        m_used += count;
-        m_free_hint = first_index.value() + count + 1; // Just a guess
-        if (m_free_hint >= m_bitmap.size())
-            m_free_hint = 0;
-        return page;
-    }
-    return {};
+    auto pfn = allocate_block(order);
+    if (!pfn.has_value())
+        return {};
+
+    // Give back whatever we don't need from the end of the block.
+    deallocate_range(pfn.value() + count, (1u << order) - count);
+
+    NonnullRefPtrVector<PhysicalPage> physical_pages;
+    physical_pages.ensure_capacity(count);
+    for (size_t index = 0; index < count; index++)
+        physical_pages.append(PhysicalPage::create(address_of_pfn(pfn.value() + index), supervisor));
+    return physical_pages;
 }
 
 RefPtr<PhysicalPage> PhysicalRegion::take_free_page(bool supervisor)
 {
     VERIFY(m_pages);
 
-    auto free_index = find_one_free_page();
-    if (!free_index.has_value())
+    auto pfn = allocate_block(0);
+    if (!pfn.has_value())
         return nullptr;
 
-    return PhysicalPage::create(m_lower.offset(free_index.value() * PAGE_SIZE), supervisor);
+    return PhysicalPage::create(address_of_pfn(pfn.value()), supervisor);
 }
 
-void PhysicalRegion::free_page_at(PhysicalAddress addr)
+size_t PhysicalRegion::take_free_pages(Span<PhysicalAddress> pages)
 {
-    VERIFY(m_pages);
-
-    if (m_used == 0) {
-        VERIFY_NOT_REACHED();
+    size_t taken = 0;
+    while (taken < pages.size()) {
+        auto pfn = allocate_block(0);
+        if (!pfn.has_value())
+            break;
+        pages[taken++] = address_of_pfn(pfn.value());
     }
+    return taken;
+}
 
-    Checked<FlatPtr> local_offset = addr.get();
-    local_offset -= m_lower.get();
-    VERIFY(!local_offset.has_overflow());
-    VERIFY(local_offset.value() < (FlatPtr)(m_pages * PAGE_SIZE));
-
-    auto page = local_offset.value() / PAGE_SIZE;
-    m_bitmap.set(page, false);
-    m_free_hint = page; // We know we can find one here for sure
-    m_used--;
-}
-
-void PhysicalRegion::return_page(const PhysicalPage& page)
-{
-    auto returned_count = m_recently_returned.size();
-    if (returned_count >= m_recently_returned.capacity()) {
-        // Return queue is full, pick a random entry and free that page
-        // and replace the entry with this page
-        auto& entry = m_recently_returned[get_fast_random<u8>()];
-        free_page_at(entry);
-        entry = page.paddr();
-    } else {
-        // Still filling the return queue, just append it
-        m_recently_returned.append(page.paddr());
-    }
+void PhysicalRegion::return_page(PhysicalAddress paddr)
+{
+    VERIFY(m_pages);
+    VERIFY((paddr.get() & ~PAGE_MASK) == 0);
+    VERIFY(paddr >= m_lower);
+
+    deallocate_block(paddr.get() / PAGE_SIZE, 0);
 }
 
 }
@@ -26,18 +26,23 @@
 
 #pragma once
 
-#include <AK/Bitmap.h>
 #include <AK/NonnullRefPtrVector.h>
 #include <AK/Optional.h>
 #include <AK/RefCounted.h>
+#include <AK/Span.h>
+#include <AK/Vector.h>
 #include <Kernel/VM/PhysicalPage.h>
 
 namespace Kernel {
 
+// A buddy allocator for a range of physical pages. Free blocks of 2^order pages are
+// always naturally aligned in physical memory.
 class PhysicalRegion : public RefCounted<PhysicalRegion> {
     AK_MAKE_ETERNAL
 
 public:
+    static constexpr size_t max_order = 10;
+
     static NonnullRefPtr<PhysicalRegion> create(PhysicalAddress lower, PhysicalAddress upper);
     ~PhysicalRegion() { }
 
@@ -47,19 +52,49 @@ public:
     PhysicalAddress lower() const { return m_lower; }
     PhysicalAddress upper() const { return m_upper; }
     unsigned size() const { return m_pages; }
-    unsigned used() const { return m_used - m_recently_returned.size(); }
-    unsigned free() const { return m_pages - m_used + m_recently_returned.size(); }
-    bool contains(const PhysicalPage& page) const { return page.paddr() >= m_lower && page.paddr() <= m_upper; }
+    unsigned used() const { return m_used; }
+    unsigned free() const { return m_pages - m_used; }
+    bool contains(PhysicalAddress paddr) const { return paddr >= m_lower && paddr <= m_upper; }
+    bool contains(const PhysicalPage& page) const { return contains(page.paddr()); }
 
     RefPtr<PhysicalPage> take_free_page(bool supervisor);
+    size_t take_free_pages(Span<PhysicalAddress>);
     NonnullRefPtrVector<PhysicalPage> take_contiguous_free_pages(size_t count, bool supervisor, size_t physical_alignment = PAGE_SIZE);
-    void return_page(const PhysicalPage& page);
+    void return_page(PhysicalAddress);
+    void return_page(const PhysicalPage& page) { return_page(page.paddr()); }
+
+    size_t free_blocks_of_order(size_t order) const { return m_buckets[order].count(); }
 
 private:
-    unsigned find_contiguous_free_pages(size_t count, size_t physical_alignment = PAGE_SIZE);
-    Optional<unsigned> find_and_allocate_contiguous_range(size_t count, unsigned alignment = 1);
-    Optional<unsigned> find_one_free_page();
-    void free_page_at(PhysicalAddress addr);
+    // The set of free blocks of one order. Finding the lowest free block is O(log n),
+    // as every word of bits is summarized by a single bit on the level above it.
+    class FreeBlockSet {
+    public:
+        void initialize(size_t size);
+
+        bool contains(size_t index) const { return m_levels[0][index / 32] & (1u << (index % 32)); }
+        void add(size_t index);
+        void remove(size_t index);
+        Optional<size_t> first() const;
+
+        size_t size() const { return m_size; }
+        size_t count() const { return m_count; }
+
+    private:
+        static constexpr size_t max_levels = 5;
+        Vector<u32> m_levels[max_levels];
+        size_t m_level_count { 0 };
+        size_t m_size { 0 };
+        size_t m_count { 0 };
+    };
+
+    Optional<size_t> allocate_block(size_t order);
+    void deallocate_block(size_t pfn, size_t order);
+    void deallocate_range(size_t pfn, size_t count);
+
+    size_t block_index(size_t pfn, size_t order) const { return (pfn >> order) - (m_first_pfn >> order); }
+    size_t pfn_of_block(size_t index, size_t order) const { return ((m_first_pfn >> order) + index) << order; }
+    PhysicalAddress address_of_pfn(size_t pfn) const { return PhysicalAddress(pfn * PAGE_SIZE); }
 
     PhysicalRegion(PhysicalAddress lower, PhysicalAddress upper);
 
@@ -67,9 +102,8 @@ private:
     PhysicalAddress m_upper;
     unsigned m_pages { 0 };
     unsigned m_used { 0 };
-    Bitmap m_bitmap;
-    size_t m_free_hint { 0 };
-    Vector<PhysicalAddress, 256> m_recently_returned;
+    size_t m_first_pfn { 0 };
+    FreeBlockSet m_buckets[max_order + 1];
 };
 
 }
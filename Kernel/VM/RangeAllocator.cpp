@@ -24,9 +24,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <AK/BinarySearch.h>
 #include <AK/Checked.h>
-#include <AK/QuickSort.h>
 #include <Kernel/Random.h>
 #include <Kernel/Thread.h>
 #include <Kernel/VM/RangeAllocator.h>
@@ -43,14 +41,17 @@ RangeAllocator::RangeAllocator()
 void RangeAllocator::initialize_with_range(VirtualAddress base, size_t size)
 {
     m_total_range = { base, size };
-    m_available_ranges.append({ base, size });
+    add_available_range({ base, size });
 }
 
 void RangeAllocator::initialize_from_parent(const RangeAllocator& parent_allocator)
 {
     ScopedSpinLock lock(parent_allocator.m_lock);
     m_total_range = parent_allocator.m_total_range;
-    m_available_ranges = parent_allocator.m_available_ranges;
+    m_available_ranges.clear();
+    m_available_ranges_by_size.clear();
+    for (auto& range : parent_allocator.m_available_ranges)
+        add_available_range(range);
 }
 
 RangeAllocator::~RangeAllocator()
@@ -66,16 +67,32 @@ void RangeAllocator::dump() const
     }
 }
 
-void RangeAllocator::carve_at_index(int index, const Range& range)
+void RangeAllocator::add_available_range(const Range& range)
+{
+    m_available_ranges.insert(range.base().get(), range);
+    m_available_ranges_by_size.insert({ range.size(), range.base().get() }, range);
+}
+
+void RangeAllocator::remove_available_range(const Range& range)
+{
+    // NOTE: The range may well live in one of the nodes we're about to remove.
+    SizeKey size_key { range.size(), range.base().get() };
+    bool removed = m_available_ranges.remove(size_key.base);
+    removed &= m_available_ranges_by_size.remove(size_key);
+    VERIFY(removed);
+}
+
+void RangeAllocator::carve_from_region(Range from, const Range& range)
 {
     VERIFY(m_lock.is_locked());
-    auto remaining_parts = m_available_ranges[index].carve(range);
+    auto remaining_parts = from.carve(range);
     VERIFY(remaining_parts.size() >= 1);
     VERIFY(m_total_range.contains(remaining_parts[0]));
-    m_available_ranges[index] = remaining_parts[0];
+    remove_available_range(from);
+    add_available_range(remaining_parts[0]);
     if (remaining_parts.size() == 2) {
         VERIFY(m_total_range.contains(remaining_parts[1]));
-        m_available_ranges.insert(index + 1, move(remaining_parts[1]));
+        add_available_range(remaining_parts[1]);
     }
 }
 
@@ -127,27 +144,27 @@ Optional<Range> RangeAllocator::allocate_anywhere(size_t size, size_t alignment)
         return {};
 
     ScopedSpinLock lock(m_lock);
-    for (size_t i = 0; i < m_available_ranges.size(); ++i) {
-        auto& available_range = m_available_ranges[i];
-        // FIXME: This check is probably excluding some valid candidates when using a large alignment.
-        if (available_range.size() < (effective_size + alignment))
-            continue;
+    // Take the smallest available range that fits.
+    // FIXME: This check is probably excluding some valid candidates when using a large alignment.
+    auto* candidate = m_available_ranges_by_size.find_smallest_not_below({ effective_size + alignment, 0 });
+    if (!candidate) {
+        dmesgln("RangeAllocator: Failed to allocate anywhere: size={}, alignment={}", size, alignment);
+        return {};
+    }
+    auto available_range = *candidate;
 
-        FlatPtr initial_base = available_range.base().offset(offset_from_effective_base).get();
-        FlatPtr aligned_base = round_up_to_power_of_two(initial_base, alignment);
+    FlatPtr initial_base = available_range.base().offset(offset_from_effective_base).get();
+    FlatPtr aligned_base = round_up_to_power_of_two(initial_base, alignment);
 
-        Range allocated_range(VirtualAddress(aligned_base), size);
-        VERIFY(m_total_range.contains(allocated_range));
+    Range allocated_range(VirtualAddress(aligned_base), size);
+    VERIFY(m_total_range.contains(allocated_range));
 
-        if (available_range == allocated_range) {
-            m_available_ranges.remove(i);
-            return allocated_range;
-        }
-        carve_at_index(i, allocated_range);
+    if (available_range == allocated_range) {
+        remove_available_range(available_range);
         return allocated_range;
     }
-    dmesgln("RangeAllocator: Failed to allocate anywhere: size={}, alignment={}", size, alignment);
-    return {};
+    carve_from_region(available_range, allocated_range);
+    return allocated_range;
 }
 
 Optional<Range> RangeAllocator::allocate_specific(VirtualAddress base, size_t size)
@@ -159,20 +176,18 @@ Optional<Range> RangeAllocator::allocate_specific(VirtualAddress base, size_t si
     VERIFY((size % PAGE_SIZE) == 0);
 
     Range allocated_range(base, size);
+    VERIFY(m_total_range.contains(allocated_range));
+
     ScopedSpinLock lock(m_lock);
-    for (size_t i = 0; i < m_available_ranges.size(); ++i) {
-        auto& available_range = m_available_ranges[i];
-        VERIFY(m_total_range.contains(allocated_range));
-        if (!available_range.contains(base, size))
-            continue;
-        if (available_range == allocated_range) {
-            m_available_ranges.remove(i);
-            return allocated_range;
-        }
-        carve_at_index(i, allocated_range);
+    auto* available_range = m_available_ranges.find_largest_not_above(base.get());
+    if (!available_range || !available_range->contains(allocated_range))
+        return {};
+    if (*available_range == allocated_range) {
+        remove_available_range(*available_range);
         return allocated_range;
     }
-    return {};
+    carve_from_region(*available_range, allocated_range);
+    return allocated_range;
 }
 
 void RangeAllocator::deallocate(const Range& range)
@@ -182,37 +197,22 @@ void RangeAllocator::deallocate(const Range& range)
     VERIFY(range.size());
     VERIFY((range.size() % PAGE_SIZE) == 0);
     VERIFY(range.base() < range.end());
-    VERIFY(!m_available_ranges.is_empty());
-
-    size_t nearby_index = 0;
-    auto* existing_range = binary_search(
-        m_available_ranges.span(),
-        range,
-        &nearby_index,
-        [](auto& a, auto& b) { return a.base().get() - b.end().get(); });
-
-    size_t inserted_index = 0;
-    if (existing_range) {
-        existing_range->m_size += range.size();
-        inserted_index = nearby_index;
-    } else {
-        m_available_ranges.insert_before_matching(
-            Range(range), [&](auto& entry) {
-                return entry.base() >= range.end();
-            },
-            nearby_index, &inserted_index);
+
+    Range merged_range = range;
+    if (auto* following_range = m_available_ranges.find(range.end().get())) {
+        merged_range.m_size += following_range->size();
+        remove_available_range(*following_range);
     }
 
-    if (inserted_index < (m_available_ranges.size() - 1)) {
-        // We already merged with previous. Try to merge with next.
-        auto& inserted_range = m_available_ranges[inserted_index];
-        auto& next_range = m_available_ranges[inserted_index + 1];
-        if (inserted_range.end() == next_range.base()) {
-            inserted_range.m_size += next_range.size();
-            m_available_ranges.remove(inserted_index + 1);
-            return;
+    if (auto* preceding_range = m_available_ranges.find_largest_not_above(range.base().get())) {
+        VERIFY(preceding_range->end() <= range.base());
+        if (preceding_range->end() == range.base()) {
+            merged_range.m_base = preceding_range->base();
+            merged_range.m_size += preceding_range->size();
+            remove_available_range(*preceding_range);
         }
     }
+    add_available_range(merged_range);
 }
 
 }
@@ -26,8 +26,8 @@
 
 #pragma once
 
+#include <AK/RedBlackTree.h>
 #include <AK/Traits.h>
-#include <AK/Vector.h>
 #include <Kernel/SpinLock.h>
 #include <Kernel/VM/Range.h>
 
@@ -55,9 +55,25 @@ public:
     }
 
 private:
-    void carve_at_index(int, const Range&);
+    void carve_from_region(Range from, const Range&);
+    void add_available_range(const Range&);
+    void remove_available_range(const Range&);
 
-    Vector<Range> m_available_ranges;
+    struct SizeKey {
+        size_t size { 0 };
+        FlatPtr base { 0 };
+
+        bool operator==(const SizeKey& other) const { return size == other.size && base == other.base; }
+        bool operator!=(const SizeKey& other) const { return !(*this == other); }
+        bool operator<(const SizeKey& other) const { return size < other.size || (size == other.size && base < other.base); }
+        bool operator>(const SizeKey& other) const { return other < *this; }
+    };
+
+    // NOTE: The available ranges never overlap, so they are keyed by their base address.
+    //       They're also indexed by size (and base, to keep the keys unique) so that
+    //       allocate_anywhere() can find the smallest one that fits without a linear walk.
+    RedBlackTree<FlatPtr, Range> m_available_ranges;
+    RedBlackTree<SizeKey, Range> m_available_ranges_by_size;
     Range m_total_range;
     mutable SpinLock<u8> m_lock;
 };
@@ -30,6 +30,7 @@
 #include <Kernel/FileSystem/Inode.h>
 #include <Kernel/Panic.h>
 #include <Kernel/Process.h>
+#include <Kernel/Tasks/ReadAheadTask.h>
 #include <Kernel/Thread.h>
 #include <Kernel/VM/AnonymousVMObject.h>
 #include <Kernel/VM/MemoryManager.h>
@@ -39,6 +40,9 @@
 
 namespace Kernel {
 
+// How far ahead to read when faulting in pages of a region marked with MADV_SEQUENTIAL.
+static constexpr size_t sequential_fault_read_ahead_size = 64 * KiB;
+
 Region::Region(const Range& range, NonnullRefPtr<VMObject> vmobject, size_t offset_in_vmobject, String name, u8 access, Cacheable cacheable, bool shared)
     : PurgeablePageRanges(vmobject)
     , m_range(range)
@@ -108,6 +112,7 @@ OwnPtr<Region> Region::clone(Process& new_owner)
         if (m_vmobject->is_anonymous())
             region->copy_purgeable_page_ranges(*this);
         region->set_mmap(m_mmap);
+        region->set_accessed_sequentially(m_accessed_sequentially);
         region->set_shared(m_shared);
         region->set_syscall_region(is_syscall_region());
         return region;
@@ -121,7 +126,10 @@ OwnPtr<Region> Region::clone(Process& new_owner)
         return {};
 
     // Set up a COW region. The parent (this) region becomes COW as well!
-    remap();
+    if (m_vmobject->is_anonymous())
+        write_protect_for_cow();
+    else
+        remap();
     auto clone_region = Region::create_user_accessible(
         &new_owner, m_range, vmobject_clone.release_nonnull(), m_offset_in_vmobject, m_name, m_access, m_cacheable ? Cacheable::Yes : Cacheable::No, m_shared);
     if (m_vmobject->is_anonymous())
@@ -134,6 +142,7 @@ OwnPtr<Region> Region::clone(Process& new_owner)
     }
     clone_region->set_syscall_region(is_syscall_region());
     clone_region->set_mmap(m_mmap);
+    clone_region->set_accessed_sequentially(m_accessed_sequentially);
     return clone_region;
 }
 
@@ -286,6 +295,53 @@ bool Region::map_individual_page_impl(size_t page_index)
     return true;
 }
 
+bool Region::map_large_page_impl(size_t page_index)
+{
+    VERIFY(m_page_directory->get_lock().own_lock());
+    auto page_vaddr = vaddr_from_page_index(page_index);
+    if (page_vaddr.get() & (large_page_size - 1))
+        return false;
+    if (page_index + pages_per_large_page > page_count())
+        return false;
+    if (!is_readable() && !is_writable())
+        return false;
+
+    bool user_allowed = page_vaddr.get() >= 0x00800000 && is_user_address(page_vaddr);
+    if (is_mmap() && !user_allowed)
+        return false;
+
+    // Only a physically contiguous, naturally aligned run of pages that all get
+    // the same protection can be mapped as a large page.
+    auto* first_page = physical_page(page_index);
+    if (!first_page || (first_page->paddr().get() & (large_page_size - 1)))
+        return false;
+    for (size_t i = 0; i < pages_per_large_page; ++i) {
+        auto* page = physical_page(page_index + i);
+        if (!page || page->paddr() != first_page->paddr().offset(i * PAGE_SIZE))
+            return false;
+        if (page->is_shared_zero_page() || page->is_lazy_committed_page() || should_cow(page_index + i))
+            return false;
+    }
+
+    return MM.map_large_page(*m_page_directory, page_vaddr, first_page->paddr(), is_writable(), user_allowed, is_executable(), m_cacheable);
+}
+
+bool Region::map_page_range_impl(size_t page_index, size_t page_count, size_t& pages_mapped)
+{
+    pages_mapped = 0;
+    while (pages_mapped < page_count) {
+        auto index = page_index + pages_mapped;
+        if (page_count - pages_mapped >= pages_per_large_page && map_large_page_impl(index)) {
+            pages_mapped += pages_per_large_page;
+            continue;
+        }
+        if (!map_individual_page_impl(index))
+            return false;
+        ++pages_mapped;
+    }
+    return true;
+}
+
 bool Region::do_remap_vmobject_page_range(size_t page_index, size_t page_count)
 {
     bool success = true;
@@ -295,16 +351,11 @@ bool Region::do_remap_vmobject_page_range(size_t page_index, size_t page_count)
     if (!translate_vmobject_page_range(page_index, page_count))
         return success; // not an error, region doesn't map this page range
     ScopedSpinLock page_lock(m_page_directory->get_lock());
-    size_t index = page_index;
-    while (index < page_index + page_count) {
-        if (!map_individual_page_impl(index)) {
-            success = false;
-            break;
-        }
-        index++;
-    }
-    if (index > page_index)
-        MM.flush_tlb(m_page_directory, vaddr_from_page_index(page_index), index - page_index);
+    size_t pages_mapped = 0;
+    if (!map_page_range_impl(page_index, page_count, pages_mapped))
+        success = false;
+    if (pages_mapped > 0)
+        MM.flush_tlb(m_page_directory, vaddr_from_page_index(page_index), pages_mapped);
     return success;
 }
 
@@ -396,19 +447,33 @@ bool Region::map(PageDirectory& page_directory)
     }
 
     set_page_directory(page_directory);
-    size_t page_index = 0;
-    while (page_index < page_count()) {
-        if (!map_individual_page_impl(page_index))
-            break;
-        ++page_index;
-    }
-    if (page_index > 0) {
-        MM.flush_tlb(m_page_directory, vaddr(), page_index);
-        return page_index == page_count();
+    size_t pages_mapped = 0;
+    bool success = map_page_range_impl(0, page_count(), pages_mapped);
+    if (pages_mapped > 0) {
+        MM.flush_tlb(m_page_directory, vaddr(), pages_mapped);
+        return success;
     }
     return false;
 }
 
+void Region::map_lazily(PageDirectory& page_directory)
+{
+    // NOTE: No page tables are populated here, pages get mapped in as they're first accessed.
+    ScopedSpinLock lock(s_mm_lock);
+    set_page_directory(page_directory);
+}
+
+void Region::write_protect_for_cow()
+{
+    VERIFY(s_mm_lock.own_lock());
+    VERIFY(m_page_directory);
+    // Every page of the VMObject is COW now, so all we need to do is revoke write access
+    // from whatever is currently mapped. Unlike remap(), this never creates page tables.
+    ScopedSpinLock page_lock(m_page_directory->get_lock());
+    if (MM.write_protect_range(*m_page_directory, vaddr(), page_count()) > 0)
+        MM.flush_tlb(m_page_directory, vaddr(), page_count());
+}
+
 void Region::remap()
 {
     VERIFY(m_page_directory);
@@ -434,18 +499,31 @@ PageFaultResponse Region::handle_fault(const PageFault& fault, ScopedSpinLock<Re
 
         auto& page_slot = physical_page_slot(page_index_in_region);
         if (page_slot->is_lazy_committed_page()) {
+            if (auto response = handle_large_page_fault(page_index_in_region, mm_lock); response.has_value())
+                return response.value();
             auto page_index_in_vmobject = translate_to_vmobject_page(page_index_in_region);
-            page_slot = static_cast<AnonymousVMObject&>(*m_vmobject).allocate_committed_page(page_index_in_vmobject);
+            // NOTE: handle_large_page_fault() may have dropped the lock, so someone else could have beaten us to it.
+            if (page_slot->is_lazy_committed_page())
+                page_slot = static_cast<AnonymousVMObject&>(*m_vmobject).allocate_committed_page(page_index_in_vmobject);
             remap_vmobject_page(page_index_in_vmobject);
             return PageFaultResponse::Continue;
         }
+        if (!page_slot.is_null()) {
+            // NOTE: fork() leaves the child's page tables empty, pages that already exist get mapped in on first access.
+            //       A write to a COW page will fault again once it's mapped, since the copy is made through the mapping.
+            if (fault.is_write() && page_slot->is_shared_zero_page())
+                return handle_zero_fault(page_index_in_region, mm_lock);
+            if (!remap_vmobject_page(translate_to_vmobject_page(page_index_in_region)))
+                return PageFaultResponse::OutOfMemory;
+            return PageFaultResponse::Continue;
+        }
 #ifdef MAP_SHARED_ZERO_PAGE_LAZILY
         if (fault.is_read()) {
             page_slot = MM.shared_zero_page();
             remap_vmobject_page(translate_to_vmobject_page(page_index_in_region));
             return PageFaultResponse::Continue;
         }
-        return handle_zero_fault(page_index_in_region);
+        return handle_zero_fault(page_index_in_region, mm_lock);
 #else
         dbgln("BUG! Unexpected NP fault at {}", fault.vaddr());
         return PageFaultResponse::ShouldCrash;
@@ -457,7 +535,7 @@ PageFaultResponse Region::handle_fault(const PageFault& fault, ScopedSpinLock<Re
         auto* phys_page = physical_page(page_index_in_region);
         if (phys_page->is_shared_zero_page() || phys_page->is_lazy_committed_page()) {
             dbgln_if(PAGE_FAULT_DEBUG, "NP(zero) fault in Region({})[{}] at {}", this, page_index_in_region, fault.vaddr());
-            return handle_zero_fault(page_index_in_region);
+            return handle_zero_fault(page_index_in_region, mm_lock);
         }
         return handle_cow_fault(page_index_in_region);
     }
@@ -465,7 +543,7 @@ PageFaultResponse Region::handle_fault(const PageFault& fault, ScopedSpinLock<Re
     return PageFaultResponse::ShouldCrash;
 }
 
-PageFaultResponse Region::handle_zero_fault(size_t page_index_in_region)
+PageFaultResponse Region::handle_zero_fault(size_t page_index_in_region, ScopedSpinLock<RecursiveSpinLock>& mm_lock)
 {
     VERIFY_INTERRUPTS_DISABLED();
     VERIFY(vmobject().is_anonymous());
@@ -489,7 +567,11 @@ PageFaultResponse Region::handle_zero_fault(size_t page_index_in_region)
         current_thread->did_zero_fault();
 
     if (page_slot->is_lazy_committed_page()) {
-        page_slot = static_cast<AnonymousVMObject&>(*m_vmobject).allocate_committed_page(page_index_in_vmobject);
+        if (auto response = handle_large_page_fault(page_index_in_region, mm_lock); response.has_value())
+            return response.value();
+        // NOTE: handle_large_page_fault() may have dropped the lock, so someone else could have beaten us to it.
+        if (page_slot->is_lazy_committed_page())
+            page_slot = static_cast<AnonymousVMObject&>(*m_vmobject).allocate_committed_page(page_index_in_vmobject);
         dbgln_if(PAGE_FAULT_DEBUG, "      >> ALLOCATED COMMITTED {}", page_slot->paddr());
     } else {
         page_slot = MM.allocate_user_physical_page(MemoryManager::ShouldZeroFill::Yes);
@@ -507,6 +589,43 @@ PageFaultResponse Region::handle_zero_fault(size_t page_index_in_region)
     return PageFaultResponse::Continue;
 }
 
+Optional<PageFaultResponse> Region::handle_large_page_fault(size_t page_index_in_region, ScopedSpinLock<RecursiveSpinLock>& mm_lock)
+{
+    // The first touch of a 2 MiB chunk of lazily committed memory commits the whole chunk
+    // at once with a physically contiguous large page, if we can find one.
+    if (!vmobject().is_anonymous() || vmobject().is_shared_by_multiple_regions())
+        return {};
+    auto large_page_vaddr = vaddr_from_page_index(page_index_in_region).get() & ~(large_page_size - 1);
+    if (large_page_vaddr < vaddr().get() || large_page_vaddr + large_page_size > vaddr().get() + size())
+        return {};
+
+    // The region may sit at any page offset into its VMObject, in which case an aligned chunk
+    // of the address space doesn't line up with an aligned chunk of the VMObject.
+    auto first_page_index_in_region = page_index_from_address(VirtualAddress(large_page_vaddr));
+    auto first_page_index_in_vmobject = translate_to_vmobject_page(first_page_index_in_region);
+    if (first_page_index_in_vmobject % pages_per_large_page)
+        return {};
+
+    auto& anonymous_vmobject = static_cast<AnonymousVMObject&>(vmobject());
+    if (!anonymous_vmobject.can_commit_large_page(first_page_index_in_vmobject))
+        return {};
+
+    mm_lock.unlock();
+    VERIFY(!s_mm_lock.own_lock());
+    auto large_page = MM.allocate_user_large_page();
+    mm_lock.lock();
+
+    if (large_page.is_empty() || !anonymous_vmobject.commit_large_page(first_page_index_in_vmobject, large_page))
+        return {};
+
+    auto current_thread = Thread::current();
+    if (current_thread != nullptr)
+        current_thread->did_zero_fault();
+    if (!remap_vmobject_page_range(first_page_index_in_vmobject, pages_per_large_page))
+        return PageFaultResponse::OutOfMemory;
+    return PageFaultResponse::Continue;
+}
+
 PageFaultResponse Region::handle_cow_fault(size_t page_index_in_region)
 {
     VERIFY_INTERRUPTS_DISABLED();
@@ -562,6 +681,8 @@ PageFaultResponse Region::handle_inode_fault(size_t page_index_in_region, Scoped
     mm_lock.unlock();
     auto buffer = UserOrKernelBuffer::for_kernel_buffer(page_buffer);
     auto nread = inode.read_bytes(page_index_in_vmobject * PAGE_SIZE, PAGE_SIZE, buffer, nullptr);
+    if (is_accessed_sequentially())
+        ReadAheadTask::enqueue(inode, (page_index_in_vmobject + 1) * PAGE_SIZE, sequential_fault_read_ahead_size);
     mm_lock.lock();
 
     if (nread < 0) {
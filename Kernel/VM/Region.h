@@ -27,6 +27,7 @@
 #pragma once
 
 #include <AK/InlineLinkedList.h>
+#include <AK/IntrusiveRedBlackTree.h>
 #include <AK/String.h>
 #include <AK/WeakPtr.h>
 #include <AK/Weakable.h>
@@ -96,6 +97,9 @@ public:
     bool is_stack() const { return m_stack; }
     void set_stack(bool stack) { m_stack = stack; }
 
+    bool is_accessed_sequentially() const { return m_accessed_sequentially; }
+    void set_accessed_sequentially(bool sequentially) { m_accessed_sequentially = sequentially; }
+
     bool is_mmap() const { return m_mmap; }
     void set_mmap(bool mmap) { m_mmap = mmap; }
 
@@ -216,6 +220,7 @@ public:
 
     void set_page_directory(PageDirectory&);
     bool map(PageDirectory&);
+    void map_lazily(PageDirectory&);
     enum class ShouldDeallocateVirtualMemoryRange {
         No,
         Yes,
@@ -228,6 +233,9 @@ public:
     Region* m_next { nullptr };
     Region* m_prev { nullptr };
 
+    // NOTE: A kernel region lives in MemoryManager's kernel region tree, a user region in its Space's region tree.
+    IntrusiveRedBlackTreeNode<FlatPtr> m_tree_node;
+
     bool remap_vmobject_page_range(size_t page_index, size_t page_count);
 
     bool is_volatile(VirtualAddress vaddr, size_t size) const;
@@ -259,11 +267,15 @@ private:
     bool do_remap_vmobject_page(size_t index, bool with_flush = true);
     bool remap_vmobject_page(size_t index, bool with_flush = true);
 
+    void write_protect_for_cow();
     PageFaultResponse handle_cow_fault(size_t page_index);
     PageFaultResponse handle_inode_fault(size_t page_index, ScopedSpinLock<RecursiveSpinLock>&);
-    PageFaultResponse handle_zero_fault(size_t page_index);
+    PageFaultResponse handle_zero_fault(size_t page_index, ScopedSpinLock<RecursiveSpinLock>&);
+    Optional<PageFaultResponse> handle_large_page_fault(size_t page_index, ScopedSpinLock<RecursiveSpinLock>&);
 
     bool map_individual_page_impl(size_t page_index);
+    bool map_large_page_impl(size_t page_index);
+    bool map_page_range_impl(size_t page_index, size_t page_count, size_t& pages_mapped);
 
     void register_purgeable_page_ranges();
     void unregister_purgeable_page_ranges();
@@ -279,9 +291,12 @@ private:
     bool m_stack : 1 { false };
     bool m_mmap : 1 { false };
     bool m_syscall_region : 1 { false };
+    bool m_accessed_sequentially : 1 { false };
     WeakPtr<Process> m_owner;
 };
 
+using RegionTree = IntrusiveRedBlackTree<FlatPtr, Region, &Region::m_tree_node>;
+
 inline unsigned prot_to_region_access_flags(int prot)
 {
     unsigned access = 0;
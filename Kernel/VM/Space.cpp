@@ -24,7 +24,6 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <AK/QuickSort.h>
 #include <Kernel/Process.h>
 #include <Kernel/SpinLock.h>
 #include <Kernel/VM/AnonymousVMObject.h>
@@ -52,6 +51,7 @@ Space::Space(Process& process, NonnullRefPtr<PageDirectory> page_directory)
 
 Space::~Space()
 {
+    delete_all_regions();
 }
 
 Optional<Range> Space::allocate_range(VirtualAddress vaddr, size_t size, size_t alignment)
@@ -117,18 +117,19 @@ KResultOr<Region*> Space::allocate_region_with_vmobject(const Range& range, Nonn
 
 bool Space::deallocate_region(Region& region)
 {
-    OwnPtr<Region> region_protector;
+    return take_region(region);
+}
+
+OwnPtr<Region> Space::take_region(Region& region)
+{
     ScopedSpinLock lock(m_lock);
 
     if (m_region_lookup_cache.region.unsafe_ptr() == &region)
         m_region_lookup_cache.region = nullptr;
-    for (size_t i = 0; i < m_regions.size(); ++i) {
-        if (&m_regions[i] == &region) {
-            region_protector = m_regions.unstable_take(i);
-            return true;
-        }
-    }
-    return false;
+    if (m_regions.find(region.vaddr().get()) != &region)
+        return {};
+    m_regions.remove(region.vaddr().get());
+    return adopt_own(region);
 }
 
 Region* Space::find_region_from_range(const Range& range)
@@ -137,32 +138,28 @@ Region* Space::find_region_from_range(const Range& range)
     if (m_region_lookup_cache.range.has_value() && m_region_lookup_cache.range.value() == range && m_region_lookup_cache.region)
         return m_region_lookup_cache.region.unsafe_ptr();
 
-    size_t size = page_round_up(range.size());
-    for (auto& region : m_regions) {
-        if (region.vaddr() == range.base() && region.size() == size) {
-            m_region_lookup_cache.range = range;
-            m_region_lookup_cache.region = region;
-            return &region;
-        }
-    }
-    return nullptr;
+    auto* region = m_regions.find(range.base().get());
+    if (!region || region->size() != page_round_up(range.size()))
+        return nullptr;
+    m_region_lookup_cache.range = range;
+    m_region_lookup_cache.region = *region;
+    return region;
 }
 
 Region* Space::find_region_containing(const Range& range)
 {
     ScopedSpinLock lock(m_lock);
-    for (auto& region : m_regions) {
-        if (region.contains(range))
-            return &region;
-    }
-    return nullptr;
+    auto* candidate = m_regions.find_largest_not_above(range.base().get());
+    if (!candidate || !candidate->contains(range))
+        return nullptr;
+    return candidate;
 }
 
 Region& Space::add_region(NonnullOwnPtr<Region> region)
 {
-    auto* ptr = region.ptr();
+    auto* ptr = region.leak_ptr();
     ScopedSpinLock lock(m_lock);
-    m_regions.append(move(region));
+    m_regions.insert(ptr->vaddr().get(), *ptr);
     return *ptr;
 }
 
@@ -192,16 +189,7 @@ void Space::dump_regions()
 
     ScopedSpinLock lock(m_lock);
 
-    Vector<Region*> sorted_regions;
-    sorted_regions.ensure_capacity(m_regions.size());
-    for (auto& region : m_regions)
-        sorted_regions.append(&region);
-    quick_sort(sorted_regions, [](auto& a, auto& b) {
-        return a->vaddr() < b->vaddr();
-    });
-
-    for (auto& sorted_region : sorted_regions) {
-        auto& region = *sorted_region;
+    for (auto& region : m_regions) {
         dbgln("{:08x} -- {:08x} {:08x} {:c}{:c}{:c}{:c}{:c}{:c} {}", region.vaddr().get(), region.vaddr().offset(region.size() - 1).get(), region.size(),
             region.is_readable() ? 'R' : ' ',
             region.is_writable() ? 'W' : ' ',
@@ -215,9 +203,17 @@ void Space::dump_regions()
 }
 
 void Space::remove_all_regions(Badge<Process>)
+{
+    delete_all_regions();
+}
+
+void Space::delete_all_regions()
 {
     ScopedSpinLock lock(m_lock);
-    m_regions.clear();
+    while (auto* region = m_regions.first()) {
+        m_regions.remove(region->vaddr().get());
+        delete region;
+    }
 }
 
 size_t Space::amount_dirty_private() const
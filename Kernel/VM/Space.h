@@ -26,11 +26,11 @@
 
 #pragma once
 
-#include <AK/NonnullOwnPtrVector.h>
 #include <AK/WeakPtr.h>
 #include <Kernel/UnixTypes.h>
 #include <Kernel/VM/AllocationStrategy.h>
 #include <Kernel/VM/PageDirectory.h>
+#include <Kernel/VM/Region.h>
 
 namespace Kernel {
 
@@ -46,8 +46,9 @@ public:
 
     size_t region_count() const { return m_regions.size(); }
 
-    NonnullOwnPtrVector<Region>& regions() { return m_regions; }
-    const NonnullOwnPtrVector<Region>& regions() const { return m_regions; }
+    // NOTE: The regions are ordered by base address and owned by the Space.
+    RegionTree& regions() { return m_regions; }
+    const RegionTree& regions() const { return m_regions; }
 
     void dump_regions();
 
@@ -56,6 +57,7 @@ public:
     KResultOr<Region*> allocate_region_with_vmobject(const Range&, NonnullRefPtr<VMObject>, size_t offset_in_vmobject, const String& name, int prot, bool shared);
     KResultOr<Region*> allocate_region(const Range&, const String& name, int prot = PROT_READ | PROT_WRITE, AllocationStrategy strategy = AllocationStrategy::Reserve);
     bool deallocate_region(Region& region);
+    OwnPtr<Region> take_region(Region& region);
 
     Region& allocate_split_region(const Region& source_region, const Range&, size_t offset_in_vmobject);
     Vector<Region*, 2> split_region_around_range(const Region& source_region, const Range&);
@@ -81,12 +83,14 @@ public:
 private:
     Space(Process&, NonnullRefPtr<PageDirectory>);
 
+    void delete_all_regions();
+
     Process* m_process { nullptr };
     mutable RecursiveSpinLock m_lock;
 
     RefPtr<PageDirectory> m_page_directory;
 
-    NonnullOwnPtrVector<Region> m_regions;
+    RegionTree m_regions;
 
     struct RegionLookupCache {
         Optional<Range> range;
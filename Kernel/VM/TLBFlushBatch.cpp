@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/Thread.h>
+#include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/TLBFlushBatch.h>
+
+namespace Kernel {
+
+TLBFlushBatch::TLBFlushBatch(const PageDirectory& page_directory)
+    : m_page_directory(page_directory)
+{
+    auto* current_thread = Thread::current();
+    VERIFY(current_thread);
+    m_previous_batch = current_thread->tlb_flush_batch();
+    current_thread->set_tlb_flush_batch(this);
+}
+
+TLBFlushBatch::~TLBFlushBatch()
+{
+    flush();
+    auto* current_thread = Thread::current();
+    VERIFY(current_thread->tlb_flush_batch() == this);
+    current_thread->set_tlb_flush_batch(m_previous_batch);
+}
+
+TLBFlushBatch* TLBFlushBatch::current_for(const PageDirectory& page_directory)
+{
+    auto* current_thread = Thread::current();
+    if (!current_thread)
+        return nullptr;
+    for (auto* batch = current_thread->tlb_flush_batch(); batch; batch = batch->m_previous_batch) {
+        if (&batch->m_page_directory == &page_directory)
+            return batch;
+    }
+    return nullptr;
+}
+
+void TLBFlushBatch::add(VirtualAddress vaddr, size_t page_count)
+{
+    if (!page_count)
+        return;
+    auto end = vaddr.offset(page_count * PAGE_SIZE);
+    for (size_t i = 0; i < m_range_count; ++i) {
+        auto& range = m_ranges[i];
+        auto range_end = range.base.offset(range.page_count * PAGE_SIZE);
+        if (vaddr > range_end || end < range.base)
+            continue;
+        // Overlapping or adjacent, so just grow this range.
+        auto new_base = min(vaddr, range.base);
+        auto new_end = max(end, range_end);
+        range.base = new_base;
+        range.page_count = (new_end.get() - new_base.get()) / PAGE_SIZE;
+        return;
+    }
+    if (m_range_count == max_ranges) {
+        if (is_user_address(vaddr) && coalesce_user_ranges(vaddr, end))
+            return;
+        flush();
+    }
+    m_ranges[m_range_count++] = { vaddr, page_count };
+}
+
+bool TLBFlushBatch::coalesce_user_ranges(VirtualAddress vaddr, VirtualAddress end)
+{
+    // NOTE: A big enough user range is flushed by reloading CR3, so lumping all of them together costs nothing extra.
+    auto new_base = vaddr;
+    auto new_end = end;
+    for (size_t i = 0; i < m_range_count; ++i) {
+        auto& range = m_ranges[i];
+        if (!is_user_address(range.base))
+            return false;
+        new_base = min(new_base, range.base);
+        new_end = max(new_end, range.base.offset(range.page_count * PAGE_SIZE));
+    }
+    m_ranges[0] = { new_base, (new_end.get() - new_base.get()) / PAGE_SIZE };
+    m_range_count = 1;
+    return true;
+}
+
+void TLBFlushBatch::defer_release(NonnullRefPtr<PhysicalPage> page_table)
+{
+    if (m_deferred_page_table_count == max_deferred_page_tables)
+        flush();
+    m_deferred_page_tables[m_deferred_page_table_count++] = move(page_table);
+}
+
+void TLBFlushBatch::flush()
+{
+    if (m_range_count > 0) {
+        ScopedSpinLock lock(s_mm_lock);
+        Processor::flush_tlb(&m_page_directory, m_ranges, m_range_count);
+        m_range_count = 0;
+    }
+    // NOTE: Nobody can be walking these page tables anymore.
+    for (size_t i = 0; i < m_deferred_page_table_count; ++i)
+        m_deferred_page_tables[i] = nullptr;
+    m_deferred_page_table_count = 0;
+}
+
+}
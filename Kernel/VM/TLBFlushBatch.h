@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Noncopyable.h>
+#include <AK/RefPtr.h>
+#include <Kernel/Arch/i386/CPU.h>
+#include <Kernel/Forward.h>
+#include <Kernel/VM/PhysicalPage.h>
+
+namespace Kernel {
+
+// Collects the TLB invalidations for one page directory made by the current thread,
+// so that multi-step operations like splitting a region only shoot down once.
+class TLBFlushBatch {
+    AK_MAKE_NONCOPYABLE(TLBFlushBatch);
+    AK_MAKE_NONMOVABLE(TLBFlushBatch);
+
+public:
+    static constexpr size_t max_ranges = 8;
+    static constexpr size_t max_deferred_page_tables = 8;
+
+    explicit TLBFlushBatch(const PageDirectory&);
+    ~TLBFlushBatch();
+
+    static TLBFlushBatch* current_for(const PageDirectory&);
+
+    void add(VirtualAddress, size_t page_count);
+    void defer_release(NonnullRefPtr<PhysicalPage> page_table);
+    void flush();
+
+private:
+    bool coalesce_user_ranges(VirtualAddress, VirtualAddress end);
+
+    const PageDirectory& m_page_directory;
+    TLBFlushBatch* m_previous_batch { nullptr };
+    TLBFlushRange m_ranges[max_ranges];
+    size_t m_range_count { 0 };
+    RefPtr<PhysicalPage> m_deferred_page_tables[max_deferred_page_tables];
+    size_t m_deferred_page_table_count { 0 };
+};
+
+}
@@ -75,6 +75,9 @@ NetworkStatisticsWidget::NetworkStatisticsWidget()
         net_tcp_fields.empend("packets_out", "Pkt Out", Gfx::TextAlignment::CenterRight);
         net_tcp_fields.empend("bytes_in", "Bytes In", Gfx::TextAlignment::CenterRight);
         net_tcp_fields.empend("bytes_out", "Bytes Out", Gfx::TextAlignment::CenterRight);
+        net_tcp_fields.empend("cwnd", "Cwnd", Gfx::TextAlignment::CenterRight);
+        net_tcp_fields.empend("srtt_usec", "SRTT (us)", Gfx::TextAlignment::CenterRight);
+        net_tcp_fields.empend("retransmits", "Retransmits", Gfx::TextAlignment::CenterRight);
         m_socket_model = GUI::JsonArrayModel::create("/proc/net/tcp", move(net_tcp_fields));
         m_socket_table_view->set_model(GUI::SortingProxyModel::create(*m_socket_model));
 
@@ -660,6 +660,9 @@ NonnullRefPtr<GUI::Widget> build_processors_tab()
         processors_field.empend("model", "Model", Gfx::TextAlignment::CenterRight);
         processors_field.empend("stepping", "Stepping", Gfx::TextAlignment::CenterRight);
         processors_field.empend("type", "Type", Gfx::TextAlignment::CenterRight);
+        processors_field.empend("ipis_sent", "IPIs sent", Gfx::TextAlignment::CenterRight);
+        processors_field.empend("ipis_received", "IPIs received", Gfx::TextAlignment::CenterRight);
+        processors_field.empend("tlb_shootdowns_received", "TLB shootdowns", Gfx::TextAlignment::CenterRight);
 
         auto& processors_table_view = self.add<GUI::TableView>();
         processors_table_view.set_model(GUI::JsonArrayModel::create("/proc/cpuinfo", move(processors_field)));
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "LockContentionModel.h"
+#include "Profile.h"
+#include <AK/HashMap.h>
+#include <AK/QuickSort.h>
+
+// Frames belonging to the locking machinery itself, we want to attribute the time to whoever called into it.
+static constexpr const char* s_lock_machinery_symbols[] = {
+    "Kernel::Lock::",
+    "Kernel::Locker::",
+    "Kernel::SpinLock<",
+    "Kernel::RecursiveSpinLock::",
+    "Kernel::ScopedSpinLock<",
+    "Kernel::spin_lock_contention_",
+    "Kernel::WaitQueue::",
+    "Kernel::Thread::block<",
+    "Kernel::Thread::wait_on",
+    "Kernel::Thread::profiling_block_",
+    "Kernel::PerformanceEventBuffer::",
+};
+
+static bool is_lock_machinery(const String& symbol)
+{
+    for (auto* machinery_symbol : s_lock_machinery_symbols) {
+        if (symbol.contains(machinery_symbol))
+            return true;
+    }
+    return false;
+}
+
+static String call_site_for(const Profile::Event& event)
+{
+    for (ssize_t i = event.frames.size() - 1; i >= 0; --i) {
+        auto& symbol = event.frames[i].symbol;
+        if (!symbol.is_empty() && !is_lock_machinery(symbol))
+            return symbol;
+    }
+    return "??";
+}
+
+static bool is_inside_lock_slow_path(const Profile::Event& event)
+{
+    for (auto& frame : event.frames) {
+        if (frame.symbol.contains("Kernel::Lock::lock_slow"))
+            return true;
+    }
+    return false;
+}
+
+LockContentionModel::LockContentionModel(Profile& profile)
+    : m_profile(profile)
+{
+    update();
+}
+
+LockContentionModel::~LockContentionModel()
+{
+}
+
+int LockContentionModel::row_count(const GUI::ModelIndex&) const
+{
+    return m_rows.size();
+}
+
+String LockContentionModel::column_name(int column) const
+{
+    switch (column) {
+    case Column::LockName:
+        return "Lock";
+    case Column::CallSite:
+        return "Call site";
+    case Column::Acquisitions:
+        return "# Acquired";
+    case Column::Contentions:
+        return "# Blocked";
+    case Column::BlockedTime:
+        return "Blocked (ms)";
+    default:
+        VERIFY_NOT_REACHED();
+        return {};
+    }
+}
+
+GUI::Variant LockContentionModel::data(const GUI::ModelIndex& index, GUI::ModelRole role) const
+{
+    auto& row = m_rows[index.row()];
+
+    if (role == GUI::ModelRole::TextAlignment) {
+        if (index.column() == Column::LockName || index.column() == Column::CallSite)
+            return Gfx::TextAlignment::CenterLeft;
+        return Gfx::TextAlignment::CenterRight;
+    }
+
+    if (role == GUI::ModelRole::Display) {
+        switch (index.column()) {
+        case Column::LockName:
+            return row.lock_name;
+        case Column::CallSite:
+            return row.call_site;
+        case Column::Acquisitions:
+            return row.acquisitions;
+        case Column::Contentions:
+            return row.contentions;
+        case Column::BlockedTime:
+            return String::formatted("{}.{:03}", row.blocked_time_ns / 1'000'000, (row.blocked_time_ns / 1'000) % 1'000);
+        }
+    }
+    return {};
+}
+
+void LockContentionModel::update()
+{
+    HashMap<String, size_t> row_indices;
+    m_rows.clear();
+
+    for (auto& event : m_profile.events()) {
+        if (!event.is_lock_event())
+            continue;
+        // NOTE: Blocking on a Lock is already accounted for by its contention event.
+        if (event.type == "block" && is_inside_lock_slow_path(event))
+            continue;
+        if (m_profile.has_timestamp_filter_range() && !m_profile.timestamp_is_in_filter_range(event.timestamp))
+            continue;
+
+        auto lock_name = event.lock_name.is_empty() ? String("(unnamed)") : event.lock_name;
+        auto call_site = call_site_for(event);
+        auto key = String::formatted("{}\n{}", lock_name, call_site);
+        auto it = row_indices.find(key);
+        if (it == row_indices.end()) {
+            row_indices.set(key, m_rows.size());
+            m_rows.append({ lock_name, call_site });
+            it = row_indices.find(key);
+        }
+        auto& row = m_rows[it->value];
+
+        if (event.type == "lock_acquire") {
+            ++row.acquisitions;
+        } else {
+            ++row.contentions;
+            row.blocked_time_ns += event.duration_ns;
+        }
+    }
+
+    quick_sort(m_rows, [](auto& a, auto& b) {
+        if (a.blocked_time_ns != b.blocked_time_ns)
+            return a.blocked_time_ns > b.blocked_time_ns;
+        return a.contentions > b.contentions;
+    });
+
+    did_update();
+}
@@ -26,6 +26,7 @@
 
 #include "Profile.h"
 #include "DisassemblyModel.h"
+#include "LockContentionModel.h"
 #include "ProfileModel.h"
 #include <AK/HashTable.h>
 #include <AK/MappedFile.h>
@@ -55,6 +56,7 @@ Profile::Profile(String executable_path, Vector<Event> events, NonnullOwnPtr<Lib
     m_last_timestamp = m_events.last().timestamp;
 
     m_model = ProfileModel::create(*this);
+    m_lock_contention_model = LockContentionModel::create(*this);
 
     for (auto& event : m_events) {
         m_deepest_stack_depth = max((u32)event.frames.size(), m_deepest_stack_depth);
@@ -72,6 +74,11 @@ GUI::Model& Profile::model()
     return *m_model;
 }
 
+GUI::Model& Profile::lock_contention_model()
+{
+    return *m_lock_contention_model;
+}
+
 void Profile::rebuild_tree()
 {
     u32 filtered_event_count = 0;
@@ -115,7 +122,7 @@ void Profile::rebuild_tree()
         if (event.type == "malloc" && !live_allocations.contains(event.ptr))
             continue;
 
-        if (event.type == "free")
+        if (event.type == "free" || event.is_lock_event())
             continue;
 
         auto for_each_frame = [&]<typename Callback>(Callback callback) {
@@ -197,6 +204,7 @@ void Profile::rebuild_tree()
     m_filtered_event_count = filtered_event_count;
     m_roots = move(roots);
     m_model->update();
+    m_lock_contention_model->update();
 }
 
 Result<NonnullOwnPtr<Profile>, String> Profile::load_from_perfcore_file(const StringView& path)
@@ -250,6 +258,10 @@ Result<NonnullOwnPtr<Profile>, String> Profile::load_from_perfcore_file(const St
             event.size = perf_event.get("size").to_number<size_t>();
         } else if (event.type == "free") {
             event.ptr = perf_event.get("ptr").to_number<FlatPtr>();
+        } else if (event.is_lock_event()) {
+            event.ptr = perf_event.get("lock").to_number<FlatPtr>();
+            event.lock_name = perf_event.get("name").to_string();
+            event.duration_ns = perf_event.get("duration_ns").to_number<u64>();
         }
 
         auto stack_array = perf_event.get("stack").as_array();
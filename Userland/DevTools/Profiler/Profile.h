@@ -40,6 +40,7 @@
 
 class ProfileModel;
 class DisassemblyModel;
+class LockContentionModel;
 
 class ProfileNode : public RefCounted<ProfileNode> {
 public:
@@ -136,6 +137,7 @@ public:
 
     GUI::Model& model();
     GUI::Model* disassembly_model();
+    GUI::Model& lock_contention_model();
 
     void set_disassembly_index(const GUI::ModelIndex&);
 
@@ -153,7 +155,11 @@ public:
         FlatPtr ptr { 0 };
         size_t size { 0 };
         bool in_kernel { false };
+        String lock_name;
+        u64 duration_ns { 0 };
         Vector<Frame> frames;
+
+        bool is_lock_event() const { return type == "lock_acquire" || type == "lock_contention" || type == "block"; }
     };
 
     u32 filtered_event_count() const { return m_filtered_event_count; }
@@ -168,6 +174,7 @@ public:
     void set_timestamp_filter_range(u64 start, u64 end);
     void clear_timestamp_filter_range();
     bool has_timestamp_filter_range() const { return m_has_timestamp_filter_range; }
+    bool timestamp_is_in_filter_range(u64 timestamp) const { return timestamp >= m_timestamp_filter_range_start && timestamp <= m_timestamp_filter_range_end; }
 
     bool is_inverted() const { return m_inverted; }
     void set_inverted(bool);
@@ -211,6 +218,7 @@ private:
 
     RefPtr<ProfileModel> m_model;
     RefPtr<DisassemblyModel> m_disassembly_model;
+    RefPtr<LockContentionModel> m_lock_contention_model;
 
     GUI::ModelIndex m_disassembly_index;
 
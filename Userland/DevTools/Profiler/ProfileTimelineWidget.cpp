@@ -59,6 +59,8 @@ void ProfileTimelineWidget::paint_event(GUI::PaintEvent& event)
     float frame_height = (float)frame_inner_rect().height() / (float)m_profile.deepest_stack_depth();
 
     for (auto& event : m_profile.events()) {
+        if (event.is_lock_event())
+            continue;
         u64 t = clamp_timestamp(event.timestamp) - start_of_trace;
         int x = (int)((float)t * column_width);
         int cw = max(1, (int)column_width);
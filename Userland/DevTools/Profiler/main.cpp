@@ -44,6 +44,7 @@
 #include <LibGUI/Model.h>
 #include <LibGUI/ProcessChooser.h>
 #include <LibGUI/Splitter.h>
+#include <LibGUI/TabWidget.h>
 #include <LibGUI/TableView.h>
 #include <LibGUI/TreeView.h>
 #include <LibGUI/Window.h>
@@ -100,7 +101,9 @@ int main(int argc, char** argv)
 
     main_widget.add<ProfileTimelineWidget>(*profile);
 
-    auto& bottom_splitter = main_widget.add<GUI::VerticalSplitter>();
+    auto& tab_widget = main_widget.add<GUI::TabWidget>();
+
+    auto& bottom_splitter = tab_widget.add_tab<GUI::VerticalSplitter>("Samples");
 
     auto& tree_view = bottom_splitter.add<GUI::TreeView>();
     tree_view.set_should_fill_selected_rows(true);
@@ -114,6 +117,9 @@ int main(int argc, char** argv)
         disassembly_view.set_model(profile->disassembly_model());
     };
 
+    auto& lock_contention_view = tab_widget.add_tab<GUI::TableView>("Locks");
+    lock_contention_view.set_model(profile->lock_contention_model());
+
     auto menubar = GUI::MenuBar::construct();
     auto& app_menu = menubar->add_menu("Profiler");
     app_menu.add_action(GUI::CommonActions::make_quit_action([&](auto&) { app->quit(); }));
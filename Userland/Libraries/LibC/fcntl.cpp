@@ -48,6 +48,21 @@ int watch_file(const char* path, size_t path_length)
     __RETURN_WITH_ERRNO(rc, rc, -1);
 }
 
+int posix_fadvise(int fd, off_t offset, off_t length, int advice)
+{
+    // NOTE: posix_fadvise() returns an error number instead of setting errno.
+    Syscall::SC_posix_fadvise_params params { fd, offset, length, advice };
+    int rc = syscall(SC_posix_fadvise, &params);
+    return rc < 0 ? -rc : 0;
+}
+
+ssize_t splice(int fd_in, off_t* off_in, int fd_out, off_t* off_out, size_t length, unsigned flags)
+{
+    Syscall::SC_splice_params params { fd_in, off_in, fd_out, off_out, length, flags };
+    int rc = syscall(SC_splice, &params);
+    __RETURN_WITH_ERRNO(rc, rc, -1);
+}
+
 int creat(const char* path, mode_t mode)
 {
     return open(path, O_CREAT | O_WRONLY | O_TRUNC, mode);
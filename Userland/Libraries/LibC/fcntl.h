@@ -91,6 +91,17 @@ int openat(int dirfd, const char* path, int options, ...);
 int fcntl(int fd, int cmd, ...);
 int watch_file(const char* path, size_t path_length);
 
+#define POSIX_FADV_NORMAL 0
+#define POSIX_FADV_RANDOM 1
+#define POSIX_FADV_SEQUENTIAL 2
+#define POSIX_FADV_WILLNEED 3
+#define POSIX_FADV_DONTNEED 4
+#define POSIX_FADV_NOREUSE 5
+
+int posix_fadvise(int fd, off_t offset, off_t length, int advice);
+
+ssize_t splice(int fd_in, off_t* off_in, int fd_out, off_t* off_out, size_t length, unsigned flags);
+
 #define F_RDLCK 0
 #define F_WRLCK 1
 #define F_UNLCK 2
@@ -97,6 +97,9 @@ int purge(int mode);
 #define PERF_EVENT_SAMPLE 0
 #define PERF_EVENT_MALLOC 1
 #define PERF_EVENT_FREE 2
+#define PERF_EVENT_LOCK_ACQUIRE 3
+#define PERF_EVENT_LOCK_CONTENTION 4
+#define PERF_EVENT_BLOCK 5
 
 int perf_event(int type, uintptr_t arg1, uintptr_t arg2);
 
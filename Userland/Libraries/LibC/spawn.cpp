@@ -35,12 +35,16 @@
 #include <spawn.h>
 
 #include <AK/Function.h>
+#include <AK/String.h>
 #include <AK/Vector.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <syscall.h>
 #include <unistd.h>
 
 struct posix_spawn_file_actions_state {
@@ -119,8 +123,43 @@ extern "C" {
     _exit(127);
 }
 
+static bool can_spawn_without_fork(const posix_spawn_file_actions_t* file_actions, const posix_spawnattr_t* attr)
+{
+    // The kernel can only start the child right away if there is nothing for it to do before exec().
+    if (file_actions && !file_actions->state->actions.is_empty())
+        return false;
+    return !attr || !attr->flags;
+}
+
+static int spawn_without_fork(pid_t* out_pid, const char* path, char* const argv[], char* const envp[])
+{
+    auto copy_strings = [](char* const strings[], Vector<Syscall::StringArgument, 16>& output) {
+        for (size_t i = 0; strings[i]; ++i)
+            output.append({ strings[i], strlen(strings[i]) });
+    };
+
+    Vector<Syscall::StringArgument, 16> arguments;
+    Vector<Syscall::StringArgument, 16> environment;
+    copy_strings(argv, arguments);
+    copy_strings(envp, environment);
+
+    Syscall::SC_posix_spawn_params params;
+    params.path = { path, strlen(path) };
+    params.arguments = { arguments.data(), arguments.size() };
+    params.environment = { environment.data(), environment.size() };
+
+    int rc = syscall(SC_posix_spawn, &params);
+    if (rc < 0)
+        return -rc;
+    *out_pid = rc;
+    return 0;
+}
+
 int posix_spawn(pid_t* out_pid, const char* path, const posix_spawn_file_actions_t* file_actions, const posix_spawnattr_t* attr, char* const argv[], char* const envp[])
 {
+    if (can_spawn_without_fork(file_actions, attr))
+        return spawn_without_fork(out_pid, path, argv, envp);
+
     pid_t child_pid = fork();
     if (child_pid < 0)
         return errno;
@@ -135,6 +174,26 @@ int posix_spawn(pid_t* out_pid, const char* path, const posix_spawn_file_actions
 
 int posix_spawnp(pid_t* out_pid, const char* path, const posix_spawn_file_actions_t* file_actions, const posix_spawnattr_t* attr, char* const argv[], char* const envp[])
 {
+    if (can_spawn_without_fork(file_actions, attr)) {
+        if (strchr(path, '/'))
+            return spawn_without_fork(out_pid, path, argv, envp);
+
+        String search_path = getenv("PATH");
+        if (search_path.is_empty())
+            search_path = "/bin:/usr/bin";
+        // Like execvp(), skip over entries we aren't allowed to execute, but report that if nothing else turns up.
+        bool saw_eacces = false;
+        for (auto& part : search_path.split(':')) {
+            auto candidate = String::formatted("{}/{}", part, path);
+            int rc = spawn_without_fork(out_pid, candidate.characters(), argv, envp);
+            if (rc == EACCES)
+                saw_eacces = true;
+            else if (rc != ENOENT)
+                return rc;
+        }
+        return saw_eacces ? EACCES : ENOENT;
+    }
+
     pid_t child_pid = fork();
     if (child_pid < 0)
         return errno;
@@ -134,16 +134,19 @@ int execvpe(const char* filename, char* const argv[], char* const envp[])
     if (path.is_empty())
         path = "/bin:/usr/bin";
     auto parts = path.split(':');
+    bool saw_eacces = false;
     for (auto& part : parts) {
         auto candidate = String::formatted("{}/{}", part, filename);
         int rc = execve(candidate.characters(), argv, envp);
-        if (rc < 0 && errno != ENOENT) {
+        if (rc < 0 && errno == EACCES) {
+            saw_eacces = true;
+        } else if (rc < 0 && errno != ENOENT) {
             errno_rollback.set_override_rollback_value(errno);
             dbgln("execvpe() failed on attempt ({}) with {}", candidate, strerror(errno));
             return rc;
         }
     }
-    errno_rollback.set_override_rollback_value(ENOENT);
+    errno_rollback.set_override_rollback_value(saw_eacces ? EACCES : ENOENT);
     dbgln("execvpe() leaving :(");
     return -1;
 }
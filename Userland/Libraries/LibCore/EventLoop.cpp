@@ -55,6 +55,10 @@
 #include <time.h>
 #include <unistd.h>
 
+#ifdef __serenity__
+#    include <sys/epoll.h>
+#endif
+
 namespace Core {
 
 class RPCClient;
@@ -81,6 +85,43 @@ static NeverDestroyed<IDAllocator> s_id_allocator;
 static HashMap<int, NonnullOwnPtr<EventLoopTimer>>* s_timers;
 static HashTable<Notifier*>* s_notifiers;
 int EventLoop::s_wake_pipe_fds[2];
+#ifdef __serenity__
+// NOTE: Notifiers are kept registered with a persistent epoll, so waiting doesn't have to
+//       hand the kernel every fd again, and only the fds that became ready come back.
+static int s_epoll_fd = -1;
+static HashMap<int, Vector<Notifier*, 1>>* s_notifiers_by_fd;
+static constexpr int max_epoll_events = 64;
+
+static void update_epoll_registration(int fd)
+{
+    if (s_epoll_fd < 0)
+        return;
+    auto it = s_notifiers_by_fd->find(fd);
+    if (it == s_notifiers_by_fd->end()) {
+        // NOTE: The kernel keeps watching as long as the file description is alive, not just the fd.
+        //       Notifiers are therefore disabled before their fd gets closed, as we can't unwatch it afterwards.
+        if (epoll_ctl(s_epoll_fd, EPOLL_CTL_DEL, fd, nullptr) < 0 && errno != ENOENT)
+            dbgln("Core::EventLoop: Failed to unwatch fd {}: {}", fd, strerror(errno));
+        return;
+    }
+
+    epoll_event event {};
+    event.data.fd = fd;
+    for (auto* notifier : it->value) {
+        if (notifier->event_mask() & Notifier::Read)
+            event.events |= EPOLLIN;
+        if (notifier->event_mask() & Notifier::Write)
+            event.events |= EPOLLOUT;
+        if (notifier->event_mask() & Notifier::Exceptional)
+            VERIFY_NOT_REACHED();
+    }
+    if (epoll_ctl(s_epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0)
+        return;
+    if (errno == EEXIST && epoll_ctl(s_epoll_fd, EPOLL_CTL_MOD, fd, &event) == 0)
+        return;
+    dbgln("Core::EventLoop: Failed to watch fd {}: {}", fd, strerror(errno));
+}
+#endif
 static RefPtr<LocalServer> s_rpc_server;
 HashMap<int, RefPtr<RPCClient>> s_rpc_clients;
 
@@ -283,6 +324,9 @@ EventLoop::EventLoop()
         s_event_loop_stack = new Vector<EventLoop*>;
         s_timers = new HashMap<int, NonnullOwnPtr<EventLoopTimer>>;
         s_notifiers = new HashTable<Notifier*>;
+#ifdef __serenity__
+        s_notifiers_by_fd = new HashMap<int, Vector<Notifier*, 1>>;
+#endif
     }
 
     if (!s_main_event_loop) {
@@ -299,6 +343,18 @@ EventLoop::EventLoop()
         VERIFY(rc == 0);
         s_event_loop_stack->append(this);
 
+#ifdef __serenity__
+        s_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        VERIFY(s_epoll_fd >= 0);
+        epoll_event wake_event {};
+        wake_event.events = EPOLLIN;
+        wake_event.data.fd = s_wake_pipe_fds[0];
+        rc = epoll_ctl(s_epoll_fd, EPOLL_CTL_ADD, s_wake_pipe_fds[0], &wake_event);
+        VERIFY(rc == 0);
+        for (auto& it : *s_notifiers_by_fd)
+            update_epoll_registration(it.key);
+#endif
+
 #ifdef __serenity__
         if (!s_rpc_server) {
             if (!start_rpc_server())
@@ -600,6 +656,14 @@ void EventLoop::notify_forked(ForkEvent event)
         s_event_loop_stack->clear();
         s_timers->clear();
         s_notifiers->clear();
+#ifdef __serenity__
+        // NOTE: The epoll is shared with the parent, so the child must not touch its registrations.
+        if (s_epoll_fd >= 0) {
+            close(s_epoll_fd);
+            s_epoll_fd = -1;
+        }
+        s_notifiers_by_fd->clear();
+#endif
         if (auto* info = signals_info<false>()) {
             info->signal_handlers.clear();
             info->next_signal_id = 0;
@@ -617,6 +681,10 @@ void EventLoop::notify_forked(ForkEvent event)
 
 void EventLoop::wait_for_event(WaitMode mode)
 {
+#ifdef __serenity__
+    epoll_event ready_events[max_epoll_events];
+retry:
+#else
     fd_set rfds;
     fd_set wfds;
 retry:
@@ -641,6 +709,7 @@ retry:
         if (notifier->event_mask() & Notifier::Exceptional)
             VERIFY_NOT_REACHED();
     }
+#endif
 
     bool queued_events_is_empty;
     {
@@ -669,7 +738,12 @@ retry:
     }
 
 try_select_again:
+#ifdef __serenity__
+    timespec epoll_timeout { timeout.tv_sec, timeout.tv_usec * 1000 };
+    int marked_fd_count = epoll_pwait2(s_epoll_fd, ready_events, max_epoll_events, should_wait_forever ? nullptr : &epoll_timeout, nullptr);
+#else
     int marked_fd_count = select(max_fd + 1, &rfds, &wfds, nullptr, should_wait_forever ? nullptr : &timeout);
+#endif
     if (marked_fd_count < 0) {
         int saved_errno = errno;
         if (saved_errno == EINTR) {
@@ -683,7 +757,16 @@ try_select_again:
         // Blow up, similar to Core::safe_syscall.
         VERIFY_NOT_REACHED();
     }
-    if (FD_ISSET(s_wake_pipe_fds[0], &rfds)) {
+#ifdef __serenity__
+    bool wake_pipe_is_readable = false;
+    for (int i = 0; i < marked_fd_count; ++i) {
+        if (ready_events[i].data.fd == s_wake_pipe_fds[0])
+            wake_pipe_is_readable = true;
+    }
+#else
+    bool wake_pipe_is_readable = FD_ISSET(s_wake_pipe_fds[0], &rfds);
+#endif
+    if (wake_pipe_is_readable) {
         int wake_events[8];
         auto nread = read(s_wake_pipe_fds[0], wake_events, sizeof(wake_events));
         if (nread < 0) {
@@ -736,6 +819,25 @@ try_select_again:
     if (!marked_fd_count)
         return;
 
+#ifdef __serenity__
+    for (int i = 0; i < marked_fd_count; ++i) {
+        auto& ready_event = ready_events[i];
+        if (ready_event.data.fd == s_wake_pipe_fds[0])
+            continue;
+        auto it = s_notifiers_by_fd->find(ready_event.data.fd);
+        if (it == s_notifiers_by_fd->end()) {
+            // Nobody is listening anymore, so stop the kernel from reporting this fd over and over again.
+            update_epoll_registration(ready_event.data.fd);
+            continue;
+        }
+        for (auto* notifier : it->value) {
+            if ((ready_event.events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && (notifier->event_mask() & Notifier::Event::Read))
+                post_event(*notifier, make<NotifierReadEvent>(notifier->fd()));
+            if ((ready_event.events & (EPOLLOUT | EPOLLERR)) && (notifier->event_mask() & Notifier::Event::Write))
+                post_event(*notifier, make<NotifierWriteEvent>(notifier->fd()));
+        }
+    }
+#else
     for (auto& notifier : *s_notifiers) {
         if (FD_ISSET(notifier->fd(), &rfds)) {
             if (notifier->event_mask() & Notifier::Event::Read)
@@ -746,6 +848,7 @@ try_select_again:
                 post_event(*notifier, make<NotifierWriteEvent>(notifier->fd()));
         }
     }
+#endif
 }
 
 bool EventLoopTimer::has_expired(const timeval& now) const
@@ -809,11 +912,36 @@ bool EventLoop::unregister_timer(int timer_id)
 void EventLoop::register_notifier(Badge<Notifier>, Notifier& notifier)
 {
     s_notifiers->set(&notifier);
+#ifdef __serenity__
+    auto& notifiers = s_notifiers_by_fd->ensure(notifier.fd());
+    if (!notifiers.contains_slow(&notifier))
+        notifiers.append(&notifier);
+    update_epoll_registration(notifier.fd());
+#endif
 }
 
 void EventLoop::unregister_notifier(Badge<Notifier>, Notifier& notifier)
 {
     s_notifiers->remove(&notifier);
+#ifdef __serenity__
+    auto it = s_notifiers_by_fd->find(notifier.fd());
+    if (it == s_notifiers_by_fd->end())
+        return;
+    it->value.remove_first_matching([&](auto* other) { return other == &notifier; });
+    if (it->value.is_empty())
+        s_notifiers_by_fd->remove(it);
+    update_epoll_registration(notifier.fd());
+#endif
+}
+
+void EventLoop::notifier_event_mask_changed(Badge<Notifier>, Notifier& notifier)
+{
+#ifdef __serenity__
+    if (s_notifiers->contains(&notifier))
+        update_epoll_registration(notifier.fd());
+#else
+    (void)notifier;
+#endif
 }
 
 void EventLoop::wake()
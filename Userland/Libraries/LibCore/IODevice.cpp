@@ -229,13 +229,15 @@ bool IODevice::close()
 {
     if (fd() < 0 || mode() == NotOpen)
         return false;
-    int rc = ::close(fd());
+    // NOTE: Let any notifiers stop watching the fd first, the event loop can't unwatch it once it's closed.
+    int fd_to_close = fd();
+    set_fd(-1);
+    set_mode(IODevice::NotOpen);
+    int rc = ::close(fd_to_close);
     if (rc < 0) {
         set_error(errno);
         return false;
     }
-    set_fd(-1);
-    set_mode(IODevice::NotOpen);
     return true;
 }
 
@@ -46,6 +46,8 @@ LocalServer::LocalServer(Object* parent)
 
 LocalServer::~LocalServer()
 {
+    if (m_notifier)
+        m_notifier->close();
     if (m_fd >= 0)
         ::close(m_fd);
 }
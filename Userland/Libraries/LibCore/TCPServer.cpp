@@ -54,6 +54,8 @@ TCPServer::TCPServer(Object* parent)
 
 TCPServer::~TCPServer()
 {
+    if (m_notifier)
+        m_notifier->close();
     ::close(m_fd);
 }
 
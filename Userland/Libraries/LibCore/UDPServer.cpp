@@ -55,6 +55,8 @@ UDPServer::UDPServer(Object* parent)
 
 UDPServer::~UDPServer()
 {
+    if (m_notifier)
+        m_notifier->close();
     ::close(m_fd);
 }
 
@@ -34,16 +34,19 @@
 #include <LibCore/DateTime.h>
 #include <LibCore/DirIterator.h>
 #include <LibCore/File.h>
-#include <LibCore/FileStream.h>
 #include <LibCore/MimeData.h>
 #include <LibHTTP/HttpRequest.h>
+#include <errno.h>
 #include <stdio.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 
 namespace WebServer {
 
+static constexpr size_t file_chunk_size = 64 * KiB;
+
 Client::Client(NonnullRefPtr<Core::TCPSocket> socket, const String& root, Core::Object* parent)
     : Core::Object(parent)
     , m_socket(socket)
@@ -65,10 +68,15 @@ void Client::start()
             return;
         }
 
+        // NOTE: We only serve one request per connection, anything sent while a file is going out is ignored.
+        if (m_file)
+            return;
+
         dbgln("Got raw request: '{}'", String::copy(raw_request));
 
         handle_request(raw_request.bytes());
-        die();
+        if (!m_file)
+            die();
     };
 }
 
@@ -127,12 +135,10 @@ void Client::handle_request(ReadonlyBytes raw_request)
         return;
     }
 
-    Core::InputFileStream stream { file };
-
-    send_response(stream, request, Core::guess_mime_type_based_on_filename(real_path));
+    send_file_response(move(file), request, Core::guess_mime_type_based_on_filename(real_path));
 }
 
-void Client::send_response(InputStream& response, const HTTP::HttpRequest& request, const String& content_type)
+void Client::send_response_header(const HTTP::HttpRequest& request, const String& content_type)
 {
     StringBuilder builder;
     builder.append("HTTP/1.0 200 OK\r\n");
@@ -144,6 +150,11 @@ void Client::send_response(InputStream& response, const HTTP::HttpRequest& reque
 
     m_socket->write(builder.to_string());
     log_response(200, request);
+}
+
+void Client::send_response(InputStream& response, const HTTP::HttpRequest& request, const String& content_type)
+{
+    send_response_header(request, content_type);
 
     char buffer[PAGE_SIZE];
     do {
@@ -155,6 +166,36 @@ void Client::send_response(InputStream& response, const HTTP::HttpRequest& reque
     } while (true);
 }
 
+void Client::send_file_response(NonnullRefPtr<Core::File> file, const HTTP::HttpRequest& request, const String& content_type)
+{
+    send_response_header(request, content_type);
+
+    // NOTE: The file contents go straight from the kernel's file cache to the socket, without a trip through userspace.
+    //       The socket stays non-blocking, we push another chunk whenever it has room for more.
+    m_socket->set_blocking(false);
+    m_file = move(file);
+    m_write_notifier = Core::Notifier::construct(m_socket->fd(), Core::Notifier::Event::Write, this);
+    m_write_notifier->on_ready_to_write = [this] {
+        send_next_file_chunk();
+    };
+}
+
+void Client::send_next_file_chunk()
+{
+    auto nsent = sendfile(m_socket->fd(), m_file->fd(), nullptr, file_chunk_size);
+    if (nsent < 0 && errno == EAGAIN)
+        return;
+    if (nsent < 0)
+        perror("sendfile");
+    if (nsent > 0)
+        return;
+
+    m_write_notifier->set_enabled(false);
+    deferred_invoke([this](auto&) {
+        die();
+    });
+}
+
 void Client::send_redirect(StringView redirect_path, const HTTP::HttpRequest& request)
 {
     StringBuilder builder;
@@ -26,6 +26,9 @@
 
 #pragma once
 
+#include <LibCore/File.h>
+#include <LibCore/Forward.h>
+#include <LibCore/Notifier.h>
 #include <LibCore/Object.h>
 #include <LibCore/TCPSocket.h>
 #include <LibHTTP/Forward.h>
@@ -42,7 +45,10 @@ private:
     Client(NonnullRefPtr<Core::TCPSocket>, const String&, Core::Object* parent);
 
     void handle_request(ReadonlyBytes);
+    void send_response_header(const HTTP::HttpRequest&, const String& content_type);
     void send_response(InputStream&, const HTTP::HttpRequest&, const String& content_type);
+    void send_file_response(NonnullRefPtr<Core::File>, const HTTP::HttpRequest&, const String& content_type);
+    void send_next_file_chunk();
     void send_redirect(StringView redirect, const HTTP::HttpRequest& request);
     void send_error_response(unsigned code, const StringView& message, const HTTP::HttpRequest&);
     void die();
@@ -51,6 +57,8 @@ private:
 
     NonnullRefPtr<Core::TCPSocket> m_socket;
     String m_root_path;
+    RefPtr<Core::File> m_file;
+    RefPtr<Core::Notifier> m_write_notifier;
 };
 
 }
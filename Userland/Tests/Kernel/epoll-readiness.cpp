@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static constexpr int pipe_count = 48;
+
+static int s_failures = 0;
+
+#define EXPECT(condition)                                                         \
+    do {                                                                          \
+        if (!(condition)) {                                                       \
+            fprintf(stderr, "FAIL: %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+            ++s_failures;                                                         \
+        }                                                                         \
+    } while (0)
+
+static void make_pipe(int fds[2])
+{
+    if (pipe(fds) < 0) {
+        perror("pipe");
+        exit(1);
+    }
+}
+
+static int create_epoll()
+{
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        perror("epoll_create1");
+        exit(1);
+    }
+    return epoll_fd;
+}
+
+static void watch(int epoll_fd, int fd, uint32_t events)
+{
+    epoll_event event {};
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        perror("epoll_ctl");
+        exit(1);
+    }
+}
+
+static int wait_now(int epoll_fd, epoll_event* events, int max_events)
+{
+    return epoll_wait(epoll_fd, events, max_events, 0);
+}
+
+static void test_level_triggered()
+{
+    int fds[2];
+    make_pipe(fds);
+    int epoll_fd = create_epoll();
+    watch(epoll_fd, fds[0], EPOLLIN);
+
+    epoll_event events[4];
+    EXPECT(wait_now(epoll_fd, events, 4) == 0);
+
+    write(fds[1], "x", 1);
+    EXPECT(wait_now(epoll_fd, events, 4) == 1);
+    EXPECT(events[0].data.fd == fds[0] && (events[0].events & EPOLLIN));
+    // Nothing was read, so the pipe must still be reported.
+    EXPECT(wait_now(epoll_fd, events, 4) == 1);
+
+    char c;
+    read(fds[0], &c, 1);
+    EXPECT(wait_now(epoll_fd, events, 4) == 0);
+
+    close(epoll_fd);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void test_edge_triggered_and_oneshot()
+{
+    int fds[2];
+    make_pipe(fds);
+    int epoll_fd = create_epoll();
+    watch(epoll_fd, fds[0], EPOLLIN | EPOLLET);
+
+    epoll_event events[4];
+    write(fds[1], "x", 1);
+    EXPECT(wait_now(epoll_fd, events, 4) == 1);
+    EXPECT(wait_now(epoll_fd, events, 4) == 0);
+    write(fds[1], "y", 1);
+    EXPECT(wait_now(epoll_fd, events, 4) == 1);
+
+    epoll_event event {};
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.fd = fds[0];
+    EXPECT(epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fds[0], &event) == 0);
+    EXPECT(wait_now(epoll_fd, events, 4) == 1);
+    write(fds[1], "z", 1);
+    EXPECT(wait_now(epoll_fd, events, 4) == 0);
+    EXPECT(epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fds[0], &event) == 0);
+    EXPECT(wait_now(epoll_fd, events, 4) == 1);
+
+    EXPECT(epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fds[0], nullptr) == 0);
+    EXPECT(epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fds[0], nullptr) < 0 && errno == ENOENT);
+    EXPECT(wait_now(epoll_fd, events, 4) == 0);
+
+    close(epoll_fd);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void test_close_forgets_description()
+{
+    int fds[2];
+    make_pipe(fds);
+    int epoll_fd = create_epoll();
+    watch(epoll_fd, fds[0], EPOLLIN);
+    write(fds[1], "x", 1);
+    close(fds[0]);
+
+    epoll_event events[4];
+    EXPECT(wait_now(epoll_fd, events, 4) == 0);
+
+    // The reader is gone, so a new pipe may reuse its fd number and must be addable again.
+    int new_fds[2];
+    make_pipe(new_fds);
+    watch(epoll_fd, new_fds[0], EPOLLIN);
+
+    close(epoll_fd);
+    close(fds[1]);
+    close(new_fds[0]);
+    close(new_fds[1]);
+}
+
+static void test_only_ready_fds_are_reported()
+{
+    int fds[pipe_count][2];
+    int epoll_fd = create_epoll();
+    for (auto& pipe_fds : fds) {
+        make_pipe(pipe_fds);
+        watch(epoll_fd, pipe_fds[0], EPOLLIN);
+    }
+
+    int writer_pid = fork();
+    if (writer_pid == 0) {
+        usleep(100'000);
+        write(fds[pipe_count / 2][1], "x", 1);
+        _exit(0);
+    }
+
+    epoll_event events[pipe_count];
+    int rc = epoll_wait(epoll_fd, events, pipe_count, 5000);
+    EXPECT(rc == 1);
+    EXPECT(rc == 1 && events[0].data.fd == fds[pipe_count / 2][0]);
+    waitpid(writer_pid, nullptr, 0);
+
+    for (auto& pipe_fds : fds) {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+    }
+    close(epoll_fd);
+}
+
+int main(int, char**)
+{
+    test_level_triggered();
+    test_edge_triggered_and_oneshot();
+    test_close_forgets_description();
+    test_only_ready_fds_are_reported();
+
+    if (s_failures) {
+        fprintf(stderr, "%d failures\n", s_failures);
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
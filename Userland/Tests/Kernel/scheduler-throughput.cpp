@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Atomic.h>
+#include <AK/NumericLimits.h>
+#include <AK/String.h>
+#include <AK/Vector.h>
+#include <LibCore/ArgsParser.h>
+#include <LibCore/ElapsedTimer.h>
+#include <LibCore/File.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// Runs a set of CPU-bound threads that yield after every chunk of work, and reports
+// the aggregate throughput and how evenly it was spread. Compare runs with /proc/scheduler.
+
+static Atomic<bool> s_should_stop { false };
+
+struct Worker {
+    pthread_t thread;
+    u64 chunks { 0 };
+    u32 state { 0 };
+};
+
+static void* run_worker(void* argument)
+{
+    auto& worker = *reinterpret_cast<Worker*>(argument);
+    while (!s_should_stop.load(AK::MemoryOrder::memory_order_relaxed)) {
+        for (int i = 0; i < 10000; ++i) {
+            // xorshift32, just to keep the processor busy.
+            worker.state ^= worker.state << 13;
+            worker.state ^= worker.state >> 17;
+            worker.state ^= worker.state << 5;
+        }
+        worker.chunks++;
+        sched_yield();
+    }
+    return nullptr;
+}
+
+static void dump_scheduler_statistics(const char* title)
+{
+    auto file = Core::File::construct("/proc/scheduler");
+    if (!file->open(Core::IODevice::ReadOnly)) {
+        fprintf(stderr, "Couldn't open /proc/scheduler: %s\n", file->error_string());
+        return;
+    }
+    auto contents = file->read_all();
+    printf("%s: %s\n", title, String::copy(contents).characters());
+}
+
+int main(int argc, char** argv)
+{
+    int thread_count = 8;
+    int seconds = 5;
+
+    Core::ArgsParser args_parser;
+    args_parser.set_general_help("Measure scheduler throughput with many yielding CPU-bound threads.");
+    args_parser.add_option(thread_count, "Number of worker threads", "threads", 't', "count");
+    args_parser.add_option(seconds, "Duration of the run in seconds", "seconds", 's', "seconds");
+    args_parser.parse(argc, argv);
+
+    if (thread_count <= 0 || seconds <= 0) {
+        args_parser.print_usage(stderr, argv[0]);
+        return 1;
+    }
+
+    dump_scheduler_statistics("Before");
+
+    Vector<Worker> workers;
+    workers.resize(thread_count);
+    for (int i = 0; i < thread_count; ++i) {
+        workers[i].state = 2463534242u + i;
+        if (int rc = pthread_create(&workers[i].thread, nullptr, run_worker, &workers[i]); rc != 0) {
+            fprintf(stderr, "pthread_create: %s\n", strerror(rc));
+            return 1;
+        }
+    }
+
+    Core::ElapsedTimer timer;
+    timer.start();
+    sleep(seconds);
+    s_should_stop.store(true);
+    for (auto& worker : workers)
+        pthread_join(worker.thread, nullptr);
+    auto elapsed_ms = timer.elapsed();
+
+    u64 total_chunks = 0;
+    u64 min_chunks = NumericLimits<u64>::max();
+    u64 max_chunks = 0;
+    for (auto& worker : workers) {
+        total_chunks += worker.chunks;
+        min_chunks = min(min_chunks, worker.chunks);
+        max_chunks = max(max_chunks, worker.chunks);
+    }
+
+    printf("Finished: threads=%d time=%dms chunks=%llu chunks_per_second=%llu min_chunks=%llu max_chunks=%llu\n",
+        thread_count,
+        elapsed_ms,
+        total_chunks,
+        elapsed_ms ? total_chunks * 1000 / elapsed_ms : total_chunks * 1000,
+        min_chunks,
+        max_chunks);
+
+    dump_scheduler_statistics("After");
+    return 0;
+}
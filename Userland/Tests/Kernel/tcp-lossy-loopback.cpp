@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/JsonArray.h>
+#include <AK/JsonObject.h>
+#include <AK/JsonValue.h>
+#include <AK/String.h>
+#include <LibCore/ArgsParser.h>
+#include <LibCore/ElapsedTimer.h>
+#include <LibCore/File.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Pushes a stream through a TCP connection over the loopback adapter while it drops a share of
+// all packets, then checks that every byte arrived intact and in order. Needs root to set the loss.
+
+static constexpr u16 port = 10101;
+
+static u8 pattern_byte(size_t offset)
+{
+    return offset % 251;
+}
+
+static bool set_loopback_packet_loss(int percentage)
+{
+    auto file = Core::File::construct("/proc/sys/loopback_packet_loss");
+    if (!file->open(Core::IODevice::WriteOnly)) {
+        fprintf(stderr, "Couldn't open /proc/sys/loopback_packet_loss: %s\n", file->error_string());
+        return false;
+    }
+    return file->write(String::number(percentage));
+}
+
+static void print_connection_stats()
+{
+    auto file = Core::File::construct("/proc/net/tcp");
+    if (!file->open(Core::IODevice::ReadOnly))
+        return;
+    auto json = JsonValue::from_string(file->read_all());
+    if (!json.has_value() || !json.value().is_array())
+        return;
+    json.value().as_array().for_each([](auto& value) {
+        auto& socket = value.as_object();
+        if (socket.get("local_port").to_u32() != port || socket.get("state").to_string() == "Listen")
+            return;
+        printf("%s: cwnd=%u ssthresh=%u srtt=%uus rto=%uus retransmits=%u fast_retransmits=%u timeouts=%u out_of_order=%u\n",
+            socket.get("state").to_string().characters(),
+            socket.get("cwnd").to_u32(),
+            socket.get("ssthresh").to_u32(),
+            socket.get("srtt_usec").to_u32(),
+            socket.get("rto_usec").to_u32(),
+            socket.get("retransmits").to_u32(),
+            socket.get("fast_retransmits").to_u32(),
+            socket.get("timeouts").to_u32(),
+            socket.get("out_of_order_packets").to_u32());
+    });
+}
+
+static int run_sender(size_t total_size)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (const sockaddr*)&address, sizeof(address)) < 0) {
+        perror("connect");
+        return 1;
+    }
+
+    u8 buffer[16 * KiB];
+    for (size_t offset = 0; offset < total_size;) {
+        size_t chunk_size = min(sizeof(buffer), total_size - offset);
+        for (size_t i = 0; i < chunk_size; ++i)
+            buffer[i] = pattern_byte(offset + i);
+        ssize_t nwritten = write(fd, buffer, chunk_size);
+        if (nwritten < 0) {
+            perror("write");
+            return 1;
+        }
+        offset += nwritten;
+    }
+
+    close(fd);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    int loss_percentage = 5;
+    int megabytes = 4;
+
+    Core::ArgsParser args_parser;
+    args_parser.add_option(loss_percentage, "Percentage of loopback packets to drop (default 5)", "loss", 'l', "percent");
+    args_parser.add_option(megabytes, "Number of MiB to transfer (default 4)", "size", 's', "MiB");
+    args_parser.parse(argc, argv);
+
+    size_t total_size = (size_t)megabytes * MiB;
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listen_fd, (const sockaddr*)&address, sizeof(address)) < 0) {
+        perror("bind");
+        return 1;
+    }
+    if (listen(listen_fd, 1) < 0) {
+        perror("listen");
+        return 1;
+    }
+
+    if (!set_loopback_packet_loss(loss_percentage))
+        return 1;
+
+    Core::ElapsedTimer timer;
+    timer.start();
+
+    pid_t sender_pid = fork();
+    if (sender_pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (sender_pid == 0)
+        _exit(run_sender(total_size));
+
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+        perror("accept");
+        set_loopback_packet_loss(0);
+        return 1;
+    }
+
+    bool ok = true;
+    size_t received = 0;
+    u8 buffer[16 * KiB];
+    for (;;) {
+        ssize_t nread = read(fd, buffer, sizeof(buffer));
+        if (nread < 0) {
+            perror("read");
+            ok = false;
+            break;
+        }
+        if (nread == 0)
+            break;
+        for (ssize_t i = 0; ok && i < nread; ++i) {
+            if (buffer[i] != pattern_byte(received + i)) {
+                printf("FAIL, byte %zu is %u, expected %u\n", received + i, buffer[i], pattern_byte(received + i));
+                ok = false;
+            }
+        }
+        received += nread;
+        if (!ok)
+            break;
+    }
+
+    auto elapsed_ms = max(timer.elapsed(), 1);
+    print_connection_stats();
+    close(fd);
+    close(listen_fd);
+    set_loopback_packet_loss(0);
+
+    int status = 0;
+    waitpid(sender_pid, &status, 0);
+
+    if (!ok)
+        return 1;
+    if (received != total_size) {
+        printf("FAIL, received %zu of %zu bytes\n", received, total_size);
+        return 1;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("FAIL, sender exited abnormally\n");
+        return 1;
+    }
+
+    printf("Received %zu bytes in %d ms (%zu KiB/s) with %d%% loss\n", received, elapsed_ms, received / KiB * 1000 / elapsed_ms, loss_percentage);
+    printf("PASS\n");
+    return 0;
+}
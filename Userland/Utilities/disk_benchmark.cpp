@@ -25,6 +25,7 @@
  */
 
 #include <AK/ByteBuffer.h>
+#include <AK/Function.h>
 #include <AK/String.h>
 #include <AK/Types.h>
 #include <AK/Vector.h>
@@ -40,30 +41,33 @@
 struct Result {
     u64 write_bps;
     u64 read_bps;
+    u64 read_without_read_ahead_bps;
 };
 
 static Result average_result(const Vector<Result>& results)
 {
-    Result average;
+    Result average {};
 
     for (auto& res : results) {
         average.write_bps += res.write_bps;
         average.read_bps += res.read_bps;
+        average.read_without_read_ahead_bps += res.read_without_read_ahead_bps;
     }
 
     average.write_bps /= results.size();
     average.read_bps /= results.size();
+    average.read_without_read_ahead_bps /= results.size();
 
     return average;
 }
 
 static void exit_with_usage(int rc)
 {
-    fprintf(stderr, "Usage: disk_benchmark [-h] [-d directory] [-t time_per_benchmark] [-f file_size1,file_size2,...] [-b block_size1,block_size2,...]\n");
+    fprintf(stderr, "Usage: disk_benchmark [-h] [-c] [-r] [-d directory] [-t time_per_benchmark] [-f file_size1,file_size2,...] [-b block_size1,block_size2,...]\n");
     exit(rc);
 }
 
-static Result benchmark(const String& filename, int file_size, int block_size, ByteBuffer& buffer, bool allow_cache);
+static Result benchmark(const String& filename, int file_size, int block_size, ByteBuffer& buffer, bool allow_cache, bool compare_read_ahead);
 
 int main(int argc, char** argv)
 {
@@ -72,9 +76,10 @@ int main(int argc, char** argv)
     Vector<int> file_sizes;
     Vector<int> block_sizes;
     bool allow_cache = false;
+    bool compare_read_ahead = false;
 
     int opt;
-    while ((opt = getopt(argc, argv, "chd:t:f:b:")) != -1) {
+    while ((opt = getopt(argc, argv, "chrd:t:f:b:")) != -1) {
         switch (opt) {
         case 'h':
             exit_with_usage(0);
@@ -82,6 +87,11 @@ int main(int argc, char** argv)
         case 'c':
             allow_cache = true;
             break;
+        case 'r':
+            // Read-ahead only happens for cached reads.
+            allow_cache = true;
+            compare_read_ahead = true;
+            break;
         case 'd':
             directory = strdup(optarg);
             break;
@@ -125,11 +135,14 @@ int main(int argc, char** argv)
             while (timer.elapsed() < time_per_benchmark * 1000) {
                 printf(".");
                 fflush(stdout);
-                results.append(benchmark(filename, file_size, block_size, buffer, allow_cache));
+                results.append(benchmark(filename, file_size, block_size, buffer, allow_cache, compare_read_ahead));
                 usleep(100);
             }
             auto average = average_result(results);
-            printf("\nFinished: runs=%zu time=%dms write_bps=%llu read_bps=%llu\n", results.size(), timer.elapsed(), average.write_bps, average.read_bps);
+            printf("\nFinished: runs=%zu time=%dms write_bps=%llu read_bps=%llu", results.size(), timer.elapsed(), average.write_bps, average.read_bps);
+            if (compare_read_ahead)
+                printf(" read_without_read_ahead_bps=%llu", average.read_without_read_ahead_bps);
+            printf("\n");
 
             sleep(1);
         }
@@ -141,7 +154,39 @@ int main(int argc, char** argv)
     }
 }
 
-Result benchmark(const String& filename, int file_size, int block_size, ByteBuffer& buffer, bool allow_cache)
+static u64 measure_read(int fd, int file_size, int block_size, ByteBuffer& buffer, int advice, const Function<void()>& cleanup_and_exit)
+{
+    if (lseek(fd, 0, SEEK_SET) < 0) {
+        perror("lseek");
+        cleanup_and_exit();
+    }
+
+    // Make sure we're measuring reads from the disk, not from the cache.
+    if (int rc = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED); rc != 0) {
+        fprintf(stderr, "posix_fadvise: %s\n", strerror(rc));
+        cleanup_and_exit();
+    }
+    if (int rc = posix_fadvise(fd, 0, 0, advice); rc != 0) {
+        fprintf(stderr, "posix_fadvise: %s\n", strerror(rc));
+        cleanup_and_exit();
+    }
+
+    Core::ElapsedTimer timer;
+    timer.start();
+    int nread = 0;
+    while (nread < file_size) {
+        int n = read(fd, buffer.data(), block_size);
+        if (n < 0) {
+            perror("read");
+            cleanup_and_exit();
+        }
+        nread += n;
+    }
+
+    return (u64)(timer.elapsed() ? (file_size / timer.elapsed()) : file_size) * 1000;
+}
+
+Result benchmark(const String& filename, int file_size, int block_size, ByteBuffer& buffer, bool allow_cache, bool compare_read_ahead)
 {
     int flags = O_CREAT | O_TRUNC | O_RDWR;
     if (!allow_cache)
@@ -159,7 +204,7 @@ Result benchmark(const String& filename, int file_size, int block_size, ByteBuff
         exit(1);
     };
 
-    Result res;
+    Result res {};
 
     Core::ElapsedTimer timer;
 
@@ -176,23 +221,9 @@ Result benchmark(const String& filename, int file_size, int block_size, ByteBuff
 
     res.write_bps = (u64)(timer.elapsed() ? (file_size / timer.elapsed()) : file_size) * 1000;
 
-    if (lseek(fd, 0, SEEK_SET) < 0) {
-        perror("lseek");
-        cleanup_and_exit();
-    }
-
-    timer.start();
-    int nread = 0;
-    while (nread < file_size) {
-        int n = read(fd, buffer.data(), block_size);
-        if (n < 0) {
-            perror("read");
-            cleanup_and_exit();
-        }
-        nread += n;
-    }
-
-    res.read_bps = (u64)(timer.elapsed() ? (file_size / timer.elapsed()) : file_size) * 1000;
+    if (compare_read_ahead)
+        res.read_without_read_ahead_bps = measure_read(fd, file_size, block_size, buffer, POSIX_FADV_RANDOM, cleanup_and_exit);
+    res.read_bps = measure_read(fd, file_size, block_size, buffer, POSIX_FADV_NORMAL, cleanup_and_exit);
 
     if (close(fd) != 0) {
         perror("close");
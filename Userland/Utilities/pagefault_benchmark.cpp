@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Vector.h>
+#include <LibCore/ArgsParser.h>
+#include <LibCore/ElapsedTimer.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Measures the cost of anonymous zero-fill page faults in a process with many regions,
+// which is dominated by looking up the faulting region.
+int main(int argc, char** argv)
+{
+    int region_count = 4096;
+    int page_count = 1024;
+    int rounds = 10;
+
+    Core::ArgsParser args_parser;
+    args_parser.set_general_help("Measure page fault throughput in a process with many memory regions.");
+    args_parser.add_option(region_count, "Number of extra regions to map before faulting", "regions", 'r', "count");
+    args_parser.add_option(page_count, "Number of pages to fault in per round", "pages", 'p', "count");
+    args_parser.add_option(rounds, "Number of rounds", "rounds", 'n', "count");
+    args_parser.parse(argc, argv);
+
+    if (region_count < 0 || page_count <= 0 || rounds <= 0) {
+        args_parser.print_usage(stderr, argv[0]);
+        return 1;
+    }
+
+    size_t page_size = sysconf(_SC_PAGESIZE);
+
+    // Each filler region is a separate mapping (the kernel pads them with guard pages), so none of them get merged.
+    Vector<void*> filler_regions;
+    filler_regions.ensure_capacity(region_count);
+    for (int i = 0; i < region_count; ++i) {
+        void* filler = mmap(nullptr, page_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, 0, 0);
+        if (filler == MAP_FAILED) {
+            perror("mmap");
+            return 1;
+        }
+        filler_regions.unchecked_append(filler);
+    }
+
+    size_t size = page_count * page_size;
+    u64 total_elapsed_ms = 0;
+    for (int round = 0; round < rounds; ++round) {
+        auto* data = (volatile u8*)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, 0, 0);
+        if (data == MAP_FAILED) {
+            perror("mmap");
+            return 1;
+        }
+
+        Core::ElapsedTimer timer;
+        timer.start();
+        for (size_t offset = 0; offset < size; offset += page_size)
+            data[offset] = 1;
+        auto elapsed_ms = timer.elapsed();
+        total_elapsed_ms += elapsed_ms;
+
+        printf("Round %d: %d faults in %dms\n", round + 1, page_count, elapsed_ms);
+
+        if (munmap((void*)data, size) < 0) {
+            perror("munmap");
+            return 1;
+        }
+    }
+
+    u64 total_faults = (u64)page_count * rounds;
+    printf("Finished: regions=%zu faults=%llu time=%llums faults_per_second=%llu\n",
+        filler_regions.size() + 1,
+        total_faults,
+        total_elapsed_ms,
+        total_elapsed_ms ? total_faults * 1000 / total_elapsed_ms : total_faults * 1000);
+
+    for (auto* filler : filler_regions)
+        munmap(filler, page_size);
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/JsonArray.h>
+#include <AK/JsonObject.h>
+#include <AK/JsonValue.h>
+#include <LibCore/ArgsParser.h>
+#include <LibCore/ElapsedTimer.h>
+#include <LibCore/File.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+struct AdapterCounters {
+    u32 packets_in { 0 };
+    u32 packets_out { 0 };
+};
+
+static Optional<AdapterCounters> read_adapter_counters(const String& adapter_name)
+{
+    auto file = Core::File::construct("/proc/net/adapters");
+    if (!file->open(Core::IODevice::ReadOnly)) {
+        fprintf(stderr, "Error: %s\n", file->error_string());
+        return {};
+    }
+    auto json = JsonValue::from_string(file->read_all());
+    if (!json.has_value() || !json.value().is_array())
+        return {};
+    Optional<AdapterCounters> counters;
+    json.value().as_array().for_each([&](auto& value) {
+        auto& adapter = value.as_object();
+        if (adapter.get("name").to_string() != adapter_name)
+            return;
+        counters = AdapterCounters { adapter.get("packets_in").to_u32(), adapter.get("packets_out").to_u32() };
+    });
+    return counters;
+}
+
+static int accept_one_connection(u16 port)
+{
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    int option = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(listen_fd, (const sockaddr*)&address, sizeof(address)) < 0) {
+        perror("bind");
+        return -1;
+    }
+    if (listen(listen_fd, 1) < 0) {
+        perror("listen");
+        return -1;
+    }
+    printf("Waiting for a connection on port %u...\n", port);
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0)
+        perror("accept");
+    close(listen_fd);
+    return fd;
+}
+
+// Sinks a TCP stream and reports how many packets per second an adapter moves while doing so.
+int main(int argc, char** argv)
+{
+    const char* adapter_name = "e1k0";
+    int port = 8888;
+    int duration_in_seconds = 10;
+
+    Core::ArgsParser args_parser;
+    args_parser.set_general_help("Measure packets per second on a network adapter while draining a TCP stream, e.g. `nc 127.0.0.1 8888 < /dev/zero` on the QEMU host.");
+    args_parser.add_option(adapter_name, "Adapter to sample", "adapter", 'i', "name");
+    args_parser.add_option(port, "Port to listen on", "port", 'p', "port");
+    args_parser.add_option(duration_in_seconds, "How long to measure", "duration", 'd', "seconds");
+    args_parser.parse(argc, argv);
+
+    if (port <= 0 || port > 65535 || duration_in_seconds <= 0) {
+        args_parser.print_usage(stderr, argv[0]);
+        return 1;
+    }
+
+    if (!read_adapter_counters(adapter_name).has_value()) {
+        fprintf(stderr, "No such adapter: %s\n", adapter_name);
+        return 1;
+    }
+
+    int fd = accept_one_connection(port);
+    if (fd < 0)
+        return 1;
+
+    static u8 buffer[64 * KiB];
+    u64 total_bytes = 0;
+    u64 total_packets_in = 0;
+    auto previous_counters = read_adapter_counters(adapter_name).value();
+    Core::ElapsedTimer timer;
+    timer.start();
+    int elapsed_seconds = 0;
+    bool connection_open = true;
+    while (connection_open && elapsed_seconds < duration_in_seconds) {
+        int next_sample_in_ms = max((elapsed_seconds + 1) * 1000 - timer.elapsed(), 0);
+        pollfd poll_fd { fd, POLLIN, 0 };
+        int rc = poll(&poll_fd, 1, next_sample_in_ms);
+        if (rc < 0) {
+            perror("poll");
+            return 1;
+        }
+        if (rc > 0) {
+            auto nread = read(fd, buffer, sizeof(buffer));
+            if (nread < 0) {
+                perror("read");
+                return 1;
+            }
+            if (nread == 0)
+                connection_open = false;
+            total_bytes += nread;
+        }
+        if (timer.elapsed() < (elapsed_seconds + 1) * 1000)
+            continue;
+
+        ++elapsed_seconds;
+        auto counters = read_adapter_counters(adapter_name).value_or(previous_counters);
+        u32 packets_in = counters.packets_in - previous_counters.packets_in;
+        u32 packets_out = counters.packets_out - previous_counters.packets_out;
+        previous_counters = counters;
+        total_packets_in += packets_in;
+        printf("%3d s: %u pps in, %u pps out\n", elapsed_seconds, packets_in, packets_out);
+    }
+    close(fd);
+
+    if (elapsed_seconds == 0) {
+        fprintf(stderr, "Connection closed before the first sample.\n");
+        return 1;
+    }
+    printf("Average: %llu pps in, %llu KiB/s received\n", total_packets_in / elapsed_seconds, total_bytes / KiB / elapsed_seconds);
+    return 0;
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <LibCore/ArgsParser.h>
+#include <LibCore/ElapsedTimer.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static constexpr u16 benchmark_port = 10102;
+
+static void create_file(const char* path, size_t size)
+{
+    int fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0600);
+    if (fd < 0) {
+        perror("open");
+        exit(1);
+    }
+    u8 buffer[64 * KiB];
+    for (size_t i = 0; i < sizeof(buffer); ++i)
+        buffer[i] = i % 251;
+    for (size_t nwritten = 0; nwritten < size;) {
+        auto nwrite = write(fd, buffer, min(sizeof(buffer), size - nwritten));
+        if (nwrite <= 0) {
+            perror("write");
+            exit(1);
+        }
+        nwritten += nwrite;
+    }
+    close(fd);
+}
+
+static int listen_on_loopback()
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        exit(1);
+    }
+    int option = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(benchmark_port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (const sockaddr*)&address, sizeof(address)) < 0) {
+        perror("bind");
+        exit(1);
+    }
+    if (listen(fd, 1) < 0) {
+        perror("listen");
+        exit(1);
+    }
+    return fd;
+}
+
+static pid_t start_receiver(size_t expected_size)
+{
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid != 0)
+        return pid;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(benchmark_port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (const sockaddr*)&address, sizeof(address)) < 0) {
+        perror("connect");
+        _exit(1);
+    }
+    static u8 buffer[64 * KiB];
+    size_t total_nread = 0;
+    for (;;) {
+        auto nread = read(fd, buffer, sizeof(buffer));
+        if (nread < 0) {
+            perror("read");
+            _exit(1);
+        }
+        if (nread == 0)
+            break;
+        total_nread += nread;
+    }
+    _exit(total_nread == expected_size ? 0 : 1);
+}
+
+static bool send_with_read_write(int socket_fd, int file_fd, size_t)
+{
+    static u8 buffer[64 * KiB];
+    for (;;) {
+        auto nread = read(file_fd, buffer, sizeof(buffer));
+        if (nread < 0) {
+            perror("read");
+            return false;
+        }
+        if (nread == 0)
+            return true;
+        for (ssize_t nwritten = 0; nwritten < nread;) {
+            auto nwrite = write(socket_fd, buffer + nwritten, nread - nwritten);
+            if (nwrite < 0) {
+                perror("write");
+                return false;
+            }
+            nwritten += nwrite;
+        }
+    }
+}
+
+static bool send_with_sendfile(int socket_fd, int file_fd, size_t size)
+{
+    for (size_t nsent = 0; nsent < size;) {
+        auto nsend = sendfile(socket_fd, file_fd, nullptr, size - nsent);
+        if (nsend < 0) {
+            perror("sendfile");
+            return false;
+        }
+        if (nsend == 0)
+            break;
+        nsent += nsend;
+    }
+    return true;
+}
+
+// Measures how fast a file can be served over a loopback TCP connection.
+int main(int argc, char** argv)
+{
+    int size_in_mib = 64;
+    const char* path = "/tmp/sendfile_benchmark";
+
+    Core::ArgsParser args_parser;
+    args_parser.set_general_help("Compare serving a file over loopback TCP with read()+write() and sendfile().");
+    args_parser.add_option(size_in_mib, "Size of the file to serve", "size", 's', "MiB");
+    args_parser.add_option(path, "Path of the temporary file", "file", 'f', "path");
+    args_parser.parse(argc, argv);
+
+    if (size_in_mib <= 0) {
+        args_parser.print_usage(stderr, argv[0]);
+        return 1;
+    }
+
+    size_t size = (size_t)size_in_mib * MiB;
+    create_file(path, size);
+    int listen_fd = listen_on_loopback();
+
+    struct Method {
+        const char* name;
+        bool (*send)(int, int, size_t);
+    };
+    int exit_code = 0;
+    for (auto& method : { Method { "read+write", send_with_read_write }, Method { "sendfile", send_with_sendfile } }) {
+        int file_fd = open(path, O_RDONLY);
+        if (file_fd < 0) {
+            perror("open");
+            return 1;
+        }
+        pid_t receiver_pid = start_receiver(size);
+        int socket_fd = accept(listen_fd, nullptr, nullptr);
+        if (socket_fd < 0) {
+            perror("accept");
+            return 1;
+        }
+
+        Core::ElapsedTimer timer;
+        timer.start();
+        bool ok = method.send(socket_fd, file_fd, size);
+        close(socket_fd);
+        int status = 0;
+        waitpid(receiver_pid, &status, 0);
+        auto elapsed_ms = max(timer.elapsed(), 1);
+        close(file_fd);
+
+        if (!ok || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "%s: transfer failed\n", method.name);
+            exit_code = 1;
+            continue;
+        }
+        printf("%s: size=%dMiB time=%dms throughput=%zuMiB/s\n",
+            method.name,
+            size_in_mib,
+            elapsed_ms,
+            (size_t)((u64)size * 1000 / elapsed_ms / MiB));
+    }
+
+    close(listen_fd);
+    unlink(path);
+    return exit_code;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <LibCore/ArgsParser.h>
+#include <LibCore/ElapsedTimer.h>
+#include <errno.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static void grow_address_space(size_t size)
+{
+    auto* data = (volatile u8*)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, 0, 0);
+    if (data == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    // NOTE: Touch every page so that fork() actually has something to copy.
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    for (size_t offset = 0; offset < size; offset += page_size)
+        data[offset] = 1;
+}
+
+static void wait_for(pid_t pid)
+{
+    int status;
+    if (waitpid(pid, &status, 0) < 0) {
+        perror("waitpid");
+        exit(1);
+    }
+}
+
+static pid_t fork_and_exec(const char* path, char* const argv[])
+{
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        execv(path, argv);
+        perror("execv");
+        _exit(127);
+    }
+    return pid;
+}
+
+static pid_t spawn(const char* path, char* const argv[])
+{
+    pid_t pid;
+    if (int rc = posix_spawn(&pid, path, nullptr, nullptr, argv, environ); rc != 0) {
+        errno = rc;
+        perror("posix_spawn");
+        exit(1);
+    }
+    return pid;
+}
+
+// Measures how long it takes to start a trivial program from a parent with a big address space.
+int main(int argc, char** argv)
+{
+    int size_in_mib = 256;
+    int iterations = 100;
+    const char* path = "/bin/true";
+
+    Core::ArgsParser args_parser;
+    args_parser.set_general_help("Measure fork+exec and posix_spawn latency from a big parent process.");
+    args_parser.add_option(size_in_mib, "Size of the parent's address space", "size", 's', "MiB");
+    args_parser.add_option(iterations, "Number of programs to start", "iterations", 'n', "count");
+    args_parser.add_option(path, "Program to start", "program", 'p', "path");
+    args_parser.parse(argc, argv);
+
+    if (size_in_mib < 0 || iterations <= 0) {
+        args_parser.print_usage(stderr, argv[0]);
+        return 1;
+    }
+
+    grow_address_space((size_t)size_in_mib * MiB);
+
+    char* child_argv[] = { const_cast<char*>(path), nullptr };
+    struct Method {
+        const char* name;
+        pid_t (*start)(const char*, char* const[]);
+    };
+    for (auto& method : { Method { "fork+exec", fork_and_exec }, Method { "posix_spawn", spawn } }) {
+        Core::ElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < iterations; ++i)
+            wait_for(method.start(path, child_argv));
+        auto elapsed_ms = timer.elapsed();
+
+        printf("%s: size=%dMiB iterations=%d time=%dms (%dus each)\n",
+            method.name,
+            size_in_mib,
+            iterations,
+            elapsed_ms,
+            elapsed_ms * 1000 / iterations);
+    }
+    return 0;
+}
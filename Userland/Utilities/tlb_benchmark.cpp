@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/JsonObject.h>
+#include <AK/JsonValue.h>
+#include <LibCore/ArgsParser.h>
+#include <LibCore/ElapsedTimer.h>
+#include <LibCore/File.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static unsigned large_pages_mapped()
+{
+    auto file = Core::File::construct("/proc/memstat");
+    if (!file->open(Core::IODevice::ReadOnly))
+        return 0;
+    auto json = JsonValue::from_string(file->read_all());
+    if (!json.has_value() || !json.value().is_object())
+        return 0;
+    return json.value().as_object().get("large_pages_mapped").to_u32();
+}
+
+static volatile u8* map_and_touch(size_t size, bool allow_large_pages)
+{
+    int flags = MAP_ANONYMOUS | MAP_PRIVATE;
+    // NOTE: Memory that isn't reserved up front is faulted in one small page at a time.
+    if (!allow_large_pages)
+        flags |= MAP_NORESERVE;
+    auto* data = (volatile u8*)mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, 0, 0);
+    if (data == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    for (size_t offset = 0; offset < size; offset += page_size)
+        data[offset] = 1;
+    return data;
+}
+
+static u64 touch_randomly(volatile u8* data, size_t size, int accesses)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t page_count = size / page_size;
+    u32 sum = 0;
+    Core::ElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < accesses; ++i)
+        sum += data[(arc4random_uniform(page_count) * page_size) + (i % page_size)];
+    auto elapsed_ms = timer.elapsed();
+    (void)sum;
+    return elapsed_ms;
+}
+
+// Measures random access across a big anonymous mapping, which is dominated by TLB misses
+// unless the kernel managed to map the memory with large pages.
+int main(int argc, char** argv)
+{
+    int size_in_mib = 256;
+    int accesses = 10000000;
+
+    Core::ArgsParser args_parser;
+    args_parser.set_general_help("Measure the cost of TLB misses with and without large pages.");
+    args_parser.add_option(size_in_mib, "Size of each mapping", "size", 's', "MiB");
+    args_parser.add_option(accesses, "Number of random accesses", "accesses", 'n', "count");
+    args_parser.parse(argc, argv);
+
+    if (size_in_mib <= 0 || accesses <= 0) {
+        args_parser.print_usage(stderr, argv[0]);
+        return 1;
+    }
+
+    size_t size = (size_t)size_in_mib * MiB;
+    for (bool allow_large_pages : { false, true }) {
+        auto large_pages_before = large_pages_mapped();
+        auto* data = map_and_touch(size, allow_large_pages);
+        auto large_pages_after = large_pages_mapped();
+        auto elapsed_ms = touch_randomly(data, size, accesses);
+
+        printf("%s: size=%dMiB large_pages=%d accesses=%d time=%llums\n",
+            allow_large_pages ? "Large pages" : "Small pages",
+            size_in_mib,
+            (int)(large_pages_after - large_pages_before),
+            accesses,
+            elapsed_ms);
+
+        if (munmap((void*)data, size) < 0) {
+            perror("munmap");
+            return 1;
+        }
+    }
+    return 0;
+}